@@ -0,0 +1,47 @@
+﻿#include "pch.h"
+// bench_main.cpp : 計測プログラム（Bench.exe）の入口。第1引数で計測を選ぶ
+//   Bench.exe scan --heap-mb 1024 --dsi
+#include "bench_entry.h"
+#include <cstdio>
+#include <cstring>
+
+struct BenchCommand {
+    const char* name;
+    int (*run)(int argc, char** argv);
+    const char* description;
+};
+
+static const BenchCommand BENCH_COMMANDS[] = {
+    { "scan", ScanBenchMain, "合成アドレス空間での MainRAM ヒープスキャン" },
+    { "tracker", TrackerBenchMain, "DeltaTracker::Update の値毎読み取りと読み取りプランの比較" },
+    { "diff", BlockDiffBenchMain, "差分検出の実装毎の1ティックあたりの時間" },
+    { "names", NameBenchMain, "名前検索の線形探索と NameIndex の比較" },
+    { "json", JsonBenchMain, "full / delta JSON 生成の JsonWriter と断片連結の比較" },
+    { "fanout", FanoutBenchMain, "UnixSocketServer の N クライアント配信と遅いクライアントの影響" },
+    { "monitor", MonitorHostMain, "合成 MainRAM で RunMonitor を動かすホスト" },
+    { "pointers", PointerScanBenchMain, "合成アドレス空間に既知のポインタの鎖を張ったロケータのパス探索の確認" },
+    { "websocket", WebSocketCheckMain, "WebSocket のハンドシェイク・フレームと WebSocketServer の確認" },
+};
+
+static void PrintUsage() {
+    printf("使い方: Bench <計測> [引数...]\n");
+    for (const BenchCommand& command : BENCH_COMMANDS) {
+        printf("  %-8s %s\n", command.name, command.description);
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        PrintUsage();
+        return 2;
+    }
+    for (const BenchCommand& command : BENCH_COMMANDS) {
+        if (strcmp(argv[1], command.name) == 0) {
+            // 計測側から見ると argv[0] が計測名になる
+            return command.run(argc - 1, argv + 1);
+        }
+    }
+    fprintf(stderr, "不明な計測: %s\n", argv[1]);
+    PrintUsage();
+    return 2;
+}
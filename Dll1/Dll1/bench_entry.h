@@ -0,0 +1,31 @@
+﻿#pragma once
+// bench_entry.h : 計測プログラムの入口
+// Windows では Bench プロジェクト（bench_main.cpp）が第1引数で選んで呼ぶ。
+// Linux では各 *_bench.cpp を *_BENCH_MAIN 付きで単体ビルドすると main からそのまま呼ばれる
+
+// 合成アドレス空間での MainRAM ヒープスキャン（scan_bench.cpp）
+int ScanBenchMain(int argc, char** argv);
+
+// DeltaTracker::Update の値毎読み取りと読み取りプランの比較（tracker_bench.cpp）
+int TrackerBenchMain(int argc, char** argv);
+
+// 差分検出の実装毎の1ティックあたりの時間（block_diff_bench.cpp）
+int BlockDiffBenchMain(int argc, char** argv);
+
+// 名前検索の線形探索と NameIndex の比較（name_bench.cpp）
+int NameBenchMain(int argc, char** argv);
+
+// full / delta JSON 生成の JsonWriter と断片連結の比較（json_bench.cpp）
+int JsonBenchMain(int argc, char** argv);
+
+// UnixSocketServer の N クライアント配信と遅いクライアントの影響（fanout_bench.cpp、Linux のみ）
+int FanoutBenchMain(int argc, char** argv);
+
+// 合成 MainRAM で RunMonitor を動かすホスト（monitor_host.cpp、Linux のみ）
+int MonitorHostMain(int argc, char** argv);
+
+// 合成アドレス空間に既知のポインタの鎖を張ったロケータのパス探索の確認（pointer_scan_bench.cpp）
+int PointerScanBenchMain(int argc, char** argv);
+
+// WebSocket のハンドシェイク・フレームと WebSocketServer の確認（websocket_check.cpp、サーバーは Linux のみ）
+int WebSocketCheckMain(int argc, char** argv);
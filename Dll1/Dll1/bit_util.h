@@ -0,0 +1,86 @@
+﻿#pragma once
+// bit_util.h : 64bitワード単位のビットセット操作
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// 最下位の立っているビット位置（word != 0 であること）
+inline uint32_t CountTrailingZeros64(uint64_t word) {
+#if defined(_MSC_VER) && defined(_WIN64)
+    unsigned long index;
+    _BitScanForward64(&index, word);
+    return (uint32_t)index;
+#elif defined(_MSC_VER)
+    // 32bit では64bit版がないので下位・上位の32bitに分けて調べる
+    unsigned long index;
+    if (_BitScanForward(&index, (unsigned long)word)) return (uint32_t)index;
+    _BitScanForward(&index, (unsigned long)(word >> 32));
+    return (uint32_t)index + 32;
+#else
+    return (uint32_t)__builtin_ctzll(word);
+#endif
+}
+
+// 最上位の立っているビット位置（word != 0 であること）
+inline uint32_t HighestSetBit64(uint64_t word) {
+#if defined(_MSC_VER) && defined(_WIN64)
+    unsigned long index;
+    _BitScanReverse64(&index, word);
+    return (uint32_t)index;
+#elif defined(_MSC_VER)
+    unsigned long index;
+    if (_BitScanReverse(&index, (unsigned long)(word >> 32))) return (uint32_t)index + 32;
+    _BitScanReverse(&index, (unsigned long)word);
+    return (uint32_t)index;
+#else
+    return 63u - (uint32_t)__builtin_clzll(word);
+#endif
+}
+
+// n ビットを格納するのに必要なワード数
+inline size_t BitWordCount(size_t n) {
+    return (n + 63) / 64;
+}
+
+inline void SetBit(std::vector<uint64_t>& bits, size_t i) {
+    bits[i >> 6] |= 1ULL << (i & 63);
+}
+
+inline bool TestBit(const std::vector<uint64_t>& bits, size_t i) {
+    return (bits[i >> 6] >> (i & 63)) & 1;
+}
+
+// いずれかのビットが立っているか（ワード単位のOR）
+inline bool AnyBitSet(const std::vector<uint64_t>& bits) {
+    uint64_t acc = 0;
+    for (uint64_t w : bits) acc |= w;
+    return acc != 0;
+}
+
+// a と b の共通部分を out に書き込む（out は a と同じワード数。b の足りない分は0扱い）
+// いずれかのビットが立っていれば true
+inline bool IntersectBits(const std::vector<uint64_t>& a, const std::vector<uint64_t>& b, std::vector<uint64_t>& out) {
+    out.resize(a.size());
+    uint64_t acc = 0;
+    for (size_t w = 0; w < a.size(); w++) {
+        out[w] = (w < b.size()) ? (a[w] & b[w]) : 0;
+        acc |= out[w];
+    }
+    return acc != 0;
+}
+
+// 立っているビットのインデックスを昇順に列挙
+template <typename Func>
+inline void ForEachSetBit(const std::vector<uint64_t>& bits, Func&& func) {
+    for (size_t w = 0; w < bits.size(); w++) {
+        uint64_t word = bits[w];
+        while (word) {
+            func((uint32_t)(w * 64 + CountTrailingZeros64(word)));
+            word &= word - 1;
+        }
+    }
+}
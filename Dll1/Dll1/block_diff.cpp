@@ -0,0 +1,155 @@
+﻿#include "pch.h"
+#include "block_diff.h"
+#include <cstring>
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__)
+#define BLOCK_DIFF_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define BLOCK_DIFF_AVX2_TARGET
+#else
+#define BLOCK_DIFF_AVX2_TARGET __attribute__((target("avx2")))
+#endif
+#endif
+
+using FindChangedBlocksFunc = size_t(*)(const uint8_t*, const uint8_t*, size_t, uint32_t*);
+
+// x86 以外の既定の実装。x86 でも計測・比較のため常にビルドし、SetBlockDiffImpl で選べる
+static size_t FindChangedBlocksScalar(const uint8_t* current, const uint8_t* shadow,
+                                      size_t blockCount, uint32_t* outBlocks) {
+    size_t count = 0;
+    for (size_t b = 0; b < blockCount; b++) {
+        const uint8_t* p = current + b * BLOCK_DIFF_SIZE;
+        const uint8_t* q = shadow + b * BLOCK_DIFF_SIZE;
+        uint64_t diff = 0;
+        for (size_t i = 0; i < BLOCK_DIFF_SIZE; i += 8) {
+            uint64_t x, y;
+            memcpy(&x, p + i, 8);
+            memcpy(&y, q + i, 8);
+            diff |= x ^ y;
+        }
+        if (diff) outBlocks[count++] = (uint32_t)b;
+    }
+    return count;
+}
+
+#ifdef BLOCK_DIFF_X86
+static size_t FindChangedBlocksSSE2(const uint8_t* current, const uint8_t* shadow,
+                                    size_t blockCount, uint32_t* outBlocks) {
+    size_t count = 0;
+    for (size_t b = 0; b < blockCount; b++) {
+        const uint8_t* p = current + b * BLOCK_DIFF_SIZE;
+        const uint8_t* q = shadow + b * BLOCK_DIFF_SIZE;
+        __m128i eq0 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)p),
+                                     _mm_loadu_si128((const __m128i*)q));
+        __m128i eq1 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p + 16)),
+                                     _mm_loadu_si128((const __m128i*)(q + 16)));
+        if (_mm_movemask_epi8(_mm_and_si128(eq0, eq1)) != 0xFFFF) {
+            outBlocks[count++] = (uint32_t)b;
+        }
+    }
+    return count;
+}
+
+BLOCK_DIFF_AVX2_TARGET
+static size_t FindChangedBlocksAVX2(const uint8_t* current, const uint8_t* shadow,
+                                    size_t blockCount, uint32_t* outBlocks) {
+    size_t count = 0;
+    for (size_t b = 0; b < blockCount; b++) {
+        const uint8_t* p = current + b * BLOCK_DIFF_SIZE;
+        const uint8_t* q = shadow + b * BLOCK_DIFF_SIZE;
+        __m256i eq = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)p),
+                                       _mm256_loadu_si256((const __m256i*)q));
+        if ((uint32_t)_mm256_movemask_epi8(eq) != 0xFFFFFFFFu) {
+            outBlocks[count++] = (uint32_t)b;
+        }
+    }
+    return count;
+}
+
+bool CpuSupportsAVX2() {
+#if defined(_MSC_VER)
+    int info[4] = {};
+    __cpuid(info, 0);
+    if (info[0] < 7) return false;
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx) return false;
+    // OSがYMMレジスタを保存するか
+    if ((_xgetbv(0) & 0x6) != 0x6) return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+#else
+bool CpuSupportsAVX2() {
+    return false;
+}
+#endif
+
+struct BlockDiffImpl {
+    FindChangedBlocksFunc func;
+    const char* name;
+};
+
+static BlockDiffImpl SelectBlockDiffImpl() {
+#ifdef BLOCK_DIFF_X86
+    if (CpuSupportsAVX2()) return { FindChangedBlocksAVX2, "avx2" };
+    return { FindChangedBlocksSSE2, "sse2" };
+#else
+    return { FindChangedBlocksScalar, "scalar" };
+#endif
+}
+
+static BlockDiffImpl& GetBlockDiffImpl() {
+    static BlockDiffImpl impl = SelectBlockDiffImpl();
+    return impl;
+}
+
+// 名前で実装を選ぶ。この CPU で使えなければ false
+static bool FindBlockDiffImpl(const char* name, BlockDiffImpl& out) {
+    if (strcmp(name, "scalar") == 0) {
+        out = { FindChangedBlocksScalar, "scalar" };
+        return true;
+    }
+#ifdef BLOCK_DIFF_X86
+    if (strcmp(name, "sse2") == 0) {
+        out = { FindChangedBlocksSSE2, "sse2" };
+        return true;
+    }
+    if (strcmp(name, "avx2") == 0 && CpuSupportsAVX2()) {
+        out = { FindChangedBlocksAVX2, "avx2" };
+        return true;
+    }
+#endif
+    return false;
+}
+
+size_t FindChangedBlocks(const uint8_t* current, const uint8_t* shadow,
+                         size_t blockCount, uint32_t* outBlocks) {
+    return GetBlockDiffImpl().func(current, shadow, blockCount, outBlocks);
+}
+
+const char* GetBlockDiffImplName() {
+    return GetBlockDiffImpl().name;
+}
+
+bool IsBlockDiffImplSupported(const char* name) {
+    BlockDiffImpl impl;
+    return name && FindBlockDiffImpl(name, impl);
+}
+
+bool SetBlockDiffImpl(const char* name) {
+    if (!name) {
+        GetBlockDiffImpl() = SelectBlockDiffImpl();
+        return true;
+    }
+    BlockDiffImpl impl;
+    if (!FindBlockDiffImpl(name, impl)) return false;
+    GetBlockDiffImpl() = impl;
+    return true;
+}
@@ -0,0 +1,28 @@
+﻿#pragma once
+// block_diff.h : ステージングバッファとシャドウコピーのブロック単位差分検出
+// AVX2 / SSE2 / スカラーを実行時に選択する
+
+#include <cstddef>
+#include <cstdint>
+
+// 差分検出の単位（バイト）。バッファはこの倍数に揃えておくこと
+constexpr size_t BLOCK_DIFF_SIZE = 32;
+
+// current と shadow を BLOCK_DIFF_SIZE 単位で比較し、
+// 内容が異なるブロック番号を outBlocks に昇順で書き出す。戻り値は書き出した個数
+// outBlocks は blockCount 個分の領域が必要
+size_t FindChangedBlocks(const uint8_t* current, const uint8_t* shadow,
+                         size_t blockCount, uint32_t* outBlocks);
+
+// 使用中の実装名（"avx2" / "sse2" / "scalar"）
+const char* GetBlockDiffImplName();
+
+// 実装名がこの CPU で使えるか
+bool IsBlockDiffImplSupported(const char* name);
+
+// 実装を名前で選び直す（計測用。nullptr なら CPU に合わせたものに戻す）。使えない実装なら false で変更しない
+// FindChangedBlocks を呼んでいるスレッドがない時に呼ぶこと
+bool SetBlockDiffImpl(const char* name);
+
+// AVX2 が使えるか（CPU と OS の両方。x86 以外は常に false）
+bool CpuSupportsAVX2();
@@ -0,0 +1,141 @@
+﻿#include "pch.h"
+// block_diff_bench.cpp : 差分検出の実装（scalar / sse2 / avx2）毎の1ティックあたりの時間
+// 147（RJ 版のアドレス表と同程度）・1,000・10,000 個の値を登録した DeltaTracker で、
+// 全区間の読み取り＋差分＋変化の列挙＋リセットを1ティックとして計る。差分検出だけの時間も別に出す
+#include "bench_entry.h"
+#include "block_diff.h"
+#include "delta_tracker.h"
+#include "monitor.h"
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+static std::vector<uint8_t> s_diffRam;
+
+static bool DiffBenchRead(uint32_t ramOffset, uint32_t length, uint8_t* outBuffer) {
+    memcpy(outBuffer, s_diffRam.data() + ramOffset, length);
+    return true;
+}
+
+static double DiffElapsedNs(std::chrono::steady_clock::time_point start) {
+    return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+// ========================================
+// 計測プログラムの入口（Windows は Bench プロジェクトの "diff"、Linux は BLOCK_DIFF_BENCH_MAIN を定義して単体でビルド）
+//   g++ -std=c++17 -O2 -DBLOCK_DIFF_BENCH_MAIN block_diff_bench.cpp delta_tracker.cpp name_index.cpp block_diff.cpp -o block_diff_bench
+//   ./block_diff_bench [--ticks N] [--change-rate F] [--seed N]
+// ========================================
+int BlockDiffBenchMain(int argc, char** argv) {
+    uint32_t ticks = 20000;
+    double changeRate = 0.02;   // 1ティックに書き換える値の割合
+    uint64_t seed = 1;
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = (i + 1 < argc) ? argv[i + 1] : "0";
+        if (strcmp(arg, "--ticks") == 0) { ticks = (uint32_t)strtoul(value, nullptr, 10); i++; }
+        else if (strcmp(arg, "--change-rate") == 0) { changeRate = atof(value); i++; }
+        else if (strcmp(arg, "--seed") == 0) { seed = strtoull(value, nullptr, 10); i++; }
+        else {
+            fprintf(stderr, "不明な引数: %s\n", arg);
+            return 2;
+        }
+    }
+    if (ticks == 0) return 2;
+
+    printf("ティック %u, 書き換え %.1f%%/ティック, seed %llu\n", ticks, changeRate * 100.0, (unsigned long long)seed);
+    printf("%6s %-7s %6s %10s %12s %12s\n", "値", "impl", "区間", "ns/tick", "差分のみ ns", "検出した変化");
+
+    for (uint32_t valueCount : { 147u, 1000u, 10000u }) {
+        std::mt19937_64 rng(seed);
+        s_diffRam.assign(DS_MAIN_RAM_SIZE, 0);
+        for (auto& b : s_diffRam) b = (uint8_t)rng();
+
+        // 2バイト値を主に、塊で並べる（ゲームのカード・アビリティ表のような配置）
+        std::vector<std::string> names;
+        std::vector<uint32_t> offsets;
+        std::vector<uint8_t> sizes;
+        while (offsets.size() < valueCount) {
+            uint32_t offset = (uint32_t)(rng() % (DS_MAIN_RAM_SIZE - 0x10000)) & ~3u;
+            uint32_t cluster = 1 + (uint32_t)(rng() % 64);
+            for (uint32_t i = 0; i < cluster && offsets.size() < valueCount; i++) {
+                uint8_t size = (rng() % 4 == 0) ? 4 : 2;
+                offset = (offset + size - 1) & ~(uint32_t)(size - 1);
+                names.push_back("VALUE_" + std::to_string(offsets.size()));
+                offsets.push_back(offset);
+                sizes.push_back(size);
+                offset += size;
+            }
+        }
+
+        uint32_t changesPerTick = (std::max)((uint32_t)(valueCount * changeRate), 1u);
+        std::vector<uint32_t> writeIds((size_t)ticks * changesPerTick);
+        for (auto& id : writeIds) id = (uint32_t)(rng() % valueCount);
+        const std::vector<uint8_t> initialRam = s_diffRam;
+
+        for (const char* impl : { "scalar", "sse2", "avx2" }) {
+            if (!SetBlockDiffImpl(impl)) continue;
+            s_diffRam = initialRam;
+
+            DeltaTracker tracker;
+            for (uint32_t id = 0; id < valueCount; id++) {
+                tracker.RegisterAddress(names[id].c_str(), DS_MAIN_RAM_START + offsets[id], sizes[id], PollTier::Hot);
+            }
+            tracker.UpdateAll(DiffBenchRead, NDS_MAIN_RAM_MASK);
+            tracker.ResetChangeFlags();
+
+            uint64_t changes = 0;
+            uint32_t counter = 0;
+            auto start = std::chrono::steady_clock::now();
+            for (uint32_t t = 0; t < ticks; t++) {
+                for (uint32_t c = 0; c < changesPerTick; c++) {
+                    uint32_t id = writeIds[(size_t)t * changesPerTick + c];
+                    uint32_t v = ++counter;
+                    memcpy(s_diffRam.data() + offsets[id], &v, sizes[id]);
+                }
+                tracker.UpdateAll(DiffBenchRead, NDS_MAIN_RAM_MASK);
+                if (tracker.HasChanges()) {
+                    tracker.ForEachChanged([&](uint32_t) { changes++; });
+                    tracker.ResetChangeFlags();
+                }
+            }
+            double tickNs = DiffElapsedNs(start) / ticks;
+
+            // 差分検出だけ（値と同じ量のバイトを、変化したブロックを書き戻しながら比べる）
+            size_t blockCount = ((size_t)valueCount * 3 + BLOCK_DIFF_SIZE - 1) / BLOCK_DIFF_SIZE;
+            std::vector<uint8_t> current(blockCount * BLOCK_DIFF_SIZE), shadow(blockCount * BLOCK_DIFF_SIZE);
+            std::vector<uint32_t> changed(blockCount);
+            for (size_t i = 0; i < current.size(); i++) current[i] = shadow[i] = (uint8_t)rng();
+            size_t found = 0;
+            start = std::chrono::steady_clock::now();
+            for (uint32_t t = 0; t < ticks; t++) {
+                for (uint32_t c = 0; c < changesPerTick; c++) {
+                    current[writeIds[(size_t)t * changesPerTick + c] % current.size()]++;
+                }
+                size_t n = FindChangedBlocks(current.data(), shadow.data(), blockCount, changed.data());
+                for (size_t i = 0; i < n; i++) {
+                    memcpy(shadow.data() + changed[i] * BLOCK_DIFF_SIZE, current.data() + changed[i] * BLOCK_DIFF_SIZE, BLOCK_DIFF_SIZE);
+                }
+                found += n;
+            }
+            double diffNs = DiffElapsedNs(start) / ticks;
+            (void)found;
+
+            printf("%6u %-7s %6zu %10.1f %12.1f %12llu\n", valueCount, impl, tracker.GetSpanCount(),
+                tickNs, diffNs, (unsigned long long)changes);
+        }
+    }
+    SetBlockDiffImpl(nullptr);
+    return 0;
+}
+
+#ifdef BLOCK_DIFF_BENCH_MAIN
+int main(int argc, char** argv) {
+    return BlockDiffBenchMain(argc, argv);
+}
+#endif
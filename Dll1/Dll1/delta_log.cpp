@@ -0,0 +1,54 @@
+﻿#include "pch.h"
+#include "delta_log.h"
+
+DeltaLog::DeltaLog(size_t capacity)
+    : m_entries(capacity) {
+}
+
+void DeltaLog::Append(uint64_t seq, const std::string& json, const std::string& frame) {
+    size_t capacity = m_entries.size();
+    if (capacity == 0) return;
+
+    size_t pos = (m_head + m_count) % capacity;
+    if (m_count == capacity) {
+        // 満杯: 最古を上書き
+        m_head = (m_head + 1) % capacity;
+    } else {
+        m_count++;
+    }
+    m_entries[pos].seq = seq;
+    m_entries[pos].json = json;   // 既存の容量を再利用
+    m_entries[pos].frame = frame;
+}
+
+bool DeltaLog::CollectSince(uint64_t lastSeq, WireEncoding encoding, std::vector<const std::string*>& out) const {
+    if (lastSeq > m_latestSeq) return false;
+    if (lastSeq == m_latestSeq) return true;
+
+    if (m_count == 0) return false;
+    const size_t capacity = m_entries.size();
+    uint64_t oldestSeq = m_entries[m_head].seq;
+
+    // lastSeq+1 が残っていなければ再送不可
+    // （seq は必ず Append と対で払い出すため、リング内に欠番はない）
+    if (lastSeq + 1 < oldestSeq) return false;
+
+    size_t first = out.size();
+    for (size_t i = 0; i < m_count; i++) {
+        const Entry& e = m_entries[(m_head + i) % capacity];
+        if (e.seq <= lastSeq) continue;
+        const std::string& message = (encoding == WireEncoding::Binary) ? e.frame : e.json;
+        if (message.empty()) {
+            // この形式では記録していない
+            out.resize(first);
+            return false;
+        }
+        out.push_back(&message);
+    }
+    return true;
+}
+
+void DeltaLog::Clear() {
+    m_head = 0;
+    m_count = 0;
+}
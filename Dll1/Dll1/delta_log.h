@@ -0,0 +1,43 @@
+﻿#pragma once
+// delta_log.h : 送信済み delta メッセージの連番付きリングバッファ
+// クライアント毎に転送形式が異なるため、JSON とバイナリフレームの両方を保持できる
+// クライアントは最後に受け取った seq を指定して欠落分だけを再送してもらえる
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "wire_format.h"
+
+class DeltaLog {
+public:
+    explicit DeltaLog(size_t capacity = 256);
+
+    // 次に使う seq を払い出す（1始まり、単調増加）
+    uint64_t NextSeq() { return ++m_latestSeq; }
+
+    // 最後に払い出した seq（未発行なら0）
+    uint64_t GetLatestSeq() const { return m_latestSeq; }
+
+    // seq で払い出した delta を記録。容量を超えたら最古のものから破棄
+    // frame: バイナリフレーム（バイナリのクライアントがいない時は空でよい）
+    void Append(uint64_t seq, const std::string& json, const std::string& frame);
+
+    // lastSeq より後の delta を古い順に、encoding の形式で out へ追加
+    // 欠落分がすでに破棄されている、その形式で記録されていない、
+    // または lastSeq が未来の値なら false（フルステートが必要）
+    bool CollectSince(uint64_t lastSeq, WireEncoding encoding, std::vector<const std::string*>& out) const;
+
+    void Clear();
+
+private:
+    struct Entry {
+        uint64_t seq;
+        std::string json;
+        std::string frame;
+    };
+
+    std::vector<Entry> m_entries;   // リング本体
+    size_t m_head = 0;              // 最古エントリの位置
+    size_t m_count = 0;
+    uint64_t m_latestSeq = 0;
+};
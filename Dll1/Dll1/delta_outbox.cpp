@@ -0,0 +1,33 @@
+﻿#include "pch.h"
+#include "delta_outbox.h"
+#include "bit_util.h"
+#include <algorithm>
+
+void DeltaOutbox::Merge(const std::vector<uint64_t>& changedBits, uint64_t seq) {
+    if (m_bits.size() < changedBits.size()) {
+        m_bits.resize(changedBits.size(), 0);
+    }
+    for (size_t w = 0; w < changedBits.size(); w++) {
+        m_bits[w] |= changedBits[w];
+    }
+
+    // 2件目以降は、送られずに合流した delta として数える
+    if (m_firstSeq == 0) {
+        m_firstSeq = seq;
+    } else {
+        m_coalescedCount++;
+    }
+    m_lastSeq = seq;
+}
+
+bool DeltaOutbox::Merge(const std::vector<uint64_t>& changedBits, const std::vector<uint64_t>& subscription, uint64_t seq) {
+    if (!IntersectBits(changedBits, subscription, m_scratch)) return false;
+    Merge(m_scratch, seq);
+    return true;
+}
+
+void DeltaOutbox::Clear() {
+    std::fill(m_bits.begin(), m_bits.end(), 0);
+    m_firstSeq = 0;
+    m_lastSeq = 0;
+}
@@ -0,0 +1,40 @@
+﻿#pragma once
+// delta_outbox.h : 送信が詰まっているクライアント向けの合流待ち delta（最新値優先）
+// 送信中に発生した delta はキューに積まず、変化した値 id の集合にまとめておく
+// 送信が空いたら、集合の各値の最新値だけを1つの合流 delta として送る
+// 保持するのは id のビットセットだけなので、遅れが続いてもメモリと帯域は登録数で頭打ちになる
+
+#include <cstdint>
+#include <vector>
+
+class DeltaOutbox {
+public:
+    // seq の delta で変化した値（changedBits）を合流させる
+    void Merge(const std::vector<uint64_t>& changedBits, uint64_t seq);
+
+    // 購読中のクライアント用。changedBits のうち subscription に含まれる値だけを合流させる
+    // 該当する値がなければ何もせず false（その delta はこのクライアントには関係ない）
+    bool Merge(const std::vector<uint64_t>& changedBits, const std::vector<uint64_t>& subscription, uint64_t seq);
+
+    // 合流待ちの変化を破棄（フルステート送信・再送で不要になった時）
+    void Clear();
+
+    bool IsEmpty() const { return m_firstSeq == 0; }
+
+    // 合流待ちに含まれる最初と最後の delta の seq（空なら0）
+    uint64_t GetFirstSeq() const { return m_firstSeq; }
+    uint64_t GetLastSeq() const { return m_lastSeq; }
+
+    // 合流待ちの値 id のビットセット
+    const std::vector<uint64_t>& GetBits() const { return m_bits; }
+
+    // 他の delta に合流させた（単独では送らなかった）delta の累計
+    uint64_t GetCoalescedCount() const { return m_coalescedCount; }
+
+private:
+    std::vector<uint64_t> m_bits;
+    std::vector<uint64_t> m_scratch;
+    uint64_t m_firstSeq = 0;
+    uint64_t m_lastSeq = 0;
+    uint64_t m_coalescedCount = 0;
+};
@@ -1,117 +1,497 @@
 ﻿#include "pch.h"
 #include "delta_tracker.h"
 #include "json_util.h"
+#include "block_diff.h"
+#include "bit_util.h"
+#include "wire_format.h"
+#include "shared_state.h"
 #include <cstring>
+#include <algorithm>
 
-void DeltaTracker::RegisterAddress(const char* name, uint32_t addr, uint8_t size) {
-    TrackedValue tv = {};
-    tv.name = name;
-    tv.dsAddress = addr;
-    tv.size = size;
-    tv.currentValue = 0;
-    tv.lastSentValue = 0;
-    tv.changed = false;
-    tv.initialized = false;
-    m_values.push_back(tv);
-}
-
-void DeltaTracker::Update(MemoryReadFunc readFunc) {
-    for (auto& tv : m_values) {
-        uint32_t newValue = 0;
-        if (readFunc(tv.dsAddress, tv.size, &newValue)) {
-            if (!tv.initialized || tv.currentValue != newValue) {
-                tv.changed = true;
-            }
-            tv.currentValue = newValue;
-            tv.initialized = true;
+// この距離以内の隙間は同じ区間として読む（読み取り回数削減を優先）
+static constexpr uint32_t READ_SPAN_MERGE_GAP = 32;
+
+// 階層毎の読み取り周期（ティック数）
+static constexpr uint32_t POLL_TIER_PERIODS[] = { 1, 4, 16 };
+
+// 変化がこのティック数続かなければ1段降格（60Hzで約2秒 / 約10秒）
+static constexpr uint32_t HOT_DEMOTE_TICKS = 120;
+static constexpr uint32_t WARM_DEMOTE_TICKS = 600;
+
+// 降格判定の間隔（全値の走査を間引く）
+static constexpr uint32_t TIER_REVIEW_INTERVAL = 64;
+
+// 値1つ分の16進表記の最大桁数
+static constexpr size_t VALUE_HEX_DIGITS = 8;
+
+// ステージングバッファからリトルエンディアン値を取り出す
+static uint32_t DecodeValue(const uint8_t* p, uint8_t size) {
+    switch (size) {
+    case 4: { uint32_t v; memcpy(&v, p, 4); return v; }
+    case 2: { uint16_t v; memcpy(&v, p, 2); return v; }
+    default: return p[0];
+    }
+}
+
+void DeltaTracker::RegisterAddress(const char* name, uint32_t addr, uint8_t size, PollTier tier) {
+    m_names.push_back(name);
+    m_addresses.push_back(addr);
+    m_sizes.push_back(size);
+    m_registeredTiers.push_back((uint8_t)tier);
+    m_nameIndex.Insert(name, (uint32_t)(m_names.size() - 1));
+
+    // JSON断片を作成（JsonWriter と同じエスケープ・書式）
+    JsonWriter keyWriter;
+    keyWriter.Key(name);
+    m_keyFragOffsets.push_back((uint32_t)m_fragments.size());
+    m_fragments += keyWriter.GetString();
+    m_fragments += "{\"v\":\"";
+    m_keyFragLengths.push_back((uint16_t)(m_fragments.size() - m_keyFragOffsets.back()));
+
+    char staticFrag[48];
+    int staticLen = snprintf(staticFrag, sizeof(staticFrag), "\",\"a\":\"%08X\",\"s\":%u}", addr, (unsigned)size);
+    m_staticFragOffsets.push_back((uint32_t)m_fragments.size());
+    m_fragments.append(staticFrag, staticLen);
+    m_staticFragLengths.push_back((uint16_t)staticLen);
+    m_currentValues.push_back(0);
+    m_stagingOffsets.push_back(0);
+    m_tiers.push_back((uint8_t)tier);
+    m_lastChangeTick.push_back(0);
+    m_valueHex.resize(m_valueHex.size() + VALUE_HEX_DIGITS, '0');
+    m_changedBits.resize(BitWordCount(m_names.size()), 0);
+    m_initializedBits.resize(BitWordCount(m_names.size()), 0);
+    m_activeBits.resize(BitWordCount(m_names.size()), 0);
+    SetBit(m_activeBits, m_names.size() - 1);
+    m_planValid = false;
+}
+
+void DeltaTracker::SetActiveIds(const std::vector<uint64_t>& activeBits) {
+    const size_t count = m_names.size();
+    bool changed = false;
+    for (size_t w = 0; w < m_activeBits.size(); w++) {
+        uint64_t word = (w < activeBits.size()) ? activeBits[w] : 0;
+        if ((w + 1) * 64 > count) {
+            word &= (1ULL << (count & 63)) - 1;  // 登録数を超えるビットは無視
         }
+        if (word == m_activeBits[w]) continue;
+
+        // 外れた値は読まなくなるので、値を捨てて未初期化に戻す
+        uint64_t removed = m_activeBits[w] & ~word;
+        m_initializedBits[w] &= ~removed;
+        m_changedBits[w] &= ~removed;
+        m_activeBits[w] = word;
+        changed = true;
+    }
+    if (changed) {
+        m_planValid = false;
     }
 }
 
-std::string DeltaTracker::BuildHelloJson() const {
-    JsonWriter jw;
-    jw.BeginObject();
-    jw.StringField("type", "hello");
-    jw.StringField("version", "1.0");
-    jw.UIntField("addresses", (uint32_t)m_values.size());
-    jw.EndObject();
-    return jw.GetString();
+size_t DeltaTracker::CountActive() const {
+    size_t active = 0;
+    ForEachSetBit(m_activeBits, [&](uint32_t) { active++; });
+    return active;
 }
 
-std::string DeltaTracker::BuildFullStateJson() const {
-    JsonWriter jw;
-    jw.BeginObject();
-    jw.StringField("type", "full");
+void DeltaTracker::BuildReadPlan(uint32_t ramMask) {
+    m_spans.clear();
+    m_planOrder.clear();
 
-    jw.Key("data");
-    jw.BeginObject();
-    for (const auto& tv : m_values) {
-        if (!tv.initialized) continue;
+    auto ramOffsetOf = [&](uint32_t id) {
+        return (m_addresses[id] - DS_MAIN_RAM_START) & ramMask;
+    };
 
-        jw.Key(tv.name);
-        jw.BeginObject();
-        jw.HexValueField("v", tv.currentValue, tv.size);
-        jw.HexField("a", tv.dsAddress);
-        jw.UIntField("s", tv.size);
-        jw.EndObject();
+    // 読み取り対象の値だけでプランを作る
+    ForEachSetBit(m_activeBits, [&](uint32_t id) { m_planOrder.push_back(id); });
+    const uint32_t count = (uint32_t)m_planOrder.size();
+    std::sort(m_planOrder.begin(), m_planOrder.end(), [&](uint32_t a, uint32_t b) {
+        return ramOffsetOf(a) < ramOffsetOf(b);
+    });
+
+    uint32_t stagingSize = 0;
+    for (uint32_t k = 0; k < count; k++) {
+        uint32_t id = m_planOrder[k];
+        uint32_t offset = ramOffsetOf(id);
+        uint32_t end = offset + m_sizes[id];
+
+        ReadSpan* span = m_spans.empty() ? nullptr : &m_spans.back();
+        if (span && offset <= span->ramOffset + span->length + READ_SPAN_MERGE_GAP) {
+            // 既存区間を延長（重複アドレスもここで吸収される）
+            uint32_t spanEnd = (std::max)(span->ramOffset + span->length, end);
+            stagingSize += spanEnd - (span->ramOffset + span->length);
+            span->length = spanEnd - span->ramOffset;
+            span->valueCount++;
+        } else {
+            ReadSpan newSpan = {};
+            newSpan.ramOffset = offset;
+            newSpan.length = m_sizes[id];
+            newSpan.stagingOffset = stagingSize;
+            newSpan.firstValue = k;
+            newSpan.valueCount = 1;
+            newSpan.tier = PollTier::Cold;
+            m_spans.push_back(newSpan);
+            stagingSize += m_sizes[id];
+            span = &m_spans.back();
+        }
+        m_stagingOffsets[id] = span->stagingOffset + (offset - span->ramOffset);
     }
-    jw.EndObject();
 
-    jw.EndObject();
-    return jw.GetString();
+    // 差分検出用にブロック境界へ揃える（余白は常に0のまま）
+    size_t blockCount = (stagingSize + BLOCK_DIFF_SIZE - 1) / BLOCK_DIFF_SIZE;
+    m_staging.assign(blockCount * BLOCK_DIFF_SIZE, 0);
+    m_shadow.assign(blockCount * BLOCK_DIFF_SIZE, 0);
+    m_changedBlocks.resize(blockCount);
+
+    // ブロック → 値 id の対応表（ブロック境界を跨ぐ値は両方に入る）
+    auto firstBlockOf = [&](uint32_t id) { return m_stagingOffsets[id] / BLOCK_DIFF_SIZE; };
+    auto lastBlockOf = [&](uint32_t id) { return (m_stagingOffsets[id] + m_sizes[id] - 1) / BLOCK_DIFF_SIZE; };
+
+    m_blockFirst.assign(blockCount + 1, 0);
+    for (uint32_t id : m_planOrder) {
+        for (size_t b = firstBlockOf(id); b <= lastBlockOf(id); b++) m_blockFirst[b + 1]++;
+    }
+    for (size_t b = 0; b < blockCount; b++) m_blockFirst[b + 1] += m_blockFirst[b];
+    m_blockValues.resize(m_blockFirst[blockCount]);
+    std::vector<uint32_t> fill(m_blockFirst.begin(), m_blockFirst.end() - 1);
+    for (uint32_t id : m_planOrder) {
+        for (size_t b = firstBlockOf(id); b <= lastBlockOf(id); b++) m_blockValues[fill[b]++] = id;
+    }
+
+    for (auto& span : m_spans) {
+        CountUninitialized(span);
+    }
+
+    m_planMask = ramMask;
+    m_planValid = true;
+    m_shadowValid = false;
+    RecomputeSpanTiers();
 }
 
-std::string DeltaTracker::BuildDeltaJson() const {
-    // 変化があるか先にチェック
-    bool anyChanged = false;
-    for (const auto& tv : m_values) {
-        if (tv.changed) {
-            anyChanged = true;
-            break;
+void DeltaTracker::CountUninitialized(ReadSpan& span) const {
+    span.uninitializedCount = 0;
+    for (uint32_t k = span.firstValue; k < span.firstValue + span.valueCount; k++) {
+        if (!TestBit(m_initializedBits, m_planOrder[k])) span.uninitializedCount++;
+    }
+}
+
+void DeltaTracker::RecomputeSpanTiers() {
+    for (auto& span : m_spans) {
+        uint8_t tier = (uint8_t)PollTier::Cold;
+        for (uint32_t k = span.firstValue; k < span.firstValue + span.valueCount; k++) {
+            tier = (std::min)(tier, m_tiers[m_planOrder[k]]);
         }
+        span.tier = (PollTier)tier;
     }
+    m_spanTiersDirty = false;
+}
 
-    if (!anyChanged) return "";
+void DeltaTracker::ReviewTiers() {
+    for (uint32_t id = 0; id < (uint32_t)m_tiers.size(); id++) {
+        if (m_registeredTiers[id] == (uint8_t)PollTier::Hot) continue;
 
-    JsonWriter jw;
-    jw.BeginObject();
-    jw.StringField("type", "delta");
+        uint32_t quietTicks = m_tick - m_lastChangeTick[id];
+        PollTier tier = (PollTier)m_tiers[id];
+        if (tier == PollTier::Hot && quietTicks >= HOT_DEMOTE_TICKS) {
+            m_tiers[id] = (uint8_t)PollTier::Warm;
+            m_spanTiersDirty = true;
+        } else if (tier == PollTier::Warm && quietTicks >= WARM_DEMOTE_TICKS) {
+            m_tiers[id] = (uint8_t)PollTier::Cold;
+            m_spanTiersDirty = true;
+        }
+    }
+}
 
-    jw.Key("data");
-    jw.BeginObject();
-    for (const auto& tv : m_values) {
-        if (!tv.changed) continue;
+void DeltaTracker::EncodeValueHex(uint32_t id) {
+    static const char HEX_DIGITS[] = "0123456789ABCDEF";
+    uint32_t value = m_currentValues[id];
+    size_t digits = (size_t)m_sizes[id] * 2;
+    char* out = m_valueHex.data() + (size_t)id * VALUE_HEX_DIGITS;
+    for (size_t i = 0; i < digits; i++) {
+        out[digits - 1 - i] = HEX_DIGITS[value & 0xF];
+        value >>= 4;
+    }
+}
+
+void DeltaTracker::DecodeTrackedValue(uint32_t id) {
+    uint32_t newValue = DecodeValue(m_staging.data() + m_stagingOffsets[id], m_sizes[id]);
+    if (!TestBit(m_initializedBits, id)) {
+        SetBit(m_initializedBits, id);
+        SetBit(m_changedBits, id);
+        m_lastChangeTick[id] = m_tick;
+    } else if (m_currentValues[id] != newValue) {
+        SetBit(m_changedBits, id);
+        m_lastChangeTick[id] = m_tick;
+        // 変化を観測したら Hot に昇格
+        if (m_tiers[id] != (uint8_t)PollTier::Hot) {
+            m_tiers[id] = (uint8_t)PollTier::Hot;
+            m_spanTiersDirty = true;
+        }
+    } else {
+        return;
+    }
+    m_currentValues[id] = newValue;
+    EncodeValueHex(id);
+}
+
+void DeltaTracker::Update(MemoryBlockReadFunc readFunc, uint32_t ramMask) {
+    Sample(readFunc, ramMask, false);
+}
+
+void DeltaTracker::UpdateAll(MemoryBlockReadFunc readFunc, uint32_t ramMask) {
+    Sample(readFunc, ramMask, true);
+}
+
+void DeltaTracker::Sample(MemoryBlockReadFunc readFunc, uint32_t ramMask, bool allSpans) {
+    if (!m_planValid || m_planMask != ramMask) {
+        BuildReadPlan(ramMask);
+    }
+    if (m_spanTiersDirty) {
+        RecomputeSpanTiers();
+    }
 
-        jw.Key(tv.name);
+    // 初回・プラン再構築直後は全区間を読んで全値をデコード
+    // その後は、未読み取りの値が残っている区間だけを毎ティック読んで全デコードし（読めない値があっても他の区間は差分検出のまま）、
+    // 残りの区間は階層の周期で読んで差分検出する
+    const bool decodeAll = !m_shadowValid;
+    if (decodeAll) allSpans = true;
+
+    m_tick++;
+
+    for (uint32_t i = 0; i < (uint32_t)m_spans.size(); i++) {
+        ReadSpan& span = m_spans[i];
+        bool decodeSpan = decodeAll || span.uninitializedCount > 0;
+        if (!allSpans && !decodeSpan) {
+            // 同じ階層の区間が同じティックに集中しないよう区間番号で位相をずらす
+            uint32_t period = POLL_TIER_PERIODS[(uint8_t)span.tier];
+            if ((m_tick + i) % period != 0) continue;
+        }
+
+        uint8_t* dst = m_staging.data() + span.stagingOffset;
+        if (!readFunc(span.ramOffset, span.length, dst)) continue;
+
+        if (decodeSpan) {
+            DecodeSpan(span);
+        } else {
+            DiffSpan(span);
+        }
+    }
+
+    if (decodeAll) {
+        m_shadow = m_staging;
+        m_shadowValid = true;
+    }
+
+    if (m_tick % TIER_REVIEW_INTERVAL == 0) {
+        ReviewTiers();
+    }
+}
+
+void DeltaTracker::DecodeSpan(ReadSpan& span) {
+    for (uint32_t k = span.firstValue; k < span.firstValue + span.valueCount; k++) {
+        DecodeTrackedValue(m_planOrder[k]);
+    }
+    CountUninitialized(span);
+    // 以降の差分検出の基準にする（区間の前後と共有するブロックも、その区間の処理で同じ内容に揃っている）
+    size_t firstBlock = span.stagingOffset / BLOCK_DIFF_SIZE;
+    size_t lastBlock = (span.stagingOffset + span.length - 1) / BLOCK_DIFF_SIZE;
+    memcpy(m_shadow.data() + firstBlock * BLOCK_DIFF_SIZE, m_staging.data() + firstBlock * BLOCK_DIFF_SIZE,
+           (lastBlock - firstBlock + 1) * BLOCK_DIFF_SIZE);
+}
+
+void DeltaTracker::DiffSpan(const ReadSpan& span) {
+    size_t firstBlock = span.stagingOffset / BLOCK_DIFF_SIZE;
+    size_t lastBlock = (span.stagingOffset + span.length - 1) / BLOCK_DIFF_SIZE;
+
+    size_t changedCount = FindChangedBlocks(m_staging.data() + firstBlock * BLOCK_DIFF_SIZE,
+                                            m_shadow.data() + firstBlock * BLOCK_DIFF_SIZE,
+                                            lastBlock - firstBlock + 1, m_changedBlocks.data());
+    for (size_t i = 0; i < changedCount; i++) {
+        size_t b = firstBlock + m_changedBlocks[i];
+        for (uint32_t k = m_blockFirst[b]; k < m_blockFirst[b + 1]; k++) {
+            DecodeTrackedValue(m_blockValues[k]);
+        }
+        memcpy(m_shadow.data() + b * BLOCK_DIFF_SIZE,
+               m_staging.data() + b * BLOCK_DIFF_SIZE, BLOCK_DIFF_SIZE);
+    }
+}
+
+std::string DeltaTracker::BuildHelloJson(uint64_t seq, const char* sharedMemoryName, size_t sharedMemorySize) const {
+    JsonWriter jw;
+    jw.BeginObject();
+    jw.StringField("type", "hello");
+    jw.StringField("version", "1.0");
+    jw.UIntField("addresses", (uint32_t)m_names.size());
+    jw.IntField("seq", (int64_t)seq);
+    // 対応する転送形式（setEncoding で切り替え。既定は json）
+    jw.Key("encodings");
+    jw.BeginArray();
+    jw.ArrayString("json");
+    jw.ArrayString("binary");
+    jw.EndArray();
+    // 共有メモリ転送（同一マシン上のツールはパイプの代わりにマップして読める）
+    if (sharedMemoryName) {
+        jw.Key("sharedMemory");
         jw.BeginObject();
-        jw.HexValueField("v", tv.currentValue, tv.size);
+        jw.StringField("name", sharedMemoryName);
+        jw.UIntField("size", (uint32_t)sharedMemorySize);
+        jw.UIntField("layout", SHARED_STATE_LAYOUT_VERSION);
         jw.EndObject();
     }
-    jw.EndObject();
-
     jw.EndObject();
     return jw.GetString();
 }
 
-void DeltaTracker::ResetChangeFlags() {
-    for (auto& tv : m_values) {
-        tv.lastSentValue = tv.currentValue;
-        tv.changed = false;
+const std::vector<uint64_t>& DeltaTracker::FullStateIds(const std::vector<uint64_t>* ids) {
+    if (!ids) return m_initializedBits;
+    IntersectBits(m_initializedBits, *ids, m_scratchBits);
+    return m_scratchBits;
+}
+
+const std::string& DeltaTracker::BuildFullStateJson(uint64_t seq, const std::vector<uint64_t>* ids) {
+    std::string& buf = m_fullBuffer;
+    buf.clear();
+
+    char header[96];
+    int headerLen = snprintf(header, sizeof(header), "{\"type\":\"full\"");
+    if (m_instanceId) {
+        headerLen += snprintf(header + headerLen, sizeof(header) - headerLen, ",\"instance\":%u", m_instanceId);
     }
+    headerLen += snprintf(header + headerLen, sizeof(header) - headerLen, ",\"seq\":%llu,\"data\":{",
+                          (unsigned long long)seq);
+    buf.append(header, headerLen);
+
+    bool first = true;
+    ForEachSetBit(FullStateIds(ids), [&](uint32_t id) {
+        if (!first) buf += ',';
+        first = false;
+        buf.append(m_fragments, m_keyFragOffsets[id], m_keyFragLengths[id]);
+        buf.append(m_valueHex.data() + (size_t)id * VALUE_HEX_DIGITS, (size_t)m_sizes[id] * 2);
+        buf.append(m_fragments, m_staticFragOffsets[id], m_staticFragLengths[id]);
+    });
+
+    buf += "}}";
+    return buf;
 }
 
-bool DeltaTracker::HasChanges() const {
-    for (const auto& tv : m_values) {
-        if (tv.changed) return true;
+// delta の先頭部分（{"type":"delta"[,"instance":I],"seq":N[,"from":M,"coalesced":true][,"sampleUs":T],"data":{）
+static void AppendDeltaHeader(std::string& buf, uint32_t instance, uint64_t seq, uint64_t firstSeq, bool coalesced, uint64_t sampleUs) {
+    char header[192];
+    int headerLen = snprintf(header, sizeof(header), "{\"type\":\"delta\"");
+    if (instance) {
+        headerLen += snprintf(header + headerLen, sizeof(header) - headerLen, ",\"instance\":%u", instance);
+    }
+    headerLen += snprintf(header + headerLen, sizeof(header) - headerLen, ",\"seq\":%llu", (unsigned long long)seq);
+    if (coalesced) {
+        headerLen += snprintf(header + headerLen, sizeof(header) - headerLen, ",\"from\":%llu,\"coalesced\":true",
+                              (unsigned long long)firstSeq);
     }
-    return false;
+    if (sampleUs) {
+        headerLen += snprintf(header + headerLen, sizeof(header) - headerLen, ",\"sampleUs\":%llu",
+                              (unsigned long long)sampleUs);
+    }
+    buf.append(header, headerLen);
+    buf += ",\"data\":{";
 }
 
-TrackedValue* DeltaTracker::FindByName(const char* name) {
-    for (auto& tv : m_values) {
-        if (strcmp(tv.name, name) == 0) {
-            return &tv;
-        }
+const std::string& DeltaTracker::BuildDeltaJson(uint64_t seq, uint64_t sampleUs) {
+    std::string& buf = m_deltaBuffer;
+    buf.clear();
+    if (!HasChanges()) return buf;
+
+    AppendDeltaHeader(buf, m_instanceId, seq, 0, false, sampleUs);
+    AppendDeltaEntries(buf, m_changedBits);
+    buf += "}}";
+    return buf;
+}
+
+const std::string& DeltaTracker::BuildCoalescedDeltaJson(uint64_t firstSeq, uint64_t seq, const std::vector<uint64_t>& ids, uint64_t sampleUs) {
+    std::string& buf = m_deltaBuffer;
+    buf.clear();
+    if (!AnyBitSet(ids)) return buf;
+
+    AppendDeltaHeader(buf, m_instanceId, seq, firstSeq, true, sampleUs);
+    AppendDeltaEntries(buf, ids);
+    buf += "}}";
+    return buf;
+}
+
+void DeltaTracker::AppendDeltaEntries(std::string& buf, const std::vector<uint64_t>& ids) const {
+    bool first = true;
+    ForEachSetBit(ids, [&](uint32_t id) {
+        if (id >= m_names.size()) return;
+        if (!first) buf += ',';
+        first = false;
+        buf.append(m_fragments, m_keyFragOffsets[id], m_keyFragLengths[id]);
+        buf.append(m_valueHex.data() + (size_t)id * VALUE_HEX_DIGITS, (size_t)m_sizes[id] * 2);
+        buf += "\"}";
+    });
+}
+
+const std::string& DeltaTracker::BuildNameTableFrame() {
+    std::string& buf = m_frameBuffer;
+    buf.clear();
+    size_t frame = BeginInstanceWireFrame(buf, WireFrameKind::NameTable, m_instanceId);
+    AppendVarint(buf, (uint32_t)m_names.size());
+    for (size_t id = 0; id < m_names.size(); id++) {
+        size_t nameLen = (std::min)(strlen(m_names[id]), (size_t)0xFF);
+        buf += (char)nameLen;
+        buf.append(m_names[id], nameLen);
+        AppendU32LE(buf, m_addresses[id]);
+        buf += (char)m_sizes[id];
     }
-    return nullptr;
+    EndWireFrame(buf, frame);
+    return buf;
+}
+
+const std::string& DeltaTracker::BuildFullStateFrame(uint64_t seq, const std::vector<uint64_t>* ids) {
+    std::string& buf = m_frameBuffer;
+    buf.clear();
+    size_t frame = BeginInstanceWireFrame(buf, WireFrameKind::Full, m_instanceId);
+    AppendU64LE(buf, seq);
+    AppendFrameValues(buf, FullStateIds(ids));
+    EndWireFrame(buf, frame);
+    return buf;
+}
+
+const std::string& DeltaTracker::BuildDeltaFrame(uint64_t seq, uint64_t sampleUs) {
+    std::string& buf = m_frameBuffer;
+    buf.clear();
+    if (!HasChanges()) return buf;
+
+    size_t frame = BeginInstanceWireFrame(buf, sampleUs ? WireFrameKind::TimedDelta : WireFrameKind::Delta, m_instanceId);
+    AppendU64LE(buf, seq);
+    if (sampleUs) AppendU64LE(buf, sampleUs);
+    AppendFrameValues(buf, m_changedBits);
+    EndWireFrame(buf, frame);
+    return buf;
+}
+
+const std::string& DeltaTracker::BuildCoalescedDeltaFrame(uint64_t firstSeq, uint64_t seq, const std::vector<uint64_t>& ids, uint64_t sampleUs) {
+    std::string& buf = m_frameBuffer;
+    buf.clear();
+    if (!AnyBitSet(ids)) return buf;
+
+    size_t frame = BeginInstanceWireFrame(buf, sampleUs ? WireFrameKind::TimedCoalescedDelta : WireFrameKind::CoalescedDelta, m_instanceId);
+    AppendU64LE(buf, seq);
+    AppendU64LE(buf, firstSeq);
+    if (sampleUs) AppendU64LE(buf, sampleUs);
+    AppendFrameValues(buf, ids);
+    EndWireFrame(buf, frame);
+    return buf;
+}
+
+void DeltaTracker::AppendFrameValues(std::string& buf, const std::vector<uint64_t>& ids) const {
+    ForEachSetBit(ids, [&](uint32_t id) {
+        if (id >= m_names.size()) return;
+        AppendVarint(buf, id);
+        AppendValueLE(buf, m_currentValues[id], m_sizes[id]);
+    });
+}
+
+void DeltaTracker::ResetChangeFlags() {
+    std::fill(m_changedBits.begin(), m_changedBits.end(), 0);
+}
+
+bool DeltaTracker::HasChanges() const {
+    return AnyBitSet(m_changedBits);
 }
@@ -4,40 +4,90 @@
 #include <string>
 #include <vector>
 #include <cstdint>
+#include "name_index.h"
+#include "bit_util.h"
 
-struct TrackedValue {
-    const char* name;
-    uint32_t dsAddress;
-    uint8_t size;           // 1, 2, or 4
-    uint32_t currentValue;
-    uint32_t lastSentValue;
-    bool changed;           // 前回送信から変化したか
-    bool initialized;       // 初回読み取り済みか
+// DSメインRAMの先頭アドレス
+constexpr uint32_t DS_MAIN_RAM_START = 0x02000000;
+
+// ポーリング頻度の階層
+// Hot: 毎ティック / Warm: 4ティック毎 / Cold: 16ティック毎
+// 変化を観測した値は Hot に昇格し、一定期間変化がなければ1段ずつ降格する
+// Hot で登録した値は降格しない（短時間のフラグ変化を取りこぼさないため）
+enum class PollTier : uint8_t {
+    Hot = 0,
+    Warm = 1,
+    Cold = 2,
+};
+
+// 読み取りプランの1区間（連続したMainRAM範囲を1回で読む）
+struct ReadSpan {
+    uint32_t ramOffset;     // MainRAM先頭からのオフセット
+    uint32_t length;        // 読み取りバイト数
+    uint32_t stagingOffset; // ステージングバッファ内の位置
+    uint32_t firstValue;    // m_planOrder 内の開始位置
+    uint32_t valueCount;    // この区間に含まれる値の数
+    uint32_t uninitializedCount; // 区間内の未読み取りの値の数（0 でなければ毎ティック読んで全デコード）
+    PollTier tier;          // 区間内で最もホットな値の階層
 };
 
-// メモリ読み取りコールバック型
-// dsAddress, size を受け取り、読み取った値を outValue に格納。成功時 true
-using MemoryReadFunc = bool(*)(uint32_t dsAddress, uint8_t size, uint32_t* outValue);
+// メモリ一括読み取りコールバック型
+// MainRAMオフセット ramOffset から length バイトを outBuffer にコピー。成功時 true
+using MemoryBlockReadFunc = bool(*)(uint32_t ramOffset, uint32_t length, uint8_t* outBuffer);
 
 // メモリ書き込みコールバック型
 using MemoryWriteFunc = bool(*)(uint32_t dsAddress, uint8_t size, uint32_t value);
 
+// 登録値は列指向（SoA）で保持する。値は登録順の連番 id で参照する
+// ホット列: 現在値・ステージング位置・changed/initialized ビットセット
+// コールド列: 名前・DSアドレス・サイズ
 class DeltaTracker {
 public:
     // アドレス登録
-    void RegisterAddress(const char* name, uint32_t addr, uint8_t size);
+    void RegisterAddress(const char* name, uint32_t addr, uint8_t size, PollTier tier = PollTier::Warm);
+
+    // 1ティック分のサンプリング。今回が読み取り周期に当たる区間だけを読み、変化を検知
+    // ramMask: MainRAMMask（読み取りプランの構築に使用。変化時はプランを再構築）
+    void Update(MemoryBlockReadFunc readFunc, uint32_t ramMask);
+
+    // 階層に関係なく全区間を読み取る（フルステート送信前に使う）
+    void UpdateAll(MemoryBlockReadFunc readFunc, uint32_t ramMask);
+
+    // 読み取り対象の値 id（ビットセット。登録直後は全値が対象）
+    // 対象外の値は読み取りプランから外し、未初期化に戻す（再び対象になった時に読み直して full に含める）
+    void SetActiveIds(const std::vector<uint64_t>& activeBits);
+    size_t GetActiveCount() const { return m_planValid ? m_planOrder.size() : CountActive(); }
+
+    // エミュレータインスタンスの id（0 以外なら full / delta の JSON に "instance" を付け、フレームを Instance で包む）
+    void SetInstanceId(uint32_t id) { m_instanceId = id; }
+    uint32_t GetInstanceId() const { return m_instanceId; }
+
+    // hello メッセージJSON。seq: 最新の delta 連番
+    // sharedMemoryName: 共有メモリ転送の名前（無効なら nullptr）
+    std::string BuildHelloJson(uint64_t seq, const char* sharedMemoryName = nullptr, size_t sharedMemorySize = 0) const;
 
-    // 全アドレスを読み取り、変化を検知
-    void Update(MemoryReadFunc readFunc);
+    // フルステートJSON (type: "full")。seq: この状態に反映済みの最新 delta 連番
+    // ids: 含める値 id のビットセット（nullptr なら初期化済みの全値）
+    // 登録時に作った固定部分と値の16進キャッシュを連結する。戻り値は次回呼び出しまで有効
+    const std::string& BuildFullStateJson(uint64_t seq, const std::vector<uint64_t>* ids = nullptr);
 
-    // hello メッセージJSON
-    std::string BuildHelloJson() const;
+    // 差分JSON (type: "delta")。seq: この delta の連番。変化なしの場合は空文字列
+    // sampleUs: 値をサンプリングした時刻（Unix 時刻のマイクロ秒。0 なら付けない）
+    // 戻り値は次回呼び出しまで有効
+    const std::string& BuildDeltaJson(uint64_t seq, uint64_t sampleUs = 0);
 
-    // フルステートJSON (type: "full")
-    std::string BuildFullStateJson() const;
+    // バイナリ転送モード用フレーム（形式は wire_format.h）。戻り値は次回呼び出しまで有効
+    // 名前・アドレス・サイズ表（id は登録順）
+    const std::string& BuildNameTableFrame();
+    // 初期化済み全値（ids を指定したらその中の値のみ）
+    const std::string& BuildFullStateFrame(uint64_t seq, const std::vector<uint64_t>* ids = nullptr);
+    // 変化した値のみ。変化なしの場合は空文字列
+    const std::string& BuildDeltaFrame(uint64_t seq, uint64_t sampleUs = 0);
 
-    // 差分JSON (type: "delta")。変化なしの場合は空文字列
-    std::string BuildDeltaJson() const;
+    // 合流 delta（送信が詰まっている間の firstSeq〜seq の変化を、ids の各値の最新値だけにまとめたもの）
+    // ids: 値 id のビットセット。空なら空文字列。戻り値は次回呼び出しまで有効
+    const std::string& BuildCoalescedDeltaJson(uint64_t firstSeq, uint64_t seq, const std::vector<uint64_t>& ids, uint64_t sampleUs = 0);
+    const std::string& BuildCoalescedDeltaFrame(uint64_t firstSeq, uint64_t seq, const std::vector<uint64_t>& ids, uint64_t sampleUs = 0);
 
     // 変化フラグリセット（送信後に呼ぶ）
     void ResetChangeFlags();
@@ -45,12 +95,115 @@ public:
     // 変化があるか
     bool HasChanges() const;
 
+    // 前回送信から変化した値の id を昇順に列挙
+    template <typename Func>
+    void ForEachChanged(Func&& func) const { ForEachSetBit(m_changedBits, func); }
+
+    // 前回送信から変化した値のビットセット
+    const std::vector<uint64_t>& GetChangedBits() const { return m_changedBits; }
+
     // アドレス数
-    size_t GetAddressCount() const { return m_values.size(); }
+    size_t GetAddressCount() const { return m_names.size(); }
+
+    // 読み取り区間数（プラン未構築時は0）
+    size_t GetSpanCount() const { return m_spans.size(); }
+
+    // 名前で値 id を検索（ハッシュ表、O(1)）。見つからなければ -1
+    int FindByName(const char* name) const { return m_nameIndex.Find(name); }
+    int FindByName(const char* name, size_t length) const { return m_nameIndex.Find(name, length); }
 
-    // 名前でアドレス情報を検索
-    TrackedValue* FindByName(const char* name);
+    // id 毎の登録情報・現在値
+    const char* GetName(uint32_t id) const { return m_names[id]; }
+    uint32_t GetAddress(uint32_t id) const { return m_addresses[id]; }
+    uint8_t GetSize(uint32_t id) const { return m_sizes[id]; }
+    uint32_t GetValue(uint32_t id) const { return m_currentValues[id]; }
+    PollTier GetTier(uint32_t id) const { return (PollTier)m_tiers[id]; }
 
 private:
-    std::vector<TrackedValue> m_values;
+    // 登録アドレスをMainRAMオフセット順に並べ、近接するものを1区間にまとめる
+    void BuildReadPlan(uint32_t ramMask);
+
+    // 読み取り本体。allSpans=false の場合は周期に当たる区間のみ
+    void Sample(MemoryBlockReadFunc readFunc, uint32_t ramMask, bool allSpans);
+
+    // 区間の差分を取り、変化したブロックに重なる値だけをデコード
+    void DiffSpan(const ReadSpan& span);
+
+    // 区間の全値をデコードしてシャドウに写す（未読み取りの値が残る区間）
+    void DecodeSpan(ReadSpan& span);
+
+    // 区間内の未読み取りの値を数え直す
+    void CountUninitialized(ReadSpan& span) const;
+
+    // ステージングの値を現在値に反映し、変化していれば changed ビットを立てる
+    void DecodeTrackedValue(uint32_t id);
+
+    // 現在値の16進表記をキャッシュに書き込む
+    void EncodeValueHex(uint32_t id);
+
+    // ids の値を delta の JSON エントリ / フレームの {id, 値} 列として追加
+    void AppendDeltaEntries(std::string& buf, const std::vector<uint64_t>& ids) const;
+    void AppendFrameValues(std::string& buf, const std::vector<uint64_t>& ids) const;
+
+    // full に含める値（初期化済み ∩ ids）
+    const std::vector<uint64_t>& FullStateIds(const std::vector<uint64_t>* ids);
+
+    size_t CountActive() const;
+
+    // 区間の階層を値の階層から再計算
+    void RecomputeSpanTiers();
+
+    // 一定期間変化のない値を降格
+    void ReviewTiers();
+
+    uint32_t m_instanceId = 0;
+
+    // コールド列
+    std::vector<const char*> m_names;
+    std::vector<uint32_t> m_addresses;
+    std::vector<uint8_t> m_sizes;           // 1, 2, or 4
+    std::vector<uint8_t> m_registeredTiers; // 登録時の PollTier
+    NameIndex m_nameIndex;
+
+    // 事前シリアライズ済みJSON断片（登録時に作成）
+    // 1エントリ = キー断片 + 値の16進 + 固定断片
+    //   キー断片: "NAME":{"v":"
+    //   固定断片: ","a":"020F3394","s":4}   （full用。delta は "} で閉じる）
+    std::string m_fragments;
+    std::vector<uint32_t> m_keyFragOffsets;
+    std::vector<uint16_t> m_keyFragLengths;
+    std::vector<uint32_t> m_staticFragOffsets;
+    std::vector<uint16_t> m_staticFragLengths;
+
+    // ホット列
+    std::vector<uint32_t> m_currentValues;
+    std::vector<uint32_t> m_stagingOffsets; // ステージングバッファ内の位置（読み取りプランで決定）
+    std::vector<uint64_t> m_changedBits;    // 前回送信から変化したか
+    std::vector<uint64_t> m_initializedBits; // 初回読み取り済みか
+    std::vector<uint64_t> m_activeBits;     // 読み取り対象か（購読されている値のみ読む）
+    std::vector<uint8_t> m_tiers;           // 現在の PollTier
+    std::vector<uint32_t> m_lastChangeTick; // 最後に変化を観測したティック
+    std::vector<char> m_valueHex;           // 値の16進表記（id毎に8文字、size*2 文字を使用）
+
+    // 組み立て用バッファ（容量を使い回す）
+    std::string m_fullBuffer;
+    std::string m_deltaBuffer;
+    std::string m_frameBuffer;
+    std::vector<uint64_t> m_scratchBits;
+
+    // 読み取りプラン
+    std::vector<ReadSpan> m_spans;
+    std::vector<uint32_t> m_planOrder;  // 区間順に並べた値 id
+    std::vector<uint8_t> m_staging;     // 一括読み取り先
+    uint32_t m_planMask = 0;
+    bool m_planValid = false;
+    bool m_spanTiersDirty = false;
+    uint32_t m_tick = 0;
+
+    // 差分検出（前回サンプルのシャドウコピーとブロック単位で比較）
+    std::vector<uint8_t> m_shadow;          // 前回サンプル（m_staging と同サイズ）
+    std::vector<uint32_t> m_blockFirst;     // ブロック毎の m_blockValues 開始位置（ブロック数+1）
+    std::vector<uint32_t> m_blockValues;    // ブロックに重なる値 id
+    std::vector<uint32_t> m_changedBlocks;  // FindChangedBlocks の出力先
+    bool m_shadowValid = false;             // false なら次のサンプルで全区間を読んで全デコード
 };
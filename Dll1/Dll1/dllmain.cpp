@@ -1,15 +1,25 @@
 ﻿// dllmain.cpp : melonDS用 DLLプロキシ (version.dll)
 // NDS構造体パターンスキャンによるMainRAM検出
-// Named Pipe Server + DeltaTracker によるリアルタイム通信
+// Named Pipe Server + モニター本体（monitor.cpp）によるリアルタイム通信
 
 #include "pch.h"
 #include <Psapi.h>
 #include <cstdio>
 #include <vector>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <mutex>
 #include <MinHook.h>
 #include "pipe_server.h"
-#include "delta_tracker.h"
-#include "json_util.h"
+#include "websocket_server.h"
+#include "transport_group.h"
+#include "frame_hook.h"
+#include "monitor.h"
+#include "heap_scan.h"
+#include "locator_cache.h"
+#include "pointer_scan.h"
 
 #pragma comment(lib, "Psapi.lib")
 
@@ -28,331 +38,21 @@ static FARPROC p_GetFileVersionInfoSizeW = nullptr;
 static FARPROC p_VerQueryValueA = nullptr;
 static FARPROC p_VerQueryValueW = nullptr;
 
-// ========================================
-// DSメモリアドレス定義
-// ========================================
-constexpr uint32_t DS_MAIN_RAM_START = 0x02000000;
-constexpr uint32_t DS_MAIN_RAM_SIZE = 0x00400000;   // 4MB (NDS)
-constexpr uint32_t DSI_MAIN_RAM_SIZE = 0x01000000;  // 16MB (DSi)
-
-// MainRAMMaskの既知の値
-constexpr uint32_t NDS_MAIN_RAM_MASK = 0x003FFFFF;  // 4MBマスク
-constexpr uint32_t DSI_MAIN_RAM_MASK = 0x00FFFFFF;  // 16MBマスク
-
-// ========================================
-// バージョン別ゲームアドレス定義
-// ========================================
-struct GameAddress {
-    const char* name;           // 識別名
-    uint32_t dsAddress;         // DSメモリ上のアドレス
-    uint8_t size;               // バイトサイズ (1, 2, or 4)
-};
-
-// RJ版 (Red Joker / レッドジョーカー) アドレスリスト
-static const GameAddress RJ_ADDRESSES[] = {
-    { "NOISE_RATE_1",       0x02193BA0, 2 }, // 表示上のノイズ率1
-    { "NOISE_RATE_2",       0x02193BA4, 2 }, // 表示上のノイズ率2
-    
-    { "COMFIRM_LV_1",       0x021862A0, 2 }, // ファイナライズアクセスLv
-    { "COMFIRM_LV_2",       0x021862B0, 2 }, // ファイナライズアクセス確認画面に表示されるLv
-    
-    { "SELECTED_SSS_VAL_1", 0x020F1E4C, 2 }, // SSS選択時サーバーアドレスの値: 1-56 (サテライトLv 1-32, メテオLv 1-24)
-    { "SELECTED_SSS_VAL_2", 0x021862A0, 2 }, // SSS選択時サーバーアドレスの値: 1-56 (サテライトLv 1-32, メテオLv 1-24)
-    { "SSS_CURSOR",         0x0218741F, 1 }, // SSS選択 A/B/Cのカーソル位置: 0-2
-    { "CURRENT_CARD",       0x020F1E24, 1 }, // カーソル選択中のカード？
-    
-    { "F_Turn_Remaining",   0x021C1A14, 1 }, // 残りファイナライズターン(バトル中に0=非変身)
-
-    { "SSS_VAL1_L1",        0x220F6608, 1 },
-    { "SSS_SERVER_ID_L1",   0x220F393D, 1 },
-    { "SSS_VAL2_L1",        0x220F660E, 1 },
-    { "SSS_VAL1_L2",        0x220F6624, 1 },
-    { "SSS_SERVER_ID_L2",   0x220F3941, 1 },
-    { "SSS_VAL2_L2",        0x220F662A, 1 },
-    { "SSS_VAL1_L3",        0x220F6640, 1 },
-    { "SSS_SERVER_ID_L3",   0x220F3945, 1 },
-    { "SSS_VAL2_L3",        0x220F6646, 1 },
-    { "SSS_VAL1_R1",        0x220F665C, 1 },
-    { "SSS_SERVER_ID_R1",   0x220F3949, 1 },
-    { "SSS_VAL2_R1",        0x220F6662, 1 },
-    { "SSS_VAL1_R2",        0x220F6678, 1 },
-    { "SSS_SERVER_ID_R2",   0x220F394D, 1 },
-    { "SSS_VAL2_R2",        0x220F667E, 1 },
-    { "SSS_VAL1_R3",        0x220F6694, 1 },
-    { "SSS_SERVER_ID_R3",   0x220F3951, 1 },
-    { "SSS_VAL2_R3",        0x220F669A, 1 },
-
-    { "MY_REZON",       0x220F39BE, 1 },
-    { "REZON_L0",       0x220F3FFE, 1 },
-    { "REZON_L1",       0x220F463E, 1 },
-    { "REZON_L2",       0x220F4C7E, 1 },
-    { "REZON_R0",       0x220F52BE, 1 },
-    { "REZON_R1",       0x220F58FE, 1 },
-    { "REZON_R2",       0x220F5F3E, 1 },
-
-    // ブラザー1 (左上)
-    { "BRO1_NOISE", 0x220F4000, 1 },
-    { "BRO1_WC",    0x220F4001, 1 },
-    { "BRO1_MEGA",  0x120F459C, 2 },
-    { "BRO1_GIGA",  0x120F459E, 2 },
-    // ブラザー2 (左中)
-    { "BRO2_NOISE", 0x220F4640, 1 },
-    { "BRO2_WC",    0x220F4641, 1 },
-    { "BRO2_MEGA",  0x120F4BDC, 2 },
-    { "BRO2_GIGA",  0x120F4BDE, 2 },
-    // ブラザー3 (左下)
-    { "BRO3_NOISE", 0x220F4C80, 1 },
-    { "BRO3_WC",    0x220F4C81, 1 },
-    { "BRO3_MEGA",  0x120F521C, 2 },
-    { "BRO3_GIGA",  0x120F521E, 2 },
-    // ブラザー4 (右上)
-    { "BRO4_NOISE", 0x220F52C0, 1 },
-    { "BRO4_WC",    0x220F52C1, 1 },
-    { "BRO4_MEGA",  0x120F585C, 2 },
-    { "BRO4_GIGA",  0x120F585E, 2 },
-    // ブラザー5 (右中)
-    { "BRO5_NOISE", 0x220F5900, 1 },
-    { "BRO5_WC",    0x220F5901, 1 },
-    { "BRO5_MEGA",  0x120F5E9C, 2 },
-    { "BRO5_GIGA",  0x120F5E9E, 2 },
-    // ブラザー6 (右下)
-    { "BRO6_NOISE", 0x220F5F40, 1 },
-    { "BRO6_WC",    0x220F5F41, 1 },
-    { "BRO6_MEGA",  0x120F64DC, 2 },
-    { "BRO6_GIGA",  0x120F64DE, 2 },
-
-    // ノイズドカード
-    { "NOISED_CARD_1", 0x220FA114, 2 },
-    { "NOISED_CARD_2", 0x220FA116, 2 },
-    { "NOISED_CARD_3", 0x220FA118, 2 },
-    { "NOISED_CARD_4", 0x220FA11A, 2 },
-    { "NOISED_CARD_5", 0x220FA11C, 2 },
-
-    // アビリティ
-    { "ABILITY01",  0x020F2CEE, 2 },
-    { "ABILITY02",  0x020F2CF0, 2 },
-    { "ABILITY03",  0x020F2CF2, 2 },
-    { "ABILITY04",  0x020F2CF4, 2 },
-    { "ABILITY05",  0x020F2CF6, 2 },
-    { "ABILITY06",  0x020F2CF8, 2 },
-    { "ABILITY07",  0x020F2CFA, 2 },
-    { "ABILITY08",  0x020F2CFC, 2 },
-    { "ABILITY09",  0x020F2CFE, 2 },
-    { "ABILITY10",  0x020F2D00, 2 },
-    { "ABILITY11",  0x020F2D02, 2 },
-    { "ABILITY12",  0x020F2D04, 2 },
-    { "ABILITY13",  0x020F2D06, 2 },
-    { "ABILITY14",  0x020F2D08, 2 },
-    { "ABILITY15",  0x020F2D0A, 2 },
-    { "ABILITY16",  0x020F2D0C, 2 },
-    { "ABILITY17",  0x020F2D0E, 2 },
-    { "ABILITY18",  0x020F2D10, 2 },
-    { "ABILITY19",  0x020F2D12, 2 },
-    { "ABILITY20",  0x020F2D14, 2 },
-
-    { "ZENY",       0x020F3394, 4 },
-   
-    { "BASE_HP",    0x0210C378, 2 },
-    // 自ノイズ
-    { "NOISE",      0x020F39C0, 1 },
-    // ホワイトカードコード
-    { "WHITE_CARDS",0x220F39C1, 1 },
-    // ウォーロック装備
-    { "WARLOCK",    0x020F2CD0, 4 },
-    
-    { "CARD01",     0x120F3806, 2 },
-    { "CARD02",     0x120F3808, 2 },
-    { "CARD03",     0x120F380A, 2 },
-    { "CARD04",     0x120F380C, 2 },
-    { "CARD05",     0x120F380E, 2 },
-    { "CARD06",     0x120F3810, 2 },
-    { "CARD07",     0x120F3812, 2 },
-    { "CARD08",     0x120F3814, 2 },
-    { "CARD09",     0x120F3816, 2 },
-    { "CARD10",     0x120F3818, 2 },
-    { "CARD11",     0x120F381A, 2 },
-    { "CARD12",     0x120F381C, 2 },
-    { "CARD13",     0x120F381E, 2 },
-    { "CARD14",     0x120F3820, 2 },
-    { "CARD15",     0x120F3822, 2 },
-    { "CARD16",     0x120F3824, 2 },
-    { "CARD17",     0x120F3826, 2 },
-    { "CARD18",     0x120F3828, 2 },
-    { "CARD19",     0x120F382A, 2 },
-    { "CARD20",     0x120F382C, 2 },
-    { "CARD21",     0x120F382E, 2 },
-    { "CARD22",     0x120F3830, 2 },
-    { "CARD23",     0x120F3832, 2 },
-    { "CARD24",     0x120F3834, 2 },
-    { "CARD25",     0x120F3836, 2 },
-    { "CARD26",     0x120F3838, 2 },
-    { "CARD27",     0x120F383A, 2 },
-    { "CARD28",     0x120F383C, 2 },
-    { "CARD29",     0x120F383E, 2 },
-    { "CARD30",     0x120F3840, 2 },
-    
-    { "REG",        0x020F3844, 2 },
-    { "TAG1_2",     0x020F3842, 2 },
-};
-static constexpr size_t RJ_ADDRESS_COUNT = sizeof(RJ_ADDRESSES) / sizeof(RJ_ADDRESSES[0]);
-
-// BA版 (Black Ace / ブラックエース) アドレスリスト
-static const GameAddress BA_ADDRESSES[] = {
-    { "NOISE_RATE_1",       0x02193B60, 2 }, // 表示上のノイズ率1
-    { "NOISE_RATE_2",       0x02193B64, 2 }, // 表示上のノイズ率2
-    { "COMFIRM_LV_1",       0x02186260, 2 }, // ファイナライズアクセスLv
-    { "COMFIRM_LV_2",       0x02186270, 2 }, // ファイナライズアクセス確認画面に表示されるLv
-    { "SELECTED_SSS_VAL_1", 0x02186264, 2 }, // SSS選択時サーバーアドレスの値: 1-56 (サテライトLv 1-32, メテオLv 1-24)
-    { "SELECTED_SSS_VAL_2", 0x02186260, 2 }, // SSS選択時サーバーアドレスの値: 1-56 (サテライトLv 1-32, メテオLv 1-24)
-    { "SSS_CURSOR",         0x021873DF, 1 }, // SSS選択 A/B/Cのカーソル位置: 0-2
-    { "CURRENT_CARD",       0x020F1E04, 1 }, // カーソル選択中のカード？
-
-    { "F_Turn_Remaining",   0x021C19D4, 1 }, // 残りファイナライズターン(バトル中に0=非変身)
-
-    { "SSS_VAL1_L1",        0x220F65E8, 1 },
-    { "SSS_SERVER_ID_L1",   0x220F391D, 1 },
-    { "SSS_VAL2_L1",        0x220F65EE, 1 },
-    { "SSS_VAL1_L2",        0x220F6604, 1 },
-    { "SSS_SERVER_ID_L2",   0x220F3921, 1 },
-    { "SSS_VAL2_L2",        0x220F660A, 1 },
-    { "SSS_VAL1_L3",        0x220F6620, 1 },
-    { "SSS_SERVER_ID_L3",   0x220F3925, 1 },
-    { "SSS_VAL2_L3",        0x220F6626, 1 },
-    { "SSS_VAL1_R1",        0x220F663C, 1 },
-    { "SSS_SERVER_ID_R1",   0x220F3929, 1 },
-    { "SSS_VAL2_R1",        0x220F6642, 1 },
-    { "SSS_VAL1_R2",        0x220F6658, 1 },
-    { "SSS_SERVER_ID_R2",   0x220F392D, 1 },
-    { "SSS_VAL2_R2",        0x220F665E, 1 },
-    { "SSS_VAL1_R3",        0x220F6674, 1 },
-    { "SSS_SERVER_ID_R3",   0x220F3931, 1 },
-    { "SSS_VAL2_R3",        0x220F667A, 1 },
-
-    { "MY_REZON",       0x220F399E, 1 },
-    
-    // ここから
-    { "REZON_L0",       0x220F3FDE, 1 },
-    { "REZON_L1",       0x220F461E, 1 },
-    { "REZON_L2",       0x220F4C5E, 1 },
-    { "REZON_R0",       0x220F529E, 1 },
-    { "REZON_R1",       0x220F58DE, 1 },
-    { "REZON_R2",       0x220F5F1E, 1 },
-    // ブラザー1 (左上)
-    { "BRO1_NOISE", 0x220F3FE0, 1 },
-    { "BRO1_WC",    0x220F3FE1, 1 },
-    { "BRO1_MEGA",  0x120F457C, 2 },
-    { "BRO1_GIGA",  0x120F457E, 2 },
-    // ブラザー2 (左中)
-    { "BRO2_NOISE", 0x220F4620, 1 },
-    { "BRO2_WC",    0x220F4621, 1 },
-    { "BRO2_MEGA",  0x120F4BBC, 2 },
-    { "BRO2_GIGA",  0x120F4BBE, 2 },
-    // ブラザー3 (左下)
-    { "BRO3_NOISE", 0x220F4C60, 1 },
-    { "BRO3_WC",    0x220F4C61, 1 },
-    { "BRO3_MEGA",  0x120F51FC, 2 },
-    { "BRO3_GIGA",  0x120F51FE, 2 },
-    // ブラザー4 (右上)
-    { "BRO4_NOISE", 0x220F52A0, 1 },
-    { "BRO4_WC",    0x220F52A1, 1 },
-    { "BRO4_MEGA",  0x120F583C, 2 },
-    { "BRO4_GIGA",  0x120F583E, 2 },
-    // ブラザー5 (右中)
-    { "BRO5_NOISE", 0x220F58E0, 1 },
-    { "BRO5_WC",    0x220F58E1, 1 },
-    { "BRO5_MEGA",  0x120F5E7C, 2 },
-    { "BRO5_GIGA",  0x120F5E7E, 2 },
-    // ブラザー6 (右下)
-    { "BRO6_NOISE", 0x220F5F20, 1 },
-    { "BRO6_WC",    0x220F5F21, 1 },
-    { "BRO6_MEGA",  0x120F64BC, 2 },
-    { "BRO6_GIGA",  0x120F64BE, 2 },
-    // ノイズドカード
-    { "NOISED_CARD_1", 0x220FA0F4, 2 },
-    { "NOISED_CARD_2", 0x220FA0F6, 2 },
-    { "NOISED_CARD_3", 0x220FA0F8, 2 },
-    { "NOISED_CARD_4", 0x220FA0FA, 2 },
-    { "NOISED_CARD_5", 0x220FA0FC, 2 },
-    // アビリティ
-    { "ABILITY01",  0x020F2CCE, 2 },
-    { "ABILITY02",  0x020F2CD0, 2 },
-    { "ABILITY03",  0x020F2CD2, 2 },
-    { "ABILITY04",  0x020F2CD4, 2 },
-    { "ABILITY05",  0x020F2CD6, 2 },
-    { "ABILITY06",  0x020F2CD8, 2 },
-    { "ABILITY07",  0x020F2CDA, 2 },
-    { "ABILITY08",  0x020F2CDC, 2 },
-    { "ABILITY09",  0x020F2CDE, 2 },
-    { "ABILITY10",  0x020F2CE0, 2 },
-    { "ABILITY11",  0x020F2CE2, 2 },
-    { "ABILITY12",  0x020F2CE4, 2 },
-    { "ABILITY13",  0x020F2CE6, 2 },
-    { "ABILITY14",  0x020F2CE8, 2 },
-    { "ABILITY15",  0x020F2CEA, 2 },
-    { "ABILITY16",  0x020F2CEC, 2 },
-    { "ABILITY17",  0x020F2CEE, 2 },
-    { "ABILITY18",  0x020F2CF0, 2 },
-    { "ABILITY19",  0x020F2CF2, 2 },
-    { "ABILITY20",  0x020F2CF4, 2 },
-
-    { "ZENY",       0x020F3374, 4 },
-
-    { "BASE_HP",    0x0210C358, 2 },
-    // 自ノイズ
-    { "NOISE",      0x220F39A0, 1 },
-    // ホワイトカードコード
-    { "WHITE_CARDS",0x220F39A1, 1 },
-    // ウォーロック装備
-    { "WARLOCK",    0x020F2CB0, 4 },
-
-    { "CARD01",     0x120F37E6, 2 },
-    { "CARD02",     0x120F37E8, 2 },
-    { "CARD03",     0x120F37EA, 2 },
-    { "CARD04",     0x120F37EC, 2 },
-    { "CARD05",     0x120F37EE, 2 },
-    { "CARD06",     0x120F37F0, 2 },
-    { "CARD07",     0x120F37F2, 2 },
-    { "CARD08",     0x120F37F4, 2 },
-    { "CARD09",     0x120F37F6, 2 },
-    { "CARD10",     0x120F37F8, 2 },
-    { "CARD11",     0x120F37FA, 2 },
-    { "CARD12",     0x120F37FC, 2 },
-    { "CARD13",     0x120F37FE, 2 },
-    { "CARD14",     0x120F3800, 2 },
-    { "CARD15",     0x120F3802, 2 },
-    { "CARD16",     0x120F3804, 2 },
-    { "CARD17",     0x120F3806, 2 },
-    { "CARD18",     0x120F3808, 2 },
-    { "CARD19",     0x120F380A, 2 },
-    { "CARD20",     0x120F380C, 2 },
-    { "CARD21",     0x120F380E, 2 },
-    { "CARD22",     0x120F3810, 2 },
-    { "CARD23",     0x120F3812, 2 },
-    { "CARD24",     0x120F3814, 2 },
-    { "CARD25",     0x120F3816, 2 },
-    { "CARD26",     0x120F3818, 2 },
-    { "CARD27",     0x120F381A, 2 },
-    { "CARD28",     0x120F381C, 2 },
-    { "CARD29",     0x120F381E, 2 },
-    { "CARD30",     0x120F3820, 2 },
-
-    { "REG",        0x020F3824, 2 },
-    { "TAG1_2",     0x020F3822, 2 },
-
-};
-static constexpr size_t BA_ADDRESS_COUNT = sizeof(BA_ADDRESSES) / sizeof(BA_ADDRESSES[0]);
-
-// melonDSのMainRAMポインタ（実行時に検出）
-static uint8_t* g_mainRAM = nullptr;
-static uint32_t g_mainRAMMask = 0;
-
-// バージョン選択状態（一度選択したら変更不可・再起動のみ）
-static std::atomic<bool> g_versionSelected{ false };
-static char g_selectedVersion[4] = "";  // "BA" or "RJ"
-
-// PipeServer & DeltaTracker
+// 通信路とフレーム通知（Windows 実装）
+// Named Pipe は常に、WebSocket は環境変数 WEBSOCKET_PORT_ENV にポートが指定された時だけ待ち受ける
 static PipeServer g_pipeServer;
-static DeltaTracker g_deltaTracker;
+static WebSocketServer g_webSocketServer;
+static TransportGroup g_transports;
+static SwapBuffersFrameSource g_swapFrameSource;
+
+constexpr const char* PIPE_NAME = "\\\\.\\pipe\\ssr3_viewer";
+constexpr const char* SHARED_STATE_NAME = "Local\\ssr3_viewer_state";
+constexpr const char* WEBSOCKET_PORT_ENV = "SSR3_VIEWER_WS_PORT";
+constexpr const wchar_t* LOCATOR_CACHE_FILE = L"ssr3_viewer_locator.txt";  // melonDS.exe と同じフォルダ
+constexpr DWORD LOCATOR_STABLE_CHECK_MS = 200;  // パスの候補を保存する前に、間を置いて辿り直すまでの時間
+constexpr size_t LOCATOR_MAX_CANDIDATES = 8;
+constexpr size_t LOCATOR_SCAN_MAX_BYTES = 512 * 1024 * 1024;  // ポインタスキャンで読むヒープの上限
+constexpr size_t LOCATOR_SCAN_MAX_POINTERS = 8 << 20;         // ポインタスキャンの逆引き表の件数の上限（1件16バイト）
 
 // ========================================
 // デバッグコンソール
@@ -381,9 +81,9 @@ void CloseConsole() {
 // 安全なメモリ読み取り（SEH保護付き）
 // ========================================
 
-static bool SafeReadPtr(void* addr, void** outValue) {
+static bool SafeReadBlock(const void* addr, void* outBuffer, size_t length) {
     __try {
-        *outValue = *reinterpret_cast<void**>(addr);
+        memcpy(outBuffer, addr, length);
         return true;
     }
     __except (EXCEPTION_EXECUTE_HANDLER) {
@@ -391,29 +91,10 @@ static bool SafeReadPtr(void* addr, void** outValue) {
     }
 }
 
-static bool SafeReadU32(void* addr, uint32_t* outValue) {
+// 関数呼び出しごと保護する（ヒープスキャンで領域を直接読む時に使う）
+static bool SafeInvoke(void (*fn)(void*), void* context) {
     __try {
-        *outValue = *reinterpret_cast<uint32_t*>(addr);
-        return true;
-    }
-    __except (EXCEPTION_EXECUTE_HANDLER) {
-        return false;
-    }
-}
-
-static bool SafeReadU16(void* addr, uint16_t* outValue) {
-    __try {
-        *outValue = *reinterpret_cast<uint16_t*>(addr);
-        return true;
-    }
-    __except (EXCEPTION_EXECUTE_HANDLER) {
-        return false;
-    }
-}
-
-static bool SafeReadU8(void* addr, uint8_t* outValue) {
-    __try {
-        *outValue = *reinterpret_cast<uint8_t*>(addr);
+        fn(context);
         return true;
     }
     __except (EXCEPTION_EXECUTE_HANDLER) {
@@ -451,48 +132,12 @@ static bool SafeWriteU8(void* addr, uint8_t value) {
     }
 }
 
-// ========================================
-// 汎用メモリ読み書きAPI
-// ========================================
-
-uint8_t* GetHostAddress(uint32_t dsAddress) {
-    if (!g_mainRAM || !g_mainRAMMask) return nullptr;
-    uint32_t offset = (dsAddress - DS_MAIN_RAM_START) & g_mainRAMMask;
-    return g_mainRAM + offset;
-}
-
-// DeltaTracker用メモリ読み取りコールバック
-static bool ReadMemory(uint32_t dsAddress, uint8_t size, uint32_t* outValue) {
-    uint8_t* hostAddr = GetHostAddress(dsAddress);
-    if (!hostAddr) return false;
-
+// モニター本体に渡す書き込み（サイズ毎に1回の書き込みにする）
+static bool SafeWriteValue(void* addr, uint32_t value, uint8_t size) {
     switch (size) {
-    case 4: return SafeReadU32(hostAddr, outValue);
-    case 2: {
-        uint16_t v16 = 0;
-        if (!SafeReadU16(hostAddr, &v16)) return false;
-        *outValue = v16;
-        return true;
-    }
-    case 1: {
-        uint8_t v8 = 0;
-        if (!SafeReadU8(hostAddr, &v8)) return false;
-        *outValue = v8;
-        return true;
-    }
-    default: return false;
-    }
-}
-
-// メモリ書き込み（コマンド処理用）
-static bool WriteMemory(uint32_t dsAddress, uint8_t size, uint32_t value) {
-    uint8_t* hostAddr = GetHostAddress(dsAddress);
-    if (!hostAddr) return false;
-
-    switch (size) {
-    case 4: return SafeWriteU32(hostAddr, value);
-    case 2: return SafeWriteU16(hostAddr, (uint16_t)value);
-    case 1: return SafeWriteU8(hostAddr, (uint8_t)value);
+    case 4: return SafeWriteU32(addr, value);
+    case 2: return SafeWriteU16(addr, (uint16_t)value);
+    case 1: return SafeWriteU8(addr, (uint8_t)value);
     default: return false;
     }
 }
@@ -501,287 +146,388 @@ static bool WriteMemory(uint32_t dsAddress, uint8_t size, uint32_t value) {
 // MainRAM検出（ヒープパターンスキャン）
 // ========================================
 
-uint8_t* FindMainRAMByHeapScan() {
-    printf("[DLL] ヒープ領域でMainRAMパターンをスキャン中...\n");
+// 候補ポインタの先が expectedSize 以上のコミット済み領域か
+static bool IsCommittedRegion(const void* address, size_t expectedSize) {
+    MEMORY_BASIC_INFORMATION mbi;
+    if (!VirtualQuery(address, &mbi, sizeof(mbi))) return false;
+    return mbi.State == MEM_COMMIT && mbi.RegionSize >= expectedSize;
+}
 
+// 書き込み可能なプライベート領域（ヒープ）のうち minSize 以上のもの（低アドレス順）
+static void GetHeapRegions(size_t minSize, std::vector<HeapRegion>& out) {
     HANDLE hProcess = GetCurrentProcess();
     MEMORY_BASIC_INFORMATION mbi;
     uint8_t* addr = nullptr;
-    std::vector<std::pair<uint8_t*, size_t>> heapRegions;
 
     while (VirtualQueryEx(hProcess, addr, &mbi, sizeof(mbi))) {
         if (mbi.State == MEM_COMMIT &&
             mbi.Type == MEM_PRIVATE &&
             (mbi.Protect == PAGE_READWRITE || mbi.Protect == PAGE_EXECUTE_READWRITE)) {
-            if (mbi.RegionSize >= 0x100000) {
-                heapRegions.push_back({ static_cast<uint8_t*>(mbi.BaseAddress), mbi.RegionSize });
+            if (mbi.RegionSize >= minSize) {
+                out.push_back({ static_cast<uint8_t*>(mbi.BaseAddress), mbi.RegionSize });
             }
         }
         addr = static_cast<uint8_t*>(mbi.BaseAddress) + mbi.RegionSize;
     }
+}
 
-    printf("[DLL] %zu個のヒープ領域をスキャン対象として発見\n", heapRegions.size());
+static uint8_t* FindMainRAMByHeapScan(uint32_t* outMask, const uint8_t** outFoundAt) {
+    printf("[DLL] ヒープ領域でMainRAMパターンをスキャン中...\n");
 
-    for (const auto& region : heapRegions) {
-        uint8_t* base = region.first;
-        size_t size = region.second;
+    std::vector<HeapRegion> heapRegions;
+    GetHeapRegions(0x100000, heapRegions);
 
-        for (size_t i = 0; i < size - 16; i += 8) {
-            void* mainRAMCandidate = nullptr;
-            if (!SafeReadPtr(base + i, &mainRAMCandidate)) continue;
-            if (!mainRAMCandidate) continue;
+    printf("[DLL] %zu個のヒープ領域をスキャン対象として発見\n", heapRegions.size());
 
-            uint32_t maskCandidate = 0;
-            if (!SafeReadU32(base + i + 8, &maskCandidate)) continue;
+    HeapScanConfig scanConfig;
+    scanConfig.safeRead = SafeReadBlock;
+    scanConfig.guardedCall = SafeInvoke;
+    scanConfig.isCommitted = IsCommittedRegion;
+    HeapScanResult result = ScanHeapForMainRAM(heapRegions, scanConfig);
 
-            if (maskCandidate != NDS_MAIN_RAM_MASK && maskCandidate != DSI_MAIN_RAM_MASK) {
-                continue;
-            }
+    printf("[DLL] スキャン: %zu/%zuチャンク %.1fMB %uスレッド(%s) %.1fms\n",
+        result.chunksScanned, result.chunkCount, result.bytesScanned / (1024.0 * 1024.0),
+        result.threads, result.impl, result.elapsedMs);
+    if (!result.mainRAM) return nullptr;
 
-            MEMORY_BASIC_INFORMATION targetMbi;
-            if (!VirtualQuery(mainRAMCandidate, &targetMbi, sizeof(targetMbi))) continue;
-            if (targetMbi.State != MEM_COMMIT) continue;
+    printf("[DLL] *** ヒープ内でNDSパターン発見! ***\n");
+    printf("[DLL]   MainRAM: %p  Mask: 0x%08X  (パターン位置: %p)\n",
+        result.mainRAM, result.mask, result.foundAt);
 
-            size_t expectedSize = (maskCandidate == NDS_MAIN_RAM_MASK) ? DS_MAIN_RAM_SIZE : DSI_MAIN_RAM_SIZE;
-            if (targetMbi.RegionSize < expectedSize) continue;
+    *outMask = result.mask;
+    *outFoundAt = result.foundAt;
+    return result.mainRAM;
+}
 
-            printf("[DLL] *** ヒープ内でNDSパターン発見! ***\n");
-            printf("[DLL]   MainRAM: %p  Mask: 0x%08X\n", mainRAMCandidate, maskCandidate);
+// ========================================
+// MainRAM検出（ロケータキャッシュ）
+// ========================================
+// 前回見つけたパターンの位置を melonDS.exe からのポインタパスとして保存しておき、
+// 次回はパスを辿って検証するだけで済ませる（合わなければヒープスキャン）
+// パスの学習は時間がかかるので、ヒープスキャンで見つけた位置を覚えておき、モニターの学習スレッドで行う
+
+static bool g_locatorInitialized = false;
+static bool g_locatorKeyValid = false;
+static uint64_t g_locatorKey = 0;
+static std::wstring g_locatorCachePath;
+static std::mutex g_locatorMutex;       // 以下のキャッシュの状態（FindMainRAM と学習スレッド）
+static bool g_haveLocatorPath = false;
+static PointerPath g_locatorPath;
+static bool g_learnPending = false;     // 学習待ちのパターンの位置がある
+static const uint8_t* g_learnFoundAt = nullptr;
+static const uint8_t* g_learnMainRAM = nullptr;
+
+static bool ReadFileContents(const std::wstring& path, std::string& out) {
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, 0, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    out.clear();
+    char buffer[4096];
+    DWORD bytesRead = 0;
+    while (ReadFile(file, buffer, sizeof(buffer), &bytesRead, nullptr) && bytesRead > 0) {
+        out.append(buffer, bytesRead);
+    }
+    CloseHandle(file);
+    return true;
+}
 
-            g_mainRAMMask = maskCandidate;
-            return static_cast<uint8_t*>(mainRAMCandidate);
-        }
+// 一時ファイルに書いてから置き換える（途中で落ちても壊れた内容を残さない）
+static bool WriteFileContents(const std::wstring& path, const std::string& contents) {
+    std::wstring temporary = path + L".tmp";
+    HANDLE file = CreateFileW(temporary.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, 0, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    DWORD written = 0;
+    bool ok = WriteFile(file, contents.data(), (DWORD)contents.size(), &written, nullptr) &&
+              written == contents.size();
+    CloseHandle(file);
+    if (!ok || !MoveFileExW(temporary.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+        DeleteFileW(temporary.c_str());
+        return false;
     }
+    return true;
+}
 
-    return nullptr;
+// 読み込まれた実行ファイルの PE ヘッダ（タイムスタンプ・イメージサイズ・チェックサム）のハッシュ
+// ビルドが変わればパスも変わるのでキーにする。ファイルを読まないので起動時にすぐ求まる
+static uint64_t HashImageHeader(const uint8_t* module) {
+    auto dos = reinterpret_cast<const IMAGE_DOS_HEADER*>(module);
+    auto nt = reinterpret_cast<const IMAGE_NT_HEADERS*>(module + dos->e_lfanew);
+    uint64_t hash = HashLocatorKey(&nt->FileHeader.TimeDateStamp, sizeof(nt->FileHeader.TimeDateStamp));
+    hash = HashLocatorKey(&nt->OptionalHeader.SizeOfImage, sizeof(nt->OptionalHeader.SizeOfImage), hash);
+    return HashLocatorKey(&nt->OptionalHeader.CheckSum, sizeof(nt->OptionalHeader.CheckSum), hash);
 }
 
-// ========================================
-// コマンド処理（Electron → DLL）
-// ========================================
+static void InitLocatorCache() {
+    g_locatorInitialized = true;
 
-static void HandleCommand(const std::string& message) {
-    JsonCommand cmd = ParseCommand(message.c_str());
-    if (!cmd.valid) {
-        printf("[DLL] 不正なコマンド: %s\n", message.c_str());
-        return;
-    }
+    wchar_t exePath[MAX_PATH];
+    DWORD length = GetModuleFileNameW(nullptr, exePath, MAX_PATH);
+    if (length == 0 || length >= MAX_PATH) return;
+    std::wstring directory(exePath, length);
+    size_t slash = directory.find_last_of(L"\\/");
+    directory.resize(slash == std::wstring::npos ? 0 : slash + 1);
+    g_locatorCachePath = directory + LOCATOR_CACHE_FILE;
 
-    if (strcmp(cmd.cmd, "ping") == 0) {
-        // pong応答
-        SYSTEMTIME st;
-        GetSystemTime(&st);
-        FILETIME ft;
-        SystemTimeToFileTime(&st, &ft);
-        ULARGE_INTEGER uli;
-        uli.LowPart = ft.dwLowDateTime;
-        uli.HighPart = ft.dwHighDateTime;
-        // Windows FILETIME → Unix timestamp (ms)
-        int64_t ts = (int64_t)(uli.QuadPart / 10000ULL - 11644473600000ULL);
-
-        JsonWriter jw;
-        jw.BeginObject();
-        jw.StringField("type", "pong");
-        jw.IntField("ts", ts);
-        jw.EndObject();
-        g_pipeServer.Send(jw.GetString());
-
-    } else if (strcmp(cmd.cmd, "setVersion") == 0) {
-        // バージョン設定（一度だけ有効。再起動しないと変更不可）
-        if (g_versionSelected) {
-            printf("[DLL] setVersion: 既にバージョン選択済み (%s)\n", g_selectedVersion);
-            return;
-        }
-        const GameAddress* addresses = nullptr;
-        size_t count = 0;
-        if (strcmp(cmd.target, "RJ") == 0) {
-            addresses = RJ_ADDRESSES;
-            count = RJ_ADDRESS_COUNT;
-            strncpy_s(g_selectedVersion, "RJ", 3);
-        } else if (strcmp(cmd.target, "BA") == 0) {
-            addresses = BA_ADDRESSES;
-            count = BA_ADDRESS_COUNT;
-            strncpy_s(g_selectedVersion, "BA", 3);
-        } else {
-            printf("[DLL] setVersion: 不明なバージョン: %s\n", cmd.target);
-            return;
-        }
-        for (size_t i = 0; i < count; i++) {
-            g_deltaTracker.RegisterAddress(addresses[i].name, addresses[i].dsAddress, addresses[i].size);
-        }
-        g_versionSelected = true;
-        printf("[DLL] バージョン設定: %s (%zu アドレス)\n", g_selectedVersion, count);
-
-        // フルステート送信（MainRAM検出済みなら即時）
-        if (g_mainRAM) {
-            g_deltaTracker.Update(ReadMemory);
-            g_pipeServer.Send(g_deltaTracker.BuildFullStateJson());
-            g_deltaTracker.ResetChangeFlags();
-        }
+    auto start = std::chrono::steady_clock::now();
+    g_locatorKey = HashImageHeader(reinterpret_cast<const uint8_t*>(GetModuleHandleW(nullptr)));
+    g_locatorKeyValid = true;
 
-    } else if (strcmp(cmd.cmd, "refresh") == 0) {
-        // 現在のstatus送信
-        {
-            JsonWriter jw;
-            jw.BeginObject();
-            jw.StringField("type", "status");
-            jw.BoolField("connected", true);
-            jw.BoolField("gameActive", g_mainRAM != nullptr);
-            if (g_mainRAM) {
-                jw.PtrField("mainram", g_mainRAM);
-            }
-            jw.EndObject();
-            g_pipeServer.Send(jw.GetString());
-        }
-        // フルステート再送（バージョン選択済みの場合のみ）
-        if (g_mainRAM && g_versionSelected) {
-            g_deltaTracker.Update(ReadMemory);
-            std::string fullJson = g_deltaTracker.BuildFullStateJson();
-            g_pipeServer.Send(fullJson);
-            g_deltaTracker.ResetChangeFlags();
-        }
-        printf("[DLL] refresh実行\n");
-
-    } else if (strcmp(cmd.cmd, "write") == 0) {
-        // 値書き込み
-        TrackedValue* tv = g_deltaTracker.FindByName(cmd.target);
-        if (tv) {
-            if (WriteMemory(tv->dsAddress, tv->size, cmd.value)) {
-                printf("[DLL] write: %s = %u\n", cmd.target, cmd.value);
-            } else {
-                JsonWriter jw;
-                jw.BeginObject();
-                jw.StringField("type", "error");
-                jw.StringField("code", "WRITE_FAILED");
-                jw.StringField("msg", "Memory write failed");
-                jw.EndObject();
-                g_pipeServer.Send(jw.GetString());
-            }
-        } else {
-            JsonWriter jw;
-            jw.BeginObject();
-            jw.StringField("type", "error");
-            jw.StringField("code", "UNKNOWN_TARGET");
-            jw.StringField("msg", "Target address not found");
-            jw.EndObject();
-            g_pipeServer.Send(jw.GetString());
-        }
+    std::string contents;
+    if (ReadFileContents(g_locatorCachePath, contents)) {
+        g_haveLocatorPath = FindLocatorCacheEntry(contents, g_locatorKey, g_locatorPath);
+    }
+    double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    printf("[DLL] ロケータキャッシュ: キー %016llx %s (%.1fms)\n", (unsigned long long)g_locatorKey,
+        g_haveLocatorPath ? FormatPointerPath(g_locatorPath).c_str() : "なし", elapsedMs);
+}
 
-    } else if (strcmp(cmd.cmd, "rescan") == 0) {
-        // MainRAM再スキャン（未検出時のみ実行）
-        if (!g_mainRAM) {
-            g_mainRAM = FindMainRAMByHeapScan();
-        }
-        JsonWriter jw;
-        jw.BeginObject();
-        jw.StringField("type", "status");
-        jw.BoolField("connected", true);
-        jw.BoolField("gameActive", g_mainRAM != nullptr);
-        if (g_mainRAM) {
-            jw.PtrField("mainram", g_mainRAM);
+// モジュールの書き込み可能セクション（.data / .bss 等。静的変数の置き場所）
+static void GetWritableSections(const uint8_t* module, std::vector<HeapRegion>& out) {
+    auto dos = reinterpret_cast<const IMAGE_DOS_HEADER*>(module);
+    auto nt = reinterpret_cast<const IMAGE_NT_HEADERS*>(module + dos->e_lfanew);
+    const IMAGE_SECTION_HEADER* section = IMAGE_FIRST_SECTION(nt);
+    for (WORD i = 0; i < nt->FileHeader.NumberOfSections; i++, section++) {
+        if (!(section->Characteristics & IMAGE_SCN_MEM_WRITE)) continue;
+        out.push_back({ const_cast<uint8_t*>(module) + section->VirtualAddress, section->Misc.VirtualSize });
+    }
+}
+
+// 読み取り可能なコミット済み領域（低アドレス順）
+static void GetReadableRegions(std::vector<HeapRegion>& out) {
+    MEMORY_BASIC_INFORMATION mbi;
+    uint8_t* addr = nullptr;
+    while (VirtualQuery(addr, &mbi, sizeof(mbi))) {
+        bool readable = mbi.State == MEM_COMMIT &&
+                        !(mbi.Protect & (PAGE_NOACCESS | PAGE_GUARD)) && mbi.Protect != 0;
+        if (readable) {
+            out.push_back({ static_cast<uint8_t*>(mbi.BaseAddress), mbi.RegionSize });
         }
-        jw.EndObject();
-        g_pipeServer.Send(jw.GetString());
-        printf("[DLL] rescan実行: %s\n", g_mainRAM ? "検出成功" : "未検出");
-
-    } else {
-        printf("[DLL] 不明コマンド: %s\n", cmd.cmd);
-        JsonWriter jw;
-        jw.BeginObject();
-        jw.StringField("type", "error");
-        jw.StringField("code", "UNKNOWN_CMD");
-        jw.StringField("msg", "Unknown command");
-        jw.EndObject();
-        g_pipeServer.Send(jw.GetString());
+        addr = static_cast<uint8_t*>(mbi.BaseAddress) + mbi.RegionSize;
     }
 }
 
-// ========================================
-// メインスレッド
-// ========================================
+// パターンの位置から MainRAM を読んで検証する（ヒープスキャンの候補検証と同じ条件）
+static uint8_t* ReadMainRAMPattern(const uint8_t* at, uint32_t* outMask) {
+    uint8_t bytes[8 + sizeof(uint32_t)];
+    if (!SafeReadBlock(at, bytes, sizeof(bytes))) return nullptr;
+    void* mainRAM;
+    uint32_t mask;
+    memcpy(&mainRAM, bytes, sizeof(mainRAM));
+    memcpy(&mask, bytes + 8, sizeof(mask));
+    if (!mainRAM || (mask != NDS_MAIN_RAM_MASK && mask != DSI_MAIN_RAM_MASK)) return nullptr;
+    size_t expectedSize = (mask == NDS_MAIN_RAM_MASK) ? DS_MAIN_RAM_SIZE : DSI_MAIN_RAM_SIZE;
+    if (!IsCommittedRegion(mainRAM, expectedSize)) return nullptr;
+    *outMask = mask;
+    return static_cast<uint8_t*>(mainRAM);
+}
 
-void MainThreadFunc() {
-    printf("[DLL] メインスレッド開始\n");
-
-    // PipeServerコールバック設定
-    // ※ アドレス登録は setVersion コマンド受信後に行う
-    g_pipeServer.OnMessage = HandleCommand;
-    g_pipeServer.OnConnect = []() {
-        printf("[DLL] クライアント接続 → hello送信\n");
-        g_pipeServer.Send(g_deltaTracker.BuildHelloJson());
-
-        // 現在の状態を即時返す
-        JsonWriter jw;
-        jw.BeginObject();
-        jw.StringField("type", "status");
-        jw.BoolField("connected", true);
-        jw.BoolField("gameActive", g_mainRAM != nullptr);
-        if (g_mainRAM) jw.PtrField("mainram", g_mainRAM);
-        jw.EndObject();
-        g_pipeServer.Send(jw.GetString());
-
-        // MainRAM検出済み＋バージョン選択済みならフルステート送信
-        if (g_mainRAM && g_versionSelected) {
-            g_deltaTracker.Update(ReadMemory);
-            g_pipeServer.Send(g_deltaTracker.BuildFullStateJson());
-            g_deltaTracker.ResetChangeFlags();
-        }
-    };
-    g_pipeServer.OnDisconnect = []() {
-        printf("[DLL] クライアント切断\n");
-    };
-
-    // PipeServer開始
-    g_pipeServer.Start("\\\\.\\pipe\\ssr3_viewer");
-
-    // MainRAM検出はクライアントからの rescan コマンドで行う
-    // バージョン選択待機（フロントエンドからの setVersion コマンドを待つ）
-    printf("[DLL] バージョン選択待機中...\n");
-    while (g_running && !g_versionSelected) {
-        Sleep(100);
-    }
-    if (!g_running) {
-        g_pipeServer.Stop();
-        return;
+// 静的領域から foundAt までのパスの候補を探す。emuInstances[] → EmuInstance::nds の形（深さ2以下）を先に試し、
+// 見つからなければヒープ全体の逆引き表で深いパスを探す
+// cached は同じビルドで前に覚えたパス（なければ nullptr）。最後のオフセットが NDS 先頭からのパターンの位置
+static bool FindLocatorPaths(const uint8_t* module, const uint8_t* foundAt, const PointerPath* cached,
+                             std::vector<PointerPath>& outPaths) {
+    std::vector<HeapRegion> sections;
+    std::vector<HeapRegion> readable;
+    GetWritableSections(module, sections);
+    GetReadableRegions(readable);
+    PointerPathLimits limits;
+    if (cached) limits.patternOffset = cached->offsets[cached->depth - 1];
+    if (FindStaticPointerPaths(sections, module, foundAt, readable, limits, LOCATOR_MAX_CANDIDATES, SafeReadBlock, outPaths)) {
+        return true;
     }
-    printf("[DLL] バージョン確定: %s\n", g_selectedVersion);
 
-    // ========================================
-    // メインポーリングループ (50ms間隔)
-    // ========================================
-    printf("[DLL] ポーリング開始 (50ms)\n");
-    DWORD lastFullSend = GetTickCount();
+    PointerScanConfig scanConfig;
+    GetHeapRegions(0, scanConfig.heapRegions);
+    scanConfig.staticRanges = sections;
+    scanConfig.moduleBase = module;
+    scanConfig.safeRead = SafeReadBlock;
+    scanConfig.maxResults = 4;
+    scanConfig.maxBytes = LOCATOR_SCAN_MAX_BYTES;
+    scanConfig.maxPointers = LOCATOR_SCAN_MAX_POINTERS;
+    PointerScanResult result = FindPointerPaths(foundAt, scanConfig);
+    printf("[DLL] ポインタスキャン: %.1fMB%s %zu個のポインタ 段%u 候補%zu%s %uスレッド (表 %.1fms / 探索 %.1fms)\n",
+        result.bytesScanned / (1024.0 * 1024.0), result.mapTruncated ? "(打ち切り)" : "",
+        result.pointerCount, result.levelsSearched, result.nodesVisited, result.truncated ? "(打ち切り)" : "",
+        result.threads, result.buildMs, result.searchMs);
+    for (const PointerPath& path : result.paths) {
+        printf("[DLL]   %s\n", FormatPointerPath(path).c_str());
+    }
+    outPaths = result.paths;
+    return !outPaths.empty();
+}
 
-    while (g_running) {
-        if (!g_pipeServer.IsConnected()) {
-            Sleep(50);
-            continue;
-        }
+// path が今も foundAt を指し、そこに mainRAM のパターンがあるか
+static bool LocatorPathReaches(const uint8_t* module, const PointerPath& path, const uint8_t* foundAt, const uint8_t* mainRAM) {
+    const uint8_t* resolved = nullptr;
+    uint32_t mask = 0;
+    return ResolvePointerPath(module, path, SafeReadBlock, &resolved) && resolved == foundAt &&
+           ReadMainRAMPattern(resolved, &mask) == mainRAM;
+}
 
-        // メモリ読み取り＆差分検知
-        g_deltaTracker.Update(ReadMemory);
+// ヒープスキャンで見つけた位置までのパスを探して保存する
+// 候補は間を置いて辿り直し、同じ位置を指し続けたものだけを使う（一時的なポインタを覚えないように）
+static void LearnLocatorPath(const uint8_t* module, const uint8_t* foundAt, const uint8_t* mainRAM,
+                             const PointerPath* cached) {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<PointerPath> candidates;
+    if (!FindLocatorPaths(module, foundAt, cached, candidates)) {
+        printf("[DLL] ロケータ: 静的領域からのパスが見つかりません\n");
+        return;
+    }
+    candidates.erase(std::remove_if(candidates.begin(), candidates.end(), [&](const PointerPath& path) {
+        return !LocatorPathReaches(module, path, foundAt, mainRAM);
+    }), candidates.end());
+    Sleep(LOCATOR_STABLE_CHECK_MS);
+    auto stable = std::find_if(candidates.begin(), candidates.end(), [&](const PointerPath& path) {
+        return LocatorPathReaches(module, path, foundAt, mainRAM);
+    });
+    if (stable == candidates.end()) {
+        printf("[DLL] ロケータ: 静的領域からの安定したパスが見つかりません (候補%zu)\n", candidates.size());
+        return;
+    }
+    const PointerPath path = *stable;
+    double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    std::lock_guard<std::mutex> lock(g_locatorMutex);
+    std::string contents;
+    ReadFileContents(g_locatorCachePath, contents);
+    bool saved = WriteFileContents(g_locatorCachePath, UpdateLocatorCacheEntry(contents, g_locatorKey, path));
+    g_locatorPath = path;
+    g_haveLocatorPath = true;
+    printf("[DLL] ロケータ: パス %s (%.1fms)%s\n", FormatPointerPath(path).c_str(), elapsedMs,
+        saved ? "" : " 保存失敗");
+}
 
-        // 定期的にフルステート送信 (30秒ごと)
-        DWORD now = GetTickCount();
-        if (now - lastFullSend >= 30000) {
-            g_pipeServer.Send(g_deltaTracker.BuildFullStateJson());
-            g_deltaTracker.ResetChangeFlags();
-            lastFullSend = now;
+// findMainRAM: キャッシュのパスを辿り、合わなければヒープスキャン
+static bool FindMainRAM(MainRAMLocation* out) {
+    const uint8_t* module = reinterpret_cast<const uint8_t*>(GetModuleHandleW(nullptr));
+    bool haveLocatorPath;
+    PointerPath locatorPath;
+    {
+        std::lock_guard<std::mutex> lock(g_locatorMutex);
+        if (!g_locatorInitialized) InitLocatorCache();
+        haveLocatorPath = g_haveLocatorPath;
+        locatorPath = g_locatorPath;
+    }
+
+    if (haveLocatorPath) {
+        auto start = std::chrono::steady_clock::now();
+        const uint8_t* at = nullptr;
+        uint8_t* mainRAM = nullptr;
+        uint32_t mask = 0;
+        if (ResolvePointerPath(module, locatorPath, SafeReadBlock, &at)) {
+            mainRAM = ReadMainRAMPattern(at, &mask);
         }
-        // 差分があれば送信
-        else if (g_deltaTracker.HasChanges()) {
-            std::string deltaJson = g_deltaTracker.BuildDeltaJson();
-            if (!deltaJson.empty()) {
-                g_pipeServer.Send(deltaJson);
-            }
-            g_deltaTracker.ResetChangeFlags();
+        double elapsedUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        if (mainRAM) {
+            printf("[DLL] キャッシュのパスでMainRAM検出: %p  Mask: 0x%08X (%.1fus)\n", mainRAM, mask, elapsedUs);
+            out->mainRAM = mainRAM;
+            out->mask = mask;
+            out->patternAt = at;
+            return true;
         }
+    }
+
+    const uint8_t* foundAt = nullptr;
+    uint8_t* mainRAM = FindMainRAMByHeapScan(&out->mask, &foundAt);
+    if (!mainRAM) return false;
+    if (g_locatorKeyValid) {
+        std::lock_guard<std::mutex> lock(g_locatorMutex);
+        g_learnPending = true;
+        g_learnFoundAt = foundAt;
+        g_learnMainRAM = mainRAM;
+    }
+    out->mainRAM = mainRAM;
+    out->patternAt = foundAt;
+    return true;
+}
 
-        Sleep(50);
+// learnMainRAM: ヒープスキャンで見つけた位置が残っていれば、パスを探して保存する（学習スレッドから呼ぶ）
+// その間にキャッシュのパスが同じ位置を指すようになっていれば（一時的に辿れなかっただけなら）探さない
+static bool LearnMainRAM() {
+    const uint8_t* foundAt;
+    const uint8_t* mainRAM;
+    bool haveLocatorPath;
+    PointerPath locatorPath;
+    {
+        std::lock_guard<std::mutex> lock(g_locatorMutex);
+        if (!g_learnPending) return false;
+        g_learnPending = false;
+        foundAt = g_learnFoundAt;
+        mainRAM = g_learnMainRAM;
+        haveLocatorPath = g_haveLocatorPath;
+        locatorPath = g_locatorPath;
+    }
+    const uint8_t* module = reinterpret_cast<const uint8_t*>(GetModuleHandleW(nullptr));
+    if (haveLocatorPath && LocatorPathReaches(module, locatorPath, foundAt, mainRAM)) {
+        printf("[DLL] ロケータ: キャッシュのパス %s が有効なので学習しない\n", FormatPointerPath(locatorPath).c_str());
+        return true;
     }
+    LearnLocatorPath(module, foundAt, mainRAM, haveLocatorPath ? &locatorPath : nullptr);
+    return true;
+}
+
+// findAllMainRAM: 全インスタンス（同じプロセスで複数のエミュレータを動かしている場合）
+// 1つだけ覚えるロケータキャッシュは使わず、毎回ヒープ全体をスキャンする
+static size_t FindAllMainRAM(MainRAMLocation* out, size_t capacity) {
+    printf("[DLL] ヒープ領域で全インスタンスのMainRAMパターンをスキャン中...\n");
+
+    std::vector<HeapRegion> heapRegions;
+    GetHeapRegions(0x100000, heapRegions);
+
+    HeapScanConfig scanConfig;
+    scanConfig.safeRead = SafeReadBlock;
+    scanConfig.guardedCall = SafeInvoke;
+    scanConfig.isCommitted = IsCommittedRegion;
+    scanConfig.findAll = true;
+    HeapScanResult result = ScanHeapForMainRAM(heapRegions, scanConfig);
+
+    printf("[DLL] スキャン: %zu/%zuチャンク %.1fMB %uスレッド(%s) %.1fms → %zu個\n",
+        result.chunksScanned, result.chunkCount, result.bytesScanned / (1024.0 * 1024.0),
+        result.threads, result.impl, result.elapsedMs, result.hits.size());
+
+    size_t count = (std::min)(capacity, result.hits.size());
+    for (size_t i = 0; i < count; i++) {
+        const HeapScanHit& hit = result.hits[i];
+        printf("[DLL]   [%zu] MainRAM: %p  Mask: 0x%08X  (パターン位置: %p)\n", i, hit.mainRAM, hit.mask, hit.foundAt);
+        out[i].mainRAM = hit.mainRAM;
+        out[i].mask = hit.mask;
+        out[i].patternAt = hit.foundAt;
+    }
+    return count;
+}
+
+// ========================================
+// メインスレッド
+// ========================================
+
+// SwapBuffersフックが使えればフレーム同期、使えなければ nullptr（50ms周期のポーリング）
+static FrameSource* BeginPolling() {
+    return g_swapFrameSource.Install() ? &g_swapFrameSource : nullptr;
+}
 
-    g_pipeServer.Stop();
-    printf("[DLL] メインスレッド停止\n");
+static void EndPolling() {
+    g_swapFrameSource.Uninstall();
+}
+
+void MainThreadFunc() {
+    g_transports.Add(&g_pipeServer, PIPE_NAME);
+    static char webSocketPort[16];
+    DWORD portLength = GetEnvironmentVariableA(WEBSOCKET_PORT_ENV, webSocketPort, sizeof(webSocketPort));
+    if (portLength > 0 && portLength < sizeof(webSocketPort)) {
+        g_transports.Add(&g_webSocketServer, webSocketPort);
+    }
+
+    MonitorConfig config;
+    config.transport = &g_transports;
+    config.sharedMemoryName = SHARED_STATE_NAME;
+    config.findMainRAM = FindMainRAM;
+    config.findAllMainRAM = FindAllMainRAM;
+    config.learnMainRAM = LearnMainRAM;
+    config.safeRead = SafeReadBlock;
+    config.safeWrite = SafeWriteValue;
+    config.beginPolling = BeginPolling;
+    config.endPolling = EndPolling;
+    RunMonitor(config, g_running);
 }
 
 // ========================================
@@ -865,7 +611,7 @@ BOOL APIENTRY DllMain(HMODULE hModule, DWORD ul_reason_for_call, LPVOID lpReserv
     case DLL_PROCESS_DETACH:
         printf("[DLL] DLLアンロード中...\n");
         g_running = false;
-        g_pipeServer.Stop();
+        g_transports.Stop();
         if (g_mainThread.joinable()) {
             g_mainThread.detach();
         }
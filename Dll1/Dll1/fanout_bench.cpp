@@ -0,0 +1,246 @@
+﻿#include "pch.h"
+// fanout_bench.cpp : 複数クライアントへのブロードキャストの計測（UnixSocketServer、Linux のみ）
+// N 個の合成クライアントを接続し、一定間隔で同じバッファを全員に送る。
+// クライアント毎の受信遅延（送信側で積んでから受け取るまで）と送信キューの統計を出し、
+// 1つだけ読むのが遅いクライアントを混ぜた時に他のクライアントが影響を受けないかを見る
+#include "bench_entry.h"
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+
+#ifndef _WIN32
+
+#include "unix_socket_server.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+struct FanoutBenchConfig {
+    uint32_t clients = 4;
+    uint32_t rate = 1000;           // 1秒あたりの送信数
+    double seconds = 2.0;
+    uint32_t messageSize = 160;     // 1通のバイト数（delta の平均程度）
+    uint32_t slowMs = 20;           // 遅いクライアントが1回読む毎に待つ時間（0 なら遅いクライアントなしの場合だけ）
+};
+
+struct FanoutClient {
+    int fd = -1;
+    bool slow = false;
+    std::thread thread;
+    std::vector<uint32_t> latenciesUs;
+    uint64_t received = 0;
+    uint64_t gaps = 0;              // seq が飛んだ数（合流・破棄されたメッセージ）
+};
+
+static uint64_t FanoutNowNs() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static int ConnectClient(const char* path, bool slow) {
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    if (slow) {
+        // 受信バッファを小さくして、送信側のキューがすぐ詰まるようにする
+        int size = 4096;
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    }
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, path, strlen(path) + 1);
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// 1行ずつ取り出し、"seq" と "t"（送信側で積んだ時刻）から欠落と遅延を数える
+static void ClientReadLoop(FanoutClient& client, const std::atomic<bool>& stop, uint32_t slowMs) {
+    std::string pending;
+    char buf[4096];
+    uint64_t lastSeq = 0;
+    while (!stop.load()) {
+        pollfd pfd = { client.fd, POLLIN, 0 };
+        if (poll(&pfd, 1, 50) <= 0) continue;
+        ssize_t n = read(client.fd, buf, client.slow ? 256 : sizeof(buf));
+        if (n <= 0) break;
+        uint64_t now = FanoutNowNs();
+        pending.append(buf, (size_t)n);
+        size_t start = 0;
+        for (size_t nl = pending.find('\n'); nl != std::string::npos; nl = pending.find('\n', start)) {
+            const char* line = pending.c_str() + start;
+            const char* seqField = strstr(line, "\"seq\":");
+            const char* timeField = strstr(line, "\"t\":");
+            if (seqField && timeField) {
+                uint64_t seq = strtoull(seqField + 6, nullptr, 10);
+                uint64_t sentNs = strtoull(timeField + 4, nullptr, 10);
+                if (lastSeq && seq > lastSeq + 1) client.gaps += seq - lastSeq - 1;
+                lastSeq = seq;
+                client.latenciesUs.push_back((uint32_t)((now - sentNs) / 1000));
+                client.received++;
+            }
+            start = nl + 1;
+        }
+        pending.erase(0, start);
+        if (client.slow) std::this_thread::sleep_for(std::chrono::milliseconds(slowMs));
+    }
+}
+
+static uint32_t Percentile(std::vector<uint32_t>& values, double p) {
+    if (values.empty()) return 0;
+    size_t k = (size_t)(p * (values.size() - 1));
+    std::nth_element(values.begin(), values.begin() + k, values.end());
+    return values[k];
+}
+
+static bool RunFanoutScenario(const FanoutBenchConfig& config, bool withSlow) {
+    char path[108];
+    snprintf(path, sizeof(path), "/tmp/fanout_bench_%d.sock", (int)getpid());
+
+    UnixSocketServer server;
+    std::mutex idsMutex;
+    std::vector<uint32_t> clientIds;
+    server.OnConnect = [&](uint32_t clientId) {
+        std::lock_guard<std::mutex> lock(idsMutex);
+        clientIds.push_back(clientId);
+    };
+    if (!server.Start(path)) return false;
+
+    std::vector<FanoutClient> clients(config.clients);
+    std::atomic<bool> stop{ false };
+    for (uint32_t i = 0; i < config.clients; i++) {
+        clients[i].slow = withSlow && i + 1 == config.clients;
+        clients[i].fd = ConnectClient(path, clients[i].slow);
+        if (clients[i].fd < 0) {
+            fprintf(stderr, "接続できません: %s\n", path);
+            stop = true;
+            break;
+        }
+        clients[i].thread = std::thread(ClientReadLoop, std::ref(clients[i]), std::cref(stop), config.slowMs);
+    }
+    for (int wait = 0; wait < 100 && !stop.load(); wait++) {
+        {
+            std::lock_guard<std::mutex> lock(idsMutex);
+            if (clientIds.size() == config.clients) break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    std::vector<uint32_t> ids;
+    {
+        std::lock_guard<std::mutex> lock(idsMutex);
+        ids = clientIds;
+    }
+
+    // 一定間隔で同じバッファを全クライアントに積む（接続順 = clients の順）
+    const uint64_t total = (uint64_t)(config.rate * config.seconds);
+    const auto interval = std::chrono::nanoseconds(1000000000ULL / (std::max)(config.rate, 1u));
+    std::string padding((std::max)(config.messageSize, 64u) - 64, 'x');
+    double broadcastNs = 0;
+    auto begin = std::chrono::steady_clock::now();
+    for (uint64_t seq = 1; seq <= total && !stop.load(); seq++) {
+        std::this_thread::sleep_until(begin + interval * (seq - 1));
+        char header[96];
+        uint64_t sendNs = FanoutNowNs();
+        snprintf(header, sizeof(header), "{\"type\":\"delta\",\"seq\":%llu,\"t\":%llu,\"pad\":\"",
+            (unsigned long long)seq, (unsigned long long)sendNs);
+        SendBuffer buffer = Transport::MakeLine(std::string(header) + padding + "\"}");
+        for (uint32_t id : ids) server.SendShared(id, buffer, MessageClass::Delta);
+        broadcastNs += (double)(FanoutNowNs() - sendNs);
+    }
+
+    // 速いクライアントの送信キューが空くまで待ってから統計を取る
+    for (int wait = 0; wait < 200; wait++) {
+        bool busy = false;
+        for (size_t i = 0; i < ids.size(); i++) {
+            if (!clients[i].slow && server.IsSendBusy(ids[i])) busy = true;
+        }
+        if (!busy) break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    std::vector<SendQueueStats> stats(ids.size());
+    for (size_t i = 0; i < ids.size(); i++) server.GetSendQueueStats(ids[i], stats[i]);
+
+    stop = true;
+    server.Stop();
+    for (auto& client : clients) {
+        if (client.thread.joinable()) client.thread.join();
+        if (client.fd >= 0) close(client.fd);
+    }
+
+    if (withSlow) {
+        printf("-- クライアント%u が遅い（1回の読み取り毎に %ums 待つ）\n", config.clients, config.slowMs);
+    } else {
+        printf("-- 全クライアントが速い\n");
+    }
+    printf("配信 %.0f ns/通（%zu クライアントへ積むまで）\n", total ? broadcastNs / total : 0.0, ids.size());
+    printf("%4s %4s %8s %8s %8s %8s %9s %8s %8s %8s %6s %10s\n", "No", "遅い", "受信", "欠落",
+        "p50 us", "p99 us", "max us", "送信済", "合流", "捨てた", "最大深", "送信 avg us");
+    for (size_t i = 0; i < clients.size() && i < stats.size(); i++) {
+        FanoutClient& client = clients[i];
+        uint32_t p50 = Percentile(client.latenciesUs, 0.5);
+        uint32_t p99 = Percentile(client.latenciesUs, 0.99);
+        uint32_t maxUs = client.latenciesUs.empty() ? 0 : *std::max_element(client.latenciesUs.begin(), client.latenciesUs.end());
+        printf("%4zu %4s %8llu %8llu %8u %8u %9u %8llu %8llu %8llu %6zu %10llu\n", i + 1, client.slow ? "*" : "",
+            (unsigned long long)client.received, (unsigned long long)client.gaps, p50, p99, maxUs,
+            (unsigned long long)stats[i].sent, (unsigned long long)stats[i].coalesced,
+            (unsigned long long)stats[i].dropped, stats[i].maxDepth, (unsigned long long)stats[i].avgLatencyUs);
+    }
+    printf("\n");
+    return true;
+}
+
+#endif // !_WIN32
+
+// ========================================
+// 計測プログラムの入口（Linux は FANOUT_BENCH_MAIN を定義して単体でビルド。Windows の Bench プロジェクトの "fanout" は未対応と表示するだけ）
+//   g++ -std=c++17 -O2 -DFANOUT_BENCH_MAIN fanout_bench.cpp unix_socket_server.cpp send_queue.cpp line_framer.cpp latency_stats.cpp -lpthread -o fanout_bench
+//   ./fanout_bench [--clients N] [--rate N] [--seconds F] [--size N] [--slow-ms N]
+// ========================================
+int FanoutBenchMain(int argc, char** argv) {
+#ifdef _WIN32
+    (void)argc;
+    (void)argv;
+    fprintf(stderr, "fanout は Linux（UnixSocketServer）のみ対応\n");
+    return 1;
+#else
+    FanoutBenchConfig config;
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = (i + 1 < argc) ? argv[i + 1] : "0";
+        if (strcmp(arg, "--clients") == 0) { config.clients = (uint32_t)strtoul(value, nullptr, 10); i++; }
+        else if (strcmp(arg, "--rate") == 0) { config.rate = (uint32_t)strtoul(value, nullptr, 10); i++; }
+        else if (strcmp(arg, "--seconds") == 0) { config.seconds = atof(value); i++; }
+        else if (strcmp(arg, "--size") == 0) { config.messageSize = (uint32_t)strtoul(value, nullptr, 10); i++; }
+        else if (strcmp(arg, "--slow-ms") == 0) { config.slowMs = (uint32_t)strtoul(value, nullptr, 10); i++; }
+        else {
+            fprintf(stderr, "不明な引数: %s\n", arg);
+            return 2;
+        }
+    }
+    if (config.clients == 0 || config.clients > Transport::MAX_CLIENTS || config.rate == 0) {
+        fprintf(stderr, "--clients は 1〜%zu、--rate は 1 以上\n", Transport::MAX_CLIENTS);
+        return 2;
+    }
+
+    printf("クライアント %u, %u 通/秒 × %.1f 秒, %u バイト/通\n\n", config.clients, config.rate, config.seconds, config.messageSize);
+    if (!RunFanoutScenario(config, false)) return 1;
+    if (config.slowMs > 0 && !RunFanoutScenario(config, true)) return 1;
+    return 0;
+#endif
+}
+
+#ifdef FANOUT_BENCH_MAIN
+int main(int argc, char** argv) {
+    return FanoutBenchMain(argc, argv);
+}
+#endif
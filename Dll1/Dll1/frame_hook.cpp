@@ -0,0 +1,72 @@
+﻿#include "pch.h"
+#include "frame_hook.h"
+#include <MinHook.h>
+#include <cstdio>
+
+SwapBuffersFrameSource::SwapBuffersFunc SwapBuffersFrameSource::s_originalSwapBuffers = nullptr;
+HANDLE SwapBuffersFrameSource::s_frameEvent = NULL;
+std::atomic<uint64_t> SwapBuffersFrameSource::s_frameCount{ 0 };
+
+SwapBuffersFrameSource::~SwapBuffersFrameSource() {
+    Uninstall();
+}
+
+BOOL WINAPI SwapBuffersFrameSource::HookedSwapBuffers(HDC hdc) {
+    // エミュスレッド上で呼ばれるため、通知だけ行い即座に元の処理へ戻す
+    s_frameCount.fetch_add(1, std::memory_order_relaxed);
+    SetEvent(s_frameEvent);
+    return s_originalSwapBuffers(hdc);
+}
+
+bool SwapBuffersFrameSource::Install() {
+    if (m_installed) return true;
+
+    // 自動リセットイベント: 複数フレーム分の通知は1回の起床にまとまる
+    s_frameEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    if (!s_frameEvent) return false;
+
+    MH_STATUS status = MH_Initialize();
+    if (status != MH_OK && status != MH_ERROR_ALREADY_INITIALIZED) {
+        printf("[FrameHook] MH_Initialize失敗: %s\n", MH_StatusToString(status));
+        CloseHandle(s_frameEvent);
+        s_frameEvent = NULL;
+        return false;
+    }
+
+    status = MH_CreateHookApiEx(L"gdi32", "SwapBuffers", reinterpret_cast<LPVOID>(&HookedSwapBuffers),
+                                reinterpret_cast<LPVOID*>(&s_originalSwapBuffers), &m_target);
+    if (status == MH_OK) {
+        status = MH_EnableHook(m_target);
+    }
+    if (status != MH_OK) {
+        printf("[FrameHook] SwapBuffersフック失敗: %s\n", MH_StatusToString(status));
+        if (m_target) {
+            MH_RemoveHook(m_target);
+            m_target = nullptr;
+        }
+        CloseHandle(s_frameEvent);
+        s_frameEvent = NULL;
+        return false;
+    }
+
+    m_installed = true;
+    printf("[FrameHook] SwapBuffersフック設置完了\n");
+    return true;
+}
+
+void SwapBuffersFrameSource::Uninstall() {
+    if (!m_installed) return;
+
+    MH_DisableHook(m_target);
+    MH_RemoveHook(m_target);
+    m_target = nullptr;
+    m_installed = false;
+
+    // フック解除後もイベントは閉じない（実行中のフック呼び出しが参照し得るため）
+    printf("[FrameHook] SwapBuffersフック解除\n");
+}
+
+bool SwapBuffersFrameSource::WaitForFrame(uint32_t timeoutMs) {
+    if (!m_installed) return false;
+    return WaitForSingleObject(s_frameEvent, timeoutMs) == WAIT_OBJECT_0;
+}
@@ -0,0 +1,34 @@
+﻿#pragma once
+// frame_hook.h : melonDSの画面更新（gdi32!SwapBuffers）をフックしてフレーム通知を得る
+// OpenGL表示時のみ有効。フックできない場合は Install() が false を返す
+
+#include <windows.h>
+#include <atomic>
+#include "frame_source.h"
+
+class SwapBuffersFrameSource : public FrameSource {
+public:
+    SwapBuffersFrameSource() = default;
+    ~SwapBuffersFrameSource();
+
+    // フック設置（MinHook）。成功時 true
+    bool Install();
+
+    // フック解除
+    void Uninstall();
+
+    bool WaitForFrame(uint32_t timeoutMs) override;
+    uint64_t GetFrameCount() const override { return s_frameCount.load(); }
+    const char* GetName() const override { return "SwapBuffers"; }
+
+private:
+    using SwapBuffersFunc = BOOL(WINAPI*)(HDC);
+    static BOOL WINAPI HookedSwapBuffers(HDC hdc);
+
+    static SwapBuffersFunc s_originalSwapBuffers;
+    static HANDLE s_frameEvent;
+    static std::atomic<uint64_t> s_frameCount;
+
+    LPVOID m_target = nullptr;
+    bool m_installed = false;
+};
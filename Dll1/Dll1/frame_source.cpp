@@ -0,0 +1,27 @@
+﻿#include "pch.h"
+#include "frame_source.h"
+#include <thread>
+
+IntervalFrameSource::IntervalFrameSource(std::chrono::microseconds period)
+    : m_period(period), m_nextFrame(std::chrono::steady_clock::now() + period) {
+}
+
+bool IntervalFrameSource::WaitForFrame(uint32_t timeoutMs) {
+    auto now = std::chrono::steady_clock::now();
+    auto deadline = now + std::chrono::milliseconds(timeoutMs);
+    if (m_nextFrame > deadline) {
+        std::this_thread::sleep_until(deadline);
+        return false;
+    }
+
+    std::this_thread::sleep_until(m_nextFrame);
+    m_frameCount++;
+
+    // 処理が周期を超えて遅れた場合は取りこぼした分を詰めずに次の周期から再開
+    m_nextFrame += m_period;
+    now = std::chrono::steady_clock::now();
+    if (m_nextFrame < now) {
+        m_nextFrame = now + m_period;
+    }
+    return true;
+}
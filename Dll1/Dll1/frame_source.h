@@ -0,0 +1,36 @@
+﻿#pragma once
+// frame_source.h : サンプリングのトリガー（フレーム通知の抽象化）
+// ポーリングループはこのインターフェース経由で「次のフレーム」を待つ
+
+#include <cstdint>
+#include <chrono>
+
+class FrameSource {
+public:
+    virtual ~FrameSource() = default;
+
+    // 次のフレーム通知を待つ。timeoutMs 以内に通知があれば true、タイムアウトで false
+    virtual bool WaitForFrame(uint32_t timeoutMs) = 0;
+
+    // これまでに通知されたフレーム数
+    virtual uint64_t GetFrameCount() const = 0;
+
+    // ログ表示用の名前
+    virtual const char* GetName() const = 0;
+};
+
+// 一定周期でフレームを発生させるソース
+// 50ms でSleepポーリング相当のフォールバック、16667us で60Hzの疑似フレーム源になる
+class IntervalFrameSource : public FrameSource {
+public:
+    explicit IntervalFrameSource(std::chrono::microseconds period);
+
+    bool WaitForFrame(uint32_t timeoutMs) override;
+    uint64_t GetFrameCount() const override { return m_frameCount; }
+    const char* GetName() const override { return "interval"; }
+
+private:
+    std::chrono::microseconds m_period;
+    std::chrono::steady_clock::time_point m_nextFrame;
+    uint64_t m_frameCount = 0;
+};
@@ -1,7 +1,9 @@
 #pragma once
 
+#ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
+#endif
 #include <cstdint>
 #include <thread>
 #include <atomic>
@@ -0,0 +1,296 @@
+﻿#include "pch.h"
+#include "game_addresses.h"
+
+// RJ版 (Red Joker / レッドジョーカー) アドレスリスト
+const GameAddress RJ_ADDRESSES[] = {
+    { "NOISE_RATE_1",       0x02193BA0, 2, PollTier::Hot }, // 表示上のノイズ率1
+    { "NOISE_RATE_2",       0x02193BA4, 2, PollTier::Hot }, // 表示上のノイズ率2
+    
+    { "COMFIRM_LV_1",       0x021862A0, 2, PollTier::Hot }, // ファイナライズアクセスLv
+    { "COMFIRM_LV_2",       0x021862B0, 2, PollTier::Hot }, // ファイナライズアクセス確認画面に表示されるLv
+    
+    { "SELECTED_SSS_VAL_1", 0x020F1E4C, 2, PollTier::Hot }, // SSS選択時サーバーアドレスの値: 1-56 (サテライトLv 1-32, メテオLv 1-24)
+    { "SELECTED_SSS_VAL_2", 0x021862A0, 2, PollTier::Hot }, // SSS選択時サーバーアドレスの値: 1-56 (サテライトLv 1-32, メテオLv 1-24)
+    { "SSS_CURSOR",         0x0218741F, 1, PollTier::Hot }, // SSS選択 A/B/Cのカーソル位置: 0-2
+    { "CURRENT_CARD",       0x020F1E24, 1, PollTier::Hot }, // カーソル選択中のカード？
+    
+    { "F_Turn_Remaining",   0x021C1A14, 1, PollTier::Hot }, // 残りファイナライズターン(バトル中に0=非変身)
+
+    { "SSS_VAL1_L1",        0x220F6608, 1 },
+    { "SSS_SERVER_ID_L1",   0x220F393D, 1 },
+    { "SSS_VAL2_L1",        0x220F660E, 1 },
+    { "SSS_VAL1_L2",        0x220F6624, 1 },
+    { "SSS_SERVER_ID_L2",   0x220F3941, 1 },
+    { "SSS_VAL2_L2",        0x220F662A, 1 },
+    { "SSS_VAL1_L3",        0x220F6640, 1 },
+    { "SSS_SERVER_ID_L3",   0x220F3945, 1 },
+    { "SSS_VAL2_L3",        0x220F6646, 1 },
+    { "SSS_VAL1_R1",        0x220F665C, 1 },
+    { "SSS_SERVER_ID_R1",   0x220F3949, 1 },
+    { "SSS_VAL2_R1",        0x220F6662, 1 },
+    { "SSS_VAL1_R2",        0x220F6678, 1 },
+    { "SSS_SERVER_ID_R2",   0x220F394D, 1 },
+    { "SSS_VAL2_R2",        0x220F667E, 1 },
+    { "SSS_VAL1_R3",        0x220F6694, 1 },
+    { "SSS_SERVER_ID_R3",   0x220F3951, 1 },
+    { "SSS_VAL2_R3",        0x220F669A, 1 },
+
+    { "MY_REZON",       0x220F39BE, 1 },
+    { "REZON_L0",       0x220F3FFE, 1, PollTier::Cold },
+    { "REZON_L1",       0x220F463E, 1, PollTier::Cold },
+    { "REZON_L2",       0x220F4C7E, 1, PollTier::Cold },
+    { "REZON_R0",       0x220F52BE, 1, PollTier::Cold },
+    { "REZON_R1",       0x220F58FE, 1, PollTier::Cold },
+    { "REZON_R2",       0x220F5F3E, 1, PollTier::Cold },
+
+    // ブラザー1 (左上)
+    { "BRO1_NOISE", 0x220F4000, 1 },
+    { "BRO1_WC",    0x220F4001, 1 },
+    { "BRO1_MEGA",  0x120F459C, 2, PollTier::Cold },
+    { "BRO1_GIGA",  0x120F459E, 2, PollTier::Cold },
+    // ブラザー2 (左中)
+    { "BRO2_NOISE", 0x220F4640, 1 },
+    { "BRO2_WC",    0x220F4641, 1 },
+    { "BRO2_MEGA",  0x120F4BDC, 2, PollTier::Cold },
+    { "BRO2_GIGA",  0x120F4BDE, 2, PollTier::Cold },
+    // ブラザー3 (左下)
+    { "BRO3_NOISE", 0x220F4C80, 1 },
+    { "BRO3_WC",    0x220F4C81, 1 },
+    { "BRO3_MEGA",  0x120F521C, 2, PollTier::Cold },
+    { "BRO3_GIGA",  0x120F521E, 2, PollTier::Cold },
+    // ブラザー4 (右上)
+    { "BRO4_NOISE", 0x220F52C0, 1 },
+    { "BRO4_WC",    0x220F52C1, 1 },
+    { "BRO4_MEGA",  0x120F585C, 2, PollTier::Cold },
+    { "BRO4_GIGA",  0x120F585E, 2, PollTier::Cold },
+    // ブラザー5 (右中)
+    { "BRO5_NOISE", 0x220F5900, 1 },
+    { "BRO5_WC",    0x220F5901, 1 },
+    { "BRO5_MEGA",  0x120F5E9C, 2, PollTier::Cold },
+    { "BRO5_GIGA",  0x120F5E9E, 2, PollTier::Cold },
+    // ブラザー6 (右下)
+    { "BRO6_NOISE", 0x220F5F40, 1 },
+    { "BRO6_WC",    0x220F5F41, 1 },
+    { "BRO6_MEGA",  0x120F64DC, 2, PollTier::Cold },
+    { "BRO6_GIGA",  0x120F64DE, 2, PollTier::Cold },
+
+    // ノイズドカード
+    { "NOISED_CARD_1", 0x220FA114, 2, PollTier::Cold },
+    { "NOISED_CARD_2", 0x220FA116, 2, PollTier::Cold },
+    { "NOISED_CARD_3", 0x220FA118, 2, PollTier::Cold },
+    { "NOISED_CARD_4", 0x220FA11A, 2, PollTier::Cold },
+    { "NOISED_CARD_5", 0x220FA11C, 2, PollTier::Cold },
+
+    // アビリティ
+    { "ABILITY01",  0x020F2CEE, 2, PollTier::Cold },
+    { "ABILITY02",  0x020F2CF0, 2, PollTier::Cold },
+    { "ABILITY03",  0x020F2CF2, 2, PollTier::Cold },
+    { "ABILITY04",  0x020F2CF4, 2, PollTier::Cold },
+    { "ABILITY05",  0x020F2CF6, 2, PollTier::Cold },
+    { "ABILITY06",  0x020F2CF8, 2, PollTier::Cold },
+    { "ABILITY07",  0x020F2CFA, 2, PollTier::Cold },
+    { "ABILITY08",  0x020F2CFC, 2, PollTier::Cold },
+    { "ABILITY09",  0x020F2CFE, 2, PollTier::Cold },
+    { "ABILITY10",  0x020F2D00, 2, PollTier::Cold },
+    { "ABILITY11",  0x020F2D02, 2, PollTier::Cold },
+    { "ABILITY12",  0x020F2D04, 2, PollTier::Cold },
+    { "ABILITY13",  0x020F2D06, 2, PollTier::Cold },
+    { "ABILITY14",  0x020F2D08, 2, PollTier::Cold },
+    { "ABILITY15",  0x020F2D0A, 2, PollTier::Cold },
+    { "ABILITY16",  0x020F2D0C, 2, PollTier::Cold },
+    { "ABILITY17",  0x020F2D0E, 2, PollTier::Cold },
+    { "ABILITY18",  0x020F2D10, 2, PollTier::Cold },
+    { "ABILITY19",  0x020F2D12, 2, PollTier::Cold },
+    { "ABILITY20",  0x020F2D14, 2, PollTier::Cold },
+
+    { "ZENY",       0x020F3394, 4, PollTier::Cold },
+   
+    { "BASE_HP",    0x0210C378, 2, PollTier::Cold },
+    // 自ノイズ
+    { "NOISE",      0x020F39C0, 1 },
+    // ホワイトカードコード
+    { "WHITE_CARDS",0x220F39C1, 1 },
+    // ウォーロック装備
+    { "WARLOCK",    0x020F2CD0, 4, PollTier::Cold },
+    
+    { "CARD01",     0x120F3806, 2, PollTier::Cold },
+    { "CARD02",     0x120F3808, 2, PollTier::Cold },
+    { "CARD03",     0x120F380A, 2, PollTier::Cold },
+    { "CARD04",     0x120F380C, 2, PollTier::Cold },
+    { "CARD05",     0x120F380E, 2, PollTier::Cold },
+    { "CARD06",     0x120F3810, 2, PollTier::Cold },
+    { "CARD07",     0x120F3812, 2, PollTier::Cold },
+    { "CARD08",     0x120F3814, 2, PollTier::Cold },
+    { "CARD09",     0x120F3816, 2, PollTier::Cold },
+    { "CARD10",     0x120F3818, 2, PollTier::Cold },
+    { "CARD11",     0x120F381A, 2, PollTier::Cold },
+    { "CARD12",     0x120F381C, 2, PollTier::Cold },
+    { "CARD13",     0x120F381E, 2, PollTier::Cold },
+    { "CARD14",     0x120F3820, 2, PollTier::Cold },
+    { "CARD15",     0x120F3822, 2, PollTier::Cold },
+    { "CARD16",     0x120F3824, 2, PollTier::Cold },
+    { "CARD17",     0x120F3826, 2, PollTier::Cold },
+    { "CARD18",     0x120F3828, 2, PollTier::Cold },
+    { "CARD19",     0x120F382A, 2, PollTier::Cold },
+    { "CARD20",     0x120F382C, 2, PollTier::Cold },
+    { "CARD21",     0x120F382E, 2, PollTier::Cold },
+    { "CARD22",     0x120F3830, 2, PollTier::Cold },
+    { "CARD23",     0x120F3832, 2, PollTier::Cold },
+    { "CARD24",     0x120F3834, 2, PollTier::Cold },
+    { "CARD25",     0x120F3836, 2, PollTier::Cold },
+    { "CARD26",     0x120F3838, 2, PollTier::Cold },
+    { "CARD27",     0x120F383A, 2, PollTier::Cold },
+    { "CARD28",     0x120F383C, 2, PollTier::Cold },
+    { "CARD29",     0x120F383E, 2, PollTier::Cold },
+    { "CARD30",     0x120F3840, 2, PollTier::Cold },
+    
+    { "REG",        0x020F3844, 2, PollTier::Cold },
+    { "TAG1_2",     0x020F3842, 2, PollTier::Cold },
+};
+const size_t RJ_ADDRESS_COUNT = sizeof(RJ_ADDRESSES) / sizeof(RJ_ADDRESSES[0]);
+
+// BA版 (Black Ace / ブラックエース) アドレスリスト
+const GameAddress BA_ADDRESSES[] = {
+    { "NOISE_RATE_1",       0x02193B60, 2, PollTier::Hot }, // 表示上のノイズ率1
+    { "NOISE_RATE_2",       0x02193B64, 2, PollTier::Hot }, // 表示上のノイズ率2
+    { "COMFIRM_LV_1",       0x02186260, 2, PollTier::Hot }, // ファイナライズアクセスLv
+    { "COMFIRM_LV_2",       0x02186270, 2, PollTier::Hot }, // ファイナライズアクセス確認画面に表示されるLv
+    { "SELECTED_SSS_VAL_1", 0x02186264, 2, PollTier::Hot }, // SSS選択時サーバーアドレスの値: 1-56 (サテライトLv 1-32, メテオLv 1-24)
+    { "SELECTED_SSS_VAL_2", 0x02186260, 2, PollTier::Hot }, // SSS選択時サーバーアドレスの値: 1-56 (サテライトLv 1-32, メテオLv 1-24)
+    { "SSS_CURSOR",         0x021873DF, 1, PollTier::Hot }, // SSS選択 A/B/Cのカーソル位置: 0-2
+    { "CURRENT_CARD",       0x020F1E04, 1, PollTier::Hot }, // カーソル選択中のカード？
+
+    { "F_Turn_Remaining",   0x021C19D4, 1, PollTier::Hot }, // 残りファイナライズターン(バトル中に0=非変身)
+
+    { "SSS_VAL1_L1",        0x220F65E8, 1 },
+    { "SSS_SERVER_ID_L1",   0x220F391D, 1 },
+    { "SSS_VAL2_L1",        0x220F65EE, 1 },
+    { "SSS_VAL1_L2",        0x220F6604, 1 },
+    { "SSS_SERVER_ID_L2",   0x220F3921, 1 },
+    { "SSS_VAL2_L2",        0x220F660A, 1 },
+    { "SSS_VAL1_L3",        0x220F6620, 1 },
+    { "SSS_SERVER_ID_L3",   0x220F3925, 1 },
+    { "SSS_VAL2_L3",        0x220F6626, 1 },
+    { "SSS_VAL1_R1",        0x220F663C, 1 },
+    { "SSS_SERVER_ID_R1",   0x220F3929, 1 },
+    { "SSS_VAL2_R1",        0x220F6642, 1 },
+    { "SSS_VAL1_R2",        0x220F6658, 1 },
+    { "SSS_SERVER_ID_R2",   0x220F392D, 1 },
+    { "SSS_VAL2_R2",        0x220F665E, 1 },
+    { "SSS_VAL1_R3",        0x220F6674, 1 },
+    { "SSS_SERVER_ID_R3",   0x220F3931, 1 },
+    { "SSS_VAL2_R3",        0x220F667A, 1 },
+
+    { "MY_REZON",       0x220F399E, 1 },
+    
+    // ここから
+    { "REZON_L0",       0x220F3FDE, 1, PollTier::Cold },
+    { "REZON_L1",       0x220F461E, 1, PollTier::Cold },
+    { "REZON_L2",       0x220F4C5E, 1, PollTier::Cold },
+    { "REZON_R0",       0x220F529E, 1, PollTier::Cold },
+    { "REZON_R1",       0x220F58DE, 1, PollTier::Cold },
+    { "REZON_R2",       0x220F5F1E, 1, PollTier::Cold },
+    // ブラザー1 (左上)
+    { "BRO1_NOISE", 0x220F3FE0, 1 },
+    { "BRO1_WC",    0x220F3FE1, 1 },
+    { "BRO1_MEGA",  0x120F457C, 2, PollTier::Cold },
+    { "BRO1_GIGA",  0x120F457E, 2, PollTier::Cold },
+    // ブラザー2 (左中)
+    { "BRO2_NOISE", 0x220F4620, 1 },
+    { "BRO2_WC",    0x220F4621, 1 },
+    { "BRO2_MEGA",  0x120F4BBC, 2, PollTier::Cold },
+    { "BRO2_GIGA",  0x120F4BBE, 2, PollTier::Cold },
+    // ブラザー3 (左下)
+    { "BRO3_NOISE", 0x220F4C60, 1 },
+    { "BRO3_WC",    0x220F4C61, 1 },
+    { "BRO3_MEGA",  0x120F51FC, 2, PollTier::Cold },
+    { "BRO3_GIGA",  0x120F51FE, 2, PollTier::Cold },
+    // ブラザー4 (右上)
+    { "BRO4_NOISE", 0x220F52A0, 1 },
+    { "BRO4_WC",    0x220F52A1, 1 },
+    { "BRO4_MEGA",  0x120F583C, 2, PollTier::Cold },
+    { "BRO4_GIGA",  0x120F583E, 2, PollTier::Cold },
+    // ブラザー5 (右中)
+    { "BRO5_NOISE", 0x220F58E0, 1 },
+    { "BRO5_WC",    0x220F58E1, 1 },
+    { "BRO5_MEGA",  0x120F5E7C, 2, PollTier::Cold },
+    { "BRO5_GIGA",  0x120F5E7E, 2, PollTier::Cold },
+    // ブラザー6 (右下)
+    { "BRO6_NOISE", 0x220F5F20, 1 },
+    { "BRO6_WC",    0x220F5F21, 1 },
+    { "BRO6_MEGA",  0x120F64BC, 2, PollTier::Cold },
+    { "BRO6_GIGA",  0x120F64BE, 2, PollTier::Cold },
+    // ノイズドカード
+    { "NOISED_CARD_1", 0x220FA0F4, 2, PollTier::Cold },
+    { "NOISED_CARD_2", 0x220FA0F6, 2, PollTier::Cold },
+    { "NOISED_CARD_3", 0x220FA0F8, 2, PollTier::Cold },
+    { "NOISED_CARD_4", 0x220FA0FA, 2, PollTier::Cold },
+    { "NOISED_CARD_5", 0x220FA0FC, 2, PollTier::Cold },
+    // アビリティ
+    { "ABILITY01",  0x020F2CCE, 2, PollTier::Cold },
+    { "ABILITY02",  0x020F2CD0, 2, PollTier::Cold },
+    { "ABILITY03",  0x020F2CD2, 2, PollTier::Cold },
+    { "ABILITY04",  0x020F2CD4, 2, PollTier::Cold },
+    { "ABILITY05",  0x020F2CD6, 2, PollTier::Cold },
+    { "ABILITY06",  0x020F2CD8, 2, PollTier::Cold },
+    { "ABILITY07",  0x020F2CDA, 2, PollTier::Cold },
+    { "ABILITY08",  0x020F2CDC, 2, PollTier::Cold },
+    { "ABILITY09",  0x020F2CDE, 2, PollTier::Cold },
+    { "ABILITY10",  0x020F2CE0, 2, PollTier::Cold },
+    { "ABILITY11",  0x020F2CE2, 2, PollTier::Cold },
+    { "ABILITY12",  0x020F2CE4, 2, PollTier::Cold },
+    { "ABILITY13",  0x020F2CE6, 2, PollTier::Cold },
+    { "ABILITY14",  0x020F2CE8, 2, PollTier::Cold },
+    { "ABILITY15",  0x020F2CEA, 2, PollTier::Cold },
+    { "ABILITY16",  0x020F2CEC, 2, PollTier::Cold },
+    { "ABILITY17",  0x020F2CEE, 2, PollTier::Cold },
+    { "ABILITY18",  0x020F2CF0, 2, PollTier::Cold },
+    { "ABILITY19",  0x020F2CF2, 2, PollTier::Cold },
+    { "ABILITY20",  0x020F2CF4, 2, PollTier::Cold },
+
+    { "ZENY",       0x020F3374, 4, PollTier::Cold },
+
+    { "BASE_HP",    0x0210C358, 2, PollTier::Cold },
+    // 自ノイズ
+    { "NOISE",      0x220F39A0, 1 },
+    // ホワイトカードコード
+    { "WHITE_CARDS",0x220F39A1, 1 },
+    // ウォーロック装備
+    { "WARLOCK",    0x020F2CB0, 4, PollTier::Cold },
+
+    { "CARD01",     0x120F37E6, 2, PollTier::Cold },
+    { "CARD02",     0x120F37E8, 2, PollTier::Cold },
+    { "CARD03",     0x120F37EA, 2, PollTier::Cold },
+    { "CARD04",     0x120F37EC, 2, PollTier::Cold },
+    { "CARD05",     0x120F37EE, 2, PollTier::Cold },
+    { "CARD06",     0x120F37F0, 2, PollTier::Cold },
+    { "CARD07",     0x120F37F2, 2, PollTier::Cold },
+    { "CARD08",     0x120F37F4, 2, PollTier::Cold },
+    { "CARD09",     0x120F37F6, 2, PollTier::Cold },
+    { "CARD10",     0x120F37F8, 2, PollTier::Cold },
+    { "CARD11",     0x120F37FA, 2, PollTier::Cold },
+    { "CARD12",     0x120F37FC, 2, PollTier::Cold },
+    { "CARD13",     0x120F37FE, 2, PollTier::Cold },
+    { "CARD14",     0x120F3800, 2, PollTier::Cold },
+    { "CARD15",     0x120F3802, 2, PollTier::Cold },
+    { "CARD16",     0x120F3804, 2, PollTier::Cold },
+    { "CARD17",     0x120F3806, 2, PollTier::Cold },
+    { "CARD18",     0x120F3808, 2, PollTier::Cold },
+    { "CARD19",     0x120F380A, 2, PollTier::Cold },
+    { "CARD20",     0x120F380C, 2, PollTier::Cold },
+    { "CARD21",     0x120F380E, 2, PollTier::Cold },
+    { "CARD22",     0x120F3810, 2, PollTier::Cold },
+    { "CARD23",     0x120F3812, 2, PollTier::Cold },
+    { "CARD24",     0x120F3814, 2, PollTier::Cold },
+    { "CARD25",     0x120F3816, 2, PollTier::Cold },
+    { "CARD26",     0x120F3818, 2, PollTier::Cold },
+    { "CARD27",     0x120F381A, 2, PollTier::Cold },
+    { "CARD28",     0x120F381C, 2, PollTier::Cold },
+    { "CARD29",     0x120F381E, 2, PollTier::Cold },
+    { "CARD30",     0x120F3820, 2, PollTier::Cold },
+
+    { "REG",        0x020F3824, 2, PollTier::Cold },
+    { "TAG1_2",     0x020F3822, 2, PollTier::Cold },
+
+};
+const size_t BA_ADDRESS_COUNT = sizeof(BA_ADDRESSES) / sizeof(BA_ADDRESSES[0]);
@@ -0,0 +1,22 @@
+﻿#pragma once
+// game_addresses.h : バージョン別ゲームアドレス定義（RJ / BA）
+// モニター本体と計測プログラムの両方から使う
+
+#include <cstdint>
+#include <cstddef>
+#include "delta_tracker.h"
+
+struct GameAddress {
+    const char* name;           // 識別名
+    uint32_t dsAddress;         // DSメモリ上のアドレス
+    uint8_t size;               // バイトサイズ (1, 2, or 4)
+    PollTier tier = PollTier::Warm; // ポーリング階層の初期値（実行中に自動で昇格・降格）
+};
+
+// RJ版 (Red Joker / レッドジョーカー)
+extern const GameAddress RJ_ADDRESSES[];
+extern const size_t RJ_ADDRESS_COUNT;
+
+// BA版 (Black Ace / ブラックエース)
+extern const GameAddress BA_ADDRESSES[];
+extern const size_t BA_ADDRESS_COUNT;
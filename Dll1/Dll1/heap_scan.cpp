@@ -0,0 +1,397 @@
+﻿#include "pch.h"
+#include "heap_scan.h"
+#include "monitor.h"
+#include "block_diff.h"
+#include "bit_util.h"
+#include <cstring>
+#include <atomic>
+#include <mutex>
+#include <deque>
+#include <thread>
+#include <chrono>
+#include <memory>
+#include <algorithm>
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__)
+#define HEAP_SCAN_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#define HEAP_SCAN_AVX2_TARGET
+#else
+#define HEAP_SCAN_AVX2_TARGET __attribute__((target("avx2")))
+#endif
+#endif
+
+// 1タスクの大きさ（パターンの開始位置の範囲）と、打ち切りを確認する間隔
+static constexpr size_t SCAN_CHUNK_SIZE = 0x100000;   // 1MB
+static constexpr size_t SCAN_BLOCK_SIZE = 0x10000;    // 64KB
+static constexpr unsigned MAX_SCAN_THREADS = 16;
+
+// パターン: 開始位置 i（8バイト境界）にポインタ、i + 8 に u32 のマスク
+static constexpr size_t PATTERN_MASK_OFFSET = 8;
+static constexpr size_t PATTERN_STEP = 8;
+// 領域末尾の16バイトは開始位置にしない（従来の逐次スキャンと同じ範囲）
+static constexpr size_t PATTERN_TAIL = 16;
+
+// ========================================
+// マスク定数の検索（マスク側から探し、見つかった位置だけ前のポインタを調べる）
+// ========================================
+
+// [begin, end) の8バイト毎の開始位置 i のうち、i + 8 の u32 が NDS / DSi のマスクに一致する最初の i
+// なければ end。base + end + 8 までを読む
+using FindMaskFunc = size_t(*)(const uint8_t*, size_t, size_t);
+
+static bool IsMainRAMMask(const uint8_t* p) {
+    uint32_t mask;
+    memcpy(&mask, p, sizeof(mask));
+    return mask == NDS_MAIN_RAM_MASK || mask == DSI_MAIN_RAM_MASK;
+}
+
+static size_t FindMaskScalar(const uint8_t* base, size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i += PATTERN_STEP) {
+        if (IsMainRAMMask(base + i + PATTERN_MASK_OFFSET)) return i;
+    }
+    return end;
+}
+
+#ifdef HEAP_SCAN_X86
+// 32バイト（開始位置4つ分）を1回で比べる。u32 のレーン 0,2,4,6 が各開始位置のマスク
+static constexpr uint32_t MASK_LANES = 0x55;
+
+static size_t FindMaskSSE2(const uint8_t* base, size_t begin, size_t end) {
+    const __m128i nds = _mm_set1_epi32((int)NDS_MAIN_RAM_MASK);
+    const __m128i dsi = _mm_set1_epi32((int)DSI_MAIN_RAM_MASK);
+    size_t i = begin;
+    for (; i + 3 * PATTERN_STEP < end; i += 4 * PATTERN_STEP) {
+        const uint8_t* p = base + i + PATTERN_MASK_OFFSET;
+        __m128i lo = _mm_loadu_si128((const __m128i*)p);
+        __m128i hi = _mm_loadu_si128((const __m128i*)(p + 16));
+        __m128i eqLo = _mm_or_si128(_mm_cmpeq_epi32(lo, nds), _mm_cmpeq_epi32(lo, dsi));
+        __m128i eqHi = _mm_or_si128(_mm_cmpeq_epi32(hi, nds), _mm_cmpeq_epi32(hi, dsi));
+        uint32_t bits = (uint32_t)_mm_movemask_ps(_mm_castsi128_ps(eqLo)) |
+                        ((uint32_t)_mm_movemask_ps(_mm_castsi128_ps(eqHi)) << 4);
+        bits &= MASK_LANES;
+        if (bits) return i + CountTrailingZeros64(bits) * 4;
+    }
+    return FindMaskScalar(base, i, end);
+}
+
+HEAP_SCAN_AVX2_TARGET
+static size_t FindMaskAVX2(const uint8_t* base, size_t begin, size_t end) {
+    const __m256i nds = _mm256_set1_epi32((int)NDS_MAIN_RAM_MASK);
+    const __m256i dsi = _mm256_set1_epi32((int)DSI_MAIN_RAM_MASK);
+    size_t i = begin;
+    for (; i + 3 * PATTERN_STEP < end; i += 4 * PATTERN_STEP) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(base + i + PATTERN_MASK_OFFSET));
+        __m256i eq = _mm256_or_si256(_mm256_cmpeq_epi32(v, nds), _mm256_cmpeq_epi32(v, dsi));
+        uint32_t bits = (uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(eq)) & MASK_LANES;
+        if (bits) return i + CountTrailingZeros64(bits) * 4;
+    }
+    return FindMaskScalar(base, i, end);
+}
+#endif
+
+struct FindMaskImpl {
+    FindMaskFunc func;
+    const char* name;
+};
+
+static FindMaskImpl SelectFindMaskImpl() {
+#ifdef HEAP_SCAN_X86
+    if (CpuSupportsAVX2()) return { FindMaskAVX2, "avx2" };
+    return { FindMaskSSE2, "sse2" };
+#else
+    return { FindMaskScalar, "scalar" };
+#endif
+}
+
+static const FindMaskImpl& GetFindMaskImpl() {
+    static const FindMaskImpl impl = SelectFindMaskImpl();
+    return impl;
+}
+
+// 名前で実装を選ぶ（nullptr なら CPU に合わせたもの）。この CPU で使えなければ false
+static bool FindFindMaskImpl(const char* name, FindMaskImpl& out) {
+    if (!name) {
+        out = GetFindMaskImpl();
+        return true;
+    }
+    if (strcmp(name, "scalar") == 0) {
+        out = { FindMaskScalar, "scalar" };
+        return true;
+    }
+#ifdef HEAP_SCAN_X86
+    if (strcmp(name, "sse2") == 0) {
+        out = { FindMaskSSE2, "sse2" };
+        return true;
+    }
+    if (strcmp(name, "avx2") == 0 && CpuSupportsAVX2()) {
+        out = { FindMaskAVX2, "avx2" };
+        return true;
+    }
+#endif
+    return false;
+}
+
+const char* GetHeapScanImplName() {
+    return GetFindMaskImpl().name;
+}
+
+bool IsHeapScanImplSupported(const char* name) {
+    FindMaskImpl impl;
+    return name && FindFindMaskImpl(name, impl);
+}
+
+// 領域内を直接読んで、マスクが一致しポインタが非 null の最初の開始位置を探す
+// （guardedCall から呼ばれる。例外で抜けても後始末が要らないよう、ここではオブジェクトを持たない）
+struct PatternSearch {
+    const uint8_t* base;
+    size_t begin;
+    size_t end;
+    FindMaskFunc findMask;
+    size_t found;       // 見つかった開始位置（なければ end）
+    void* pointer;
+    uint32_t mask;
+};
+
+static void SearchPatternInPlace(void* context) {
+    PatternSearch& search = *static_cast<PatternSearch*>(context);
+    for (size_t i = search.begin; i < search.end; i += PATTERN_STEP) {
+        i = search.findMask(search.base, i, search.end);
+        if (i >= search.end) break;
+        void* pointer;
+        memcpy(&pointer, search.base + i, sizeof(pointer));
+        if (!pointer) continue;
+        search.found = i;
+        search.pointer = pointer;
+        memcpy(&search.mask, search.base + i + PATTERN_MASK_OFFSET, sizeof(search.mask));
+        return;
+    }
+    search.found = search.end;
+}
+
+namespace {
+
+struct ScanChunk {
+    uint8_t* regionBase;
+    size_t begin;   // 開始位置の範囲（領域先頭からのオフセット）
+    size_t end;
+};
+
+struct WorkQueue {
+    std::mutex mutex;
+    std::deque<uint32_t> chunks;  // チャンク番号（小さいほど低アドレス）
+};
+
+class ParallelHeapScan {
+public:
+    ParallelHeapScan(const std::vector<ScanChunk>& chunks, const HeapScanConfig& config, FindMaskFunc findMask, unsigned threads)
+        : m_chunks(chunks), m_config(config), m_findMask(findMask), m_queues(threads) {
+        m_bestChunk = (uint32_t)chunks.size();
+        // 低アドレスのチャンクから全ワーカーが同時に進むよう、順番に配る
+        for (uint32_t i = 0; i < (uint32_t)chunks.size(); i++) {
+            m_queues[i % threads].chunks.push_back(i);
+        }
+    }
+
+    void Run() {
+        size_t threads = m_queues.size();
+        std::vector<std::thread> workers;
+        for (size_t w = 1; w < threads; w++) {
+            workers.emplace_back(&ParallelHeapScan::Worker, this, w);
+        }
+        Worker(0);
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    bool Found() const { return m_bestChunk.load() < m_chunks.size(); }
+    uint8_t* GetMainRAM() const { return m_mainRAM; }
+    uint32_t GetMask() const { return m_mask; }
+    const uint8_t* GetFoundAt() const { return m_foundAt; }
+    std::vector<HeapScanHit>& GetHits() { return m_hits; }
+    size_t GetChunksScanned() const { return m_chunksScanned.load(); }
+    uint64_t GetBytesScanned() const { return m_bytesScanned.load(); }
+    size_t GetCandidates() const { return m_candidates.load(); }
+    size_t GetCandidatesRejected() const { return m_candidatesRejected.load(); }
+
+private:
+    // 自分のキューの先頭、なければ他のキューの先頭（低アドレス）から取る
+    bool NextChunk(size_t self, uint32_t& out) {
+        size_t count = m_queues.size();
+        for (size_t k = 0; k < count; k++) {
+            WorkQueue& queue = m_queues[(self + k) % count];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (!queue.chunks.empty()) {
+                out = queue.chunks.front();
+                queue.chunks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void Worker(size_t self) {
+        uint32_t index;
+        while (NextChunk(self, index)) {
+            // 見つかったチャンクより高いアドレスは調べなくても結果は変わらない
+            if (index > m_bestChunk.load(std::memory_order_relaxed)) continue;
+            if (ScanChunkForPattern(index)) {
+                m_chunksScanned++;
+            }
+        }
+    }
+
+    // 候補を検証して記録（より低いチャンクで見つかっていれば記録しない）。有効な候補でチャンクを打ち切るなら true
+    bool CheckCandidate(uint32_t index, const uint8_t* at, void* candidate, uint32_t mask) {
+        size_t expectedSize = (mask == NDS_MAIN_RAM_MASK) ? DS_MAIN_RAM_SIZE : DSI_MAIN_RAM_SIZE;
+        m_candidates++;
+        if (!m_config.isCommitted(candidate, expectedSize)) {
+            m_candidatesRejected++;
+            return false;
+        }
+
+        std::lock_guard<std::mutex> lock(m_resultMutex);
+        if (m_config.findAll) {
+            // 全候補を集める時は打ち切らずにチャンクの続きを調べる
+            m_hits.push_back({ static_cast<uint8_t*>(candidate), mask, at });
+            return false;
+        }
+        if (index < m_bestChunk.load()) {
+            m_bestChunk = index;
+            m_mainRAM = static_cast<uint8_t*>(candidate);
+            m_mask = mask;
+            m_foundAt = at;
+        }
+        return true;
+    }
+
+    // 例外保護付きで search.begin から検索する。読めないページに当たったら false
+    bool SearchGuarded(PatternSearch& search) {
+        if (!m_config.guardedCall) {
+            SearchPatternInPlace(&search);
+            return true;
+        }
+        return m_config.guardedCall(SearchPatternInPlace, &search);
+    }
+
+    // チャンクを走査する。最後まで走査したら true（より低いチャンクで見つかって打ち切ったら false）
+    bool ScanChunkForPattern(uint32_t index) {
+        const ScanChunk& chunk = m_chunks[index];
+        PatternSearch search = {};
+        search.base = chunk.regionBase;
+        search.findMask = m_findMask;
+
+        for (size_t block = chunk.begin; block < chunk.end; block += SCAN_BLOCK_SIZE) {
+            if (index > m_bestChunk.load(std::memory_order_relaxed)) return false;
+
+            size_t blockEnd = (std::min)(block + SCAN_BLOCK_SIZE, chunk.end);
+            m_bytesScanned += blockEnd - block;
+
+            // 領域は列挙時にコミット済みと分かっているので、コピーせずに直接読む
+            search.begin = block;
+            search.end = blockEnd;
+            while (search.begin < blockEnd) {
+                if (!SearchGuarded(search)) {
+                    // 走査中に解放された等。残りは開始位置毎に読み直す
+                    if (ScanBlockCopied(index, search.begin, blockEnd, chunk.regionBase)) return true;
+                    break;
+                }
+                if (search.found >= blockEnd) break;
+                if (CheckCandidate(index, chunk.regionBase + search.found, search.pointer, search.mask)) return true;
+                search.begin = search.found + PATTERN_STEP;
+            }
+        }
+        return true;
+    }
+
+    // 保護付き読み取りで1位置ずつ調べる（直接読めなかったブロックの残り）
+    bool ScanBlockCopied(uint32_t index, size_t begin, size_t end, const uint8_t* regionBase) {
+        for (size_t i = begin; i < end; i += PATTERN_STEP) {
+            uint8_t bytes[PATTERN_MASK_OFFSET + sizeof(uint32_t)];
+            if (!m_config.safeRead(regionBase + i, bytes, sizeof(bytes))) continue;
+            if (!IsMainRAMMask(bytes + PATTERN_MASK_OFFSET)) continue;
+            void* candidate;
+            memcpy(&candidate, bytes, sizeof(candidate));
+            if (!candidate) continue;
+            uint32_t mask;
+            memcpy(&mask, bytes + PATTERN_MASK_OFFSET, sizeof(mask));
+            if (CheckCandidate(index, regionBase + i, candidate, mask)) return true;
+        }
+        return false;
+    }
+
+    const std::vector<ScanChunk>& m_chunks;
+    const HeapScanConfig& m_config;
+    FindMaskFunc m_findMask;
+    std::vector<WorkQueue> m_queues;
+
+    std::atomic<uint32_t> m_bestChunk;      // 見つかった最も低いチャンク（なければチャンク数）
+    std::mutex m_resultMutex;
+    uint8_t* m_mainRAM = nullptr;
+    uint32_t m_mask = 0;
+    const uint8_t* m_foundAt = nullptr;
+    std::vector<HeapScanHit> m_hits;    // findAll の時の全候補（見つかった順）
+
+    std::atomic<size_t> m_chunksScanned{ 0 };
+    std::atomic<uint64_t> m_bytesScanned{ 0 };
+    std::atomic<size_t> m_candidates{ 0 };
+    std::atomic<size_t> m_candidatesRejected{ 0 };
+};
+
+} // namespace
+
+HeapScanResult ScanHeapForMainRAM(const std::vector<HeapRegion>& regions, const HeapScanConfig& config) {
+    auto start = std::chrono::steady_clock::now();
+    HeapScanResult result;
+    result.regionCount = regions.size();
+
+    // 領域をチャンクに分ける（開始位置は領域先頭から8バイト毎、末尾16バイトを除く）
+    std::vector<ScanChunk> chunks;
+    for (const HeapRegion& region : regions) {
+        if (region.size <= PATTERN_TAIL) continue;
+        size_t limit = region.size - PATTERN_TAIL;
+        for (size_t begin = 0; begin < limit; begin += SCAN_CHUNK_SIZE) {
+            chunks.push_back({ region.base, begin, (std::min)(begin + SCAN_CHUNK_SIZE, limit) });
+        }
+    }
+    result.chunkCount = chunks.size();
+
+    unsigned threads = config.threadCount ? config.threadCount : std::thread::hardware_concurrency();
+    threads = (std::max)(1u, (std::min)(threads, MAX_SCAN_THREADS));
+    threads = (std::min)(threads, (unsigned)(std::max)(chunks.size(), (size_t)1));
+    result.threads = threads;
+    FindMaskImpl impl;
+    if (!FindFindMaskImpl(config.impl, impl)) impl = GetFindMaskImpl();
+    result.impl = impl.name;
+
+    auto scan = std::make_unique<ParallelHeapScan>(chunks, config, impl.func, threads);
+    scan->Run();
+    if (config.findAll) {
+        // パターンの位置の順に並べ、同じ MainRAM を指す候補は最初の1つだけ残す
+        std::vector<HeapScanHit>& hits = scan->GetHits();
+        std::sort(hits.begin(), hits.end(),
+            [](const HeapScanHit& a, const HeapScanHit& b) { return a.foundAt < b.foundAt; });
+        for (const HeapScanHit& hit : hits) {
+            bool known = std::any_of(result.hits.begin(), result.hits.end(),
+                [&](const HeapScanHit& other) { return other.mainRAM == hit.mainRAM; });
+            if (!known) result.hits.push_back(hit);
+        }
+        if (!result.hits.empty()) {
+            result.mainRAM = result.hits.front().mainRAM;
+            result.mask = result.hits.front().mask;
+            result.foundAt = result.hits.front().foundAt;
+        }
+    } else if (scan->Found()) {
+        result.mainRAM = scan->GetMainRAM();
+        result.mask = scan->GetMask();
+        result.foundAt = scan->GetFoundAt();
+    }
+    result.chunksScanned = scan->GetChunksScanned();
+    result.bytesScanned = scan->GetBytesScanned();
+    result.candidates = scan->GetCandidates();
+    result.candidatesRejected = scan->GetCandidatesRejected();
+    result.elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
@@ -0,0 +1,69 @@
+﻿#pragma once
+// heap_scan.h : MainRAM 検出のためのヒープスキャン（[MainRAM ポインタ][マスク] の並びを探す）
+// 領域の列挙と保護付き読み取りは呼び出し側（OS 依存）が渡し、ここでは並列に走査するだけ
+//
+// 領域を 1MB のチャンクに分け、ワーカー毎のキューに低アドレスから順に配る。
+// 自分のキューが空になったワーカーは他のキューから盗む（ワークスティーリング）。
+// 見つかった時点で、それより高いアドレスのチャンクは打ち切る。低いチャンクは最後まで走査するので、
+// 結果は先頭から1つずつ調べた場合（最も低いアドレスで最初に見つかるもの）と常に一致する
+//
+// 各位置でポインタを読むのではなく、マスク定数（0x003FFFFF / 0x00FFFFFF）を SIMD でまとめて探し、
+// 一致した位置だけ直前のポインタを調べる。領域は列挙時にコミット済みと分かっているので直接読み、
+// 例外保護は64KBブロック毎に1回だけ掛ける（読めなくなったブロックだけ1位置ずつの保護付き読み取りに落とす）
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+struct HeapRegion {
+    uint8_t* base;
+    size_t size;
+};
+
+struct HeapScanConfig {
+    // 保護付き読み取り（解放済み・保護されたページでも落ちない）
+    bool (*safeRead)(const void* src, void* dst, size_t length) = nullptr;
+    // fn(context) を例外保護付きで呼ぶ（アクセス違反なら false）。nullptr なら保護なしで直接呼ぶ
+    bool (*guardedCall)(void (*fn)(void*), void* context) = nullptr;
+    // 候補ポインタの先に expectedSize 以上のコミット済み領域があるか
+    bool (*isCommitted)(const void* address, size_t expectedSize) = nullptr;
+    // ワーカー数（0 なら論理コア数。1 なら呼び出し元のスレッドだけで走査する）
+    unsigned threadCount = 0;
+    // 最初の1つで打ち切らず、全域を走査してすべての候補を集める（エミュレータの複数インスタンス用）
+    bool findAll = false;
+    // マスク検索の実装（"avx2" / "sse2" / "scalar"。nullptr か使えない実装なら CPU に合わせて選ぶ）
+    const char* impl = nullptr;
+};
+
+struct HeapScanHit {
+    uint8_t* mainRAM;
+    uint32_t mask;
+    const uint8_t* foundAt;
+};
+
+struct HeapScanResult {
+    uint8_t* mainRAM = nullptr;     // 見つからなければ nullptr
+    uint32_t mask = 0;
+    const uint8_t* foundAt = nullptr;  // パターン（ポインタ）の位置
+    // findAll の時の全候補（パターンの位置の順。同じ MainRAM を指すものは最初の1つだけ）
+    std::vector<HeapScanHit> hits;
+
+    // 計測用
+    size_t regionCount = 0;
+    size_t chunkCount = 0;
+    size_t chunksScanned = 0;       // 打ち切らずに走査したチャンク数
+    uint64_t bytesScanned = 0;
+    size_t candidates = 0;          // マスクが一致しポインタが非 null だった位置（isCommitted で確かめた数）
+    size_t candidatesRejected = 0;  // そのうち isCommitted で外れたもの
+    unsigned threads = 0;
+    double elapsedMs = 0;
+    const char* impl = "";          // マスク検索の実装名
+};
+
+// regions は低アドレス順であること（VirtualQuery の列挙順）
+HeapScanResult ScanHeapForMainRAM(const std::vector<HeapRegion>& regions, const HeapScanConfig& config);
+
+// 使用中のマスク検索の実装名（"avx2" / "sse2" / "scalar"）
+const char* GetHeapScanImplName();
+// 実装名がこの CPU で使えるか（HeapScanConfig::impl で指定できるか）
+bool IsHeapScanImplSupported(const char* name);
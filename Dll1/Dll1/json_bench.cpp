@@ -0,0 +1,156 @@
+﻿#include "pch.h"
+// json_bench.cpp : full / delta JSON 生成の計測（RJ 版のアドレス表）
+// 旧方式（呼び出し毎に JsonWriter で全フィールドを snprintf し直す）と、
+// DeltaTracker の事前シリアライズ済み断片の連結を比べる。両者の出力が一致することも確かめる
+#include "bench_entry.h"
+#include "delta_tracker.h"
+#include "game_addresses.h"
+#include "json_util.h"
+#include "monitor.h"
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+static std::vector<uint8_t> s_jsonRam;
+
+static bool JsonBenchRead(uint32_t ramOffset, uint32_t length, uint8_t* outBuffer) {
+    memcpy(outBuffer, s_jsonRam.data() + ramOffset, length);
+    return true;
+}
+
+// 旧 BuildFullStateJson（JsonWriter で毎回組み立てる）
+static std::string BuildFullStateJsonWriter(const DeltaTracker& tracker, uint64_t seq) {
+    JsonWriter jw;
+    jw.BeginObject();
+    jw.StringField("type", "full");
+    jw.IntField("seq", (int64_t)seq);
+    jw.Key("data");
+    jw.BeginObject();
+    for (uint32_t id = 0; id < (uint32_t)tracker.GetAddressCount(); id++) {
+        jw.Key(tracker.GetName(id));
+        jw.BeginObject();
+        jw.HexValueField("v", tracker.GetValue(id), tracker.GetSize(id));
+        jw.HexField("a", tracker.GetAddress(id));
+        jw.UIntField("s", tracker.GetSize(id));
+        jw.EndObject();
+    }
+    jw.EndObject();
+    jw.EndObject();
+    return jw.GetString();
+}
+
+// 旧 BuildDeltaJson
+static std::string BuildDeltaJsonWriter(const DeltaTracker& tracker, uint64_t seq) {
+    if (!tracker.HasChanges()) return "";
+    JsonWriter jw;
+    jw.BeginObject();
+    jw.StringField("type", "delta");
+    jw.IntField("seq", (int64_t)seq);
+    jw.Key("data");
+    jw.BeginObject();
+    tracker.ForEachChanged([&](uint32_t id) {
+        jw.Key(tracker.GetName(id));
+        jw.BeginObject();
+        jw.HexValueField("v", tracker.GetValue(id), tracker.GetSize(id));
+        jw.EndObject();
+    });
+    jw.EndObject();
+    jw.EndObject();
+    return jw.GetString();
+}
+
+// ========================================
+// 計測プログラムの入口（Windows は Bench プロジェクトの "json"、Linux は JSON_BENCH_MAIN を定義して単体でビルド）
+//   g++ -std=c++17 -O2 -DJSON_BENCH_MAIN json_bench.cpp delta_tracker.cpp name_index.cpp block_diff.cpp game_addresses.cpp -o json_bench
+//   ./json_bench [--iterations N] [--changes N] [--seed N]
+// ========================================
+int JsonBenchMain(int argc, char** argv) {
+    uint32_t iterations = 20000;
+    uint32_t changesPerTick = 5;    // delta 1通に含める変化の数（目安）
+    uint64_t seed = 1;
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = (i + 1 < argc) ? argv[i + 1] : "0";
+        if (strcmp(arg, "--iterations") == 0) { iterations = (uint32_t)strtoul(value, nullptr, 10); i++; }
+        else if (strcmp(arg, "--changes") == 0) { changesPerTick = (uint32_t)strtoul(value, nullptr, 10); i++; }
+        else if (strcmp(arg, "--seed") == 0) { seed = strtoull(value, nullptr, 10); i++; }
+        else {
+            fprintf(stderr, "不明な引数: %s\n", arg);
+            return 2;
+        }
+    }
+    if (iterations == 0) return 2;
+
+    std::mt19937_64 rng(seed);
+    s_jsonRam.assign(DS_MAIN_RAM_SIZE, 0);
+    for (auto& b : s_jsonRam) b = (uint8_t)rng();
+
+    DeltaTracker tracker;
+    for (size_t i = 0; i < RJ_ADDRESS_COUNT; i++) {
+        tracker.RegisterAddress(RJ_ADDRESSES[i].name, RJ_ADDRESSES[i].dsAddress, RJ_ADDRESSES[i].size, RJ_ADDRESSES[i].tier);
+    }
+    tracker.UpdateAll(JsonBenchRead, NDS_MAIN_RAM_MASK);
+    auto ramOffsetOf = [&](uint32_t id) { return (tracker.GetAddress(id) - DS_MAIN_RAM_START) & NDS_MAIN_RAM_MASK; };
+    const uint32_t count = (uint32_t)tracker.GetAddressCount();
+
+    // full: 出力の一致を確かめてから計る
+    size_t mismatches = 0;
+    if (BuildFullStateJsonWriter(tracker, 1) != tracker.BuildFullStateJson(1)) mismatches++;
+    size_t fullBytes = tracker.BuildFullStateJson(1).size();
+
+    double fullNs[2];
+    size_t sink = 0;
+    for (int method = 0; method < 2; method++) {
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < iterations; i++) {
+            sink += (method == 0) ? BuildFullStateJsonWriter(tracker, i).size() : tracker.BuildFullStateJson(i).size();
+        }
+        fullNs[method] = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count() / iterations;
+    }
+
+    // delta: 毎回いくつかの値を書き換えてサンプリングし、同じ変化から両方式で組み立てる
+    double deltaNs[2] = { 0, 0 };
+    size_t deltaBytes = 0, deltas = 0;
+    uint32_t counter = 0;
+    for (uint32_t i = 0; i < iterations; i++) {
+        for (uint32_t c = 0; c < changesPerTick; c++) {
+            uint32_t id = (uint32_t)(rng() % count);
+            uint32_t v = ++counter;
+            memcpy(s_jsonRam.data() + ramOffsetOf(id), &v, tracker.GetSize(id));
+        }
+        tracker.UpdateAll(JsonBenchRead, NDS_MAIN_RAM_MASK);
+
+        auto start = std::chrono::steady_clock::now();
+        std::string oldJson = BuildDeltaJsonWriter(tracker, i);
+        auto middle = std::chrono::steady_clock::now();
+        const std::string& newJson = tracker.BuildDeltaJson(i);
+        auto end = std::chrono::steady_clock::now();
+        deltaNs[0] += (double)std::chrono::duration_cast<std::chrono::nanoseconds>(middle - start).count();
+        deltaNs[1] += (double)std::chrono::duration_cast<std::chrono::nanoseconds>(end - middle).count();
+
+        if (oldJson != newJson) mismatches++;
+        if (!newJson.empty()) {
+            deltaBytes += newJson.size();
+            deltas++;
+        }
+        tracker.ResetChangeFlags();
+    }
+
+    printf("RJ 表 %u 値, full %zu バイト, delta 平均 %.0f バイト, 回数 %u, 出力の不一致 %zu\n",
+        count, fullBytes, deltas ? (double)deltaBytes / deltas : 0.0, iterations, mismatches);
+    printf("%-12s %12s %12s\n", "方式", "full ns", "delta ns");
+    printf("%-12s %12.1f %12.1f\n", "JsonWriter", fullNs[0], deltaNs[0] / iterations);
+    printf("%-12s %12.1f %12.1f\n", "断片の連結", fullNs[1], deltaNs[1] / iterations);
+    (void)sink;
+    return mismatches == 0 ? 0 : 1;
+}
+
+#ifdef JSON_BENCH_MAIN
+int main(int argc, char** argv) {
+    return JsonBenchMain(argc, argv);
+}
+#endif
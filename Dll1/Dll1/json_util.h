@@ -6,6 +6,7 @@
 #include <cstdio>
 #include <cstdint>
 #include <cstring>
+#include <cstdlib>
 
 class JsonWriter {
 public:
@@ -16,6 +17,7 @@ public:
 
     void EndObject() {
         m_buf += '}';
+        m_first = false;
     }
 
     void BeginArray() {
@@ -25,6 +27,7 @@ public:
 
     void EndArray() {
         m_buf += ']';
+        m_first = false;
     }
 
     void Key(const char* key) {
@@ -56,6 +59,24 @@ public:
         m_buf += val ? "true" : "false";
     }
 
+    // 配列要素（文字列）
+    void ArrayString(const char* val) {
+        Comma();
+        ValueString(val);
+    }
+
+    // 配列要素（数値）
+    void ArrayUInt(uint32_t val) {
+        Comma();
+        ValueUInt(val);
+    }
+
+    // 配列要素（オブジェクト）。EndObject で閉じる
+    void BeginArrayObject() {
+        Comma();
+        BeginObject();
+    }
+
     // Key + 各種 Value ショートカット
     void StringField(const char* key, const char* val) {
         Key(key);
@@ -104,7 +125,8 @@ public:
     void PtrField(const char* key, const void* ptr) {
         Key(key);
         char tmp[32];
-        snprintf(tmp, sizeof(tmp), "0x%p", ptr);
+        // %p の書式は処理系で異なる（"0x" の有無・桁数）ため、16桁の16進数に揃える
+        snprintf(tmp, sizeof(tmp), "0x%016llX", (unsigned long long)(uintptr_t)ptr);
         m_buf += '"';
         m_buf += tmp;
         m_buf += '"';
@@ -149,10 +171,18 @@ private:
 // 簡易JSONパーサー（コマンド受信用）
 // ========================================
 
+// subscribe の groups に書けるパターン数の上限
+constexpr size_t JSON_COMMAND_MAX_GROUPS = 16;
+
 struct JsonCommand {
-    char cmd[32];       // "write", "refresh", "ping"
+    char cmd[32];       // "write", "refresh", "ping", "resume", "subscribe"
     char target[32];    // write時のターゲット名
     uint32_t value;     // write時の値
+    uint64_t seq;       // resume時の最終受信seq
+    uint32_t instance;  // 対象のエミュレータインスタンス（setVersion / resume / write。省略時 0）
+    char groups[JSON_COMMAND_MAX_GROUPS][32];  // subscribe時のグループ名・パターン
+    uint32_t groupCount;
+    bool hasGroups;     // "groups" 配列があったか（上限を超えた分・長すぎる要素は無視）
     bool valid;
 };
 
@@ -199,5 +229,45 @@ inline JsonCommand ParseCommand(const char* json) {
         }
     }
 
+    // "seq" フィールド (数値)
+    const char* seqPos = strstr(json, "\"seq\"");
+    if (seqPos) {
+        const char* colon = strchr(seqPos + 5, ':');
+        if (colon) {
+            result.seq = (uint64_t)strtoull(colon + 1, nullptr, 10);
+        }
+    }
+
+    // "instance" フィールド (数値)
+    const char* instancePos = strstr(json, "\"instance\"");
+    if (instancePos) {
+        const char* colon = strchr(instancePos + 10, ':');
+        if (colon) {
+            result.instance = (uint32_t)strtoul(colon + 1, nullptr, 10);
+        }
+    }
+
+    // "groups" フィールド (文字列の配列。エスケープには対応しない)
+    const char* groupsPos = strstr(json, "\"groups\"");
+    if (groupsPos) {
+        const char* p = strchr(groupsPos + 8, '[');
+        const char* arrayEnd = p ? strchr(p, ']') : nullptr;
+        if (p && arrayEnd) {
+            result.hasGroups = true;
+            while ((valStart = (const char*)memchr(p, '"', arrayEnd - p)) != nullptr) {
+                valStart++;
+                valEnd = (const char*)memchr(valStart, '"', arrayEnd - valStart);
+                if (!valEnd) break;
+                size_t length = (size_t)(valEnd - valStart);
+                if (result.groupCount < JSON_COMMAND_MAX_GROUPS && length > 0 && length < sizeof(result.groups[0])) {
+                    memcpy(result.groups[result.groupCount], valStart, length);
+                    result.groups[result.groupCount][length] = '\0';
+                    result.groupCount++;
+                }
+                p = valEnd + 1;
+            }
+        }
+    }
+
     return result;
 }
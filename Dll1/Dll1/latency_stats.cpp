@@ -0,0 +1,95 @@
+﻿#include "pch.h"
+#include "latency_stats.h"
+#include "bit_util.h"
+#include <algorithm>
+
+static const char* const LATENCY_STAGE_NAMES[] = {
+    "read", "diff", "serialize", "enqueue", "send", "command",
+};
+static_assert(sizeof(LATENCY_STAGE_NAMES) / sizeof(LATENCY_STAGE_NAMES[0]) == (size_t)LatencyStage::Count,
+              "LatencyStage と名前の数が合わない");
+
+const char* GetLatencyStageName(LatencyStage stage) {
+    return (stage < LatencyStage::Count) ? LATENCY_STAGE_NAMES[(size_t)stage] : "unknown";
+}
+
+uint32_t LatencyHistogram::BucketIndex(uint64_t ns) {
+    // 32未満はそのまま。以降は 2の累乗毎に上位5bitで32分割
+    if (ns < SUB_BUCKET_COUNT) return (uint32_t)ns;
+    uint32_t exponent = HighestSetBit64(ns);
+    if (exponent >= MAX_VALUE_BITS) return BUCKET_COUNT - 1;
+    uint32_t shift = exponent - SUB_BUCKET_BITS;
+    uint32_t sub = (uint32_t)(ns >> shift) & (SUB_BUCKET_COUNT - 1);
+    return (shift + 1) * SUB_BUCKET_COUNT + sub;
+}
+
+uint64_t LatencyHistogram::BucketUpperBound(uint32_t index) {
+    if (index < SUB_BUCKET_COUNT) return index;
+    uint32_t shift = index / SUB_BUCKET_COUNT - 1;
+    uint64_t sub = index % SUB_BUCKET_COUNT;
+    return ((SUB_BUCKET_COUNT + sub + 1) << shift) - 1;
+}
+
+void LatencyHistogram::Record(uint64_t ns) {
+    m_buckets[BucketIndex(ns)].fetch_add(1, std::memory_order_relaxed);
+    m_count.fetch_add(1, std::memory_order_relaxed);
+    m_totalNs.fetch_add(ns, std::memory_order_relaxed);
+
+    uint64_t current = m_minNs.load(std::memory_order_relaxed);
+    while (ns < current && !m_minNs.compare_exchange_weak(current, ns, std::memory_order_relaxed)) {}
+    current = m_maxNs.load(std::memory_order_relaxed);
+    while (ns > current && !m_maxNs.compare_exchange_weak(current, ns, std::memory_order_relaxed)) {}
+}
+
+void LatencyHistogram::Reset() {
+    for (auto& bucket : m_buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    m_count.store(0, std::memory_order_relaxed);
+    m_totalNs.store(0, std::memory_order_relaxed);
+    m_minNs.store(UINT64_MAX, std::memory_order_relaxed);
+    m_maxNs.store(0, std::memory_order_relaxed);
+}
+
+LatencySnapshot LatencyHistogram::GetSnapshot() const {
+    LatencySnapshot snapshot;
+
+    // バケットの合計を件数とする（m_count とは記録中のずれがあり得るため）
+    uint64_t counts[BUCKET_COUNT];
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < BUCKET_COUNT; i++) {
+        counts[i] = m_buckets[i].load(std::memory_order_relaxed);
+        total += counts[i];
+    }
+    if (total == 0) return snapshot;
+
+    snapshot.count = total;
+    snapshot.minNs = m_minNs.load(std::memory_order_relaxed);
+    snapshot.maxNs = m_maxNs.load(std::memory_order_relaxed);
+    snapshot.meanNs = m_totalNs.load(std::memory_order_relaxed) / (std::max)(m_count.load(std::memory_order_relaxed), (uint64_t)1);
+
+    // 各パーセンタイルはそのバケットの上限値（ただし最大値を超えない）
+    struct Target { uint64_t rank; uint64_t* out; };
+    Target targets[] = {
+        { (total * 500 + 999) / 1000, &snapshot.p50Ns },
+        { (total * 900 + 999) / 1000, &snapshot.p90Ns },
+        { (total * 990 + 999) / 1000, &snapshot.p99Ns },
+        { (total * 999 + 999) / 1000, &snapshot.p999Ns },
+    };
+    size_t next = 0;
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < BUCKET_COUNT && next < 4; i++) {
+        seen += counts[i];
+        while (next < 4 && seen >= targets[next].rank) {
+            *targets[next].out = (std::min)(BucketUpperBound(i), snapshot.maxNs);
+            next++;
+        }
+    }
+    return snapshot;
+}
+
+void LatencyStats::Reset() {
+    for (auto& histogram : m_histograms) {
+        histogram.Reset();
+    }
+}
@@ -0,0 +1,101 @@
+﻿#pragma once
+// latency_stats.h : 処理段階毎の所要時間ヒストグラム（stats コマンド・定期 stats メッセージ用）
+// 値（ナノ秒）を 2の累乗毎に32分割した対数線形のバケットに数える（HDR Histogram と同じ考え方。誤差は約3%）
+// 記録は atomic の加算だけで、ロックを取らずにどのスレッドからでも呼べる
+// 無効の間の計測コストは StageTimer での relaxed load 1回のみ
+
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <chrono>
+
+// 計測する処理段階
+enum class LatencyStage : uint8_t {
+    Read,       // MainRAM の一括読み取り（読み取りプランの区間の合計）
+    Diff,       // 差分検知・デコード（サンプリング全体から Read を除いたもの）
+    Serialize,  // delta の JSON / フレーム作成
+    Enqueue,    // 全クライアントの送信キューへの投入
+    Send,       // 送信キュー投入から書き込み完了まで（1メッセージ毎）
+    Command,    // コマンド1件の処理
+    Count,
+};
+
+const char* GetLatencyStageName(LatencyStage stage);
+
+struct LatencySnapshot {
+    uint64_t count = 0;
+    uint64_t minNs = 0;
+    uint64_t maxNs = 0;
+    uint64_t meanNs = 0;
+    uint64_t p50Ns = 0;
+    uint64_t p90Ns = 0;
+    uint64_t p99Ns = 0;
+    uint64_t p999Ns = 0;
+};
+
+class LatencyHistogram {
+public:
+    // 1バケットの分割数（2の累乗毎）
+    static constexpr uint32_t SUB_BUCKET_BITS = 5;
+    static constexpr uint32_t SUB_BUCKET_COUNT = 1u << SUB_BUCKET_BITS;
+    // 記録できる上限は 2^40 ns（約18分）。超えた値は最後のバケットに入る
+    static constexpr uint32_t MAX_VALUE_BITS = 40;
+    static constexpr uint32_t BUCKET_COUNT = (MAX_VALUE_BITS - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT;
+
+    LatencyHistogram() { Reset(); }
+
+    void Record(uint64_t ns);
+    void Reset();
+
+    // 記録中でも呼べる（各カウンタは個別に読むため、厳密に同時点の値ではない）
+    LatencySnapshot GetSnapshot() const;
+
+private:
+    static uint32_t BucketIndex(uint64_t ns);
+    static uint64_t BucketUpperBound(uint32_t index);
+
+    std::atomic<uint64_t> m_buckets[BUCKET_COUNT];
+    std::atomic<uint64_t> m_count;
+    std::atomic<uint64_t> m_totalNs;
+    std::atomic<uint64_t> m_minNs;
+    std::atomic<uint64_t> m_maxNs;
+};
+
+class LatencyStats {
+public:
+    bool IsEnabled() const { return m_enabled.load(std::memory_order_relaxed); }
+    void SetEnabled(bool enabled) { m_enabled.store(enabled, std::memory_order_relaxed); }
+
+    void Record(LatencyStage stage, uint64_t ns) { m_histograms[(size_t)stage].Record(ns); }
+    void Reset();
+
+    const LatencyHistogram& GetHistogram(LatencyStage stage) const { return m_histograms[(size_t)stage]; }
+
+    // 計測用の時刻（ナノ秒、単調増加）
+    static uint64_t NowNs() {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+private:
+    std::atomic<bool> m_enabled{ false };
+    LatencyHistogram m_histograms[(size_t)LatencyStage::Count];
+};
+
+// スコープの所要時間を記録する（無効なら時刻も取らない）
+class StageTimer {
+public:
+    StageTimer(LatencyStats& stats, LatencyStage stage)
+        : m_stats(stats), m_stage(stage), m_startNs(stats.IsEnabled() ? LatencyStats::NowNs() : 0) {}
+    ~StageTimer() {
+        if (m_startNs) m_stats.Record(m_stage, LatencyStats::NowNs() - m_startNs);
+    }
+
+    StageTimer(const StageTimer&) = delete;
+    StageTimer& operator=(const StageTimer&) = delete;
+
+private:
+    LatencyStats& m_stats;
+    LatencyStage m_stage;
+    uint64_t m_startNs;
+};
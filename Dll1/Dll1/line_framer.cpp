@@ -0,0 +1,36 @@
+﻿#include "pch.h"
+#include "line_framer.h"
+
+LineFramer::LineFramer(size_t maxMessageSize)
+    : m_buffer(maxMessageSize + 1) {
+}
+
+void LineFramer::Reset() {
+    m_start = 0;
+    m_scanned = 0;
+    m_end = 0;
+    m_discarding = false;
+    m_discarded = 0;
+}
+
+void LineFramer::Compact() {
+    // 行を1つ以上切り出した時だけ動かす。各バイトが動くのは高々1回
+    if (m_start > 0) {
+        size_t remaining = m_end - m_start;
+        if (remaining > 0) {
+            memmove(m_buffer.data(), m_buffer.data() + m_start, remaining);
+        }
+        m_scanned -= m_start;
+        m_end = remaining;
+        m_start = 0;
+    }
+
+    // 上限まで埋まっても改行がない: ここまでを捨て、次の改行まで読み捨てる
+    if (m_end == m_buffer.size()) {
+        m_discarding = true;
+        m_discarded += m_end;
+        m_start = 0;
+        m_scanned = 0;
+        m_end = 0;
+    }
+}
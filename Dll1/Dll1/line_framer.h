@@ -0,0 +1,65 @@
+﻿#pragma once
+// line_framer.h : LF区切りメッセージの切り出し
+// 固定サイズの受信バッファに直接読み込み、memchr で改行を探して、行をバッファ上のまま渡す
+// （行毎のコピー・確保なし）。走査済みの位置は覚えておくので、1回の受信に多数の行があっても
+// 分割された長い行が何回かに分けて届いても、受信量に対して線形時間で処理できる
+
+#include <cstddef>
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+class LineFramer {
+public:
+    // maxMessageSize: 1行の上限（改行を除くバイト数）。超えた行は捨てる
+    explicit LineFramer(size_t maxMessageSize);
+
+    // 次の受信先と、そこに書き込めるバイト数（常に1以上）
+    char* GetWritePtr() { return m_buffer.data() + m_end; }
+    size_t GetWritableSize() const { return m_buffer.size() - m_end; }
+
+    // GetWritePtr に受信した bytes バイトを取り込み、完成した行を順に onLine(std::string_view) で渡す
+    // 行は改行位置で NUL 終端してあり、コールバック中だけ有効。空行は渡さない
+    // 上限を超えた行は改行まで読み捨て、onOversize(捨てたバイト数) を呼ぶ
+    template <typename LineFunc, typename OversizeFunc>
+    void Commit(size_t bytes, LineFunc&& onLine, OversizeFunc&& onOversize) {
+        m_end += bytes;
+        char* base = m_buffer.data();
+
+        while (m_scanned < m_end) {
+            char* newline = static_cast<char*>(memchr(base + m_scanned, '\n', m_end - m_scanned));
+            if (!newline) {
+                m_scanned = m_end;
+                break;
+            }
+
+            size_t lineEnd = (size_t)(newline - base);
+            if (m_discarding) {
+                m_discarding = false;
+                onOversize(m_discarded + (lineEnd - m_start));
+                m_discarded = 0;
+            } else if (lineEnd > m_start) {
+                *newline = '\0';
+                onLine(std::string_view(base + m_start, lineEnd - m_start));
+            }
+            m_start = lineEnd + 1;
+            m_scanned = m_start;
+        }
+
+        Compact();
+    }
+
+    // 途中まで受信した行を破棄する（切断時など）
+    void Reset();
+
+private:
+    // 未完成の行をバッファ先頭に寄せる。バッファが埋まっても改行がなければ読み捨てモードに入る
+    void Compact();
+
+    std::vector<char> m_buffer;  // 上限 + 改行1バイト
+    size_t m_start = 0;          // 未完成の行の先頭
+    size_t m_scanned = 0;        // 改行を探し終えた位置
+    size_t m_end = 0;            // 受信データの末尾
+    bool m_discarding = false;   // 上限超えの行を改行まで読み捨て中
+    size_t m_discarded = 0;      // 読み捨て中の行のこれまでのバイト数
+};
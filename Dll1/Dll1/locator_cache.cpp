@@ -0,0 +1,206 @@
+﻿#include "pch.h"
+#include "locator_cache.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+// 静的領域はこの大きさずつ写して調べる
+static constexpr size_t STATIC_BLOCK_SIZE = 0x10000;
+
+bool ResolvePointerPath(const uint8_t* moduleBase, const PointerPath& path,
+                        bool (*safeRead)(const void*, void*, size_t), const uint8_t** outAddress) {
+    if (path.depth == 0 || path.depth > MAX_POINTER_PATH_DEPTH) return false;
+    uintptr_t address = (uintptr_t)moduleBase + (uintptr_t)path.moduleOffset;
+    for (uint32_t k = 0; k < path.depth; k++) {
+        uintptr_t pointer = 0;
+        if (!safeRead((const void*)address, &pointer, sizeof(pointer)) || !pointer) return false;
+        address = pointer + (uintptr_t)path.offsets[k];
+    }
+    *outAddress = (const uint8_t*)address;
+    return true;
+}
+
+// value から読める残りのバイト数（readableRegions に入らなければ 0）
+static size_t ReadableLength(const std::vector<HeapRegion>& regions, uintptr_t value) {
+    auto it = std::upper_bound(regions.begin(), regions.end(), value,
+        [](uintptr_t v, const HeapRegion& region) { return v < (uintptr_t)region.base; });
+    if (it == regions.begin()) return 0;
+    --it;
+    uintptr_t offset = value - (uintptr_t)it->base;
+    return (offset < it->size) ? it->size - offset : 0;
+}
+
+// 深さ2の候補はこの数まで集める（同じオブジェクトを指すメンバが多い時に探索が伸びすぎないよう）
+static constexpr size_t MAX_DEPTH2_CANDIDATES = 64;
+
+size_t FindStaticPointerPaths(const std::vector<HeapRegion>& staticRanges, const uint8_t* moduleBase,
+                              const uint8_t* target, const std::vector<HeapRegion>& readableRegions,
+                              const PointerPathLimits& limits, size_t maxPaths,
+                              bool (*safeRead)(const void*, void*, size_t), std::vector<PointerPath>& outPaths) {
+    const uintptr_t targetAddress = (uintptr_t)target;
+    // pointer + offset == target となる offset（limits.targetOffset 以下）があるか
+    auto reachesTarget = [&](uintptr_t pointer, uint64_t& offset) {
+        if (!pointer || pointer > targetAddress) return false;
+        offset = targetAddress - pointer;
+        return offset <= limits.targetOffset;
+    };
+
+    std::vector<uint8_t> block(STATIC_BLOCK_SIZE);
+    std::vector<uint8_t> object(limits.objectSize);
+    std::vector<PointerPath> depth1;
+    std::vector<PointerPath> depth2;
+    // 深さ2の途中のメンバポインタが指す位置（オブジェクトの先頭とみなせる位置）からのオフセット
+    std::vector<uint64_t> objectOffsets;
+    if (limits.patternOffset) objectOffsets.push_back(limits.patternOffset);
+
+    for (const HeapRegion& range : staticRanges) {
+        for (size_t b = 0; b < range.size; b += STATIC_BLOCK_SIZE) {
+            size_t length = (std::min)(STATIC_BLOCK_SIZE, range.size - b);
+            if (!safeRead(range.base + b, block.data(), length)) continue;
+
+            for (size_t i = 0; i + sizeof(uintptr_t) <= length; i += sizeof(uintptr_t)) {
+                uintptr_t pointer;
+                memcpy(&pointer, block.data() + i, sizeof(pointer));
+                uint64_t slotOffset = (uint64_t)(range.base + b + i - moduleBase);
+
+                // 深さ1（静的変数が直接オブジェクトを指している）。先頭かどうかは全部見てから確かめる
+                uint64_t offset;
+                if (reachesTarget(pointer, offset)) {
+                    PointerPath path;
+                    path.moduleOffset = slotOffset;
+                    path.depth = 1;
+                    path.offsets[0] = offset;
+                    depth1.push_back(path);
+                }
+
+                // 深さ2（静的変数 → オブジェクト内のポインタ → 目的のオブジェクト）
+                if (depth2.size() >= MAX_DEPTH2_CANDIDATES || (pointer % sizeof(uintptr_t)) != 0) continue;
+                size_t objectLength = (std::min)(limits.objectSize, ReadableLength(readableRegions, pointer));
+                if (objectLength < sizeof(uintptr_t)) continue;
+                if (!safeRead((const void*)pointer, object.data(), objectLength)) continue;
+
+                for (size_t o = 0; o + sizeof(uintptr_t) <= objectLength; o += sizeof(uintptr_t)) {
+                    uintptr_t inner;
+                    memcpy(&inner, object.data() + o, sizeof(inner));
+                    if (!reachesTarget(inner, offset)) continue;
+                    PointerPath path;
+                    path.moduleOffset = slotOffset;
+                    path.depth = 2;
+                    path.offsets[0] = o;
+                    path.offsets[1] = offset;
+                    depth2.push_back(path);
+                    objectOffsets.push_back(offset);
+                    break;
+                }
+            }
+        }
+    }
+
+    // 深さ1はオブジェクトの先頭を指しているものだけ、深さ2はパターンのオフセットが分かっていればそれに合うものを先に
+    auto isObjectStart = [&](uint64_t offset) {
+        return std::find(objectOffsets.begin(), objectOffsets.end(), offset) != objectOffsets.end();
+    };
+    std::stable_partition(depth2.begin(), depth2.end(), [&](const PointerPath& path) {
+        return limits.patternOffset && path.offsets[1] == limits.patternOffset;
+    });
+
+    outPaths.clear();
+    for (const PointerPath& path : depth1) {
+        if (outPaths.size() < maxPaths && isObjectStart(path.offsets[0])) outPaths.push_back(path);
+    }
+    for (const PointerPath& path : depth2) {
+        if (outPaths.size() < maxPaths) outPaths.push_back(path);
+    }
+    return outPaths.size();
+}
+
+std::string FormatPointerPath(const PointerPath& path) {
+    std::string text;
+    char hex[24];
+    snprintf(hex, sizeof(hex), "%llx", (unsigned long long)path.moduleOffset);
+    text += hex;
+    for (uint32_t k = 0; k < path.depth && k < MAX_POINTER_PATH_DEPTH; k++) {
+        snprintf(hex, sizeof(hex), " %llx", (unsigned long long)path.offsets[k]);
+        text += hex;
+    }
+    return text;
+}
+
+bool ParsePointerPath(const char* text, PointerPath& outPath) {
+    PointerPath path;
+    char* end = nullptr;
+    path.moduleOffset = strtoull(text, &end, 16);
+    if (end == text) return false;
+    text = end;
+    while (*text == ' ') {
+        unsigned long long value = strtoull(text, &end, 16);
+        if (end == text) break;
+        if (path.depth == MAX_POINTER_PATH_DEPTH) return false;
+        path.offsets[path.depth++] = value;
+        text = end;
+    }
+    if (path.depth == 0) return false;
+    outPath = path;
+    return true;
+}
+
+// 1行（LF なし）から key とパスを読む
+static bool ParseCacheLine(const std::string& line, uint64_t& key, PointerPath& path) {
+    char* end = nullptr;
+    key = strtoull(line.c_str(), &end, 16);
+    if (end == line.c_str() || *end != ' ') return false;
+    return ParsePointerPath(end + 1, path);
+}
+
+template <typename Func>
+static void ForEachLine(const std::string& contents, Func&& func) {
+    size_t start = 0;
+    while (start < contents.size()) {
+        size_t lf = contents.find('\n', start);
+        if (lf == std::string::npos) lf = contents.size();
+        std::string line = contents.substr(start, lf - start);
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (!line.empty()) func(line);
+        start = lf + 1;
+    }
+}
+
+bool FindLocatorCacheEntry(const std::string& contents, uint64_t key, PointerPath& outPath) {
+    bool found = false;
+    ForEachLine(contents, [&](const std::string& line) {
+        uint64_t lineKey;
+        PointerPath path;
+        if (!found && ParseCacheLine(line, lineKey, path) && lineKey == key) {
+            outPath = path;
+            found = true;
+        }
+    });
+    return found;
+}
+
+std::string UpdateLocatorCacheEntry(const std::string& contents, uint64_t key, const PointerPath& path) {
+    std::string updated;
+    ForEachLine(contents, [&](const std::string& line) {
+        uint64_t lineKey;
+        PointerPath linePath;
+        if (ParseCacheLine(line, lineKey, linePath) && lineKey == key) return;
+        updated += line;
+        updated += '\n';
+    });
+    char hex[24];
+    snprintf(hex, sizeof(hex), "%016llx ", (unsigned long long)key);
+    updated += hex;
+    updated += FormatPointerPath(path);
+    updated += '\n';
+    return updated;
+}
+
+uint64_t HashLocatorKey(const void* data, size_t size, uint64_t hash) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; i++) {
+        hash ^= p[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
@@ -0,0 +1,59 @@
+﻿#pragma once
+// locator_cache.h : MainRAM パターンの位置をモジュール基準のポインタパスとして覚えておくキャッシュ
+// 一度ヒープスキャンで見つけたら、エミュレータの静的領域（emuInstances[] 等）から
+// パターン（[MainRAM ポインタ][マスク]）までのポインタの辿り方を記録し、エミュレータ本体の PE ヘッダのハッシュをキーに保存する。
+// 次回の起動ではパスを辿って検証するだけで済み、合わなかった時だけ全体スキャンに戻る
+//
+// ファイル形式（1行1エントリ。他のビルドの行はそのまま残す）
+//   <ハッシュ16桁> <モジュール先頭からのオフセット> [<オフセット> ...]
+//   例: 0123456789abcdef 1a2b30 48 5d10
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "heap_scan.h"
+
+constexpr size_t MAX_POINTER_PATH_DEPTH = 4;
+
+// moduleBase + moduleOffset から始めて、offsets の数だけ「ポインタを読んでオフセットを足す」を繰り返した先が目的の位置
+struct PointerPath {
+    uint64_t moduleOffset = 0;
+    uint32_t depth = 0;
+    uint64_t offsets[MAX_POINTER_PATH_DEPTH] = {};
+};
+
+// 静的領域からの探索範囲
+struct PointerPathLimits {
+    size_t objectSize = 0x1000;     // 途中のオブジェクト内でポインタを探す範囲（emuInstances[i] → EmuInstance::nds 等）
+    size_t targetOffset = 0x100000; // 最後のポインタから目的の位置までの最大オフセット（NDS 先頭 → MainRAM メンバ）
+    uint64_t patternOffset = 0;     // オブジェクト先頭から目的の位置までのオフセットが分かっていれば（0 なら不明）
+};
+
+// パスを辿って目的の位置を求める（途中が読めない・null なら false）
+bool ResolvePointerPath(const uint8_t* moduleBase, const PointerPath& path,
+                        bool (*safeRead)(const void*, void*, size_t), const uint8_t** outAddress);
+
+// staticRanges（モジュールの書き込み可能セクション）から target までの深さ2以下のパスの候補を優先順に outPaths へ入れる
+//   深さ1: 静的変数がオブジェクトの先頭を指していて、target がちょうどそのパターンのオフセットにあるもの
+//          （先頭は limits.patternOffset か、深さ2の途中のメンバポインタ（EmuInstance::nds 等）が指す位置で確かめる。
+//            確かめられない静的変数は、たまたま target の少し手前を指しているだけの事があるので使わない）
+//   深さ2: 静的配列（emuInstances[] 等）→ オブジェクト内のポインタ → target のオブジェクト
+// readableRegions（低アドレス順）に入らない値はポインタとみなさない（読み取り例外を起こさないため）
+size_t FindStaticPointerPaths(const std::vector<HeapRegion>& staticRanges, const uint8_t* moduleBase,
+                              const uint8_t* target, const std::vector<HeapRegion>& readableRegions,
+                              const PointerPathLimits& limits, size_t maxPaths,
+                              bool (*safeRead)(const void*, void*, size_t), std::vector<PointerPath>& outPaths);
+
+// "1a2b30 48 5d10" 形式との変換
+std::string FormatPointerPath(const PointerPath& path);
+bool ParsePointerPath(const char* text, PointerPath& outPath);
+
+// キャッシュファイルの内容から key の行を探す
+bool FindLocatorCacheEntry(const std::string& contents, uint64_t key, PointerPath& outPath);
+// key の行を置き換えた（なければ追加した）内容を返す
+std::string UpdateLocatorCacheEntry(const std::string& contents, uint64_t key, const PointerPath& path);
+
+// キーのハッシュ（FNV-1a 64bit。PE ヘッダの各フィールドを分けて渡せるよう前回の値を hash に渡す）
+constexpr uint64_t LOCATOR_HASH_SEED = 0xcbf29ce484222325ULL;
+uint64_t HashLocatorKey(const void* data, size_t size, uint64_t hash = LOCATOR_HASH_SEED);
@@ -0,0 +1,58 @@
+﻿#include "pch.h"
+#include "mainram_canary.h"
+#include <cstring>
+
+void MainRAMCanary::Bind(uint8_t* mainRAM, uint32_t mask, const uint8_t* patternAt) {
+    m_mainRAM = mainRAM;
+    m_mask = mask;
+    m_patternAt = patternAt;
+    m_headerValid = false;
+    m_candidateValid = false;
+}
+
+void MainRAMCanary::Reset() {
+    m_mainRAM = nullptr;
+    m_mask = 0;
+    m_patternAt = nullptr;
+    m_headerValid = false;
+    m_candidateValid = false;
+}
+
+CanaryResult MainRAMCanary::Check(bool (*safeRead)(const void*, void*, size_t)) {
+    if (!m_mainRAM) return CanaryResult::Lost;
+
+    // NDS オブジェクトが解放・再確保されていればポインタかマスクが変わる（読めなくなる）
+    if (m_patternAt) {
+        uint8_t pattern[sizeof(uint8_t*) + sizeof(uint32_t)];
+        if (!safeRead(m_patternAt, pattern, sizeof(pattern))) return CanaryResult::Lost;
+        uint8_t* pointer;
+        uint32_t mask;
+        memcpy(&pointer, pattern, sizeof(pointer));
+        memcpy(&mask, pattern + sizeof(pointer), sizeof(mask));
+        if (pointer != m_mainRAM || mask != m_mask) return CanaryResult::Lost;
+    }
+
+    // ヘッダのコピー。起動前・リセット中（0 のまま）は覚えず比べない
+    uint8_t header[HEADER_BYTES];
+    if (!safeRead(m_mainRAM + GetHeaderOffset(m_mask), header, HEADER_BYTES)) {
+        return m_headerValid ? CanaryResult::Lost : CanaryResult::Valid;
+    }
+    static const uint8_t ZERO_HEADER[HEADER_BYTES] = {};
+    if (memcmp(header, ZERO_HEADER, HEADER_BYTES) == 0 ||
+        (m_headerValid && memcmp(header, m_header, HEADER_BYTES) == 0)) {
+        m_candidateValid = false;
+        return CanaryResult::Valid;
+    }
+
+    // 覚えていない・覚えたものと違う内容は、同じ内容が2回続いてから覚える（書き込み途中の内容を覚えないように）
+    if (!m_candidateValid || memcmp(header, m_candidate, HEADER_BYTES) != 0) {
+        memcpy(m_candidate, header, HEADER_BYTES);
+        m_candidateValid = true;
+        return CanaryResult::Valid;
+    }
+    bool changed = m_headerValid;
+    memcpy(m_header, header, HEADER_BYTES);
+    m_headerValid = true;
+    m_candidateValid = false;
+    return changed ? CanaryResult::RomChanged : CanaryResult::Valid;
+}
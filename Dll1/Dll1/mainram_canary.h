@@ -0,0 +1,47 @@
+﻿#pragma once
+// mainram_canary.h : 検出済みの MainRAM がまだ有効かを毎ティック確かめる軽い検査
+// 一度見つけた MainRAM も、ROM のリセット・読み込み直しや NDS オブジェクトの再確保で無効になる。
+// 検出時にパターン（[MainRAM ポインタ][マスク]）の位置と、MainRAM 末尾の ROM ヘッダのコピー（タイトル・ゲームコード）を覚えておき、
+// 毎ティック読み直して比べる。読み取りは 12 + 16 バイトだけなので、サンプリングに比べて無視できる
+//
+// ヘッダのコピーは NDS で 0x027FFE00、DSi で 0x02FFFE00（どちらも MainRAM の末尾 0x200 バイト）
+// ROM の起動前に検出するとまだ 0 のままなので、0 でない同じ内容を2回続けて読めた時に覚える。
+// 覚えた後に変わった時も、新しい内容が2回続いたら ROM の読み込み直しとして覚え直す（MainRAM は同じなので外さない）
+
+#include <cstdint>
+#include <cstddef>
+
+enum class CanaryResult : uint8_t {
+    Valid,          // 同じ MainRAM のまま
+    Lost,           // パターンの位置が別の MainRAM・マスクを指している（読めない）→ 外して再検出
+    RomChanged,     // 同じ MainRAM で別の ROM が起動した（ヘッダを覚え直した）
+};
+
+class MainRAMCanary {
+public:
+    static constexpr size_t HEADER_BYTES = 16;   // タイトル（12バイト）+ ゲームコード（4バイト）
+
+    // 検出した MainRAM を覚える（patternAt は nullptr なら位置の検査を省く）
+    // ヘッダはここでは覚えず、以降の Check で安定してから覚える
+    void Bind(uint8_t* mainRAM, uint32_t mask, const uint8_t* patternAt);
+
+    void Reset();
+
+    // パターンの位置が同じ MainRAM とマスクを指しているか確かめ、ヘッダを覚える・比べる
+    CanaryResult Check(bool (*safeRead)(const void*, void*, size_t));
+
+    bool IsBound() const { return m_mainRAM != nullptr; }
+    const uint8_t* GetPatternAt() const { return m_patternAt; }
+
+    // ヘッダのコピーの MainRAM 先頭からの位置
+    static uint32_t GetHeaderOffset(uint32_t mask) { return (mask + 1) - 0x200; }
+
+private:
+    uint8_t* m_mainRAM = nullptr;
+    uint32_t m_mask = 0;
+    const uint8_t* m_patternAt = nullptr;
+    bool m_headerValid = false;                 // m_header を覚えた
+    bool m_candidateValid = false;              // 覚える前・覚えたものと違う内容を1回読んだ
+    uint8_t m_header[HEADER_BYTES] = {};
+    uint8_t m_candidate[HEADER_BYTES] = {};
+};
@@ -0,0 +1,1249 @@
+﻿// monitor.cpp : モニター本体（コマンド処理・差分検知・送信）
+// DeltaTracker による差分検知、クライアント毎の送信状態を扱う
+// OS 依存の処理は MonitorConfig 経由で呼ぶ（monitor.h 参照）
+
+#include "pch.h"
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <mutex>
+#include <map>
+#include <chrono>
+#include <thread>
+#include <memory>
+#include <condition_variable>
+#include <cstdlib>
+#include "monitor.h"
+#include "transport.h"
+#include "delta_tracker.h"
+#include "delta_log.h"
+#include "json_util.h"
+#include "frame_source.h"
+#include "wire_format.h"
+#include "shared_state.h"
+#include "delta_outbox.h"
+#include "game_addresses.h"
+#include "latency_stats.h"
+#include "mainram_canary.h"
+
+// subscribe コマンドで使えるグループ名（画面毎に必要な値のまとまり。RJ/BA 共通）
+// 各パターンは値の名前そのものか、末尾 * の前方一致
+struct SubscriptionGroup {
+    const char* name;
+    const char* patterns[4];
+};
+
+static const SubscriptionGroup SUBSCRIPTION_GROUPS[] = {
+    { "folder",    { "CARD*", "REG", "TAG1*" } },                            // フォルダ
+    { "brothers",  { "BRO*", "REZON_*", "MY_REZON" } },                      // ブラザー・レゾン
+    { "sss",       { "SSS_*", "SELECTED_SSS_*" } },                          // サテライトサーバー
+    { "noise",     { "NOISE*", "NOISED_CARD*", "WHITE_CARDS" } },            // ノイズ・ノイズドカード
+    { "abilities", { "ABILITY*" } },                                         // アビリティ
+    { "finalize",  { "COMFIRM_LV_*", "F_Turn_Remaining", "CURRENT_CARD" } }, // ファイナライズ
+};
+
+// ========================================
+// グローバル変数
+// ========================================
+// エミュレータインスタンス毎の状態（id は検出順。0 は rescan で最初に検出したもの）
+// インスタンス毎に DeltaTracker / DeltaLog を持ち、seq もインスタンス毎に払い出す
+// 0 以外のインスタンスの full / delta には "instance" が付く（wire_format.h の Instance フレーム）
+struct EmulatorInstance {
+    uint32_t id = 0;
+    uint8_t* mainRAM = nullptr;     // melonDSのMainRAMポインタ（実行時に検出）
+    uint32_t mainRAMMask = 0;
+    char version[4] = "";           // 登録したアドレス表（"BA" or "RJ"。空なら未登録）
+    DeltaTracker tracker;
+    DeltaLog deltaLog;              // 送信済み delta（resume 用）
+    MainRAMCanary canary;           // mainRAM がまだ有効かの毎ティックの検査
+    bool rebinding = false;         // 検査に失敗して再検出待ち（mainRAM は nullptr）
+    const uint8_t* lastPatternAt = nullptr;  // 外す前のパターンの位置とマスク（再検出で同じインスタンスに戻すため）
+    uint32_t lastMask = 0;
+
+    // MainRAM検出済みでアドレス登録済み（ポーリング対象）
+    bool IsTracking() const { return mainRAM && version[0]; }
+};
+
+// バージョン選択状態（インスタンス毎に一度だけ。最初に選んだものを、指定のないインスタンスにも使う）
+static std::atomic<bool> g_versionSelected{ false };
+static char g_selectedVersion[4] = "";  // "BA" or "RJ"
+
+// 通信路 & インスタンス
+static const MonitorConfig* g_config = nullptr;
+static Transport* g_transport = nullptr;
+static std::vector<std::unique_ptr<EmulatorInstance>> g_instances;  // 0番は常にある（RunMonitor で作る）
+static std::mutex g_trackerMutex;   // g_instances と各インスタンスの DeltaTracker / DeltaLog の保護（ポーリングとコマンド処理）
+static EmulatorInstance* g_readingInstance = nullptr;  // ReadMemoryBlock の読み取り先（SampleMemory の間だけ）
+
+// MainRAM の再検出（検査に失敗したインスタンスを別スレッドで探し直す。待機は g_trackerMutex と組で使う）
+constexpr uint32_t REBIND_RETRY_MS = 500;       // 見つからなかった時の最初の再試行間隔（失敗する度に倍にする）
+constexpr uint32_t REBIND_MAX_RETRY_MS = 8000;  // ヒープスキャンを繰り返し過ぎないための上限
+static std::condition_variable g_rebindSignal;
+static std::mutex g_scanMutex;              // findMainRAM / findAllMainRAM を同時に呼ばないため（rescan と再検出）
+
+// 検出の後の学習（learnMainRAM）。時間がかかる（ポインタスキャン・安定の確認）ので再検出スレッドとは別のスレッドで行い、
+// 学習中に MainRAM が無効になっても再検出を待たせない
+static std::condition_variable g_learnSignal;
+static std::mutex g_learnMutex;
+static bool g_learnRequested = false;       // g_learnMutex で保護
+
+// クライアントが受け取っているインスタンス毎の送信状態
+struct InstanceView {
+    bool nameTableSent = false;  // バイナリモードで名前表を送信済みか
+    DeltaOutbox outbox;          // 送信中に発生した delta の合流待ち
+    uint64_t sentSeq = 0;        // 送信済みの最新の seq（full / delta / 再送）
+    std::vector<uint64_t> subscription;  // 購読している値 id のビットセット（id はインスタンスの登録順）
+};
+
+// クライアント毎の送信状態（g_trackerMutex で保護）
+// 転送形式は接続毎に JSON から開始し、setEncoding で切り替える
+struct ClientSession {
+    WireEncoding encoding = WireEncoding::Json;
+
+    // 購読（subscribe コマンド）。既定は全値
+    // 購読中のクライアントには、購読している値の変化だけを合流 delta で送る
+    bool subscribedAll = true;
+    std::vector<std::string> patterns;   // グループ名・パターン（setVersion で登録が変わったら解決し直す）
+
+    // 受け取るインスタンス（ビット i がインスタンス i。watch コマンドで変更。既定はインスタンス0のみ）
+    uint32_t watchMask = 1;
+    InstanceView views[MAX_EMULATOR_INSTANCES];
+
+    // 定期 stats メッセージ（stats コマンドの "on" で間隔を指定。0 なら送らない）
+    uint32_t statsIntervalMs = 0;
+    std::chrono::steady_clock::time_point nextStatsAt;
+
+    bool Watches(uint32_t instance) const { return (watchMask >> instance) & 1; }
+};
+static std::map<uint32_t, ClientSession> g_sessions;
+constexpr uint32_t ALL_CLIENTS = 0;  // SendFullState の宛先指定（clientId は1始まり）
+
+// 共有メモリ転送（同一マシン上のツール向け。hello で名前を通知する。インスタンス0のみ）
+constexpr uint32_t SHARED_STATE_VALUE_CAPACITY = 1024;  // 登録アドレス数の上限
+constexpr uint32_t SHARED_STATE_RING_CAPACITY = 4096;   // 変化レコード数
+static SharedStateChannel g_sharedState;                 // g_trackerMutex で保護
+static bool g_sharedReadersActive = false;               // 共有メモリの読み取り側の分も読み取り対象に含めているか
+
+// サンプリングのトリガー
+// フレーム通知が使えればフレーム同期、使えなければ50ms周期のポーリング
+constexpr uint32_t FRAME_WAIT_TIMEOUT_MS = 50;
+static IntervalFrameSource g_intervalFrameSource{ std::chrono::milliseconds(FRAME_WAIT_TIMEOUT_MS) };
+static FrameSource* g_frameSource = &g_intervalFrameSource;
+
+// 処理段階毎の所要時間（stats コマンド）。既定は無効で、無効の間は時刻も取らない
+static LatencyStats g_latencyStats;
+static uint64_t g_readNs = 0;               // 今回のサンプリングで MainRAM 読み取りにかかった時間（g_trackerMutex で保護）
+static bool g_sampleTimestamps = false;     // delta にサンプリング時刻を付けるか（全クライアント共通。g_trackerMutex で保護）
+static uint64_t g_lastSampleUs = 0;         // 最後にサンプリングした時刻（Unix 時刻のマイクロ秒）
+
+// ========================================
+// インスタンス
+// ========================================
+
+static EmulatorInstance* FindInstance(uint32_t id) {
+    return (id < g_instances.size()) ? g_instances[id].get() : nullptr;
+}
+
+static EmulatorInstance& PrimaryInstance() {
+    return *g_instances[0];
+}
+
+// 新しいインスタンスを追加する（上限に達していれば nullptr）
+// ※ g_trackerMutex を保持して呼ぶこと
+static EmulatorInstance* AddInstance() {
+    if (g_instances.size() >= MAX_EMULATOR_INSTANCES) return nullptr;
+    auto instance = std::make_unique<EmulatorInstance>();
+    instance->id = (uint32_t)g_instances.size();
+    instance->tracker.SetInstanceId(instance->id);
+    g_instances.push_back(std::move(instance));
+    return g_instances.back().get();
+}
+
+// ========================================
+// 汎用メモリ読み書きAPI
+// ========================================
+
+static uint8_t* GetHostAddress(const EmulatorInstance& instance, uint32_t dsAddress) {
+    if (!instance.mainRAM || !instance.mainRAMMask) return nullptr;
+    uint32_t offset = (dsAddress - DS_MAIN_RAM_START) & instance.mainRAMMask;
+    return instance.mainRAM + offset;
+}
+
+// DeltaTracker用メモリ一括読み取りコールバック（読み取りプランの1区間を1回でコピー）
+// 読み取り先は SampleMemory で g_readingInstance に設定したインスタンス
+static bool ReadMemoryBlock(uint32_t ramOffset, uint32_t length, uint8_t* outBuffer) {
+    const EmulatorInstance* instance = g_readingInstance;
+    if (!instance || !instance->mainRAM || !instance->mainRAMMask) return false;
+    if ((uint64_t)ramOffset + length > (uint64_t)instance->mainRAMMask + 1) return false;
+    if (!g_latencyStats.IsEnabled()) {
+        return g_config->safeRead(instance->mainRAM + ramOffset, outBuffer, length);
+    }
+    uint64_t start = LatencyStats::NowNs();
+    bool ok = g_config->safeRead(instance->mainRAM + ramOffset, outBuffer, length);
+    g_readNs += LatencyStats::NowNs() - start;
+    return ok;
+}
+
+// メモリ読み取り＆差分検知（all なら全区間、それ以外は今回が周期に当たる階層のみ）
+// 計測中は読み取り（Read）とそれ以外のデコード・比較（Diff）を分けて記録する
+// ※ g_trackerMutex を保持して呼ぶこと
+static void SampleMemory(EmulatorInstance& instance, bool all) {
+    if (g_sampleTimestamps) {
+        g_lastSampleUs = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    bool measure = g_latencyStats.IsEnabled();
+    uint64_t start = measure ? LatencyStats::NowNs() : 0;
+    g_readNs = 0;
+    g_readingInstance = &instance;
+    if (all) {
+        instance.tracker.UpdateAll(ReadMemoryBlock, instance.mainRAMMask);
+    } else {
+        instance.tracker.Update(ReadMemoryBlock, instance.mainRAMMask);
+    }
+    g_readingInstance = nullptr;
+    if (measure) {
+        uint64_t total = LatencyStats::NowNs() - start;
+        g_latencyStats.Record(LatencyStage::Read, g_readNs);
+        g_latencyStats.Record(LatencyStage::Diff, total - (std::min)(g_readNs, total));
+    }
+}
+
+// delta に付けるサンプリング時刻（無効なら 0）
+static uint64_t GetSampleTimestamp() {
+    return g_sampleTimestamps ? g_lastSampleUs : 0;
+}
+
+// メモリ書き込み（コマンド処理用）
+static bool WriteMemory(const EmulatorInstance& instance, uint32_t dsAddress, uint8_t size, uint32_t value) {
+    uint8_t* hostAddr = GetHostAddress(instance, dsAddress);
+    if (!hostAddr) return false;
+    if (size != 4 && size != 2 && size != 1) return false;
+    return g_config->safeWrite(hostAddr, value, size);
+}
+
+// ========================================
+// コマンド処理（Electron → DLL）
+// ========================================
+
+// 制御メッセージ（hello / status / pong / error など）を送信
+// バイナリモードのクライアントには Json フレームに包む
+// ※ g_trackerMutex を保持して呼ぶこと
+static void SendControl(uint32_t clientId, const std::string& json) {
+    auto it = g_sessions.find(clientId);
+    if (it == g_sessions.end()) return;
+    if (it->second.encoding == WireEncoding::Binary) {
+        std::string frame = WrapJsonFrame(json);
+        g_transport->SendShared(clientId, Transport::MakeRaw(frame.data(), frame.size()));
+    } else {
+        g_transport->Send(clientId, json);
+    }
+}
+
+// エンコード済みの full / delta を送信バッファにする
+static SendBuffer MakeSendBuffer(const std::string& message, WireEncoding encoding) {
+    return (encoding == WireEncoding::Binary)
+        ? Transport::MakeRaw(message.data(), message.size())
+        : Transport::MakeLine(message);
+}
+
+// バイナリモードでインスタンスの名前表が未送信なら送る（値フレームの id を解釈するのに必要）
+// nameTable は複数クライアントで共有するため、未作成なら作って返す
+// ※ g_trackerMutex を保持して呼ぶこと
+static void EnsureNameTableSent(uint32_t clientId, ClientSession& session, EmulatorInstance& instance, SendBuffer& nameTable) {
+    InstanceView& view = session.views[instance.id];
+    if (session.encoding != WireEncoding::Binary || view.nameTableSent) return;
+    if (!nameTable) {
+        nameTable = MakeSendBuffer(instance.tracker.BuildNameTableFrame(), WireEncoding::Binary);
+    }
+    g_transport->SendShared(clientId, nameTable);
+    view.nameTableSent = true;
+}
+
+// インスタンスを受け取っているクライアントが使っている形式
+// 購読中のクライアントは合流 delta で送るので数えない
+static void GetSessionEncodings(uint32_t instance, bool& anyJson, bool& anyBinary) {
+    anyJson = anyBinary = false;
+    for (const auto& entry : g_sessions) {
+        if (!entry.second.subscribedAll || !entry.second.Watches(instance)) continue;
+        if (entry.second.encoding == WireEncoding::Binary) anyBinary = true;
+        else anyJson = true;
+    }
+}
+
+// 変化があれば seq を払い出して delta を記録し、インスタンスを受け取っている全クライアントと共有メモリへ送信する
+// 形式毎に1回だけエンコードし、同じバッファを全クライアントのキューで共有する
+// ※ g_trackerMutex を保持して呼ぶこと
+static void FlushDelta(EmulatorInstance& instance) {
+    DeltaTracker& tracker = instance.tracker;
+    if (!tracker.HasChanges()) return;
+
+    bool anyJson, anyBinary;
+    GetSessionEncodings(instance.id, anyJson, anyBinary);
+
+    // JSON は resume 用に常に記録。バイナリはバイナリのクライアントがいる時だけ作る
+    static const std::string NO_FRAME;
+    uint64_t seq = instance.deltaLog.NextSeq();
+    uint64_t sampleUs = GetSampleTimestamp();
+    SendBuffer jsonBuffer, frameBuffer;
+    {
+        StageTimer timer(g_latencyStats, LatencyStage::Serialize);
+        const std::string& json = tracker.BuildDeltaJson(seq, sampleUs);
+        const std::string& frame = anyBinary ? tracker.BuildDeltaFrame(seq, sampleUs) : NO_FRAME;
+        instance.deltaLog.Append(seq, json, frame);
+        if (anyJson) jsonBuffer = MakeSendBuffer(json, WireEncoding::Json);
+        if (anyBinary) frameBuffer = MakeSendBuffer(frame, WireEncoding::Binary);
+    }
+    if (instance.id == 0) {
+        g_sharedState.PublishDelta(tracker, seq);
+    }
+
+    StageTimer timer(g_latencyStats, LatencyStage::Enqueue);
+    SendBuffer nameTable;
+    for (auto& entry : g_sessions) {
+        if (!entry.second.Watches(instance.id)) continue;
+        InstanceView& view = entry.second.views[instance.id];
+        DeltaOutbox& outbox = view.outbox;
+        // 購読中のクライアントには購読している値だけを合流させ、FlushOutboxes で送る
+        if (!entry.second.subscribedAll) {
+            outbox.Merge(tracker.GetChangedBits(), view.subscription, seq);
+            continue;
+        }
+        // 送信中（または合流待ちあり）のクライアントには積まず、合流待ちにまとめる
+        if (!outbox.IsEmpty() || g_transport->IsSendBusy(entry.first)) {
+            outbox.Merge(tracker.GetChangedBits(), seq);
+            continue;
+        }
+        if (entry.second.encoding == WireEncoding::Binary) {
+            EnsureNameTableSent(entry.first, entry.second, instance, nameTable);
+            g_transport->SendShared(entry.first, frameBuffer, MessageClass::Delta);
+        } else {
+            g_transport->SendShared(entry.first, jsonBuffer, MessageClass::Delta);
+        }
+        view.sentSeq = seq;
+    }
+    tracker.ResetChangeFlags();
+}
+
+// 送信が空いたクライアントへ合流待ちの変化を送る（各値の最新値のみ。毎ティック呼ぶ）
+// ※ g_trackerMutex を保持して呼ぶこと
+static void FlushOutboxes() {
+    for (auto& entry : g_sessions) {
+        for (auto& instance : g_instances) {
+            if (!entry.second.Watches(instance->id)) continue;
+            InstanceView& view = entry.second.views[instance->id];
+            DeltaOutbox& outbox = view.outbox;
+            if (outbox.IsEmpty() || g_transport->IsSendBusy(entry.first)) continue;
+
+            // 合流待ちが空になるまで以降の delta もすべてここに入るため、最後の seq は常に最新
+            // 購読中は関係のない delta を飛ばしているので、from は前回送った seq の次からにする
+            // 値はどれも最後のサンプリングのものなので、サンプリング時刻も最後のもの
+            DeltaTracker& tracker = instance->tracker;
+            uint64_t seq = outbox.GetLastSeq();
+            uint64_t from = (std::min)(outbox.GetFirstSeq(), view.sentSeq + 1);
+            if (entry.second.encoding == WireEncoding::Binary) {
+                SendBuffer nameTable;
+                EnsureNameTableSent(entry.first, entry.second, *instance, nameTable);
+            }
+            SendBuffer buffer;
+            {
+                StageTimer timer(g_latencyStats, LatencyStage::Serialize);
+                buffer = (entry.second.encoding == WireEncoding::Binary)
+                    ? MakeSendBuffer(tracker.BuildCoalescedDeltaFrame(from, seq, outbox.GetBits(), GetSampleTimestamp()), WireEncoding::Binary)
+                    : MakeSendBuffer(tracker.BuildCoalescedDeltaJson(from, seq, outbox.GetBits(), GetSampleTimestamp()), WireEncoding::Json);
+            }
+            {
+                StageTimer timer(g_latencyStats, LatencyStage::Enqueue);
+                g_transport->SendShared(entry.first, buffer, MessageClass::Delta);
+            }
+            view.sentSeq = seq;
+            outbox.Clear();
+        }
+    }
+}
+
+// インスタンスの全区間を読み直してフルステート送信（clientId = ALL_CLIENTS なら受け取っている全クライアント）
+// 読み直しで見つかった変化は delta として全クライアントに送ってから full を送る
+// ※ g_trackerMutex を保持して呼ぶこと
+static void SendFullState(EmulatorInstance& instance, uint32_t clientId) {
+    if (!instance.IsTracking()) return;
+    SampleMemory(instance, true);
+    FlushDelta(instance);
+
+    DeltaTracker& tracker = instance.tracker;
+    uint64_t seq = instance.deltaLog.GetLatestSeq();
+    SendBuffer jsonBuffer, frameBuffer, nameTable;
+    for (auto& entry : g_sessions) {
+        if (clientId != ALL_CLIENTS && entry.first != clientId) continue;
+        if (!entry.second.Watches(instance.id)) continue;
+        InstanceView& view = entry.second.views[instance.id];
+
+        // full は合流待ちの変化をすべて含む
+        view.outbox.Clear();
+        view.sentSeq = seq;
+
+        // 購読中のクライアントには購読している値だけの full を個別に作る
+        const std::vector<uint64_t>* ids = entry.second.subscribedAll ? nullptr : &view.subscription;
+        if (entry.second.encoding == WireEncoding::Binary) {
+            // 名前表とフレームは DeltaTracker の同じバッファを使うので、名前表を先に作る
+            EnsureNameTableSent(entry.first, entry.second, instance, nameTable);
+            if (ids) {
+                g_transport->SendShared(entry.first, MakeSendBuffer(tracker.BuildFullStateFrame(seq, ids), WireEncoding::Binary));
+                continue;
+            }
+            if (!frameBuffer) {
+                frameBuffer = MakeSendBuffer(tracker.BuildFullStateFrame(seq), WireEncoding::Binary);
+            }
+            g_transport->SendShared(entry.first, frameBuffer);
+        } else {
+            if (ids) {
+                g_transport->SendShared(entry.first, MakeSendBuffer(tracker.BuildFullStateJson(seq, ids), WireEncoding::Json));
+                continue;
+            }
+            if (!jsonBuffer) {
+                jsonBuffer = MakeSendBuffer(tracker.BuildFullStateJson(seq), WireEncoding::Json);
+            }
+            g_transport->SendShared(entry.first, jsonBuffer);
+        }
+    }
+}
+
+// ポーリング中の全インスタンスのフルステート送信
+// ※ g_trackerMutex を保持して呼ぶこと
+static void SendFullStates(uint32_t clientId) {
+    for (auto& instance : g_instances) {
+        SendFullState(*instance, clientId);
+    }
+}
+
+// パターン1つ（グループ名・値の名前・末尾 * の前方一致）に一致する値 id を bits に立てる
+// ※ g_trackerMutex を保持して呼ぶこと
+static void MatchSubscriptionPattern(const DeltaTracker& tracker, const char* pattern, std::vector<uint64_t>& bits) {
+    for (const auto& group : SUBSCRIPTION_GROUPS) {
+        if (strcmp(group.name, pattern) != 0) continue;
+        for (const char* groupPattern : group.patterns) {
+            if (groupPattern) MatchSubscriptionPattern(tracker, groupPattern, bits);
+        }
+        return;
+    }
+
+    size_t length = strlen(pattern);
+    if (length > 0 && pattern[length - 1] == '*') {
+        for (uint32_t id = 0; id < (uint32_t)tracker.GetAddressCount(); id++) {
+            if (strncmp(tracker.GetName(id), pattern, length - 1) == 0) SetBit(bits, id);
+        }
+        return;
+    }
+
+    int id = tracker.FindByName(pattern, length);
+    if (id >= 0) SetBit(bits, id);
+}
+
+// セッションの購読パターンをインスタンスの値 id に解決する（登録内容が変わった時も呼ぶ）。購読している値の数を返す
+// ※ g_trackerMutex を保持して呼ぶこと
+static size_t ResolveSubscription(ClientSession& session, const EmulatorInstance& instance) {
+    InstanceView& view = session.views[instance.id];
+    size_t count = instance.tracker.GetAddressCount();
+    if (session.subscribedAll) {
+        view.subscription.clear();
+        return count;
+    }
+    view.subscription.assign(BitWordCount(count), 0);
+    for (const std::string& pattern : session.patterns) {
+        MatchSubscriptionPattern(instance.tracker, pattern.c_str(), view.subscription);
+    }
+    size_t subscribed = 0;
+    ForEachSetBit(view.subscription, [&](uint32_t) { subscribed++; });
+    return subscribed;
+}
+
+// 全インスタンス分を解決する。インスタンス0で購読している値の数を返す
+// ※ g_trackerMutex を保持して呼ぶこと
+static size_t ResolveSubscription(ClientSession& session) {
+    size_t subscribed = 0;
+    for (const auto& instance : g_instances) {
+        size_t count = ResolveSubscription(session, *instance);
+        if (instance->id == 0) subscribed = count;
+    }
+    return subscribed;
+}
+
+// インスタンス毎に、受け取っているクライアントの購読の和を読み取り対象にする。どのクライアントも購読していない値は読まない
+// 全値を購読しているクライアントか（インスタンス0なら）共有メモリの読み取り側がいれば全値
+// クライアントがいない間はポーリング自体が止まるので、対象はそのままにしておく
+// ※ g_trackerMutex を保持して呼ぶこと
+static void UpdateActiveIds() {
+    g_sharedReadersActive = g_sharedState.HasReaders();
+    if (g_sessions.empty() && !g_sharedReadersActive) return;
+
+    for (auto& instance : g_instances) {
+        DeltaTracker& tracker = instance->tracker;
+        bool all = (instance->id == 0) && g_sharedReadersActive;
+        std::vector<uint64_t> active(BitWordCount(tracker.GetAddressCount()), 0);
+        for (const auto& entry : g_sessions) {
+            if (!entry.second.Watches(instance->id)) continue;
+            if (entry.second.subscribedAll) {
+                all = true;
+                break;
+            }
+            const std::vector<uint64_t>& subscription = entry.second.views[instance->id].subscription;
+            for (size_t w = 0; w < active.size() && w < subscription.size(); w++) {
+                active[w] |= subscription[w];
+            }
+        }
+        if (all) {
+            std::fill(active.begin(), active.end(), ~0ULL);
+        }
+        tracker.SetActiveIds(active);
+    }
+}
+
+// インスタンスにアドレス表を登録する（インスタンス毎に一度だけ）
+// ※ g_trackerMutex を保持して呼ぶこと
+static bool RegisterVersion(EmulatorInstance& instance, const char* version) {
+    if (instance.version[0]) return false;
+    const GameAddress* addresses = nullptr;
+    size_t count = 0;
+    if (strcmp(version, "RJ") == 0) {
+        addresses = RJ_ADDRESSES;
+        count = RJ_ADDRESS_COUNT;
+    } else if (strcmp(version, "BA") == 0) {
+        addresses = BA_ADDRESSES;
+        count = BA_ADDRESS_COUNT;
+    } else {
+        return false;
+    }
+    snprintf(instance.version, sizeof(instance.version), "%s", version);
+    for (size_t i = 0; i < count; i++) {
+        instance.tracker.RegisterAddress(addresses[i].name, addresses[i].dsAddress, addresses[i].size, addresses[i].tier);
+    }
+    // 登録内容が変わったので名前表を送り直し、購読を解決し直す
+    for (auto& entry : g_sessions) {
+        InstanceView& view = entry.second.views[instance.id];
+        view.nameTableSent = false;
+        view.outbox.Clear();
+        ResolveSubscription(entry.second, instance);
+    }
+    UpdateActiveIds();
+    if (instance.id == 0) {
+        g_sharedState.PublishNameTable(instance.tracker);
+    }
+    printf("[DLL] バージョン設定: %s (インスタンス %u, %zu アドレス)\n", instance.version, instance.id, count);
+    return true;
+}
+
+// クライアントの転送形式を切り替える
+// ※ g_trackerMutex を保持して呼ぶこと
+static void SwitchWireEncoding(uint32_t clientId, WireEncoding encoding) {
+    auto it = g_sessions.find(clientId);
+    if (it == g_sessions.end()) return;
+    it->second.encoding = encoding;
+    for (InstanceView& view : it->second.views) {
+        view.nameTableSent = false;
+    }
+}
+
+// 現在のstatusを送信
+// gameActive / mainram はインスタンス0、instances は検出済みの全インスタンス
+// ※ g_trackerMutex を保持して呼ぶこと
+static void SendStatus(uint32_t clientId) {
+    const EmulatorInstance& primary = PrimaryInstance();
+    JsonWriter jw;
+    jw.BeginObject();
+    jw.StringField("type", "status");
+    jw.BoolField("connected", true);
+    jw.BoolField("gameActive", primary.mainRAM != nullptr);
+    if (primary.mainRAM) {
+        jw.PtrField("mainram", primary.mainRAM);
+    }
+    if (primary.rebinding) {
+        jw.BoolField("rebinding", true);
+    }
+    jw.Key("instances");
+    jw.BeginArray();
+    for (const auto& instance : g_instances) {
+        if (!instance->mainRAM) continue;
+        jw.BeginArrayObject();
+        jw.UIntField("id", instance->id);
+        jw.PtrField("mainram", instance->mainRAM);
+        jw.StringField("version", instance->version);
+        jw.EndObject();
+    }
+    jw.EndArray();
+    jw.EndObject();
+    SendControl(clientId, jw.GetString());
+}
+
+// エラー通知
+// ※ g_trackerMutex を保持して呼ぶこと
+static void SendError(uint32_t clientId, const char* code, const char* msg) {
+    JsonWriter jw;
+    jw.BeginObject();
+    jw.StringField("type", "error");
+    jw.StringField("code", code);
+    jw.StringField("msg", msg);
+    jw.EndObject();
+    SendControl(clientId, jw.GetString());
+}
+
+// 処理段階毎の所要時間（stats メッセージ）
+// ※ g_trackerMutex を保持して呼ぶこと
+static void SendStats(uint32_t clientId) {
+    JsonWriter jw;
+    jw.BeginObject();
+    jw.StringField("type", "stats");
+    jw.BoolField("enabled", g_latencyStats.IsEnabled());
+    jw.BoolField("timestamps", g_sampleTimestamps);
+    jw.Key("stages");
+    jw.BeginObject();
+    for (size_t i = 0; i < (size_t)LatencyStage::Count; i++) {
+        LatencyStage stage = (LatencyStage)i;
+        LatencySnapshot s = g_latencyStats.GetHistogram(stage).GetSnapshot();
+        jw.Key(GetLatencyStageName(stage));
+        jw.BeginObject();
+        jw.IntField("count", (int64_t)s.count);
+        jw.IntField("minNs", (int64_t)s.minNs);
+        jw.IntField("meanNs", (int64_t)s.meanNs);
+        jw.IntField("p50Ns", (int64_t)s.p50Ns);
+        jw.IntField("p90Ns", (int64_t)s.p90Ns);
+        jw.IntField("p99Ns", (int64_t)s.p99Ns);
+        jw.IntField("p999Ns", (int64_t)s.p999Ns);
+        jw.IntField("maxNs", (int64_t)s.maxNs);
+        jw.EndObject();
+    }
+    jw.EndObject();
+    jw.EndObject();
+    SendControl(clientId, jw.GetString());
+}
+
+// 間隔を指定したクライアントへ stats を送る（毎ティック呼ぶ）
+// ※ g_trackerMutex を保持して呼ぶこと
+static void SendPeriodicStats() {
+    auto now = std::chrono::steady_clock::now();
+    for (auto& entry : g_sessions) {
+        ClientSession& session = entry.second;
+        if (session.statsIntervalMs == 0 || now < session.nextStatsAt) continue;
+        session.nextStatsAt = now + std::chrono::milliseconds(session.statsIntervalMs);
+        SendStats(entry.first);
+    }
+}
+
+
+// id のインスタンスを返す（まだなければ MainRAM 未検出のまま id まで作る。上限を超える id は nullptr）
+// setVersion で検出前のインスタンスにバージョンを指定できるようにするため
+// ※ g_trackerMutex を保持して呼ぶこと
+static EmulatorInstance* FindOrAddInstance(uint32_t id) {
+    if (id >= MAX_EMULATOR_INSTANCES) return nullptr;
+    while (g_instances.size() <= id) {
+        AddInstance();
+    }
+    return FindInstance(id);
+}
+
+// 接続中の全クライアントへ status を送る（検出状態が変わった時）
+// ※ g_trackerMutex を保持して呼ぶこと
+static void BroadcastStatus() {
+    for (const auto& entry : g_sessions) {
+        SendStatus(entry.first);
+    }
+}
+
+// MainRAM を探す（all なら全インスタンス分）。見つかった数を返す
+// 時間がかかるため g_trackerMutex を保持せずに呼ぶこと
+static size_t LocateMainRAM(bool all, MainRAMLocation* out, size_t capacity) {
+    size_t count;
+    {
+        std::lock_guard<std::mutex> lock(g_scanMutex);
+        if (all && g_config->findAllMainRAM) {
+            count = g_config->findAllMainRAM(out, capacity);
+        } else {
+            count = g_config->findMainRAM(&out[0]) ? 1 : 0;
+        }
+    }
+    // 見つけた位置の学習（learnMainRAM）を学習スレッドに任せる
+    if (count && g_config->learnMainRAM) {
+        {
+            std::lock_guard<std::mutex> lock(g_learnMutex);
+            g_learnRequested = true;
+        }
+        g_learnSignal.notify_one();
+    }
+    return count;
+}
+
+// 見つけた MainRAM を割り当てるインスタンスを選ぶ（既に割り当て済みなら nullptr）
+// インスタンス同士が入れ替わらないよう、再検出待ちのインスタンスは外す前の位置で照合する
+//   1. 再検出待ちで、外す前と同じパターンの位置・マスク（同じ NDS オブジェクト）
+//   2. 再検出待ちで、同じマスク（NDS オブジェクトが再確保されて位置が変わった）
+//   3. MainRAM 未検出のもの（再検出待ちを含む）のうち id が最小のもの。なければ追加する
+// exactOnly なら 1 だけを探す
+// ※ g_trackerMutex を保持して呼ぶこと
+static EmulatorInstance* ChooseInstance(const MainRAMLocation& location, bool exactOnly) {
+    EmulatorInstance* sameSlot = nullptr;
+    EmulatorInstance* sameMask = nullptr;
+    EmulatorInstance* firstFree = nullptr;
+    for (auto& instance : g_instances) {
+        if (instance->mainRAM == location.mainRAM) return nullptr;
+        if (instance->mainRAM) continue;
+        if (instance->rebinding && instance->lastMask == location.mask) {
+            if (!sameSlot && location.patternAt && instance->lastPatternAt == location.patternAt) sameSlot = instance.get();
+            if (!sameMask) sameMask = instance.get();
+        }
+        if (!firstFree) firstFree = instance.get();
+    }
+    if (sameSlot || exactOnly) return sameSlot;
+    if (sameMask) return sameMask;
+    return firstFree ? firstFree : AddInstance();
+}
+
+// 見つけた MainRAM をインスタンスに割り当てる（既に割り当て済みなら何もしない）。割り当てたインスタンスを返す
+// 再検出待ちだったインスタンスは、全クライアントへ status を、受け取っているクライアントへフルステートを送り直す
+// ※ g_trackerMutex を保持して呼ぶこと
+static EmulatorInstance* AssignMainRAM(const MainRAMLocation& location, bool exactOnly) {
+    EmulatorInstance* target = ChooseInstance(location, exactOnly);
+    if (!target) return nullptr;
+    target->mainRAMMask = location.mask;
+    target->mainRAM = location.mainRAM;
+    target->canary.Bind(location.mainRAM, location.mask, location.patternAt);
+    // バージョン未指定のインスタンスには最初に選ばれたバージョンを使う
+    if (!target->version[0] && g_versionSelected) {
+        RegisterVersion(*target, g_selectedVersion);
+    }
+    if (target->rebinding) {
+        target->rebinding = false;
+        printf("[DLL] インスタンス %u: MainRAM 再検出 %p%s\n", target->id, target->mainRAM,
+            target->lastPatternAt == location.patternAt ? "" : " (パターンの位置が変わった)");
+        BroadcastStatus();
+        SendFullState(*target, ALL_CLIENTS);
+    }
+    return target;
+}
+
+// 見つけた全 MainRAM を割り当てる。割り当てた数を返す
+// 外す前と同じ位置のものを先に全部割り当ててから残りを埋める（後の MainRAM の元のインスタンスを先に取らないように）
+// ※ g_trackerMutex を保持して呼ぶこと
+static size_t AssignMainRAMs(const MainRAMLocation* found, size_t count) {
+    size_t assigned = 0;
+    for (bool exactOnly : { true, false }) {
+        for (size_t i = 0; i < count; i++) {
+            if (AssignMainRAM(found[i], exactOnly)) assigned++;
+        }
+    }
+    return assigned;
+}
+
+// 検査に失敗したインスタンスの MainRAM を外し、再検出を始める
+// NDS オブジェクトの再確保（エミュレータの再起動・設定変更等）の後は、古い mainRAM を読み続けないようにする
+// ※ g_trackerMutex を保持して呼ぶこと
+static void UnbindMainRAM(EmulatorInstance& instance) {
+    printf("[DLL] インスタンス %u: MainRAM %p が無効になった → 再検出\n", instance.id, instance.mainRAM);
+    instance.lastPatternAt = instance.canary.GetPatternAt();
+    instance.lastMask = instance.mainRAMMask;
+    instance.mainRAM = nullptr;
+    instance.mainRAMMask = 0;
+    instance.canary.Reset();
+    instance.rebinding = true;
+    BroadcastStatus();
+    g_rebindSignal.notify_one();
+}
+
+// 再検出スレッド: 再検出待ちのインスタンスがある間、探し直す
+// クライアントの rescan を待たずに復帰し、status を全クライアントへ送る
+static void RunRebinder(const std::atomic<bool>& running) {
+    std::unique_lock<std::mutex> lock(g_trackerMutex);
+    uint32_t retryMs = REBIND_RETRY_MS;
+    while (running) {
+        bool waiting = false;
+        for (const auto& instance : g_instances) {
+            if (instance->rebinding) waiting = true;
+        }
+        if (!waiting) {
+            retryMs = REBIND_RETRY_MS;
+            g_rebindSignal.wait_for(lock, std::chrono::milliseconds(REBIND_RETRY_MS));
+            continue;
+        }
+
+        // インスタンスが1つなら findMainRAM（ロケータキャッシュで速い）
+        // 複数あれば、他のインスタンスの MainRAM を返されないよう全インスタンス分を探す
+        bool scanAll = g_instances.size() > 1;
+        lock.unlock();
+        MainRAMLocation found[MAX_EMULATOR_INSTANCES];
+        size_t count = LocateMainRAM(scanAll, found, MAX_EMULATOR_INSTANCES);
+        lock.lock();
+
+        if (AssignMainRAMs(found, count) > 0) continue;
+        g_rebindSignal.wait_for(lock, std::chrono::milliseconds(retryMs));
+        retryMs = (std::min)(retryMs * 2, REBIND_MAX_RETRY_MS);
+    }
+}
+
+// 学習スレッド: 検出の度に learnMainRAM を呼ぶ（スキャンのロックも g_trackerMutex も持たない）
+static void RunLearner(const std::atomic<bool>& running) {
+    std::unique_lock<std::mutex> lock(g_learnMutex);
+    while (running) {
+        if (!g_learnRequested) {
+            g_learnSignal.wait_for(lock, std::chrono::milliseconds(REBIND_RETRY_MS));
+            continue;
+        }
+        g_learnRequested = false;
+        lock.unlock();
+        while (running && g_config->learnMainRAM()) {}
+        lock.lock();
+    }
+}
+
+// message は NUL 終端済み（Transport の受信バッファ上の1行）
+static void HandleCommand(uint32_t clientId, std::string_view message) {
+    StageTimer commandTimer(g_latencyStats, LatencyStage::Command);
+    JsonCommand cmd = ParseCommand(message.data());
+    if (!cmd.valid) {
+        printf("[DLL] 不正なコマンド: %.*s\n", (int)message.size(), message.data());
+        return;
+    }
+
+    // MainRAM再スキャンは時間がかかるため、ロックを取る前に行う
+    //   target 省略: インスタンス0が未検出の時のみ、最初に見つかった1つ
+    //   "all": 全インスタンス（未登録のものを追加する）
+    //   インスタンス0の再検出中は再検出スレッドに任せる
+    MainRAMLocation scanned[MAX_EMULATOR_INSTANCES];
+    size_t scannedCount = 0;
+    if (strcmp(cmd.cmd, "rescan") == 0) {
+        bool scanAll = (strcmp(cmd.target, "all") == 0);
+        bool primaryFound;
+        {
+            std::lock_guard<std::mutex> lock(g_trackerMutex);
+            primaryFound = PrimaryInstance().mainRAM != nullptr || PrimaryInstance().rebinding;
+        }
+        if (scanAll || !primaryFound) {
+            scannedCount = LocateMainRAM(scanAll, scanned, MAX_EMULATOR_INSTANCES);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(g_trackerMutex);
+
+    if (strcmp(cmd.cmd, "ping") == 0) {
+        // pong応答（Unix timestamp (ms)）
+        int64_t ts = (int64_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+
+        JsonWriter jw;
+        jw.BeginObject();
+        jw.StringField("type", "pong");
+        jw.IntField("ts", ts);
+        // 送信キューの状態（クライアントが受信遅れを把握できるように）
+        SendQueueStats qs;
+        if (g_transport->GetSendQueueStats(clientId, qs)) {
+            jw.Key("queue");
+            jw.BeginObject();
+            jw.UIntField("depth", (uint32_t)qs.depth);
+            jw.UIntField("maxDepth", (uint32_t)qs.maxDepth);
+            jw.IntField("sent", (int64_t)qs.sent);
+            jw.IntField("dropped", (int64_t)qs.dropped);
+            jw.IntField("coalesced", (int64_t)qs.coalesced);
+            jw.IntField("latencyUs", (int64_t)qs.lastLatencyUs);
+            jw.IntField("maxLatencyUs", (int64_t)qs.maxLatencyUs);
+            jw.IntField("avgLatencyUs", (int64_t)qs.avgLatencyUs);
+            jw.EndObject();
+        }
+        // 送信中に発生して合流させた delta の累計（全インスタンス分）
+        auto session = g_sessions.find(clientId);
+        if (session != g_sessions.end()) {
+            uint64_t coalescedDeltas = 0;
+            for (const InstanceView& view : session->second.views) {
+                coalescedDeltas += view.outbox.GetCoalescedCount();
+            }
+            jw.IntField("coalescedDeltas", (int64_t)coalescedDeltas);
+        }
+        jw.UIntField("clients", (uint32_t)g_transport->GetClientCount());
+        jw.EndObject();
+        SendControl(clientId, jw.GetString());
+
+    } else if (strcmp(cmd.cmd, "setVersion") == 0) {
+        // バージョン設定（インスタンス毎に一度だけ有効。再起動しないと変更不可）
+        // 最初に選ばれたバージョンは、指定のないインスタンス（後から検出したものを含む）にも使う
+        if (strcmp(cmd.target, "RJ") != 0 && strcmp(cmd.target, "BA") != 0) {
+            printf("[DLL] setVersion: 不明なバージョン: %s\n", cmd.target);
+            return;
+        }
+        EmulatorInstance* target = FindOrAddInstance(cmd.instance);
+        if (!target) {
+            SendError(clientId, "UNKNOWN_INSTANCE", "Instance not found");
+            return;
+        }
+        if (target->version[0]) {
+            printf("[DLL] setVersion: 既にバージョン選択済み (インスタンス %u: %s)\n", target->id, target->version);
+            return;
+        }
+        RegisterVersion(*target, cmd.target);
+        if (!g_versionSelected) {
+            snprintf(g_selectedVersion, sizeof(g_selectedVersion), "%s", target->version);
+            for (auto& instance : g_instances) {
+                if (instance->mainRAM && !instance->version[0]) {
+                    RegisterVersion(*instance, g_selectedVersion);
+                }
+            }
+            g_versionSelected = true;
+        }
+
+        // フルステート送信（MainRAM検出済みなら即時。接続中の全クライアントへ）
+        SendFullStates(ALL_CLIENTS);
+
+    } else if (strcmp(cmd.cmd, "refresh") == 0) {
+        // 現在のstatus送信
+        SendStatus(clientId);
+        // フルステート再送（バージョン選択済みのインスタンスのみ）
+        SendFullStates(clientId);
+        printf("[DLL] refresh実行\n");
+
+    } else if (strcmp(cmd.cmd, "resume") == 0) {
+        // 指定seqより後の delta を再送。ログから破棄済みならフルステート（seq はインスタンス毎）
+        EmulatorInstance* instance = FindInstance(cmd.instance);
+        if (!instance || !instance->IsTracking()) return;
+        auto it = g_sessions.find(clientId);
+        if (it == g_sessions.end() || !it->second.Watches(instance->id)) return;
+
+        // 記録済みの delta は全値分なので、購読中のクライアントには購読分の full を送る
+        WireEncoding encoding = it->second.encoding;
+        InstanceView& view = it->second.views[instance->id];
+        std::vector<const std::string*> missing;
+        if (it->second.subscribedAll && instance->deltaLog.CollectSince(cmd.seq, encoding, missing)) {
+            SendBuffer nameTable;
+            EnsureNameTableSent(clientId, it->second, *instance, nameTable);
+            for (const std::string* delta : missing) {
+                g_transport->SendShared(clientId, MakeSendBuffer(*delta, encoding), MessageClass::Delta);
+            }
+            // 再送は最新の delta までを含むので、合流待ちは不要
+            view.outbox.Clear();
+            view.sentSeq = instance->deltaLog.GetLatestSeq();
+            printf("[DLL] resume: インスタンス %u の seq %llu から %zu 件再送\n",
+                   instance->id, (unsigned long long)cmd.seq, missing.size());
+        } else {
+            SendFullState(*instance, clientId);
+            printf("[DLL] resume: インスタンス %u の seq %llu は再送不可 → full送信\n",
+                   instance->id, (unsigned long long)cmd.seq);
+        }
+
+    } else if (strcmp(cmd.cmd, "setEncoding") == 0) {
+        // 転送形式の切り替え（json / binary）
+        WireEncoding encoding;
+        if (strcmp(cmd.target, "json") == 0) {
+            encoding = WireEncoding::Json;
+        } else if (strcmp(cmd.target, "binary") == 0) {
+            encoding = WireEncoding::Binary;
+        } else {
+            SendError(clientId, "UNKNOWN_ENCODING", "Unsupported encoding");
+            return;
+        }
+
+        // 応答は切り替え前の形式で返し、次のメッセージから新しい形式になる
+        JsonWriter jw;
+        jw.BeginObject();
+        jw.StringField("type", "encoding");
+        jw.StringField("mode", cmd.target);
+        jw.EndObject();
+        SendControl(clientId, jw.GetString());
+        SwitchWireEncoding(clientId, encoding);
+        printf("[DLL] 転送形式: %s (client %u)\n", cmd.target, clientId);
+
+        // 新しい形式でフルステートを送り直す
+        SendFullStates(clientId);
+
+    } else if (strcmp(cmd.cmd, "subscribe") == 0) {
+        // 受け取る値の購読（グループ名・値の名前・"CARD*" のような前方一致。"*" か groups 省略で全値）
+        // 購読は受け取っている全インスタンスに同じように効く
+        auto it = g_sessions.find(clientId);
+        if (it == g_sessions.end()) return;
+        ClientSession& session = it->second;
+        session.subscribedAll = !cmd.hasGroups;
+        session.patterns.clear();
+        for (uint32_t i = 0; i < cmd.groupCount; i++) {
+            if (strcmp(cmd.groups[i], "*") == 0) session.subscribedAll = true;
+            session.patterns.emplace_back(cmd.groups[i]);
+        }
+        size_t subscribed = ResolveSubscription(session);
+        UpdateActiveIds();
+
+        JsonWriter jw;
+        jw.BeginObject();
+        jw.StringField("type", "subscribed");
+        jw.BoolField("all", session.subscribedAll);
+        jw.Key("groups");
+        jw.BeginArray();
+        for (const std::string& pattern : session.patterns) {
+            jw.ArrayString(pattern.c_str());
+        }
+        jw.EndArray();
+        jw.UIntField("values", (uint32_t)subscribed);
+        jw.EndObject();
+        SendControl(clientId, jw.GetString());
+        printf("[DLL] subscribe: %zu 値 (client %u, 読み取り対象 %zu)\n",
+               subscribed, clientId, PrimaryInstance().tracker.GetActiveCount());
+
+        // 購読した値でフルステートを送り直す（以降の delta は購読分のみ）
+        SendFullStates(clientId);
+
+    } else if (strcmp(cmd.cmd, "watch") == 0) {
+        // 受け取るインスタンスの指定（groups にインスタンス id の文字列。"*" か groups 省略で全インスタンス）
+        auto it = g_sessions.find(clientId);
+        if (it == g_sessions.end()) return;
+        ClientSession& session = it->second;
+        uint32_t watchMask = cmd.hasGroups ? 0 : UINT32_MAX;
+        for (uint32_t i = 0; i < cmd.groupCount; i++) {
+            if (strcmp(cmd.groups[i], "*") == 0) {
+                watchMask = UINT32_MAX;
+                continue;
+            }
+            char* end = nullptr;
+            unsigned long id = strtoul(cmd.groups[i], &end, 10);
+            if (end == cmd.groups[i] || *end != '\0' || id >= MAX_EMULATOR_INSTANCES) {
+                SendError(clientId, "UNKNOWN_INSTANCE", "Instance not found");
+                return;
+            }
+            watchMask |= 1u << id;
+        }
+        watchMask &= (1u << MAX_EMULATOR_INSTANCES) - 1;
+
+        // 新しく受け取るインスタンスは送信状態を作り直し、受け取らなくなったものは合流待ちを捨てる
+        uint32_t added = watchMask & ~session.watchMask;
+        for (uint32_t id = 0; id < MAX_EMULATOR_INSTANCES; id++) {
+            if (((session.watchMask ^ watchMask) >> id) & 1) {
+                InstanceView& view = session.views[id];
+                view.nameTableSent = false;
+                view.outbox.Clear();
+                view.sentSeq = 0;
+            }
+        }
+        session.watchMask = watchMask;
+        ResolveSubscription(session);
+        UpdateActiveIds();
+
+        JsonWriter jw;
+        jw.BeginObject();
+        jw.StringField("type", "watching");
+        jw.BoolField("all", watchMask == (1u << MAX_EMULATOR_INSTANCES) - 1);
+        jw.Key("instances");
+        jw.BeginArray();
+        for (const auto& instance : g_instances) {
+            if (session.Watches(instance->id)) jw.ArrayUInt(instance->id);
+        }
+        jw.EndArray();
+        jw.EndObject();
+        SendControl(clientId, jw.GetString());
+        printf("[DLL] watch: client %u → 0x%04x\n", clientId, watchMask);
+
+        for (auto& instance : g_instances) {
+            if ((added >> instance->id) & 1) SendFullState(*instance, clientId);
+        }
+
+    } else if (strcmp(cmd.cmd, "stats") == 0) {
+        // 処理段階毎の所要時間
+        //   target 省略: 現在の値を返す
+        //   "on":  計測を有効にする（value > 0 ならこのクライアントに value ms 毎に送る）
+        //   "off": 計測を無効にする（全クライアントの定期送信も止める）
+        //   "reset": 記録を消す
+        //   "timestamps": value が 1 なら delta にサンプリング時刻を付ける（0 で外す）
+        auto it = g_sessions.find(clientId);
+        if (it == g_sessions.end()) return;
+        if (strcmp(cmd.target, "on") == 0) {
+            g_latencyStats.SetEnabled(true);
+            it->second.statsIntervalMs = cmd.value;
+            it->second.nextStatsAt = std::chrono::steady_clock::now() + std::chrono::milliseconds(cmd.value);
+        } else if (strcmp(cmd.target, "off") == 0) {
+            g_latencyStats.SetEnabled(false);
+            for (auto& entry : g_sessions) {
+                entry.second.statsIntervalMs = 0;
+            }
+        } else if (strcmp(cmd.target, "reset") == 0) {
+            g_latencyStats.Reset();
+        } else if (strcmp(cmd.target, "timestamps") == 0) {
+            g_sampleTimestamps = (cmd.value != 0);
+        } else if (cmd.target[0] != '\0') {
+            SendError(clientId, "UNKNOWN_TARGET", "Unknown stats target");
+            return;
+        }
+        SendStats(clientId);
+        if (cmd.target[0] != '\0') {
+            printf("[DLL] stats %s (client %u, 計測%s, 時刻%s)\n", cmd.target, clientId,
+                   g_latencyStats.IsEnabled() ? "有効" : "無効", g_sampleTimestamps ? "あり" : "なし");
+        }
+
+    } else if (strcmp(cmd.cmd, "write") == 0) {
+        // 値書き込み
+        EmulatorInstance* instance = FindInstance(cmd.instance);
+        if (!instance) {
+            SendError(clientId, "UNKNOWN_INSTANCE", "Instance not found");
+            return;
+        }
+        const DeltaTracker& tracker = instance->tracker;
+        int id = tracker.FindByName(cmd.target);
+        if (id >= 0) {
+            if (WriteMemory(*instance, tracker.GetAddress(id), tracker.GetSize(id), cmd.value)) {
+                printf("[DLL] write: %s = %u (インスタンス %u)\n", cmd.target, cmd.value, instance->id);
+            } else {
+                SendError(clientId, "WRITE_FAILED", "Memory write failed");
+            }
+        } else {
+            SendError(clientId, "UNKNOWN_TARGET", "Target address not found");
+        }
+
+    } else if (strcmp(cmd.cmd, "rescan") == 0) {
+        // MainRAM再スキャン（スキャン自体はロック前に実施済み）
+        size_t added = AssignMainRAMs(scanned, scannedCount);
+        SendStatus(clientId);
+        size_t found = 0;
+        for (const auto& instance : g_instances) {
+            if (instance->mainRAM) found++;
+        }
+        printf("[DLL] rescan実行: %s (%zu インスタンス, 新規 %zu)\n",
+               PrimaryInstance().mainRAM ? "検出成功" : "未検出", found, added);
+
+    } else {
+        printf("[DLL] 不明コマンド: %s\n", cmd.cmd);
+        SendError(clientId, "UNKNOWN_CMD", "Unknown command");
+    }
+}
+
+// ========================================
+// メインループ
+// ========================================
+
+void RunMonitor(const MonitorConfig& config, const std::atomic<bool>& running) {
+    printf("[DLL] メインスレッド開始\n");
+    g_config = &config;
+    g_transport = config.transport;
+
+    // インスタンス0（rescan で最初に検出したエミュレータ）
+    {
+        std::lock_guard<std::mutex> lock(g_trackerMutex);
+        if (g_instances.empty()) AddInstance();
+    }
+
+    // 通信路のコールバック設定
+    // ※ アドレス登録は setVersion コマンド受信後に行う
+    g_transport->OnMessage = HandleCommand;
+    g_transport->OnConnect = [](uint32_t clientId) {
+        printf("[DLL] クライアント接続 (client %u) → hello送信\n", clientId);
+        std::lock_guard<std::mutex> lock(g_trackerMutex);
+        g_sessions[clientId] = ClientSession();
+        UpdateActiveIds();
+        EmulatorInstance& primary = PrimaryInstance();
+        SendControl(clientId, primary.tracker.BuildHelloJson(primary.deltaLog.GetLatestSeq(),
+            g_sharedState.IsOpen() ? g_sharedState.GetName() : nullptr, g_sharedState.GetSize()));
+
+        // 現在の状態を即時返す
+        SendStatus(clientId);
+
+        // MainRAM検出済み＋バージョン選択済みならフルステート送信（既定はインスタンス0のみ受け取る）
+        SendFullStates(clientId);
+    };
+    g_transport->OnDisconnect = [](uint32_t clientId) {
+        printf("[DLL] クライアント切断 (client %u)\n", clientId);
+        std::lock_guard<std::mutex> lock(g_trackerMutex);
+        g_sessions.erase(clientId);
+        UpdateActiveIds();
+    };
+
+    // 共有メモリ転送（作成できなくてもパイプだけで動作する）
+    {
+        std::lock_guard<std::mutex> lock(g_trackerMutex);
+        if (config.sharedMemoryName) {
+            g_sharedState.Create(config.sharedMemoryName, SHARED_STATE_VALUE_CAPACITY, SHARED_STATE_RING_CAPACITY);
+        }
+    }
+
+    // サーバー開始
+    g_transport->SetLatencyStats(&g_latencyStats);
+    g_transport->Start(config.endpoint);
+
+    // MainRAM検出はクライアントからの rescan コマンドで行う
+    // バージョン選択待機（フロントエンドからの setVersion コマンドを待つ）
+    printf("[DLL] バージョン選択待機中...\n");
+    while (running && !g_versionSelected) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    if (!running) {
+        g_transport->Stop();
+        std::lock_guard<std::mutex> lock(g_trackerMutex);
+        g_sharedState.Close();
+        return;
+    }
+    printf("[DLL] バージョン確定: %s\n", g_selectedVersion);
+
+    // ========================================
+    // メインポーリングループ (フレーム同期 / 50ms間隔)
+    // ========================================
+    if (config.beginPolling) {
+        if (FrameSource* source = config.beginPolling()) {
+            g_frameSource = source;
+        }
+    }
+    printf("[DLL] ポーリング開始 (%s)\n", g_frameSource->GetName());
+
+    // MainRAM が無効になった時の再検出スレッドと、検出の後の学習スレッド
+    std::thread rebinder(RunRebinder, std::cref(running));
+    std::thread learner;
+    if (config.learnMainRAM) learner = std::thread(RunLearner, std::cref(running));
+
+    while (running) {
+        // 通信路のクライアントも共有メモリの読み取り側もいなければ読まない
+        if (!g_transport->IsConnected() && !g_sharedState.HasReaders()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            continue;
+        }
+
+        // 次のフレームを待つ。フレーム通知が途絶えている間（一時停止・ソフトウェア描画）は
+        // タイムアウトでそのままサンプリングするため、50ms周期のポーリングと同等になる
+        g_frameSource->WaitForFrame(FRAME_WAIT_TIMEOUT_MS);
+
+        std::lock_guard<std::mutex> lock(g_trackerMutex);
+
+        // 共有メモリの読み取り側が増減したら読み取り対象を見直す
+        if (g_sharedState.HasReaders() != g_sharedReadersActive) {
+            UpdateActiveIds();
+        }
+
+        for (auto& instance : g_instances) {
+            if (!instance->IsTracking()) continue;
+
+            // MainRAM がまだ有効か（パターンの位置とヘッダのコピーを読み直す）。無効なら外して再検出
+            // 同じ MainRAM で ROM が変わっただけなら、外さずに受け取っている全クライアントへフルステートを送り直す
+            CanaryResult canary = instance->canary.Check(g_config->safeRead);
+            if (canary == CanaryResult::Lost) {
+                UnbindMainRAM(*instance);
+                continue;
+            }
+            if (canary == CanaryResult::RomChanged) {
+                printf("[DLL] インスタンス %u: ROM が変わった → フルステートを送り直す\n", instance->id);
+                SendFullState(*instance, ALL_CLIENTS);
+                continue;
+            }
+
+            // メモリ読み取り＆差分検知（今回が周期に当たる階層・購読されている値のみ）
+            SampleMemory(*instance, false);
+
+            // 差分があれば seq を付けて受け取っている全クライアントへ送信（欠落時はクライアントが resume で再取得する）
+            FlushDelta(*instance);
+        }
+
+        // 送信が詰まっていたクライアントには、空いた時点で最新値をまとめて送る
+        FlushOutboxes();
+
+        // 定期 stats メッセージ
+        SendPeriodicStats();
+    }
+
+    g_rebindSignal.notify_one();
+    rebinder.join();
+    g_learnSignal.notify_one();
+    if (learner.joinable()) learner.join();
+    if (config.endPolling) {
+        config.endPolling();
+    }
+    g_transport->Stop();
+    {
+        std::lock_guard<std::mutex> lock(g_trackerMutex);
+        g_sharedState.Close();
+    }
+    printf("[DLL] メインスレッド停止\n");
+}
@@ -0,0 +1,56 @@
+﻿#pragma once
+// monitor.h : モニター本体（コマンド処理・差分検知・送信）
+// OS 依存部分（通信路・MainRAM 検出・保護付きメモリアクセス・フレーム通知）は
+// MonitorConfig で受け取るため、Windows（DLL + Named Pipe）でも Linux（Unix ドメインソケット）でも同じコードで動く
+
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+
+class Transport;
+class FrameSource;
+
+// ========================================
+// DSメモリアドレス定義
+// ========================================
+// DS_MAIN_RAM_START は delta_tracker.h で定義
+constexpr uint32_t DS_MAIN_RAM_SIZE = 0x00400000;   // 4MB (NDS)
+constexpr uint32_t DSI_MAIN_RAM_SIZE = 0x01000000;  // 16MB (DSi)
+
+// MainRAMMaskの既知の値
+constexpr uint32_t NDS_MAIN_RAM_MASK = 0x003FFFFF;  // 4MBマスク
+constexpr uint32_t DSI_MAIN_RAM_MASK = 0x00FFFFFF;  // 16MBマスク
+
+// 同時に扱うエミュレータインスタンス数（melonDS の kMaxEmuInstances）
+constexpr uint32_t MAX_EMULATOR_INSTANCES = 16;
+
+// 検出した MainRAM（パターンの位置は検証用。分からなければ nullptr）
+struct MainRAMLocation {
+    uint8_t* mainRAM = nullptr;
+    uint32_t mask = 0;
+    const uint8_t* patternAt = nullptr;     // パターン（[MainRAM ポインタ][マスク]）の位置
+};
+
+struct MonitorConfig {
+    Transport* transport = nullptr;
+    const char* endpoint = nullptr;             // パイプ名 / ソケットのパス（TransportGroup では各通信路の分を Add で渡す）
+    const char* sharedMemoryName = nullptr;     // nullptr なら共有メモリ転送なし
+
+    // MainRAM検出（rescan コマンドと、検出済みの MainRAM が無効になった時の再検出で呼ぶ）。見つからなければ false
+    // 別スレッドから呼ぶことがあるが、同時には呼ばない
+    bool (*findMainRAM)(MainRAMLocation* out) = nullptr;
+    // 全インスタンスの MainRAM 検出（rescan "all" で呼ぶ）。見つかった数を返す（nullptr なら findMainRAM だけ使う）
+    size_t (*findAllMainRAM)(MainRAMLocation* out, size_t capacity) = nullptr;
+    // 検出の後の時間のかかる処理（ロケータの学習等）。検出の後に学習スレッドからロックを持たずに呼ぶ（その間も再検出は止めない）
+    // 何かしたら true で、false を返すまで続けて呼ぶ（nullptr なら呼ばない）
+    bool (*learnMainRAM)() = nullptr;
+    // 保護付きメモリアクセス（ゲーム側の解放等で無効になったアドレスでも落ちない）
+    bool (*safeRead)(const void* src, void* dst, size_t length) = nullptr;
+    bool (*safeWrite)(void* dst, uint32_t value, uint8_t size) = nullptr;
+    // ポーリング開始・終了時のフレーム通知の用意と後始末（nullptr なら50ms周期）
+    FrameSource* (*beginPolling)() = nullptr;
+    void (*endPolling)() = nullptr;
+};
+
+// サーバーを開始し、running が false になるまでポーリングする（呼び出し元のスレッドで実行）
+void RunMonitor(const MonitorConfig& config, const std::atomic<bool>& running);
@@ -0,0 +1,516 @@
+﻿#include "pch.h"
+// monitor_host.cpp : Linux で RunMonitor をそのまま動かすホスト（UnixSocketServer、Linux のみ）
+// 4MB の合成 MainRAM と NDS オブジェクト（[MainRAM ポインタ][マスク]）を用意し、RJ のアドレスの値を一定間隔で書き換える。
+// findMainRAM / safeRead / safeWrite は合成 MainRAM を返す・範囲を確かめて写すだけ。
+// 内部の合成クライアントが rescan → setVersion を送って delta を受け取り、ping の往復時間（コマンド処理の待ち）を測る。
+// --relocate-ms で途中で MainRAM を別の場所に移し（NDS オブジェクトの再確保の代わり）、再検出でフルステートが届くまでの時間を測る。
+// --learn-ms は検出の度に learnMainRAM がかかる時間（ロケータの学習の代わり）で、学習中でも再検出が待たされないことを見る。
+// --clients 0 なら外部のクライアント（フロントエンド等）を --socket に繋いで試すだけのホストになる。
+// --ws-port を付けると WebSocketServer も並べる（TransportGroup。ブラウザから ws://127.0.0.1:N/ で繋げる）
+// --frame-us を付けると IntervalFrameSource をその周期のフレーム源にし、一定間隔の書き換えの代わりに
+// フレーム毎に NOISE_RATE_1（Hot）を1だけ増やす。クライアントは delta の値が1ずつ進むこと（1変化につき delta 1件）を確かめる
+#include "bench_entry.h"
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+
+#ifndef _WIN32
+
+#include "monitor.h"
+#include "unix_socket_server.h"
+#include "websocket_server.h"
+#include "transport_group.h"
+#include "game_addresses.h"
+#include "mainram_canary.h"
+#include "frame_source.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+struct MonitorHostConfig {
+    uint32_t clients = 2;
+    double seconds = 3.0;
+    uint32_t mutateMs = 16;         // 値を書き換える間隔
+    uint32_t changesPerTick = 4;    // 1回に書き換える値の数
+    uint32_t pingMs = 100;          // 合成クライアントが ping を送る間隔
+    uint32_t relocateMs = 0;        // 開始から MainRAM を移すまで（0 なら移さない）
+    uint32_t learnMs = 0;           // learnMainRAM の所要時間（0 なら learnMainRAM なし）
+    const char* socketPath = nullptr;
+    const char* webSocketPort = nullptr;    // nullptr なら WebSocket なし
+    uint32_t frameUs = 0;           // フレーム源の周期（0 ならフレーム源なし。16667 で 60Hz）
+};
+
+// 合成 MainRAM と、それを指す NDS オブジェクト（melonDS の NDS::MainRAM / MainRAMMask の並び）
+struct HostNds {
+    uint8_t* mainRAM = nullptr;
+    uint32_t mask = 0;
+};
+
+static std::vector<uint8_t> g_hostRam;
+static std::vector<uint8_t> g_hostSpareRam;    // 移す先（移した後は元の MainRAM になり、読めなくなる）
+static HostNds g_hostNds;
+static std::mutex g_hostRamMutex;  // 書き換えと読み取りを重ねない（実機のエミュレータは重なるが、ここでは結果を比べるため）
+
+static bool HostContains(const void* p, size_t length) {
+    const uint8_t* begin = static_cast<const uint8_t*>(p);
+    const uint8_t* ram = g_hostRam.data();
+    const uint8_t* nds = reinterpret_cast<const uint8_t*>(&g_hostNds);
+    if (begin >= ram && length <= g_hostRam.size() && begin - ram <= (ptrdiff_t)(g_hostRam.size() - length)) return true;
+    return begin >= nds && length <= sizeof(g_hostNds) && begin - nds <= (ptrdiff_t)(sizeof(g_hostNds) - length);
+}
+
+static bool HostSafeRead(const void* src, void* dst, size_t length) {
+    std::lock_guard<std::mutex> lock(g_hostRamMutex);
+    if (!HostContains(src, length)) return false;
+    memcpy(dst, src, length);
+    return true;
+}
+
+static bool HostSafeWrite(void* dst, uint32_t value, uint8_t size) {
+    std::lock_guard<std::mutex> lock(g_hostRamMutex);
+    if (size > sizeof(value) || !HostContains(dst, size)) return false;
+    memcpy(dst, &value, size);
+    return true;
+}
+
+static std::atomic<bool> g_hostLearnPending{ false };
+static std::atomic<uint32_t> g_hostLearnMs{ 0 };
+
+static bool HostFindMainRAM(MainRAMLocation* out) {
+    std::lock_guard<std::mutex> lock(g_hostRamMutex);
+    g_hostLearnPending = true;
+    out->mainRAM = g_hostNds.mainRAM;
+    out->mask = g_hostNds.mask;
+    out->patternAt = reinterpret_cast<const uint8_t*>(&g_hostNds);
+    return true;
+}
+
+// 見つけた後の学習の代わりに待つだけ
+static bool HostLearnMainRAM() {
+    if (!g_hostLearnPending.exchange(false)) return false;
+    std::this_thread::sleep_for(std::chrono::milliseconds(g_hostLearnMs.load()));
+    return true;
+}
+
+// MainRAM を別の場所に写して NDS オブジェクトの指す先を変える（元の場所は safeRead で読めなくなる）
+static void RelocateHostRam() {
+    std::lock_guard<std::mutex> lock(g_hostRamMutex);
+    g_hostSpareRam = g_hostRam;
+    g_hostRam.swap(g_hostSpareRam);
+    g_hostNds.mainRAM = g_hostRam.data();
+}
+
+// 書き換える値（ROM ヘッダのコピーに重なるものは除く。同じ位置の別名は1つにまとめる）
+static std::vector<const GameAddress*> CollectMutableAddresses() {
+    const uint32_t headerOffset = MainRAMCanary::GetHeaderOffset(NDS_MAIN_RAM_MASK);
+    std::vector<const GameAddress*> targets;
+    for (size_t i = 0; i < RJ_ADDRESS_COUNT; i++) {
+        const GameAddress& address = RJ_ADDRESSES[i];
+        uint32_t offset = address.dsAddress & NDS_MAIN_RAM_MASK;
+        if (offset + address.size > headerOffset) continue;
+        bool overlaps = false;
+        for (const GameAddress* other : targets) {
+            uint32_t otherOffset = other->dsAddress & NDS_MAIN_RAM_MASK;
+            if (offset < otherOffset + other->size && otherOffset < offset + address.size) overlaps = true;
+        }
+        if (!overlaps) targets.push_back(&address);
+    }
+    return targets;
+}
+
+static void InitHostRam() {
+    g_hostRam.assign(DS_MAIN_RAM_SIZE, 0);
+    g_hostNds.mainRAM = g_hostRam.data();
+    g_hostNds.mask = NDS_MAIN_RAM_MASK;
+
+    // ROM ヘッダのコピー（タイトル + ゲームコード）。0 のままだとカナリアが覚えない
+    static const char header[MainRAMCanary::HEADER_BYTES + 1] = "ROCKMAN EX3 BRJE";
+    memcpy(g_hostRam.data() + MainRAMCanary::GetHeaderOffset(NDS_MAIN_RAM_MASK), header, MainRAMCanary::HEADER_BYTES);
+}
+
+// 選んだ値を1ずつ増やす（必ず変化する）。書き換えた数を返す
+static uint32_t MutateValues(const std::vector<const GameAddress*>& targets, std::mt19937& rng, uint32_t count) {
+    std::lock_guard<std::mutex> lock(g_hostRamMutex);
+    for (uint32_t i = 0; i < count; i++) {
+        const GameAddress* address = targets[rng() % targets.size()];
+        uint8_t* p = g_hostRam.data() + (address->dsAddress & NDS_MAIN_RAM_MASK);
+        uint32_t value = 0;
+        memcpy(&value, p, address->size);
+        value++;
+        memcpy(p, &value, address->size);
+    }
+    return count;
+}
+
+// フレーム毎に書き換える値（RJ の NOISE_RATE_1。Hot なので毎回サンプリングされる）
+static const char* const FRAME_VALUE_NAME = "NOISE_RATE_1";
+
+static const GameAddress* FindHostAddress(const char* name) {
+    for (size_t i = 0; i < RJ_ADDRESS_COUNT; i++) {
+        if (strcmp(RJ_ADDRESSES[i].name, name) == 0) return &RJ_ADDRESSES[i];
+    }
+    return nullptr;
+}
+
+static uint32_t ReadHostValue(const GameAddress& address) {
+    std::lock_guard<std::mutex> lock(g_hostRamMutex);
+    uint32_t value = 0;
+    memcpy(&value, g_hostRam.data() + (address.dsAddress & NDS_MAIN_RAM_MASK), address.size);
+    return value;
+}
+
+// フレームが来る度に1つの値を1だけ増やすフレーム源（エミュレータのフレームの進行の代わり）
+// ポーリングループのスレッドで WaitForFrame から戻る直前に書き換えるので、次の SampleMemory は必ず1変化だけを見る
+class MutatingFrameSource : public FrameSource {
+public:
+    MutatingFrameSource(std::chrono::microseconds period, const GameAddress* address)
+        : m_frames(period), m_address(address) {
+    }
+
+    bool WaitForFrame(uint32_t timeoutMs) override {
+        if (!m_frames.WaitForFrame(timeoutMs)) return false;
+        if (m_mutating.load()) {
+            std::lock_guard<std::mutex> lock(g_hostRamMutex);
+            uint8_t* p = g_hostRam.data() + (m_address->dsAddress & NDS_MAIN_RAM_MASK);
+            uint32_t value = 0;
+            memcpy(&value, p, m_address->size);
+            value++;
+            memcpy(p, &value, m_address->size);
+            m_mutations++;
+        }
+        return true;
+    }
+    uint64_t GetFrameCount() const override { return m_frames.GetFrameCount(); }
+    const char* GetName() const override { return "interval (毎フレーム書き換え)"; }
+
+    void SetMutating(bool mutating) { m_mutating = mutating; }
+    uint64_t GetMutations() const { return m_mutations.load(); }
+
+private:
+    IntervalFrameSource m_frames;
+    const GameAddress* m_address;
+    std::atomic<bool> m_mutating{ true };
+    std::atomic<uint64_t> m_mutations{ 0 };
+};
+
+static MutatingFrameSource* g_hostFrameSource = nullptr;
+
+static FrameSource* HostBeginPolling() {
+    return g_hostFrameSource;
+}
+
+static uint64_t HostNowNs() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct HostClient {
+    int fd = -1;
+    std::thread thread;
+    uint64_t fulls = 0;
+    uint64_t deltas = 0;
+    uint64_t values = 0;            // delta に含まれていた値の数
+    uint64_t bytes = 0;
+    uint64_t lastFullNs = 0;
+    std::vector<uint32_t> pingUs;
+
+    // --frame-us のとき: フレーム毎に書き換える値の追跡（full で基準を取り直し、delta 毎に1ずつ進むはず）
+    bool frameValueSeen = false;
+    uint32_t frameValue = 0;
+    uint64_t frameSteps = 0;        // 1だけ進んだ delta
+    uint64_t frameBadSteps = 0;     // 値が無い・1以外進んだ delta
+};
+
+static int ConnectHost(const char* path) {
+    // RunMonitor がソケットを作るまで少し待つ
+    for (int attempt = 0; attempt < 200; attempt++) {
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) return -1;
+        sockaddr_un addr = {};
+        addr.sun_family = AF_UNIX;
+        memcpy(addr.sun_path, path, strlen(path) + 1);
+        if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0) return fd;
+        close(fd);
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return -1;
+}
+
+static bool SendLine(int fd, const char* line) {
+    std::string text = std::string(line) + "\n";
+    return send(fd, text.data(), text.size(), MSG_NOSIGNAL) == (ssize_t)text.size();
+}
+
+// 行の中の "NAME":{"v":"HEX" を読む
+static bool FindLineValue(const char* line, const char* name, uint32_t* value) {
+    char key[64];
+    snprintf(key, sizeof(key), "\"%s\":{\"v\":\"", name);
+    const char* p = strstr(line, key);
+    if (!p) return false;
+    *value = (uint32_t)strtoul(p + strlen(key), nullptr, 16);
+    return true;
+}
+
+static size_t CountOccurrences(const char* text, const char* needle) {
+    size_t count = 0;
+    for (const char* p = strstr(text, needle); p; p = strstr(p + 1, needle)) count++;
+    return count;
+}
+
+// rescan → setVersion を送り（フロントエンドと同じ順。setVersion の応答でフルステートが届く）、
+// 以降は受け取った行を数えながら pingMs 毎に ping を送る
+// pong は送った順に返るので、送信時刻の列の先頭と組にする
+// frameValue があれば、その値が full で基準を取り直した後は delta 毎にちょうど1ずつ進むかを数える
+static void HostClientLoop(HostClient& client, const std::atomic<bool>& stop, uint32_t pingMs, const GameAddress* frameValue) {
+    const uint32_t frameValueMask = frameValue ? (uint32_t)((1ULL << (frameValue->size * 8)) - 1) : 0;
+    SendLine(client.fd, "{\"cmd\":\"rescan\"}");
+    SendLine(client.fd, "{\"cmd\":\"setVersion\",\"target\":\"RJ\"}");
+
+    std::string pending;
+    std::vector<uint64_t> pingSentNs;
+    size_t pongs = 0;
+    uint64_t nextPingNs = HostNowNs() + pingMs * 1000000ULL;
+    char buf[8192];
+    while (!stop.load()) {
+        if (pingMs && HostNowNs() >= nextPingNs) {
+            pingSentNs.push_back(HostNowNs());
+            SendLine(client.fd, "{\"cmd\":\"ping\"}");
+            nextPingNs += pingMs * 1000000ULL;
+        }
+        pollfd pfd = { client.fd, POLLIN, 0 };
+        if (poll(&pfd, 1, 5) <= 0) continue;
+        ssize_t n = read(client.fd, buf, sizeof(buf));
+        if (n <= 0) break;
+        uint64_t now = HostNowNs();
+        client.bytes += (uint64_t)n;
+        pending.append(buf, (size_t)n);
+        size_t start = 0;
+        for (size_t nl = pending.find('\n'); nl != std::string::npos; nl = pending.find('\n', start)) {
+            pending[nl] = '\0';
+            const char* line = pending.c_str() + start;
+            if (strstr(line, "\"type\":\"delta\"")) {
+                client.deltas++;
+                client.values += CountOccurrences(line, "\"v\":");
+                uint32_t value = 0;
+                if (frameValue && client.frameValueSeen) {
+                    if (FindLineValue(line, frameValue->name, &value) && value == ((client.frameValue + 1) & frameValueMask)) {
+                        client.frameSteps++;
+                    } else {
+                        client.frameBadSteps++;
+                    }
+                    client.frameValue = value;
+                }
+            } else if (strstr(line, "\"type\":\"full\"")) {
+                client.fulls++;
+                client.lastFullNs = now;
+                if (frameValue) client.frameValueSeen = FindLineValue(line, frameValue->name, &client.frameValue);
+            } else if (strstr(line, "\"type\":\"pong\"") && pongs < pingSentNs.size()) {
+                client.pingUs.push_back((uint32_t)((now - pingSentNs[pongs++]) / 1000));
+            }
+            start = nl + 1;
+        }
+        pending.erase(0, start);
+    }
+}
+
+static uint32_t HostPercentile(std::vector<uint32_t>& values, double p) {
+    if (values.empty()) return 0;
+    size_t k = (size_t)(p * (values.size() - 1));
+    std::nth_element(values.begin(), values.begin() + k, values.end());
+    return values[k];
+}
+
+static int RunMonitorHost(const MonitorHostConfig& config) {
+    char defaultPath[108];
+    snprintf(defaultPath, sizeof(defaultPath), "/tmp/monitor_host_%d.sock", (int)getpid());
+    const char* path = config.socketPath ? config.socketPath : defaultPath;
+
+    InitHostRam();
+    std::vector<const GameAddress*> targets = CollectMutableAddresses();
+
+    static UnixSocketServer server;
+    static WebSocketServer webSocketServer;
+    static TransportGroup transports;
+    static MonitorConfig monitorConfig;
+    monitorConfig.transport = &server;
+    monitorConfig.endpoint = path;
+    if (config.webSocketPort) {
+        transports.Add(&server, path);
+        transports.Add(&webSocketServer, config.webSocketPort);
+        monitorConfig.transport = &transports;
+    }
+    monitorConfig.findMainRAM = HostFindMainRAM;
+    monitorConfig.safeRead = HostSafeRead;
+    monitorConfig.safeWrite = HostSafeWrite;
+    g_hostLearnMs = config.learnMs;
+    if (config.learnMs) monitorConfig.learnMainRAM = HostLearnMainRAM;
+    const GameAddress* frameValue = nullptr;
+    if (config.frameUs) {
+        frameValue = FindHostAddress(FRAME_VALUE_NAME);
+        static MutatingFrameSource frameSource(std::chrono::microseconds(config.frameUs), frameValue);
+        g_hostFrameSource = &frameSource;
+        monitorConfig.beginPolling = HostBeginPolling;
+    }
+
+    std::atomic<bool> running{ true };
+    std::thread monitor([&]() { RunMonitor(monitorConfig, running); });
+
+    std::vector<HostClient> clients(config.clients);
+    std::atomic<bool> stop{ false };
+    bool connected = true;
+    for (HostClient& client : clients) {
+        client.fd = ConnectHost(path);
+        if (client.fd < 0) {
+            fprintf(stderr, "接続できません: %s\n", path);
+            connected = false;
+            break;
+        }
+        client.thread = std::thread(HostClientLoop, std::ref(client), std::cref(stop), config.pingMs, frameValue);
+    }
+
+    // 一定間隔で値を書き換える（このスレッドが書き換え役。--frame-us のときはフレーム源が書き換えるので移すだけ）
+    std::mt19937 rng(1234);
+    uint64_t mutations = 0;
+    uint64_t relocatedNs = 0;
+    const auto interval = std::chrono::milliseconds((std::max)(config.mutateMs, 1u));
+    auto begin = std::chrono::steady_clock::now();
+    auto end = begin + std::chrono::microseconds((int64_t)(config.seconds * 1000000));
+    for (uint64_t tick = 1; connected && std::chrono::steady_clock::now() < end; tick++) {
+        std::this_thread::sleep_until(begin + interval * tick);
+        if (!frameValue) mutations += MutateValues(targets, rng, config.changesPerTick);
+        if (config.relocateMs && !relocatedNs && std::chrono::steady_clock::now() - begin >= std::chrono::milliseconds(config.relocateMs)) {
+            RelocateHostRam();
+            relocatedNs = HostNowNs();
+        }
+    }
+    // 最後の書き換えがサンプリングされて届くまで待つ
+    if (g_hostFrameSource) g_hostFrameSource->SetMutating(false);
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    stop = true;
+    for (HostClient& client : clients) {
+        if (client.thread.joinable()) client.thread.join();
+        if (client.fd >= 0) close(client.fd);
+    }
+    running = false;
+    monitor.join();
+    if (!connected) return 1;
+
+    if (frameValue) {
+        mutations = g_hostFrameSource->GetMutations();
+        printf("\n合成 MainRAM %u KB, フレーム %uus 毎に %s を1ずつ × %.1f 秒 = %llu フレーム / %llu 回書き換え (%.1f 回/秒)\n",
+            DS_MAIN_RAM_SIZE / 1024, config.frameUs, frameValue->name, config.seconds,
+            (unsigned long long)g_hostFrameSource->GetFrameCount(), (unsigned long long)mutations, mutations / config.seconds);
+    } else {
+        printf("\n合成 MainRAM %u KB, 書き換え対象 %zu 値, %ums 毎に %u 値 × %.1f 秒 = %llu 回書き換え\n",
+            DS_MAIN_RAM_SIZE / 1024, targets.size(), config.mutateMs, config.changesPerTick, config.seconds,
+            (unsigned long long)mutations);
+    }
+    printf("%4s %6s %8s %8s %10s %10s %10s %10s\n", "No", "full", "delta", "値", "受信 KB", "ping p50", "ping p99", "ping max");
+    bool ok = true;
+    for (size_t i = 0; i < clients.size(); i++) {
+        HostClient& client = clients[i];
+        uint32_t p50 = HostPercentile(client.pingUs, 0.5);
+        uint32_t p99 = HostPercentile(client.pingUs, 0.99);
+        uint32_t maxUs = client.pingUs.empty() ? 0 : *std::max_element(client.pingUs.begin(), client.pingUs.end());
+        printf("%4zu %6llu %8llu %8llu %10.1f %8u us %8u us %8u us\n", i + 1, (unsigned long long)client.fulls,
+            (unsigned long long)client.deltas, (unsigned long long)client.values, client.bytes / 1024.0, p50, p99, maxUs);
+        if (client.fulls == 0 || (mutations > 0 && client.deltas == 0)) ok = false;
+    }
+    if (relocatedNs) {
+        // 移した後のフルステートは再検出で送り直されたもの
+        printf("MainRAM を %ums で移した（learnMainRAM %ums）→ 再検出のフルステートまで:", config.relocateMs, config.learnMs);
+        for (const HostClient& client : clients) {
+            if (client.lastFullNs > relocatedNs) {
+                printf(" %.1fms", (client.lastFullNs - relocatedNs) / 1e6);
+            } else {
+                printf(" 届かない");
+                ok = false;
+            }
+        }
+        printf("\n");
+    }
+    if (!ok) {
+        fprintf(stderr, "フルステート・delta・再検出のフルステートを受け取れなかったクライアントがある\n");
+        return 1;
+    }
+    if (frameValue) {
+        // 1変化につき delta 1件: どの delta も1だけ進み、最後に受け取った値が書き換え後の値と一致する
+        uint32_t finalValue = ReadHostValue(*frameValue);
+        printf("%s: 最終値 0x%X\n", frameValue->name, finalValue);
+        printf("%4s %10s %10s %10s\n", "No", "1変化", "それ以外", "最後の値");
+        for (size_t i = 0; i < clients.size(); i++) {
+            const HostClient& client = clients[i];
+            printf("%4zu %10llu %10llu %10X\n", i + 1, (unsigned long long)client.frameSteps,
+                (unsigned long long)client.frameBadSteps, client.frameValue);
+            if (!client.frameValueSeen || client.frameBadSteps || client.frameSteps == 0 || client.frameValue != finalValue) {
+                ok = false;
+            }
+        }
+        if (!ok) {
+            fprintf(stderr, "フレーム毎の書き換えと delta が1対1になっていないクライアントがある\n");
+            return 1;
+        }
+    }
+    return 0;
+}
+
+#endif // !_WIN32
+
+// ========================================
+// 計測プログラムの入口（Linux は MONITOR_HOST_MAIN を定義して単体でビルド。Windows の Bench プロジェクトの "monitor" は未対応と表示するだけ）
+//   g++ -std=c++17 -O2 -DMONITOR_HOST_MAIN monitor_host.cpp monitor.cpp delta_tracker.cpp delta_log.cpp delta_outbox.cpp
+//       block_diff.cpp name_index.cpp game_addresses.cpp shared_state.cpp mainram_canary.cpp frame_source.cpp
+//       unix_socket_server.cpp websocket_server.cpp websocket.cpp transport_group.cpp send_queue.cpp line_framer.cpp
+//       latency_stats.cpp -lpthread -lrt -o monitor_host
+//   ./monitor_host [--clients N] [--seconds F] [--mutate-ms N] [--changes N] [--ping-ms N]
+//                  [--relocate-ms N] [--learn-ms N] [--socket PATH] [--ws-port N] [--frame-us N]
+// ========================================
+int MonitorHostMain(int argc, char** argv) {
+#ifdef _WIN32
+    (void)argc;
+    (void)argv;
+    fprintf(stderr, "monitor は Linux（UnixSocketServer）のみ対応\n");
+    return 1;
+#else
+    MonitorHostConfig config;
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = (i + 1 < argc) ? argv[i + 1] : "0";
+        if (strcmp(arg, "--clients") == 0) { config.clients = (uint32_t)strtoul(value, nullptr, 10); i++; }
+        else if (strcmp(arg, "--seconds") == 0) { config.seconds = atof(value); i++; }
+        else if (strcmp(arg, "--mutate-ms") == 0) { config.mutateMs = (uint32_t)strtoul(value, nullptr, 10); i++; }
+        else if (strcmp(arg, "--changes") == 0) { config.changesPerTick = (uint32_t)strtoul(value, nullptr, 10); i++; }
+        else if (strcmp(arg, "--ping-ms") == 0) { config.pingMs = (uint32_t)strtoul(value, nullptr, 10); i++; }
+        else if (strcmp(arg, "--relocate-ms") == 0) { config.relocateMs = (uint32_t)strtoul(value, nullptr, 10); i++; }
+        else if (strcmp(arg, "--learn-ms") == 0) { config.learnMs = (uint32_t)strtoul(value, nullptr, 10); i++; }
+        else if (strcmp(arg, "--socket") == 0) { config.socketPath = value; i++; }
+        else if (strcmp(arg, "--ws-port") == 0) { config.webSocketPort = value; i++; }
+        else if (strcmp(arg, "--frame-us") == 0) { config.frameUs = (uint32_t)strtoul(value, nullptr, 10); i++; }
+        else {
+            fprintf(stderr, "不明な引数: %s\n", arg);
+            return 2;
+        }
+    }
+    if (config.clients > Transport::MAX_CLIENTS) {
+        fprintf(stderr, "--clients は 0〜%zu\n", Transport::MAX_CLIENTS);
+        return 2;
+    }
+    return RunMonitorHost(config);
+#endif
+}
+
+#ifdef MONITOR_HOST_MAIN
+int main(int argc, char** argv) {
+    return MonitorHostMain(argc, argv);
+}
+#endif
@@ -0,0 +1,98 @@
+﻿#include "pch.h"
+// name_bench.cpp : 名前 → 値 id の検索の計測（RJ 版のアドレス表）
+// 旧方式（登録順に strcmp で線形探索）と NameIndex（オープンアドレス法のハッシュ表）を比べる
+#include "bench_entry.h"
+#include "name_index.h"
+#include "game_addresses.h"
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+// 旧 DeltaTracker::FindByName と同じ線形探索
+static int FindByNameLinear(const std::vector<const char*>& names, const char* name) {
+    for (size_t i = 0; i < names.size(); i++) {
+        if (strcmp(names[i], name) == 0) return (int)i;
+    }
+    return -1;
+}
+
+// ========================================
+// 計測プログラムの入口（Windows は Bench プロジェクトの "names"、Linux は NAME_BENCH_MAIN を定義して単体でビルド）
+//   g++ -std=c++17 -O2 -DNAME_BENCH_MAIN name_bench.cpp name_index.cpp game_addresses.cpp -o name_bench
+//   ./name_bench [--lookups N] [--seed N]
+// ========================================
+int NameBenchMain(int argc, char** argv) {
+    uint32_t lookups = 2000000;
+    uint64_t seed = 1;
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = (i + 1 < argc) ? argv[i + 1] : "0";
+        if (strcmp(arg, "--lookups") == 0) { lookups = (uint32_t)strtoul(value, nullptr, 10); i++; }
+        else if (strcmp(arg, "--seed") == 0) { seed = strtoull(value, nullptr, 10); i++; }
+        else {
+            fprintf(stderr, "不明な引数: %s\n", arg);
+            return 2;
+        }
+    }
+    if (lookups == 0) return 2;
+
+    // 登録（重複名は先に登録した方が優先。線形探索も先頭から見るので結果は同じになる）
+    std::vector<const char*> names;
+    NameIndex index;
+    for (size_t i = 0; i < RJ_ADDRESS_COUNT; i++) {
+        names.push_back(RJ_ADDRESSES[i].name);
+        index.Insert(RJ_ADDRESSES[i].name, (uint32_t)i);
+    }
+
+    // 問い合わせ列: 登録済みの名前を一様に選び、1割は存在しない名前（write の打ち間違い等）
+    std::vector<std::string> missNames;
+    for (const char* name : names) missNames.push_back(std::string(name) + "_X");
+    std::mt19937_64 rng(seed);
+    std::vector<const char*> queries(lookups);
+    for (auto& q : queries) {
+        size_t k = (size_t)(rng() % names.size());
+        q = (rng() % 10 == 0) ? missNames[k].c_str() : names[k];
+    }
+
+    // 両方式の結果が一致するか
+    size_t mismatches = 0;
+    for (size_t i = 0; i < queries.size() && i < 10000; i++) {
+        if (FindByNameLinear(names, queries[i]) != index.Find(queries[i])) mismatches++;
+    }
+
+    struct Row {
+        const char* name;
+        double ns;
+        long long checksum;
+    };
+    std::vector<Row> rows;
+    for (int method = 0; method < 2; method++) {
+        long long checksum = 0;
+        auto start = std::chrono::steady_clock::now();
+        if (method == 0) {
+            for (const char* q : queries) checksum += FindByNameLinear(names, q);
+        } else {
+            for (const char* q : queries) checksum += index.Find(q);
+        }
+        double ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        rows.push_back({ method == 0 ? "線形探索" : "NameIndex", ns / lookups, checksum });
+    }
+
+    printf("RJ 表 %zu 名, 検索 %u 回（1割は存在しない名前）, 不一致 %zu, seed %llu\n",
+        names.size(), lookups, mismatches, (unsigned long long)seed);
+    printf("%-12s %10s %14s\n", "方式", "ns/検索", "checksum");
+    for (const Row& row : rows) {
+        printf("%-12s %10.1f %14lld\n", row.name, row.ns, row.checksum);
+    }
+    return mismatches == 0 ? 0 : 1;
+}
+
+#ifdef NAME_BENCH_MAIN
+int main(int argc, char** argv) {
+    return NameBenchMain(argc, argv);
+}
+#endif
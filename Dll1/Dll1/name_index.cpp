@@ -0,0 +1,74 @@
+﻿#include "pch.h"
+#include "name_index.h"
+#include <cstring>
+
+// 初期スロット数（2の累乗）。アドレステーブル1本分なら再ハッシュ不要
+static constexpr size_t NAME_INDEX_INITIAL_SLOTS = 256;
+
+// FNV-1a
+uint32_t NameIndex::Hash(const char* name, size_t length) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        h ^= (uint8_t)name[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+void NameIndex::Clear() {
+    m_slots.clear();
+    m_count = 0;
+}
+
+void NameIndex::Grow() {
+    std::vector<Slot> old;
+    old.swap(m_slots);
+    m_slots.assign(old.empty() ? NAME_INDEX_INITIAL_SLOTS : old.size() * 2, Slot{});
+
+    const size_t mask = m_slots.size() - 1;
+    for (const auto& slot : old) {
+        if (!slot.name) continue;
+        size_t i = slot.hash & mask;
+        while (m_slots[i].name) i = (i + 1) & mask;
+        m_slots[i] = slot;
+    }
+}
+
+void NameIndex::Insert(const char* name, uint32_t id) {
+    // 負荷率 1/2 を超えないよう拡張
+    if ((m_count + 1) * 2 > m_slots.size()) Grow();
+
+    const size_t length = strlen(name);
+    const uint32_t hash = Hash(name, length);
+    const size_t mask = m_slots.size() - 1;
+
+    size_t i = hash & mask;
+    while (m_slots[i].name) {
+        const Slot& slot = m_slots[i];
+        if (slot.hash == hash && slot.length == length && memcmp(slot.name, name, length) == 0) {
+            return;
+        }
+        i = (i + 1) & mask;
+    }
+    m_slots[i] = Slot{ name, hash, (uint32_t)length, id };
+    m_count++;
+}
+
+int NameIndex::Find(const char* name) const {
+    return Find(name, strlen(name));
+}
+
+int NameIndex::Find(const char* name, size_t length) const {
+    if (m_slots.empty()) return -1;
+
+    const uint32_t hash = Hash(name, length);
+    const size_t mask = m_slots.size() - 1;
+
+    for (size_t i = hash & mask; m_slots[i].name; i = (i + 1) & mask) {
+        const Slot& slot = m_slots[i];
+        if (slot.hash == hash && slot.length == length && memcmp(slot.name, name, length) == 0) {
+            return (int)slot.id;
+        }
+    }
+    return -1;
+}
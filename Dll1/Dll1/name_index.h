@@ -0,0 +1,33 @@
+﻿#pragma once
+// name_index.h : アドレス識別名 → 値 id のハッシュ表（オープンアドレス法・線形探査）
+// 名前文字列は登録元（静的アドレステーブル）のものをそのまま参照する
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+class NameIndex {
+public:
+    // name を id として追加。同名が登録済みなら何もしない（先に登録した方が優先）
+    void Insert(const char* name, uint32_t id);
+
+    // 見つからなければ -1
+    int Find(const char* name) const;
+    int Find(const char* name, size_t length) const;
+
+    void Clear();
+
+private:
+    struct Slot {
+        const char* name;   // nullptr = 空き
+        uint32_t hash;
+        uint32_t length;
+        uint32_t id;
+    };
+
+    static uint32_t Hash(const char* name, size_t length);
+    void Grow();
+
+    std::vector<Slot> m_slots;
+    size_t m_count = 0;
+};
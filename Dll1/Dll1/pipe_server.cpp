@@ -1,6 +1,11 @@
 ﻿#include "pch.h"
 #include "pipe_server.h"
+#include "line_framer.h"
 #include <cstdio>
+#include <algorithm>
+
+// パイプインスタンス数の上限（接続中 + 接続待ち）
+static constexpr DWORD MAX_PIPE_INSTANCES = (DWORD)(PipeServer::MAX_CLIENTS + PipeServer::PENDING_INSTANCES);
 
 PipeServer::~PipeServer() {
     Stop();
@@ -11,155 +16,255 @@ bool PipeServer::Start(const char* pipeName) {
 
     m_pipeName = pipeName;
     m_running = true;
-    m_writeEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
-    m_serverThread = std::thread(&PipeServer::ServerThread, this);
+    m_acceptThread = std::thread(&PipeServer::AcceptThread, this);
 
-    printf("[PipeServer] 開始: %s\n", pipeName);
+    printf("[PipeServer] 開始: %s (最大%zuクライアント)\n", pipeName, MAX_CLIENTS);
     return true;
 }
 
 void PipeServer::Stop() {
-    m_running = false;
-
-    // パイプハンドルを閉じてブロック中の操作を解除
-    if (m_hPipe != INVALID_HANDLE_VALUE) {
-        CancelIoEx(m_hPipe, NULL);
-        DisconnectNamedPipe(m_hPipe);
-        CloseHandle(m_hPipe);
-        m_hPipe = INVALID_HANDLE_VALUE;
+    if (!m_running.exchange(false)) return;
+
+    // 全クライアントのブロック中の操作を解除（各クライアントスレッドが後始末する）
+    {
+        std::lock_guard<std::mutex> lock(m_clientsMutex);
+        for (auto& client : m_clients) {
+            client->connected = false;
+            client->queue.Stop(false);
+            CancelIoEx(client->pipe, NULL);
+        }
     }
 
-    if (m_serverThread.joinable()) {
-        m_serverThread.detach();
-    }
-    if (m_readThread.joinable()) {
-        m_readThread.detach();
-    }
-    if (m_writeEvent) {
-        CloseHandle(m_writeEvent);
-        m_writeEvent = NULL;
+    if (m_acceptThread.joinable()) {
+        m_acceptThread.detach();
     }
 
-    m_connected = false;
     printf("[PipeServer] 停止\n");
 }
 
-bool PipeServer::Send(const std::string& json) {
-    if (!m_connected.load() || m_hPipe == INVALID_HANDLE_VALUE) return false;
+bool PipeServer::SendShared(uint32_t clientId, const SendBuffer& buffer, MessageClass cls) {
+    std::shared_ptr<Client> client = FindClient(clientId);
+    if (!client || !client->connected.load()) return false;
+    return client->queue.Push(buffer, cls);
+}
 
-    // LF区切りメッセージ
-    std::string msg = json + "\n";
+bool PipeServer::GetSendQueueStats(uint32_t clientId, SendQueueStats& out) const {
+    std::shared_ptr<Client> client = FindClient(clientId);
+    if (!client) return false;
+    out = client->queue.GetStats();
+    return true;
+}
 
-    std::lock_guard<std::mutex> lock(m_writeMutex);
+bool PipeServer::IsSendBusy(uint32_t clientId) const {
+    std::shared_ptr<Client> client = FindClient(clientId);
+    return client && client->queue.IsBusy();
+}
+
+std::shared_ptr<PipeServer::Client> PipeServer::FindClient(uint32_t clientId) const {
+    std::lock_guard<std::mutex> lock(m_clientsMutex);
+    for (const auto& client : m_clients) {
+        if (client->id == clientId) return client;
+    }
+    return nullptr;
+}
 
+bool PipeServer::WriteBlocking(Client& client, const char* data, size_t size) {
     OVERLAPPED ol = {};
-    ol.hEvent = m_writeEvent;
-    ResetEvent(m_writeEvent);
+    ol.hEvent = client.writeEvent;
+    ResetEvent(client.writeEvent);
 
-    BOOL ok = WriteFile(m_hPipe, msg.c_str(), (DWORD)msg.size(), NULL, &ol);
+    BOOL ok = WriteFile(client.pipe, data, (DWORD)size, NULL, &ol);
     if (!ok && GetLastError() != ERROR_IO_PENDING) {
-        printf("[PipeServer] Send失敗: %lu\n", GetLastError());
+        printf("[PipeServer] Send失敗 (id=%u): %lu\n", client.id, GetLastError());
         return false;
     }
 
+    // 書き込み待ち（500ms毎に停止チェック）
+    while (WaitForSingleObject(client.writeEvent, 500) != WAIT_OBJECT_0) {
+        if (!m_running.load() || !client.connected.load()) {
+            DWORD ignored = 0;
+            CancelIoEx(client.pipe, &ol);
+            GetOverlappedResult(client.pipe, &ol, &ignored, TRUE);
+            return false;
+        }
+    }
+
     DWORD written = 0;
-    if (!GetOverlappedResult(m_hPipe, &ol, &written, TRUE)) {
-        printf("[PipeServer] Send完了失敗: %lu\n", GetLastError());
+    if (!GetOverlappedResult(client.pipe, &ol, &written, FALSE) || written != size) {
+        printf("[PipeServer] Send完了失敗 (id=%u): %lu\n", client.id, GetLastError());
+        return false;
+    }
+
+    return true;
+}
+
+bool PipeServer::CreatePendingInstance(PendingInstance& pending) {
+    pending.pipe = CreateNamedPipeA(
+        m_pipeName.c_str(),
+        PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED,
+        PIPE_TYPE_BYTE | PIPE_READMODE_BYTE,
+        MAX_PIPE_INSTANCES,
+        8192,   // out buffer
+        4096,   // in buffer
+        0, NULL
+    );
+
+    if (pending.pipe == INVALID_HANDLE_VALUE) {
+        printf("[PipeServer] CreateNamedPipe失敗: %lu\n", GetLastError());
         return false;
     }
 
+    // Overlapped接続待ち
+    pending.ol = {};
+    pending.alreadyConnected = false;
+    pending.ol.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    ConnectNamedPipe(pending.pipe, &pending.ol);
+    DWORD lastErr = GetLastError();
+
+    if (lastErr == ERROR_PIPE_CONNECTED) {
+        // ConnectNamedPipe 前にクライアントが接続済み。待機ループで即座に拾わせる
+        pending.alreadyConnected = true;
+        SetEvent(pending.ol.hEvent);
+    } else if (lastErr != ERROR_IO_PENDING) {
+        printf("[PipeServer] ConnectNamedPipe失敗: %lu\n", lastErr);
+        ClosePendingInstance(pending);
+        return false;
+    }
     return true;
 }
 
-void PipeServer::ServerThread() {
-    printf("[PipeServer] サーバースレッド開始\n");
+void PipeServer::ClosePendingInstance(PendingInstance& pending) {
+    if (pending.pipe != INVALID_HANDLE_VALUE) {
+        CancelIoEx(pending.pipe, &pending.ol);
+        CloseHandle(pending.pipe);
+        pending.pipe = INVALID_HANDLE_VALUE;
+    }
+    if (pending.ol.hEvent) {
+        CloseHandle(pending.ol.hEvent);
+        pending.ol.hEvent = NULL;
+    }
+}
+
+void PipeServer::AcceptThread() {
+    printf("[PipeServer] 接続受付スレッド開始\n");
+
+    PendingInstance pending[PENDING_INSTANCES];
 
     while (m_running.load()) {
-        // パイプ作成
-        m_hPipe = CreateNamedPipeA(
-            m_pipeName.c_str(),
-            PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED,
-            PIPE_TYPE_BYTE | PIPE_READMODE_BYTE,
-            1,      // max instances
-            8192,   // out buffer
-            4096,   // in buffer
-            0, NULL
-        );
-
-        if (m_hPipe == INVALID_HANDLE_VALUE) {
-            printf("[PipeServer] CreateNamedPipe失敗: %lu\n", GetLastError());
-            Sleep(1000);
-            continue;
+        // 空いている枠に接続待ちインスタンスを補充
+        bool createFailed = false;
+        HANDLE events[PENDING_INSTANCES];
+        size_t slots[PENDING_INSTANCES];
+        DWORD eventCount = 0;
+        for (size_t i = 0; i < PENDING_INSTANCES; i++) {
+            if (pending[i].pipe == INVALID_HANDLE_VALUE && m_clientCount.load() < MAX_CLIENTS) {
+                if (!CreatePendingInstance(pending[i])) createFailed = true;
+            }
+            if (pending[i].pipe != INVALID_HANDLE_VALUE) {
+                events[eventCount] = pending[i].ol.hEvent;
+                slots[eventCount] = i;
+                eventCount++;
+            }
         }
 
-        printf("[PipeServer] クライアント接続待機中...\n");
-
-        // Overlapped接続待ち
-        OVERLAPPED olConnect = {};
-        olConnect.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
-        ConnectNamedPipe(m_hPipe, &olConnect);
-        DWORD lastErr = GetLastError();
-
-        bool connected = false;
-        if (lastErr == ERROR_PIPE_CONNECTED) {
-            connected = true;
-        } else if (lastErr == ERROR_IO_PENDING) {
-            while (m_running.load()) {
-                DWORD waitResult = WaitForSingleObject(olConnect.hEvent, 500);
-                if (waitResult == WAIT_OBJECT_0) {
-                    connected = true;
-                    break;
-                }
-            }
+        if (eventCount == 0) {
+            Sleep(createFailed ? 1000 : 500);
+            continue;
         }
-        CloseHandle(olConnect.hEvent);
 
+        // いずれかの接続を待つ（500ms毎に停止チェック）
+        DWORD waitResult = WaitForMultipleObjects(eventCount, events, FALSE, 500);
+        if (waitResult < WAIT_OBJECT_0 || waitResult >= WAIT_OBJECT_0 + eventCount) continue;
+
+        PendingInstance& ready = pending[slots[waitResult - WAIT_OBJECT_0]];
+        DWORD ignored = 0;
+        bool connected = ready.alreadyConnected ||
+                         GetOverlappedResult(ready.pipe, &ready.ol, &ignored, FALSE);
         if (!connected) {
-            CloseHandle(m_hPipe);
-            m_hPipe = INVALID_HANDLE_VALUE;
+            ClosePendingInstance(ready);
             continue;
         }
 
-        m_connected = true;
-        printf("[PipeServer] クライアント接続!\n");
+        // パイプハンドルはクライアントに引き渡し、枠は次のループで補充する
+        HANDLE pipe = ready.pipe;
+        ready.pipe = INVALID_HANDLE_VALUE;
+        ClosePendingInstance(ready);
+        AttachClient(pipe);
+    }
 
-        if (OnConnect) OnConnect();
+    for (auto& p : pending) {
+        ClosePendingInstance(p);
+    }
+    printf("[PipeServer] 接続受付スレッド停止\n");
+}
 
-        // 読み取りスレッド開始
-        m_readThread = std::thread(&PipeServer::ReadThread, this);
+void PipeServer::AttachClient(HANDLE pipe) {
+    auto client = std::make_shared<Client>();
+    client->id = m_nextClientId++;
+    client->pipe = pipe;
+    client->writeEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    client->queue.SetPolicy(m_overflowPolicy);
+    client->queue.SetLatencyStats(m_latencyStats);
+
+    {
+        std::lock_guard<std::mutex> lock(m_clientsMutex);
+        m_clients.push_back(client);
+    }
+    m_clientCount++;
 
-        // 読み取りスレッド終了まで待機（接続中はここでブロック）
-        if (m_readThread.joinable()) {
-            m_readThread.join();
-        }
+    // クライアントスレッドが切断まで面倒を見る
+    std::thread(&PipeServer::ClientThread, this, client).detach();
+}
 
-        // クライアント切断
-        m_connected = false;
-        printf("[PipeServer] クライアント切断\n");
-        if (OnDisconnect) OnDisconnect();
+void PipeServer::ClientThread(std::shared_ptr<Client> client) {
+    Client* c = client.get();
 
-        DisconnectNamedPipe(m_hPipe);
-        CloseHandle(m_hPipe);
-        m_hPipe = INVALID_HANDLE_VALUE;
-    }
+    // 書き込みスレッド開始。書き込み失敗・キュー溢れでは保留中のI/Oを取り消して切断する
+    c->queue.Start(
+        [this, c](const SendPayload& payload) { return WriteBlocking(*c, payload.bytes.data(), payload.bytes.size()); },
+        [c]() {
+            c->connected = false;
+            CancelIoEx(c->pipe, NULL);
+        });
 
-    printf("[PipeServer] サーバースレッド停止\n");
-}
+    c->connected = true;
+    printf("[PipeServer] クライアント接続! (id=%u, 接続数=%zu)\n", c->id, m_clientCount.load());
+
+    if (OnConnect) OnConnect(c->id);
+
+    // 切断までここでブロック
+    ReadLoop(*c);
 
-void PipeServer::ReadThread() {
-    printf("[PipeServer] 読み取りスレッド開始\n");
+    // クライアント切断（未送信分は破棄）
+    c->connected = false;
+    c->queue.Stop();
+    {
+        std::lock_guard<std::mutex> lock(m_clientsMutex);
+        m_clients.erase(std::remove(m_clients.begin(), m_clients.end(), client), m_clients.end());
+    }
+    m_clientCount--;
+    printf("[PipeServer] クライアント切断 (id=%u, 接続数=%zu)\n", c->id, m_clientCount.load());
+    if (OnDisconnect) OnDisconnect(c->id);
+
+    DisconnectNamedPipe(c->pipe);
+    CloseHandle(c->pipe);
+    CloseHandle(c->writeEvent);
+    c->pipe = INVALID_HANDLE_VALUE;
+    c->writeEvent = NULL;
+}
 
-    char buffer[4096];
-    std::string lineBuffer;
+void PipeServer::ReadLoop(Client& client) {
+    // 受信バッファに直接読み込み、行はバッファ上のまま OnMessage に渡す
+    LineFramer framer(MAX_MESSAGE_SIZE);
     HANDLE readEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
 
-    while (m_running.load() && m_connected.load()) {
+    while (m_running.load() && client.connected.load()) {
         OVERLAPPED ol = {};
         ol.hEvent = readEvent;
         ResetEvent(readEvent);
 
         DWORD bytesRead = 0;
-        BOOL ok = ReadFile(m_hPipe, buffer, sizeof(buffer) - 1, &bytesRead, &ol);
+        BOOL ok = ReadFile(client.pipe, framer.GetWritePtr(), (DWORD)framer.GetWritableSize(), &bytesRead, &ol);
 
         if (!ok) {
             DWORD err = GetLastError();
@@ -168,7 +273,7 @@ void PipeServer::ReadThread() {
                 while (m_running.load()) {
                     DWORD waitResult = WaitForSingleObject(readEvent, 500);
                     if (waitResult == WAIT_OBJECT_0) {
-                        if (!GetOverlappedResult(m_hPipe, &ol, &bytesRead, FALSE)) {
+                        if (!GetOverlappedResult(client.pipe, &ol, &bytesRead, FALSE)) {
                             goto disconnect;
                         }
                         break;
@@ -182,24 +287,17 @@ void PipeServer::ReadThread() {
         }
 
         if (bytesRead > 0) {
-            buffer[bytesRead] = '\0';
-            lineBuffer += buffer;
-
             // LF区切りでメッセージ分割
-            size_t pos;
-            while ((pos = lineBuffer.find('\n')) != std::string::npos) {
-                std::string message = lineBuffer.substr(0, pos);
-                lineBuffer.erase(0, pos + 1);
-
-                if (!message.empty() && OnMessage) {
-                    OnMessage(message);
-                }
-            }
+            framer.Commit(bytesRead,
+                [&](std::string_view message) {
+                    if (OnMessage) OnMessage(client.id, message);
+                },
+                [&](size_t discarded) {
+                    printf("[PipeServer] 上限超えのメッセージを破棄 (id=%u, %zu bytes)\n", client.id, discarded);
+                });
         }
     }
 
 disconnect:
     CloseHandle(readEvent);
-    m_connected = false;
-    printf("[PipeServer] 読み取りスレッド停止\n");
 }
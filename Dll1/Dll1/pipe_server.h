@@ -1,45 +1,68 @@
 ﻿#pragma once
-// pipe_server.h : Named Pipe Server（双方向・メッセージ送受信）
+// pipe_server.h : Named Pipe Server（複数クライアント・双方向・メッセージ送受信）
+// 接続待ちのインスタンスを常に用意しておき、接続したクライアント毎に
+// 読み取りスレッドと送信キューを持つ。遅いクライアントが他のクライアントを止めることはない
+// 同じ内容を複数クライアントへ送る時は、1回だけ作ったバッファ（SendBuffer）を各キューで共有する
 
 #include <windows.h>
 #include <string>
 #include <thread>
 #include <atomic>
-#include <functional>
 #include <mutex>
+#include <memory>
+#include <vector>
+#include "transport.h"
 
-class PipeServer {
+class PipeServer : public Transport {
 public:
+    // 常に用意しておく接続待ちインスタンス数
+    static constexpr size_t PENDING_INSTANCES = 2;
+
     PipeServer() = default;
-    ~PipeServer();
+    ~PipeServer() override;
 
     // サーバー開始（別スレッドでパイプ待機）
-    bool Start(const char* pipeName);
+    bool Start(const char* pipeName) override;
 
-    // サーバー停止
-    void Stop();
+    // サーバー停止（全クライアント切断）
+    void Stop() override;
 
-    // JSONメッセージ送信（LF区切り）
-    bool Send(const std::string& json);
+    bool SendShared(uint32_t clientId, const SendBuffer& buffer, MessageClass cls = MessageClass::Control) override;
+    bool GetSendQueueStats(uint32_t clientId, SendQueueStats& out) const override;
+    bool IsSendBusy(uint32_t clientId) const override;
 
-    // 接続状態
-    bool IsConnected() const { return m_connected.load(); }
+private:
+    struct Client {
+        uint32_t id = 0;
+        HANDLE pipe = INVALID_HANDLE_VALUE;
+        HANDLE writeEvent = NULL;
+        SendQueue queue;
+        std::atomic<bool> connected{ false };
+    };
 
-    // コールバック
-    std::function<void(const std::string&)> OnMessage;  // メッセージ受信
-    std::function<void()> OnConnect;                     // クライアント接続
-    std::function<void()> OnDisconnect;                  // クライアント切断
+    // 接続待ちインスタンス
+    struct PendingInstance {
+        HANDLE pipe = INVALID_HANDLE_VALUE;
+        OVERLAPPED ol = {};
+        bool alreadyConnected = false;  // ConnectNamedPipe が ERROR_PIPE_CONNECTED を返した
+    };
 
-private:
-    void ServerThread();
-    void ReadThread();
+    void AcceptThread();
+    void ClientThread(std::shared_ptr<Client> client);
+    void ReadLoop(Client& client);
+
+    bool CreatePendingInstance(PendingInstance& pending);
+    void ClosePendingInstance(PendingInstance& pending);
+    void AttachClient(HANDLE pipe);
+    std::shared_ptr<Client> FindClient(uint32_t clientId) const;
+
+    // 書き込みスレッドから呼ばれる。1件を書き終えるまでブロックする
+    bool WriteBlocking(Client& client, const char* data, size_t size);
 
     std::string m_pipeName;
-    HANDLE m_hPipe = INVALID_HANDLE_VALUE;
-    std::thread m_serverThread;
-    std::thread m_readThread;
+    std::thread m_acceptThread;
     std::atomic<bool> m_running{ false };
-    std::atomic<bool> m_connected{ false };
-    std::mutex m_writeMutex;
-    HANDLE m_writeEvent = NULL;
+
+    mutable std::mutex m_clientsMutex;
+    std::vector<std::shared_ptr<Client>> m_clients;
 };
@@ -0,0 +1,261 @@
+﻿#include "pch.h"
+#include "pointer_scan.h"
+#include <cstring>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+
+// 逆引き表を作る時の1タスクの大きさと、1回の保護付き読み取りで写す大きさ
+static constexpr size_t MAP_CHUNK_SIZE = 0x100000;   // 1MB
+static constexpr size_t MAP_BLOCK_SIZE = 0x10000;    // 64KB
+static constexpr unsigned MAX_POINTER_SCAN_THREADS = 16;
+static constexpr uint32_t NO_PARENT = UINT32_MAX;
+
+namespace {
+
+struct PointerEntry {
+    uintptr_t value;    // 指している先
+    uintptr_t slot;     // ポインタの置き場所
+};
+
+struct MapChunk {
+    const uint8_t* base;
+    size_t size;
+};
+
+// 段ごとの候補。parent は1つ前の段の添字、offset は「このポインタの値 + offset = 親のアドレス」
+struct SearchNode {
+    uintptr_t address;
+    uint32_t parent;
+    uint32_t offset;
+};
+
+// 静的領域で見つかった起点（level 段目の nodes[node] を指している）
+struct RootHit {
+    uint32_t level;
+    uint32_t node;
+    uintptr_t slot;
+    uint32_t offset;
+};
+
+// func(worker) を threads 個のスレッドで並列に実行する（0番は呼び出し元のスレッド）
+template <typename Func>
+void RunWorkers(unsigned threads, Func&& func) {
+    std::vector<std::thread> workers;
+    for (unsigned w = 1; w < threads; w++) {
+        workers.emplace_back([&func, w]() { func(w); });
+    }
+    func(0);
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+bool InRanges(const std::vector<HeapRegion>& ranges, uintptr_t value) {
+    auto it = std::upper_bound(ranges.begin(), ranges.end(), value,
+        [](uintptr_t v, const HeapRegion& range) { return v < (uintptr_t)range.base; });
+    if (it == ranges.begin()) return false;
+    --it;
+    return value - (uintptr_t)it->base < it->size;
+}
+
+double ElapsedMs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// 全領域のポインタ（指す先がいずれかの領域に入る、ポインタ境界の値）を集めて値の順に並べる
+// 静的領域は全部、ヒープは目的アドレスに近い領域から maxBytes まで読む。maxPointers を超えたら残りのチャンクは読まない
+std::vector<PointerEntry> BuildPointerMap(const PointerScanConfig& config, const uint8_t* target, unsigned threads,
+                                          PointerScanResult& result) {
+    std::vector<HeapRegion> ranges = config.heapRegions;
+    ranges.insert(ranges.end(), config.staticRanges.begin(), config.staticRanges.end());
+    std::sort(ranges.begin(), ranges.end(),
+        [](const HeapRegion& a, const HeapRegion& b) { return a.base < b.base; });
+
+    std::vector<HeapRegion> heap = config.heapRegions;
+    auto distance = [&](const HeapRegion& region) {
+        uintptr_t address = (uintptr_t)target, base = (uintptr_t)region.base;
+        if (address < base) return base - address;
+        return (address - base < region.size) ? 0 : address - base - region.size;
+    };
+    std::stable_sort(heap.begin(), heap.end(),
+        [&](const HeapRegion& a, const HeapRegion& b) { return distance(a) < distance(b); });
+
+    std::vector<MapChunk> chunks;
+    for (const HeapRegion& range : config.staticRanges) {
+        for (size_t offset = 0; offset < range.size; offset += MAP_CHUNK_SIZE) {
+            chunks.push_back({ range.base + offset, (std::min)(MAP_CHUNK_SIZE, range.size - offset) });
+        }
+    }
+    size_t heapBytes = 0;
+    for (const HeapRegion& range : heap) {
+        for (size_t offset = 0; offset < range.size; offset += MAP_CHUNK_SIZE) {
+            if (config.maxBytes && heapBytes >= config.maxBytes) {
+                result.mapTruncated = true;
+                break;
+            }
+            size_t size = (std::min)(MAP_CHUNK_SIZE, range.size - offset);
+            chunks.push_back({ range.base + offset, size });
+            heapBytes += size;
+        }
+    }
+
+    std::atomic<size_t> nextChunk{ 0 };
+    std::atomic<size_t> pointerCount{ 0 };
+    std::atomic<size_t> bytesScanned{ 0 };
+    std::atomic<bool> mapFull{ false };
+    std::vector<std::vector<PointerEntry>> partial(threads);
+    RunWorkers(threads, [&](unsigned w) {
+        std::vector<uint8_t> block(MAP_BLOCK_SIZE);
+        std::vector<PointerEntry>& out = partial[w];
+        for (size_t c = nextChunk++; c < chunks.size() && !mapFull.load(); c = nextChunk++) {
+            const MapChunk& chunk = chunks[c];
+            size_t before = out.size();
+            for (size_t b = 0; b < chunk.size; b += MAP_BLOCK_SIZE) {
+                size_t length = (std::min)(MAP_BLOCK_SIZE, chunk.size - b);
+                if (!config.safeRead(chunk.base + b, block.data(), length)) continue;
+                for (size_t i = 0; i + sizeof(uintptr_t) <= length; i += sizeof(uintptr_t)) {
+                    uintptr_t value;
+                    memcpy(&value, block.data() + i, sizeof(value));
+                    if (!value || (value % sizeof(uintptr_t)) != 0) continue;
+                    if (!InRanges(ranges, value)) continue;
+                    out.push_back({ value, (uintptr_t)(chunk.base + b + i) });
+                }
+            }
+            bytesScanned += chunk.size;
+            size_t count = pointerCount += out.size() - before;
+            if (config.maxPointers && count >= config.maxPointers) mapFull = true;
+        }
+    });
+    result.bytesScanned = bytesScanned.load();
+    if (mapFull.load()) result.mapTruncated = true;
+
+    size_t total = 0;
+    for (const auto& p : partial) total += p.size();
+    std::vector<PointerEntry> map;
+    map.reserve(total);
+    for (auto& p : partial) {
+        map.insert(map.end(), p.begin(), p.end());
+        std::vector<PointerEntry>().swap(p);
+    }
+    std::sort(map.begin(), map.end(), [](const PointerEntry& a, const PointerEntry& b) {
+        return a.value != b.value ? a.value < b.value : a.slot < b.slot;
+    });
+    return map;
+}
+
+PointerPath BuildPath(const std::vector<std::vector<SearchNode>>& levels, const RootHit& hit,
+                      const uint8_t* moduleBase) {
+    PointerPath path;
+    path.moduleOffset = (uint64_t)(hit.slot - (uintptr_t)moduleBase);
+    path.offsets[path.depth++] = hit.offset;
+    uint32_t index = hit.node;
+    for (uint32_t level = hit.level; level > 0; level--) {
+        const SearchNode& node = levels[level][index];
+        path.offsets[path.depth++] = node.offset;
+        index = node.parent;
+    }
+    return path;
+}
+
+uint64_t TotalOffset(const PointerPath& path) {
+    uint64_t total = 0;
+    for (uint32_t k = 0; k < path.depth; k++) total += path.offsets[k];
+    return total;
+}
+
+} // namespace
+
+PointerScanResult FindPointerPaths(const uint8_t* target, const PointerScanConfig& config) {
+    PointerScanResult result;
+    unsigned threads = config.threadCount ? config.threadCount : std::thread::hardware_concurrency();
+    threads = (std::max)(1u, (std::min)(threads, MAX_POINTER_SCAN_THREADS));
+    result.threads = threads;
+    uint32_t maxDepth = (std::min)(config.maxDepth, (uint32_t)MAX_POINTER_PATH_DEPTH);
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<PointerEntry> map = BuildPointerMap(config, target, threads, result);
+    result.pointerCount = map.size();
+    result.buildMs = ElapsedMs(start);
+
+    start = std::chrono::steady_clock::now();
+    std::vector<std::vector<SearchNode>> levels;
+    levels.push_back({ { (uintptr_t)target, NO_PARENT, 0 } });
+    std::vector<uintptr_t> visited = { (uintptr_t)target };
+    std::vector<RootHit> roots;
+
+    for (uint32_t depth = 1; depth <= maxDepth && !levels.back().empty(); depth++) {
+        const std::vector<SearchNode>& nodes = levels.back();
+        const uint32_t level = (uint32_t)levels.size() - 1;
+        const size_t limit = (depth == 1) ? config.limits.targetOffset : config.limits.objectSize;
+        const bool expand = depth < maxDepth;
+        result.levelsSearched = depth;
+        result.nodesVisited += nodes.size();
+
+        // 候補を連続した範囲に分けて並列に逆引きする（結果はワーカー順に繋ぐので毎回同じ順序になる）
+        std::vector<std::vector<RootHit>> partialRoots(threads);
+        std::vector<std::vector<SearchNode>> partialNext(threads);
+        size_t perWorker = (nodes.size() + threads - 1) / threads;
+        RunWorkers(threads, [&](unsigned w) {
+            size_t begin = (std::min)(nodes.size(), (size_t)w * perWorker);
+            size_t end = (std::min)(nodes.size(), begin + perWorker);
+            for (size_t i = begin; i < end; i++) {
+                uintptr_t address = nodes[i].address;
+                uintptr_t low = (address >= limit) ? address - limit : 0;
+                auto it = std::lower_bound(map.begin(), map.end(), low,
+                    [](const PointerEntry& entry, uintptr_t v) { return entry.value < v; });
+                for (; it != map.end() && it->value <= address; ++it) {
+                    uint32_t offset = (uint32_t)(address - it->value);
+                    if (InRanges(config.staticRanges, it->slot)) {
+                        partialRoots[w].push_back({ level, (uint32_t)i, it->slot, offset });
+                    } else if (expand) {
+                        partialNext[w].push_back({ it->slot, (uint32_t)i, offset });
+                    }
+                }
+            }
+        });
+
+        for (const auto& p : partialRoots) roots.insert(roots.end(), p.begin(), p.end());
+        if (roots.size() >= config.maxResults || !expand) break;
+
+        // 次の段: 置き場所ごとに1つ（オフセットが小さいものを残す）、前の段までに出たものは除く
+        std::vector<SearchNode> next;
+        for (const auto& p : partialNext) next.insert(next.end(), p.begin(), p.end());
+        std::sort(next.begin(), next.end(), [](const SearchNode& a, const SearchNode& b) {
+            return a.address != b.address ? a.address < b.address : a.offset < b.offset;
+        });
+        next.erase(std::unique(next.begin(), next.end(),
+            [](const SearchNode& a, const SearchNode& b) { return a.address == b.address; }), next.end());
+        next.erase(std::remove_if(next.begin(), next.end(), [&](const SearchNode& node) {
+            return std::binary_search(visited.begin(), visited.end(), node.address);
+        }), next.end());
+        if (next.size() > config.maxNodesPerLevel) {
+            next.resize(config.maxNodesPerLevel);
+            result.truncated = true;
+        }
+
+        size_t visitedSize = visited.size();
+        for (const SearchNode& node : next) visited.push_back(node.address);
+        std::inplace_merge(visited.begin(), visited.begin() + visitedSize, visited.end());
+        levels.push_back(std::move(next));
+    }
+
+    // パスにして、辿り直して目的アドレスに着くものだけ残す（探索中に書き換わったものを除く）
+    for (const RootHit& hit : roots) {
+        PointerPath path = BuildPath(levels, hit, config.moduleBase);
+        const uint8_t* resolved = nullptr;
+        if (ResolvePointerPath(config.moduleBase, path, config.safeRead, &resolved) && resolved == target) {
+            result.paths.push_back(path);
+        }
+    }
+    std::stable_sort(result.paths.begin(), result.paths.end(), [](const PointerPath& a, const PointerPath& b) {
+        if (a.depth != b.depth) return a.depth < b.depth;
+        uint64_t ta = TotalOffset(a), tb = TotalOffset(b);
+        if (ta != tb) return ta < tb;
+        return a.moduleOffset < b.moduleOffset;
+    });
+    if (result.paths.size() > config.maxResults) result.paths.resize(config.maxResults);
+    result.searchMs = ElapsedMs(start);
+    return result;
+}
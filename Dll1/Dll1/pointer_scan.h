@@ -0,0 +1,47 @@
+﻿#pragma once
+// pointer_scan.h : 任意の目的アドレスに対するポインタパス探索
+// 書き込み可能な領域の全ポインタを「指している値 → 置き場所」の逆引き表にまとめ、
+// 目的アドレスから逆向きに1段ずつ（各段は並列に）たどって、モジュールの静的領域に着いたものをパスとして返す。
+// 結果は locator_cache.h の PointerPath なので、起動時は ResolvePointerPath で辿るだけでよい
+//
+//   段0: 目的アドレス
+//   段k: 段k-1 のアドレス a に対して、値 v が [a - 上限, a] に入るポインタの置き場所
+//        置き場所が静的領域なら深さ k のパスが1つ見つかる。それ以外は次の段の候補になる
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include "heap_scan.h"
+#include "locator_cache.h"
+
+struct PointerScanConfig {
+    std::vector<HeapRegion> heapRegions;    // 逆引き表に含める領域（ヒープ）。低アドレス順
+    std::vector<HeapRegion> staticRanges;   // パスの起点（モジュールの書き込み可能セクション）。低アドレス順
+    const uint8_t* moduleBase = nullptr;
+    bool (*safeRead)(const void* src, void* dst, size_t length) = nullptr;
+
+    PointerPathLimits limits;               // 途中の段のオフセット上限と、最後の段（目的アドレス）のオフセット上限
+    uint32_t maxDepth = MAX_POINTER_PATH_DEPTH;
+    size_t maxResults = 16;
+    size_t maxNodesPerLevel = 1 << 20;      // 1段の候補数の上限（超えた分は捨てる）
+    size_t maxBytes = 0;                    // 逆引き表に含めるヒープの大きさの上限（目的アドレスに近い領域から。0 なら全部）
+    size_t maxPointers = 0;                 // 逆引き表の件数の上限（0 なら無制限）
+    unsigned threadCount = 0;               // 0 なら論理コア数
+};
+
+struct PointerScanResult {
+    std::vector<PointerPath> paths;         // 浅い順、オフセットの合計が小さい順
+
+    // 計測用
+    size_t pointerCount = 0;                // 逆引き表の件数
+    size_t bytesScanned = 0;                // 逆引き表を作るために読んだ大きさ
+    bool mapTruncated = false;              // maxBytes / maxPointers で逆引き表を打ち切った
+    size_t nodesVisited = 0;
+    uint32_t levelsSearched = 0;
+    bool truncated = false;                 // maxNodesPerLevel で候補を捨てた
+    unsigned threads = 0;
+    double buildMs = 0;
+    double searchMs = 0;
+};
+
+PointerScanResult FindPointerPaths(const uint8_t* target, const PointerScanConfig& config);
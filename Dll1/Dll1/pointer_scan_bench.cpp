@@ -0,0 +1,199 @@
+﻿#include "pch.h"
+// pointer_scan_bench.cpp : ロケータのパス探索（FindStaticPointerPaths / FindPointerPaths）の確認と計測
+// scan_bench の合成アドレス空間（ノイズ領域 + MainRAM + パターン）に、合成のモジュールと途中のオブジェクトを足し、
+// 答えの分かっているポインタの鎖を張ってから両方の探索を走らせ、返ったパスを確かめる
+//
+//   モジュール（静的領域 +0x1000〜+0x3000）
+//     +0x2000 emuInstances[0] → EmuInstance、EmuInstance+0x18 → NDS                  （深さ2）
+//     +0x2200 NDS を直接指す静的変数                                                （深さ1。深さ2で先頭と確かめられる）
+//     +0x2400 → オブジェクトA、A+0x10 → オブジェクトB、B+0x28 → NDS                  （深さ3。FindPointerPaths のみ）
+//     +0x2800 パターンの少し手前を指すだけの静的変数                                 （先頭と確かめられないので深さ1にしない）
+//   NDS はパターンの PATTERN_OFFSET 手前（パターン = NDS::MainRAM メンバ）
+//
+// 返ったパスはすべて ResolvePointerPath でパターンの位置に着くこと、期待するパスが含まれること、
+// FindStaticPointerPaths が手前を指すだけの静的変数を返さないことを確かめ、外れたら 1 を返す
+#include "bench_entry.h"
+#include "scan_bench.h"
+#include "pointer_scan.h"
+#include "locator_cache.h"
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+static constexpr size_t MODULE_SIZE = 0x4000;
+static constexpr size_t MODULE_STATIC_BEGIN = 0x1000;
+static constexpr size_t MODULE_STATIC_SIZE = 0x2000;
+static constexpr size_t OBJECT_HEAP_SIZE = 0x10000;
+static constexpr uint64_t PATTERN_OFFSET = 0x40;
+
+static constexpr uint64_t EMU_INSTANCES_OFFSET = 0x2000;
+static constexpr uint64_t EMU_NDS_MEMBER = 0x18;
+static constexpr uint64_t CURRENT_NDS_OFFSET = 0x2200;
+static constexpr uint64_t CHAIN_ROOT_OFFSET = 0x2400;
+static constexpr uint64_t CHAIN_A_MEMBER = 0x10;
+static constexpr uint64_t CHAIN_B_MEMBER = 0x28;
+static constexpr uint64_t LOOSE_POINTER_OFFSET = 0x2800;
+static constexpr uint64_t LOOSE_POINTER_GAP = 0x10;
+
+static bool PointerBenchRead(const void* src, void* dst, size_t length) {
+    memcpy(dst, src, length);
+    return true;
+}
+
+static void WritePointer(uint8_t* at, const void* value) {
+    memcpy(at, &value, sizeof(value));
+}
+
+static PointerPath MakePath(uint64_t moduleOffset, std::initializer_list<uint64_t> offsets) {
+    PointerPath path;
+    path.moduleOffset = moduleOffset;
+    for (uint64_t offset : offsets) path.offsets[path.depth++] = offset;
+    return path;
+}
+
+static bool SamePath(const PointerPath& a, const PointerPath& b) {
+    if (a.moduleOffset != b.moduleOffset || a.depth != b.depth) return false;
+    for (uint32_t i = 0; i < a.depth; i++) {
+        if (a.offsets[i] != b.offsets[i]) return false;
+    }
+    return true;
+}
+
+static bool ContainsPath(const std::vector<PointerPath>& paths, const PointerPath& expected) {
+    return std::any_of(paths.begin(), paths.end(), [&](const PointerPath& path) { return SamePath(path, expected); });
+}
+
+// 返ったパスを表示し、全部が target に着くか確かめる
+static bool CheckResolves(const char* label, const uint8_t* module, const std::vector<PointerPath>& paths, const uint8_t* target) {
+    bool ok = true;
+    for (const PointerPath& path : paths) {
+        const uint8_t* resolved = nullptr;
+        bool reaches = ResolvePointerPath(module, path, PointerBenchRead, &resolved) && resolved == target;
+        printf("  %-8s %-24s %s\n", label, FormatPointerPath(path).c_str(), reaches ? "" : "← パターンに着かない");
+        if (!reaches) ok = false;
+    }
+    return ok;
+}
+
+static bool Expect(bool condition, const char* message) {
+    if (!condition) fprintf(stderr, "NG: %s\n", message);
+    return condition;
+}
+
+// ========================================
+// 計測プログラムの入口（Windows は Bench プロジェクトの "pointers"、Linux は POINTER_SCAN_BENCH_MAIN を定義して単体でビルド）
+//   g++ -std=c++17 -O2 -DPOINTER_SCAN_BENCH_MAIN pointer_scan_bench.cpp pointer_scan.cpp locator_cache.cpp scan_bench.cpp
+//       heap_scan.cpp block_diff.cpp -lpthread -o pointer_scan_bench
+//   ./pointer_scan_bench [--heap-mb N] [--fill F] [--seed N] [--threads N]
+// ========================================
+int PointerScanBenchMain(int argc, char** argv) {
+    SyntheticSpaceConfig config;
+    config.heapBytes = 256ULL << 20;
+    unsigned threadCount = 0;
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = (i + 1 < argc) ? argv[i + 1] : "0";
+        if (strcmp(arg, "--heap-mb") == 0) { config.heapBytes = strtoull(value, nullptr, 10) << 20; i++; }
+        else if (strcmp(arg, "--fill") == 0) { config.noiseFill = atof(value); i++; }
+        else if (strcmp(arg, "--seed") == 0) { config.seed = strtoull(value, nullptr, 10); i++; }
+        else if (strcmp(arg, "--threads") == 0) { threadCount = (unsigned)strtoul(value, nullptr, 10); i++; }
+        else {
+            fprintf(stderr, "不明な引数: %s\n", arg);
+            return 2;
+        }
+    }
+
+    SyntheticAddressSpace space;
+    if (!space.Build(config)) {
+        fprintf(stderr, "合成イメージを確保できません (%.1fMB)\n", config.heapBytes / (1024.0 * 1024.0));
+        return 1;
+    }
+    const uint8_t* target = space.GetInstances()[0].patternAt;
+
+    // NDS の先頭（パターンが領域の先頭に近ければその分だけ手前）
+    uint64_t patternOffset = PATTERN_OFFSET;
+    for (const HeapRegion& region : space.GetRegions()) {
+        if (target >= region.base && target < region.base + region.size) {
+            patternOffset = (std::min)(patternOffset, (uint64_t)(target - region.base));
+        }
+    }
+    const uint8_t* nds = target - patternOffset;
+
+    // 合成のモジュールと途中のオブジェクト（8バイト境界）
+    std::vector<uint64_t> moduleStorage(MODULE_SIZE / sizeof(uint64_t));
+    std::vector<uint64_t> objectStorage(OBJECT_HEAP_SIZE / sizeof(uint64_t));
+    uint8_t* module = reinterpret_cast<uint8_t*>(moduleStorage.data());
+    uint8_t* objects = reinterpret_cast<uint8_t*>(objectStorage.data());
+    uint8_t* emuInstance = objects;
+    uint8_t* objectA = objects + 0x4000;
+    uint8_t* objectB = objects + 0x8000;
+
+    WritePointer(module + EMU_INSTANCES_OFFSET, emuInstance);
+    WritePointer(emuInstance + EMU_NDS_MEMBER, nds);
+    WritePointer(module + CURRENT_NDS_OFFSET, nds);
+    WritePointer(module + CHAIN_ROOT_OFFSET, objectA);
+    WritePointer(objectA + CHAIN_A_MEMBER, objectB);
+    WritePointer(objectB + CHAIN_B_MEMBER, nds);
+    WritePointer(module + LOOSE_POINTER_OFFSET, target - LOOSE_POINTER_GAP);
+
+    const PointerPath expectDepth1 = MakePath(CURRENT_NDS_OFFSET, { patternOffset });
+    const PointerPath expectDepth2 = MakePath(EMU_INSTANCES_OFFSET, { EMU_NDS_MEMBER, patternOffset });
+    const PointerPath expectDepth3 = MakePath(CHAIN_ROOT_OFFSET, { CHAIN_A_MEMBER, CHAIN_B_MEMBER, patternOffset });
+    const PointerPath loosePath = MakePath(LOOSE_POINTER_OFFSET, { LOOSE_POINTER_GAP });
+
+    std::vector<HeapRegion> staticRanges = { { module + MODULE_STATIC_BEGIN, MODULE_STATIC_SIZE } };
+    std::vector<HeapRegion> heapRegions = space.GetRegions();
+    heapRegions.push_back({ objects, OBJECT_HEAP_SIZE });
+    std::sort(heapRegions.begin(), heapRegions.end(), [](const HeapRegion& a, const HeapRegion& b) { return a.base < b.base; });
+    std::vector<HeapRegion> readableRegions = heapRegions;
+    readableRegions.push_back({ module, MODULE_SIZE });
+    std::sort(readableRegions.begin(), readableRegions.end(), [](const HeapRegion& a, const HeapRegion& b) { return a.base < b.base; });
+
+    printf("合成ヒープ %.1fMB（%zu 領域）, パターン %p, NDS 先頭からのオフセット 0x%llx\n",
+        space.GetTotalBytes() / (1024.0 * 1024.0), space.GetRegions().size(), (const void*)target,
+        (unsigned long long)patternOffset);
+    bool ok = true;
+
+    // 静的領域からの深さ2以下
+    PointerPathLimits limits;
+    std::vector<PointerPath> staticPaths;
+    auto staticStart = std::chrono::steady_clock::now();
+    FindStaticPointerPaths(staticRanges, module, target, readableRegions, limits, 8, PointerBenchRead, staticPaths);
+    double staticMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - staticStart).count();
+    printf("FindStaticPointerPaths: %zu 本 (%.2fms)\n", staticPaths.size(), staticMs);
+    ok &= CheckResolves("static", module, staticPaths, target);
+    ok &= Expect(ContainsPath(staticPaths, expectDepth1), "FindStaticPointerPaths が深さ1のパスを返さない");
+    ok &= Expect(ContainsPath(staticPaths, expectDepth2), "FindStaticPointerPaths が emuInstances[] からの深さ2のパスを返さない");
+    ok &= Expect(!ContainsPath(staticPaths, loosePath), "FindStaticPointerPaths が先頭と確かめられない静的変数を返した");
+
+    // 逆引き表による深いパス
+    PointerScanConfig scanConfig;
+    scanConfig.heapRegions = heapRegions;
+    scanConfig.staticRanges = staticRanges;
+    scanConfig.moduleBase = module;
+    scanConfig.safeRead = PointerBenchRead;
+    scanConfig.maxResults = 16;
+    scanConfig.threadCount = threadCount;
+    PointerScanResult result = FindPointerPaths(target, scanConfig);
+    printf("FindPointerPaths: %zu 本, %.1fMB %zu個のポインタ 段%u 候補%zu %uスレッド (表 %.1fms / 探索 %.1fms)\n",
+        result.paths.size(), result.bytesScanned / (1024.0 * 1024.0), result.pointerCount, result.levelsSearched,
+        result.nodesVisited, result.threads, result.buildMs, result.searchMs);
+    ok &= CheckResolves("scan", module, result.paths, target);
+    ok &= Expect(ContainsPath(result.paths, expectDepth1), "FindPointerPaths が深さ1のパスを返さない");
+    ok &= Expect(ContainsPath(result.paths, expectDepth2), "FindPointerPaths が深さ2のパスを返さない");
+    ok &= Expect(ContainsPath(result.paths, expectDepth3), "FindPointerPaths が深さ3のパスを返さない");
+    ok &= Expect(std::is_sorted(result.paths.begin(), result.paths.end(),
+        [](const PointerPath& a, const PointerPath& b) { return a.depth < b.depth; }), "FindPointerPaths の結果が浅い順でない");
+
+    printf("%s\n", ok ? "OK" : "NG");
+    return ok ? 0 : 1;
+}
+
+#ifdef POINTER_SCAN_BENCH_MAIN
+int main(int argc, char** argv) {
+    return PointerScanBenchMain(argc, argv);
+}
+#endif
@@ -0,0 +1,385 @@
+﻿#include "pch.h"
+#include "scan_bench.h"
+#include "bench_entry.h"
+#include "monitor.h"
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <random>
+#include <set>
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+static constexpr size_t BENCH_PAGE_SIZE = 0x1000;
+static constexpr size_t REGION_ALIGN = 0x10000;     // 領域の大きさの単位（VirtualAlloc の確保単位）
+static constexpr size_t PATTERN_SIZE = 16;          // [ポインタ][マスク] と次の位置との間隔
+static constexpr size_t ROM_HEADER_OFFSET_FROM_END = 0x200;
+static const char SYNTHETIC_ROM_HEADER[17] = "SYNTHETIC   ASEJ";
+
+SyntheticAddressSpace::~SyntheticAddressSpace() {
+    Release();
+}
+
+uint8_t* SyntheticAddressSpace::Allocate(size_t size) {
+#ifdef _WIN32
+    void* p = VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    if (!p) return nullptr;
+#else
+    void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (p == MAP_FAILED) return nullptr;
+#endif
+    m_allocations.push_back({ static_cast<uint8_t*>(p), size });
+    m_regions.push_back({ static_cast<uint8_t*>(p), size });
+    m_totalBytes += size;
+    return static_cast<uint8_t*>(p);
+}
+
+void SyntheticAddressSpace::Release() {
+    for (const HeapRegion& allocation : m_allocations) {
+#ifdef _WIN32
+        VirtualFree(allocation.base, 0, MEM_RELEASE);
+#else
+        munmap(allocation.base, allocation.size);
+#endif
+    }
+    m_allocations.clear();
+    m_regions.clear();
+    m_instances.clear();
+    m_totalBytes = 0;
+    m_writtenBytes = 0;
+}
+
+bool SyntheticAddressSpace::IsCommitted(const void* address, size_t expectedSize) const {
+    uintptr_t value = (uintptr_t)address;
+    auto it = std::upper_bound(m_regions.begin(), m_regions.end(), value,
+        [](uintptr_t v, const HeapRegion& region) { return v < (uintptr_t)region.base; });
+    if (it == m_regions.begin()) return false;
+    --it;
+    uintptr_t offset = value - (uintptr_t)it->base;
+    return offset < it->size && it->size - offset >= expectedSize;
+}
+
+bool SyntheticAddressSpace::Build(const SyntheticSpaceConfig& config) {
+    Release();
+    m_config = config;
+    std::mt19937_64 rng(config.seed);
+    auto uniform = [&](uint64_t n) { return n ? rng() % n : 0; };
+
+    const uint32_t mask = config.dsi ? DSI_MAIN_RAM_MASK : NDS_MAIN_RAM_MASK;
+    const uint32_t otherMask = config.dsi ? NDS_MAIN_RAM_MASK : DSI_MAIN_RAM_MASK;
+    const size_t mainRAMSize = (size_t)mask + 1;
+
+    // ノイズ領域（大きさは min〜max の対数一様）
+    std::vector<HeapRegion> noise;
+    double logMin = std::log((double)config.minRegionSize);
+    double logMax = std::log((double)(std::max)(config.maxRegionSize, config.minRegionSize));
+    std::uniform_real_distribution<double> logSize(logMin, logMax);
+    uint64_t remaining = config.heapBytes;
+    while (remaining > 0) {
+        size_t size = (size_t)std::exp(logSize(rng));
+        size = (std::max)(REGION_ALIGN, size / REGION_ALIGN * REGION_ALIGN);
+        size = (size_t)(std::min)((uint64_t)size, (remaining + REGION_ALIGN - 1) / REGION_ALIGN * REGION_ALIGN);
+        uint8_t* base = Allocate(size);
+        if (!base) {
+            Release();
+            return false;
+        }
+        noise.push_back({ base, size });
+        remaining -= (std::min)((uint64_t)size, remaining);
+    }
+    if (noise.empty()) return false;
+
+    // 本物の MainRAM（末尾に ROM ヘッダのコピー）と、検証を通ってしまう偽物が指す大きな領域
+    std::vector<uint8_t*> mainRAMs;
+    for (uint32_t i = 0; i < config.instances; i++) {
+        uint8_t* ram = Allocate(mainRAMSize);
+        if (!ram) {
+            Release();
+            return false;
+        }
+        memcpy(ram + mainRAMSize - ROM_HEADER_OFFSET_FROM_END, SYNTHETIC_ROM_HEADER, 16);
+        mainRAMs.push_back(ram);
+    }
+    uint8_t* strongTarget = nullptr;
+    if (config.strongDecoys > 0) {
+        strongTarget = Allocate(mainRAMSize + REGION_ALIGN);
+        if (!strongTarget) {
+            Release();
+            return false;
+        }
+    }
+    std::sort(m_regions.begin(), m_regions.end(),
+        [](const HeapRegion& a, const HeapRegion& b) { return a.base < b.base; });
+
+    // ノイズ（ヒープらしく、ゼロ・小さな整数・他の領域へのポインタ・乱数を混ぜる）
+    // MainRAM と偽物の大きな領域には書かない（ROM ヘッダのコピーを壊さないため）
+    for (const HeapRegion& region : m_regions) {
+        bool planted = (region.base == strongTarget) ||
+            std::find(mainRAMs.begin(), mainRAMs.end(), region.base) != mainRAMs.end();
+        if (planted) continue;
+        for (size_t page = 0; page + BENCH_PAGE_SIZE <= region.size; page += BENCH_PAGE_SIZE) {
+            if ((double)(rng() >> 11) * (1.0 / 9007199254740992.0) >= config.noiseFill) continue;
+            uint64_t* words = reinterpret_cast<uint64_t*>(region.base + page);
+            for (size_t w = 0; w < BENCH_PAGE_SIZE / sizeof(uint64_t); w++) {
+                uint64_t r = rng();
+                switch (r % 20) {
+                case 0: case 1: case 2: case 3: case 4: case 5: case 6: case 7:
+                    words[w] = 0;
+                    break;
+                case 8: case 9: case 10: case 11: case 12:
+                    words[w] = (r >> 8) & 0xFFFF;
+                    break;
+                case 13: case 14: case 15: case 16: {
+                    const HeapRegion& target = m_regions[(r >> 8) % m_regions.size()];
+                    words[w] = (uint64_t)(uintptr_t)(target.base + (uniform(target.size) & ~(uint64_t)7));
+                    break;
+                }
+                default:
+                    // 乱数の下位32ビットがマスクと一致したら本物と区別できないので避ける
+                    words[w] = ((r & 0xFFFFFFFF) == NDS_MAIN_RAM_MASK || (r & 0xFFFFFFFF) == DSI_MAIN_RAM_MASK) ? 0 : r;
+                    break;
+                }
+            }
+            m_writtenBytes += BENCH_PAGE_SIZE;
+        }
+    }
+
+    // パターンをノイズ領域のランダムな位置に置く（互いに重ならないように）
+    std::set<uintptr_t> placed;
+    auto placePattern = [&](const void* pointer, uint32_t patternMask) -> const uint8_t* {
+        for (;;) {
+            const HeapRegion& region = noise[uniform(noise.size())];
+            if (region.size < 2 * PATTERN_SIZE) continue;
+            uint8_t* at = region.base + (uniform(region.size - PATTERN_SIZE) & ~(uint64_t)7);
+            auto next = placed.lower_bound((uintptr_t)at);
+            if (next != placed.end() && *next < (uintptr_t)at + PATTERN_SIZE) continue;
+            if (next != placed.begin() && *std::prev(next) + PATTERN_SIZE > (uintptr_t)at) continue;
+            placed.insert((uintptr_t)at);
+            memcpy(at, &pointer, sizeof(pointer));
+            memcpy(at + 8, &patternMask, sizeof(patternMask));
+            return at;
+        }
+    };
+
+    for (uint8_t* ram : mainRAMs) {
+        m_instances.push_back({ ram, mask, placePattern(ram, mask) });
+    }
+    for (size_t i = 0; i < config.decoys; i++) {
+        uint32_t decoyMask = (uniform(5) == 0) ? otherMask : mask;
+        size_t expectedSize = (size_t)decoyMask + 1;
+        const void* pointer = nullptr;
+        if (uniform(2) == 0) {
+            // 小さな確保の途中（末尾までが MainRAM より短い）を指す
+            const HeapRegion& target = noise[uniform(noise.size())];
+            size_t tail = (std::min)(target.size, expectedSize - 8);
+            pointer = target.base + target.size - ((uniform(tail) + 8) & ~(uint64_t)7);
+        }
+        placePattern(pointer, decoyMask);
+    }
+    for (size_t i = 0; i < config.strongDecoys; i++) {
+        placePattern(strongTarget, mask);
+    }
+    return true;
+}
+
+// ========================================
+// 計測
+// ========================================
+
+static const SyntheticAddressSpace* s_benchSpace = nullptr;
+
+static bool BenchRead(const void* src, void* dst, size_t length) {
+    memcpy(dst, src, length);
+    return true;
+}
+
+static bool BenchIsCommitted(const void* address, size_t expectedSize) {
+    return s_benchSpace->IsCommitted(address, expectedSize);
+}
+
+// 並列で走査した結果が1スレッドで走査した結果と同じか（違えば stderr に出す）
+// 打ち切りモードは最初の1つ（MainRAM・マスク・位置）、全候補モードは hits の列全体を比べる
+static bool MatchesSerialScan(const HeapScanResult& result, const HeapScanResult& serial, const char* impl, bool findAll) {
+    const char* mode = findAll ? "all" : "first";
+    bool same = result.mainRAM == serial.mainRAM && result.mask == serial.mask && result.foundAt == serial.foundAt;
+    if (!same) {
+        fprintf(stderr, "NG: %s/%s %uスレッドの結果が1スレッドと違う: MainRAM %p/%p マスク 0x%08X/0x%08X 位置 %p/%p\n",
+            impl, mode, result.threads, (void*)result.mainRAM, (void*)serial.mainRAM, result.mask, serial.mask,
+            (const void*)result.foundAt, (const void*)serial.foundAt);
+    }
+    if (result.hits.size() != serial.hits.size()) {
+        fprintf(stderr, "NG: %s/%s %uスレッドの候補数が1スレッドと違う: %zu/%zu\n",
+            impl, mode, result.threads, result.hits.size(), serial.hits.size());
+        return false;
+    }
+    for (size_t i = 0; i < result.hits.size(); i++) {
+        const HeapScanHit& a = result.hits[i];
+        const HeapScanHit& b = serial.hits[i];
+        if (a.mainRAM != b.mainRAM || a.mask != b.mask || a.foundAt != b.foundAt) {
+            fprintf(stderr, "NG: %s/%s %uスレッドの候補[%zu]が1スレッドと違う: MainRAM %p/%p マスク 0x%08X/0x%08X 位置 %p/%p\n",
+                impl, mode, result.threads, i, (void*)a.mainRAM, (void*)b.mainRAM, a.mask, b.mask,
+                (const void*)a.foundAt, (const void*)b.foundAt);
+            return false;
+        }
+    }
+    return same;
+}
+
+std::vector<ScanBenchResult> RunHeapScanBenchmark(const SyntheticAddressSpace& space, const ScanBenchOptions& options) {
+    s_benchSpace = &space;
+    std::vector<ScanBenchResult> results;
+    auto isReal = [&](const uint8_t* mainRAM) {
+        for (const SyntheticInstance& instance : space.GetInstances()) {
+            if (instance.mainRAM == mainRAM) return true;
+        }
+        return false;
+    };
+
+    // 最初に計測する実装だけが未アクセスのページのフォールトを負担しないよう、計測前に1回全域を走査しておく
+    {
+        HeapScanConfig warmup;
+        warmup.safeRead = BenchRead;
+        warmup.isCommitted = BenchIsCommitted;
+        warmup.threadCount = options.threadCount;
+        warmup.findAll = true;
+        ScanHeapForMainRAM(space.GetRegions(), warmup);
+    }
+
+    for (const char* impl : { "avx2", "sse2", "scalar" }) {
+        if (!IsHeapScanImplSupported(impl)) continue;
+        for (bool findAll : { false, true }) {
+            HeapScanConfig config;
+            config.safeRead = BenchRead;
+            config.isCommitted = BenchIsCommitted;
+            config.threadCount = options.threadCount;
+            config.findAll = findAll;
+            config.impl = impl;
+
+            ScanBenchResult bench;
+            bench.impl = impl;
+            bench.findAll = findAll;
+            double totalMs = 0;
+            uint32_t repeat = (std::max)(options.repeat, 1u);
+            HeapScanResult result;
+            for (uint32_t r = 0; r < repeat; r++) {
+                result = ScanHeapForMainRAM(space.GetRegions(), config);
+                totalMs += result.elapsedMs;
+                bench.bestMs = (r == 0) ? result.elapsedMs : (std::min)(bench.bestMs, result.elapsedMs);
+            }
+            bench.meanMs = totalMs / repeat;
+
+            // 同じ実装を1スレッドで走査した結果と比べる（並列化で結果が変わっていないか）
+            HeapScanConfig serialConfig = config;
+            serialConfig.threadCount = 1;
+            bench.matchesSerial = MatchesSerialScan(result, ScanHeapForMainRAM(space.GetRegions(), serialConfig), impl, findAll);
+
+            bench.threads = result.threads;
+            bench.bytesScanned = result.bytesScanned;
+            bench.candidates = result.candidates;
+            bench.candidatesRejected = result.candidatesRejected;
+
+            if (findAll) {
+                bench.hits = result.hits.size();
+                for (const HeapScanHit& hit : result.hits) {
+                    if (!isReal(hit.mainRAM)) bench.falsePositives++;
+                }
+                for (const SyntheticInstance& instance : space.GetInstances()) {
+                    bool found = std::any_of(result.hits.begin(), result.hits.end(),
+                        [&](const HeapScanHit& hit) { return hit.mainRAM == instance.mainRAM; });
+                    if (!found) bench.missed++;
+                }
+            } else {
+                bench.hits = result.mainRAM ? 1 : 0;
+                bench.falsePositives = (result.mainRAM && !isReal(result.mainRAM)) ? 1 : 0;
+                bench.missed = (!space.GetInstances().empty() && !isReal(result.mainRAM)) ? 1 : 0;
+            }
+            results.push_back(bench);
+        }
+    }
+    s_benchSpace = nullptr;
+    return results;
+}
+
+std::string FormatScanBenchReport(const SyntheticAddressSpace& space, const std::vector<ScanBenchResult>& results) {
+    const SyntheticSpaceConfig& config = space.GetConfig();
+    std::string report;
+    char line[256];
+    snprintf(line, sizeof(line),
+        "合成イメージ: %s, %zu領域 %.1fMB (書き込み %.1fMB), 本物 %u, 偽物 %zu (検証を通るもの %zu), seed %llu\n",
+        config.dsi ? "DSi 16MB" : "NDS 4MB", space.GetRegions().size(),
+        space.GetTotalBytes() / (1024.0 * 1024.0), space.GetWrittenBytes() / (1024.0 * 1024.0),
+        config.instances, config.decoys, config.strongDecoys, (unsigned long long)config.seed);
+    report += line;
+    snprintf(line, sizeof(line), "%-7s %-5s %4s %10s %10s %8s %10s %8s %8s %5s %5s %5s %7s %s\n",
+        "impl", "mode", "thr", "best(ms)", "mean(ms)", "GB/s", "走査(MB)", "候補", "除外", "結果", "誤検出", "見逃し", "誤検出率", "1スレッド");
+    report += line;
+    for (const ScanBenchResult& r : results) {
+        double gbPerSec = r.bestMs > 0 ? (r.bytesScanned / (1024.0 * 1024.0 * 1024.0)) / (r.bestMs / 1000.0) : 0;
+        double fpRate = r.hits ? (double)r.falsePositives / r.hits : 0;
+        snprintf(line, sizeof(line), "%-7s %-5s %4u %10.2f %10.2f %8.2f %10.1f %8zu %8zu %5zu %5zu %5zu %6.1f%% %s\n",
+            r.impl, r.findAll ? "all" : "first", r.threads, r.bestMs, r.meanMs, gbPerSec,
+            r.bytesScanned / (1024.0 * 1024.0), r.candidates, r.candidatesRejected,
+            r.hits, r.falsePositives, r.missed, fpRate * 100.0, r.matchesSerial ? "一致" : "不一致");
+        report += line;
+    }
+    return report;
+}
+
+// ========================================
+// 計測プログラムの入口（Windows は Bench プロジェクトの "scan"、Linux は SCAN_BENCH_MAIN を定義して単体でビルド）
+//   g++ -std=c++17 -O2 -DSCAN_BENCH_MAIN scan_bench.cpp heap_scan.cpp block_diff.cpp -lpthread -o scan_bench
+//   ./scan_bench [--heap-mb N] [--fill F] [--decoys N] [--strong N] [--instances N] [--nds|--dsi]
+//                [--seed N] [--threads N] [--repeat N]
+// ========================================
+int ScanBenchMain(int argc, char** argv) {
+    SyntheticSpaceConfig config;
+    ScanBenchOptions options;
+    bool runNds = true, runDsi = true;
+    bool mismatched = false;
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = (i + 1 < argc) ? argv[i + 1] : "0";
+        if (strcmp(arg, "--heap-mb") == 0) { config.heapBytes = strtoull(value, nullptr, 10) << 20; i++; }
+        else if (strcmp(arg, "--fill") == 0) { config.noiseFill = atof(value); i++; }
+        else if (strcmp(arg, "--decoys") == 0) { config.decoys = (size_t)strtoull(value, nullptr, 10); i++; }
+        else if (strcmp(arg, "--strong") == 0) { config.strongDecoys = (size_t)strtoull(value, nullptr, 10); i++; }
+        else if (strcmp(arg, "--instances") == 0) { config.instances = (uint32_t)strtoul(value, nullptr, 10); i++; }
+        else if (strcmp(arg, "--seed") == 0) { config.seed = strtoull(value, nullptr, 10); i++; }
+        else if (strcmp(arg, "--threads") == 0) { options.threadCount = (unsigned)strtoul(value, nullptr, 10); i++; }
+        else if (strcmp(arg, "--repeat") == 0) { options.repeat = (uint32_t)strtoul(value, nullptr, 10); i++; }
+        else if (strcmp(arg, "--nds") == 0) { runNds = true; runDsi = false; }
+        else if (strcmp(arg, "--dsi") == 0) { runNds = false; runDsi = true; }
+        else {
+            fprintf(stderr, "不明な引数: %s\n", arg);
+            return 2;
+        }
+    }
+
+    for (bool dsi : { false, true }) {
+        if (dsi ? !runDsi : !runNds) continue;
+        config.dsi = dsi;
+        SyntheticAddressSpace space;
+        if (!space.Build(config)) {
+            fprintf(stderr, "合成イメージを確保できません (%.1fMB)\n", config.heapBytes / (1024.0 * 1024.0));
+            return 1;
+        }
+        std::vector<ScanBenchResult> results = RunHeapScanBenchmark(space, options);
+        printf("%s\n", FormatScanBenchReport(space, results).c_str());
+        for (const ScanBenchResult& result : results) {
+            if (!result.matchesSerial) mismatched = true;
+        }
+    }
+    if (mismatched) {
+        fprintf(stderr, "並列の走査結果が1スレッドと一致しない実装がある\n");
+        return 1;
+    }
+    return 0;
+}
+
+#ifdef SCAN_BENCH_MAIN
+int main(int argc, char** argv) {
+    return ScanBenchMain(argc, argv);
+}
+#endif
@@ -0,0 +1,96 @@
+﻿#pragma once
+// scan_bench.h : MainRAM スキャナの計測用に、melonDS のアドレス空間を模した合成イメージを作って走査する
+// melonDS を動かさずに（Linux でも）ScanHeapForMainRAM の速度と誤検出を比べられるようにする
+//
+// 合成イメージ
+//   ノイズ領域: 1MB〜64MB のヒープ領域を合計 heapBytes 分。noiseFill の割合のページに、ゼロ・小さな整数・
+//              他の領域を指すポインタ・乱数を混ぜて書く（残りのページは触らない＝ゼロのまま）
+//   本物:      MainRAM（NDS 4MB / DSi 16MB）を別に確保し、ノイズ領域内のランダムな位置に [MainRAM ポインタ][マスク]
+//   偽物:      [null][マスク]（候補にならない）、[小さな確保の途中を指すポインタ][マスク]（isCommitted で外れる）、
+//              strongDecoys 個の [MainRAM より大きな別領域を指すポインタ][マスク]（検証を通る＝誤検出）
+//
+// 計測は実装（avx2 / sse2 / scalar）毎に、最初の1つで打ち切るモードと全候補を集めるモードの両方
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "heap_scan.h"
+
+struct SyntheticSpaceConfig {
+    uint64_t seed = 1;
+    uint64_t heapBytes = 2ULL << 30;        // ノイズ領域の合計
+    size_t minRegionSize = 1 << 20;
+    size_t maxRegionSize = 64 << 20;
+    double noiseFill = 0.1;                 // ノイズを書くページの割合
+    bool dsi = false;                       // MainRAM を 16MB（DSi）にする
+    uint32_t instances = 1;                 // 本物の NDS オブジェクトの数
+    size_t decoys = 10000;                  // 検証で外れる偽のパターン
+    size_t strongDecoys = 0;                // 検証を通ってしまう偽のパターン
+};
+
+// 本物の NDS オブジェクト（正解）
+struct SyntheticInstance {
+    uint8_t* mainRAM;
+    uint32_t mask;
+    const uint8_t* patternAt;
+};
+
+class SyntheticAddressSpace {
+public:
+    SyntheticAddressSpace() = default;
+    ~SyntheticAddressSpace();
+    SyntheticAddressSpace(const SyntheticAddressSpace&) = delete;
+    SyntheticAddressSpace& operator=(const SyntheticAddressSpace&) = delete;
+
+    // 確保できなければ false（作りかけの分は解放する）
+    bool Build(const SyntheticSpaceConfig& config);
+    void Release();
+
+    // スキャン対象の全領域（低アドレス順。MainRAM と偽物の大きな領域を含む）
+    const std::vector<HeapRegion>& GetRegions() const { return m_regions; }
+    const std::vector<SyntheticInstance>& GetInstances() const { return m_instances; }
+    const SyntheticSpaceConfig& GetConfig() const { return m_config; }
+    uint64_t GetTotalBytes() const { return m_totalBytes; }
+    uint64_t GetWrittenBytes() const { return m_writtenBytes; }     // 書き込んだページの合計（常駐する分）
+
+    // HeapScanConfig::isCommitted と同じ意味（address から領域末尾までが expectedSize 以上か）
+    bool IsCommitted(const void* address, size_t expectedSize) const;
+
+private:
+    uint8_t* Allocate(size_t size);
+
+    SyntheticSpaceConfig m_config;
+    std::vector<HeapRegion> m_allocations;  // 解放用（確保順）
+    std::vector<HeapRegion> m_regions;
+    std::vector<SyntheticInstance> m_instances;
+    uint64_t m_totalBytes = 0;
+    uint64_t m_writtenBytes = 0;
+};
+
+struct ScanBenchOptions {
+    unsigned threadCount = 0;               // 0 なら論理コア数
+    uint32_t repeat = 3;                    // 1実装・1モードあたりの回数（最速と平均を出す）
+};
+
+struct ScanBenchResult {
+    const char* impl = "";
+    bool findAll = false;
+    unsigned threads = 0;
+    double bestMs = 0;
+    double meanMs = 0;
+    uint64_t bytesScanned = 0;              // 走査したバイト数（触ったメモリ）
+    size_t candidates = 0;                  // isCommitted で確かめた数
+    size_t candidatesRejected = 0;
+    size_t hits = 0;                        // 返した MainRAM の数（打ち切りモードは0か1）
+    size_t falsePositives = 0;              // そのうち本物でないもの
+    size_t missed = 0;                      // 見つけられなかった本物（打ち切りモードは本物を返せなければ1）
+    bool matchesSerial = true;              // 同じ実装の1スレッドでの結果（MainRAM・マスク・位置・全候補の列）と同じ
+};
+
+// 使える実装毎に、打ち切り・全候補の両モードで走査する
+// それぞれ1スレッドでも1回走査し、結果が違えば matchesSerial を false にして stderr に出す
+std::vector<ScanBenchResult> RunHeapScanBenchmark(const SyntheticAddressSpace& space, const ScanBenchOptions& options);
+
+// 結果の表（1行1結果）
+std::string FormatScanBenchReport(const SyntheticAddressSpace& space, const std::vector<ScanBenchResult>& results);
@@ -0,0 +1,250 @@
+﻿#include "pch.h"
+#include "send_queue.h"
+#include <cstdio>
+
+// 空キューでの待機上限（通知漏れがあってもこの間隔で再確認する）
+static constexpr auto WRITER_IDLE_WAIT = std::chrono::milliseconds(100);
+
+static size_t RoundUpPowerOfTwo(size_t value) {
+    size_t result = 2;
+    while (result < value) result <<= 1;
+    return result;
+}
+
+SendQueue::SendQueue(size_t capacity)
+    : m_cells(RoundUpPowerOfTwo(capacity)), m_mask(m_cells.size() - 1) {
+    for (size_t i = 0; i < m_cells.size(); i++) {
+        m_cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+SendQueue::~SendQueue() {
+    Stop();
+}
+
+void SendQueue::Start(WriteFunc write, FailureFunc onFailure) {
+    if (m_running.load()) return;
+
+    m_write = std::move(write);
+    m_onFailure = std::move(onFailure);
+    m_overflowed = false;
+    m_failed = false;
+    m_maxDepth = 0;
+    m_sent = 0;
+    m_dropped = 0;
+    m_coalesced = 0;
+    m_lastLatencyUs = 0;
+    m_maxLatencyUs = 0;
+    m_totalLatencyUs = 0;
+
+    m_running = true;
+    m_thread = std::thread(&SendQueue::WriterThread, this);
+}
+
+void SendQueue::Stop(bool wait) {
+    if (!m_running.exchange(false)) return;
+
+    {
+        std::lock_guard<std::mutex> lock(m_waitMutex);
+        m_waitCv.notify_one();
+    }
+    if (!m_thread.joinable()) return;
+    if (!wait) {
+        m_thread.detach();
+        return;
+    }
+    m_thread.join();
+
+    // 未送信分を破棄（次の接続に持ち越さない）
+    SendBuffer discard;
+    Clock::time_point unused;
+    while (TryDequeue(discard, unused)) {}
+    TakeCoalesced(discard, unused);
+}
+
+bool SendQueue::Push(const SendBuffer& message, MessageClass cls) {
+    if (!message || !m_running.load() || m_failed.load()) return false;
+
+    Clock::time_point now = Clock::now();
+
+    // 退避中の Delta があるなら、順序を保つため以降の Delta も退避スロットへ上書きする
+    if (cls == MessageClass::Delta && m_policy == OverflowPolicy::Coalesce && m_hasCoalesced.load()) {
+        StoreCoalesced(message, now);
+        Wake();
+        return true;
+    }
+
+    if (TryEnqueue(message, now)) {
+        size_t depth = m_enqueuePos.load(std::memory_order_relaxed) - m_dequeuePos.load(std::memory_order_relaxed);
+        size_t maxDepth = m_maxDepth.load(std::memory_order_relaxed);
+        while (depth > maxDepth && !m_maxDepth.compare_exchange_weak(maxDepth, depth)) {}
+        Wake();
+        return true;
+    }
+
+    // キュー満杯
+    if (cls == MessageClass::Delta) {
+        switch (m_policy) {
+        case OverflowPolicy::Drop:
+            m_dropped++;
+            return false;
+        case OverflowPolicy::Coalesce:
+            StoreCoalesced(message, now);
+            Wake();
+            return true;
+        case OverflowPolicy::Disconnect:
+            break;
+        }
+    }
+
+    // 捨てられないメッセージが積めない、または Disconnect 指定 → 切断要求
+    if (!m_overflowed.exchange(true)) {
+        printf("[SendQueue] キュー溢れ → 切断要求\n");
+    }
+    Fail();
+    return false;
+}
+
+bool SendQueue::IsBusy() const {
+    return m_writing.load() || !IsEmpty();
+}
+
+SendQueueStats SendQueue::GetStats() const {
+    SendQueueStats stats;
+    size_t enqueued = m_enqueuePos.load(std::memory_order_relaxed);
+    size_t dequeued = m_dequeuePos.load(std::memory_order_relaxed);
+    stats.depth = (enqueued > dequeued ? enqueued - dequeued : 0) + (m_hasCoalesced.load() ? 1 : 0);
+    stats.maxDepth = m_maxDepth.load();
+    stats.sent = m_sent.load();
+    stats.dropped = m_dropped.load();
+    stats.coalesced = m_coalesced.load();
+    stats.lastLatencyUs = m_lastLatencyUs.load();
+    stats.maxLatencyUs = m_maxLatencyUs.load();
+    stats.avgLatencyUs = stats.sent ? m_totalLatencyUs.load() / stats.sent : 0;
+    stats.overflowed = m_overflowed.load();
+    return stats;
+}
+
+bool SendQueue::TryEnqueue(const SendBuffer& message, Clock::time_point now) {
+    size_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+    Cell* cell;
+    for (;;) {
+        cell = &m_cells[pos & m_mask];
+        size_t seq = cell->sequence.load(std::memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+        if (diff == 0) {
+            if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+        } else if (diff < 0) {
+            return false;  // 満杯
+        } else {
+            pos = m_enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+    cell->data = message;
+    cell->enqueuedAt = now;
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+bool SendQueue::TryDequeue(SendBuffer& out, Clock::time_point& enqueuedAt) {
+    size_t pos = m_dequeuePos.load(std::memory_order_relaxed);
+    Cell* cell;
+    for (;;) {
+        cell = &m_cells[pos & m_mask];
+        size_t seq = cell->sequence.load(std::memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+        if (diff == 0) {
+            if (m_dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+        } else if (diff < 0) {
+            return false;  // 空
+        } else {
+            pos = m_dequeuePos.load(std::memory_order_relaxed);
+        }
+    }
+    out = std::move(cell->data);
+    enqueuedAt = cell->enqueuedAt;
+    cell->sequence.store(pos + m_mask + 1, std::memory_order_release);
+    return true;
+}
+
+void SendQueue::StoreCoalesced(const SendBuffer& message, Clock::time_point now) {
+    std::lock_guard<std::mutex> lock(m_coalesceMutex);
+    if (m_hasCoalesced.load()) {
+        m_coalesced++;
+    } else {
+        m_coalescedAt = now;  // 遅延は最初に退避した時刻から測る
+    }
+    m_coalescedData = message;
+    m_hasCoalesced = true;
+}
+
+bool SendQueue::TakeCoalesced(SendBuffer& out, Clock::time_point& enqueuedAt) {
+    if (!m_hasCoalesced.load()) return false;
+    std::lock_guard<std::mutex> lock(m_coalesceMutex);
+    if (!m_hasCoalesced.load()) return false;
+    out = std::move(m_coalescedData);
+    enqueuedAt = m_coalescedAt;
+    m_hasCoalesced = false;
+    return true;
+}
+
+bool SendQueue::IsEmpty() const {
+    size_t pos = m_dequeuePos.load(std::memory_order_relaxed);
+    const Cell& cell = m_cells[pos & m_mask];
+    return cell.sequence.load(std::memory_order_acquire) != pos + 1 && !m_hasCoalesced.load();
+}
+
+void SendQueue::Wake() {
+    // 投入（リングへの書き込み）と m_waiting の読み出しの順序を保証する
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_waiting.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> lock(m_waitMutex);
+        m_waitCv.notify_one();
+    }
+}
+
+void SendQueue::Fail() {
+    if (m_failed.exchange(true)) return;
+    if (m_onFailure) m_onFailure();
+}
+
+void SendQueue::WriterThread() {
+    SendBuffer message;
+    Clock::time_point enqueuedAt;
+
+    while (m_running.load()) {
+        // リングを先に空にし、退避スロットは最後に送る（退避分が一番新しい）
+        // 取り出す前に書き込み中にしておき、取り出しから書き込み完了までを IsBusy に含める
+        m_writing = true;
+        if (TryDequeue(message, enqueuedAt) || TakeCoalesced(message, enqueuedAt)) {
+            bool ok = m_write(*message);
+            message.reset();  // 共有バッファの参照をすぐに手放す
+            m_writing = false;
+            if (!ok) {
+                printf("[SendQueue] 書き込み失敗 → 切断要求\n");
+                Fail();
+                break;
+            }
+            Clock::duration latency = Clock::now() - enqueuedAt;
+            uint64_t latencyUs = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(latency).count();
+            if (m_latencyStats && m_latencyStats->IsEnabled()) {
+                m_latencyStats->Record(LatencyStage::Send,
+                    (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(latency).count());
+            }
+            m_lastLatencyUs = latencyUs;
+            if (latencyUs > m_maxLatencyUs.load()) m_maxLatencyUs = latencyUs;
+            m_totalLatencyUs += latencyUs;
+            m_sent++;
+            continue;
+        }
+        m_writing = false;
+
+        std::unique_lock<std::mutex> lock(m_waitMutex);
+        m_waiting.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_running.load() && IsEmpty()) {
+            m_waitCv.wait_for(lock, WRITER_IDLE_WAIT);
+        }
+        m_waiting.store(false, std::memory_order_relaxed);
+    }
+}
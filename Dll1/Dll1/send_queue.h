@@ -0,0 +1,146 @@
+﻿#pragma once
+// send_queue.h : 送信キュー（専用の書き込みスレッドで送信）
+// 送信元スレッドは有界ロックフリーキューに積むだけで戻るため、
+// 遅い・止まったクライアントがポーリングループやコマンド処理を止めない
+// 転送方式には依存しない（実際の書き込みは Start に渡す関数で行う）
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+#include <memory>
+#include "latency_stats.h"
+
+// キュー満杯時の扱い（MessageClass::Delta のみ対象。Control は満杯なら常に切断）
+enum class OverflowPolicy : uint8_t {
+    Drop,        // 新しいメッセージを捨てる
+    Coalesce,    // 退避スロット1件に上書きし、最新のものだけを残す
+    Disconnect,  // クライアントを切断する
+};
+
+enum class MessageClass : uint8_t {
+    Control,  // 捨てられないメッセージ（hello / status / full / error など）
+    Delta,    // 捨てても seq の欠落から resume で回復できるメッセージ
+};
+
+// 送信バッファの中身の種類（WebSocket ではこれで Text / Binary のどちらのメッセージにするかを決める）
+enum class PayloadKind : uint8_t {
+    Line,    // LF 終端の JSON の1行
+    Frame,   // バイナリフレーム（[u32 長さ][種別][本体]）
+};
+
+struct SendPayload {
+    std::string bytes;
+    PayloadKind kind = PayloadKind::Line;
+};
+
+// 送信バッファ（ブロードキャスト時は全クライアントのキューで同じバッファを共有する）
+using SendBuffer = std::shared_ptr<const SendPayload>;
+
+struct SendQueueStats {
+    size_t depth = 0;            // 未送信件数（退避スロットを含む）
+    size_t maxDepth = 0;         // 接続後の最大未送信件数
+    uint64_t sent = 0;           // 送信済み件数
+    uint64_t dropped = 0;        // Drop で捨てた件数
+    uint64_t coalesced = 0;      // Coalesce で上書きされた件数
+    uint64_t lastLatencyUs = 0;  // 直近の投入→送信完了までの時間
+    uint64_t maxLatencyUs = 0;
+    uint64_t avgLatencyUs = 0;
+    bool overflowed = false;     // 溢れにより切断要求を出した
+};
+
+class SendQueue {
+public:
+    // 1件をすべて書き込むまでブロックする。失敗したら false
+    using WriteFunc = std::function<bool(const SendPayload& payload)>;
+    // 書き込み失敗・溢れによる切断要求
+    using FailureFunc = std::function<void()>;
+
+    // capacity は2の累乗に切り上げる
+    explicit SendQueue(size_t capacity = 256);
+    ~SendQueue();
+
+    SendQueue(const SendQueue&) = delete;
+    SendQueue& operator=(const SendQueue&) = delete;
+
+    void SetPolicy(OverflowPolicy policy) { m_policy = policy; }
+    OverflowPolicy GetPolicy() const { return m_policy; }
+
+    // 投入→送信完了までの時間を LatencyStage::Send に記録する先（nullptr なら記録しない）
+    void SetLatencyStats(LatencyStats* stats) { m_latencyStats = stats; }
+
+    // 書き込みスレッドを開始（統計はリセットされる）
+    void Start(WriteFunc write, FailureFunc onFailure);
+
+    // 書き込みスレッドを停止し、未送信のメッセージを破棄する
+    // wait=false の場合はスレッドの終了を待たない（DLLアンロード時用）
+    void Stop(bool wait = true);
+
+    // メッセージを積む。捨てられた場合・停止中は false
+    bool Push(const SendBuffer& message, MessageClass cls);
+
+    SendQueueStats GetStats() const;
+
+    // 未送信・書き込み中のメッセージがあるか（送信が空くまで delta を合流させる判断に使う）
+    bool IsBusy() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Cell {
+        std::atomic<size_t> sequence{ 0 };
+        SendBuffer data;
+        Clock::time_point enqueuedAt;
+    };
+
+    bool TryEnqueue(const SendBuffer& message, Clock::time_point now);
+    bool TryDequeue(SendBuffer& out, Clock::time_point& enqueuedAt);
+    void StoreCoalesced(const SendBuffer& message, Clock::time_point now);
+    bool TakeCoalesced(SendBuffer& out, Clock::time_point& enqueuedAt);
+    bool IsEmpty() const;
+    void Wake();
+    void Fail();
+    void WriterThread();
+
+    // リング本体（Vyukov 方式の有界MPMCキュー。送信元は複数、取り出しは書き込みスレッドのみ）
+    std::vector<Cell> m_cells;
+    size_t m_mask;
+    std::atomic<size_t> m_enqueuePos{ 0 };
+    std::atomic<size_t> m_dequeuePos{ 0 };
+
+    // Coalesce 用の退避スロット（溢れた時だけ使う低頻度パス）
+    std::mutex m_coalesceMutex;
+    SendBuffer m_coalescedData;
+    Clock::time_point m_coalescedAt;
+    std::atomic<bool> m_hasCoalesced{ false };
+
+    OverflowPolicy m_policy = OverflowPolicy::Coalesce;
+    LatencyStats* m_latencyStats = nullptr;
+    WriteFunc m_write;
+    FailureFunc m_onFailure;
+
+    std::thread m_thread;
+    std::atomic<bool> m_running{ false };
+    std::atomic<bool> m_overflowed{ false };
+    std::atomic<bool> m_failed{ false };     // 切断要求済み（以降は積まない）
+    std::atomic<bool> m_writing{ false };    // 書き込みスレッドが取り出し・書き込み中
+
+    // 書き込みスレッドの待機（キューが空の時だけ眠る）
+    std::mutex m_waitMutex;
+    std::condition_variable m_waitCv;
+    std::atomic<bool> m_waiting{ false };
+
+    // 統計
+    std::atomic<size_t> m_maxDepth{ 0 };
+    std::atomic<uint64_t> m_sent{ 0 };
+    std::atomic<uint64_t> m_dropped{ 0 };
+    std::atomic<uint64_t> m_coalesced{ 0 };
+    std::atomic<uint64_t> m_lastLatencyUs{ 0 };
+    std::atomic<uint64_t> m_maxLatencyUs{ 0 };
+    std::atomic<uint64_t> m_totalLatencyUs{ 0 };
+};
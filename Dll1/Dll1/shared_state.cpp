@@ -0,0 +1,395 @@
+﻿#include "pch.h"
+#include "shared_state.h"
+#include "delta_tracker.h"
+#include "bit_util.h"
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <thread>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+static constexpr size_t SECTION_ALIGN = 64;
+
+static size_t AlignUp(size_t value, size_t align) {
+    return (value + align - 1) & ~(align - 1);
+}
+
+static uint32_t RoundUpPowerOfTwo(uint32_t value) {
+    uint32_t result = 2;
+    while (result < value) result <<= 1;
+    return result;
+}
+
+// ========================================
+// SharedMemoryRegion
+// ========================================
+
+#ifdef _WIN32
+
+bool SharedMemoryRegion::Open(const char* name, size_t size, bool create) {
+    Close();
+
+    HANDLE mapping;
+    if (create) {
+        mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+                                     (DWORD)((uint64_t)size >> 32), (DWORD)size, name);
+        if (mapping && GetLastError() == ERROR_ALREADY_EXISTS) {
+            // 別のインスタンスが使用中（ゼロ初期化もサイズも保証されない）
+            printf("[SharedState] 共有メモリは使用中: %s\n", name);
+            CloseHandle(mapping);
+            return false;
+        }
+    } else {
+        mapping = OpenFileMappingA(FILE_MAP_READ | FILE_MAP_WRITE, FALSE, name);
+    }
+    if (!mapping) {
+        printf("[SharedState] ファイルマッピング失敗: %s (%lu)\n", name, GetLastError());
+        return false;
+    }
+
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ | FILE_MAP_WRITE, 0, 0, create ? size : 0);
+    if (!view) {
+        printf("[SharedState] MapViewOfFile失敗: %lu\n", GetLastError());
+        CloseHandle(mapping);
+        return false;
+    }
+
+    if (!create) {
+        // 既存のマッピングのサイズはビューの領域サイズから得る（ページ単位に切り上がっている）
+        MEMORY_BASIC_INFORMATION mbi;
+        size = VirtualQuery(view, &mbi, sizeof(mbi)) ? mbi.RegionSize : 0;
+    }
+
+    m_mapping = mapping;
+    m_data = static_cast<uint8_t*>(view);
+    m_size = size;
+    m_name = name;
+    m_owner = create;
+    return true;
+}
+
+void SharedMemoryRegion::Close() {
+    if (m_data) {
+        UnmapViewOfFile(m_data);
+        m_data = nullptr;
+    }
+    if (m_mapping) {
+        CloseHandle(m_mapping);
+        m_mapping = nullptr;
+    }
+    m_size = 0;
+    m_owner = false;
+}
+
+#else
+
+bool SharedMemoryRegion::Open(const char* name, size_t size, bool create) {
+    Close();
+
+    // 作成時は古いものが残っていても切り詰めてゼロから作り直す
+    int fd = create ? shm_open(name, O_CREAT | O_RDWR | O_TRUNC, 0600)
+                    : shm_open(name, O_RDWR, 0);
+    if (fd < 0) {
+        printf("[SharedState] shm_open失敗: %s\n", name);
+        return false;
+    }
+
+    if (create) {
+        if (ftruncate(fd, (off_t)size) != 0) {
+            printf("[SharedState] ftruncate失敗: %s\n", name);
+            close(fd);
+            shm_unlink(name);
+            return false;
+        }
+    } else {
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+            close(fd);
+            return false;
+        }
+        size = (size_t)st.st_size;
+    }
+
+    void* view = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED) {
+        printf("[SharedState] mmap失敗: %s\n", name);
+        if (create) shm_unlink(name);
+        return false;
+    }
+
+    m_data = static_cast<uint8_t*>(view);
+    m_size = size;
+    m_name = name;
+    m_owner = create;
+    return true;
+}
+
+void SharedMemoryRegion::Close() {
+    if (m_data) {
+        munmap(m_data, m_size);
+        m_data = nullptr;
+    }
+    // 名前を消しても、マップ済みの読み取り側は閉じるまで読める
+    if (m_owner) {
+        shm_unlink(m_name.c_str());
+    }
+    m_size = 0;
+    m_owner = false;
+}
+
+#endif
+
+// ========================================
+// SharedStateChannel（書き込み側）
+// ========================================
+
+bool SharedStateChannel::Create(const char* name, uint32_t valueCapacity, uint32_t ringCapacity) {
+    Close();
+
+    ringCapacity = RoundUpPowerOfTwo(ringCapacity);
+    size_t bitWords = BitWordCount(valueCapacity);
+
+    size_t nameTableOffset = AlignUp(sizeof(SharedStateHeader), SECTION_ALIGN);
+    size_t statePageOffset = AlignUp(nameTableOffset + sizeof(SharedNameEntry) * valueCapacity, SECTION_ALIGN);
+    size_t bitsOffset = statePageOffset + sizeof(SharedStatePage);
+    size_t valuesOffset = bitsOffset + sizeof(uint64_t) * bitWords;
+    size_t ringOffset = AlignUp(valuesOffset + sizeof(uint32_t) * valueCapacity, SECTION_ALIGN);
+    size_t totalSize = ringOffset + sizeof(SharedDeltaRecord) * ringCapacity;
+
+    if (!m_region.Open(name, totalSize, true)) return false;
+
+    uint8_t* base = m_region.GetData();
+    m_header = reinterpret_cast<SharedStateHeader*>(base);
+    m_nameTable = reinterpret_cast<SharedNameEntry*>(base + nameTableOffset);
+    m_statePage = reinterpret_cast<SharedStatePage*>(base + statePageOffset);
+    m_initializedBits = reinterpret_cast<std::atomic<uint64_t>*>(base + bitsOffset);
+    m_values = reinterpret_cast<std::atomic<uint32_t>*>(base + valuesOffset);
+    m_ring = reinterpret_cast<SharedDeltaRecord*>(base + ringOffset);
+    m_name = name;
+    m_generation = 0;
+    m_publishedCount = 0;
+
+    // 領域はゼロ初期化済み。レイアウトを書いてから magic と writerActive で公開する
+    m_header->layoutVersion = SHARED_STATE_LAYOUT_VERSION;
+    m_header->totalSize = (uint32_t)totalSize;
+    m_header->valueCapacity = valueCapacity;
+    m_header->ringCapacity = ringCapacity;
+    m_header->nameTableOffset = (uint32_t)nameTableOffset;
+    m_header->statePageOffset = (uint32_t)statePageOffset;
+    m_header->ringOffset = (uint32_t)ringOffset;
+    m_header->magic = SHARED_STATE_MAGIC;
+    m_header->writerActive.store(1, std::memory_order_release);
+
+    printf("[SharedState] 開始: %s (%zu bytes, 値%u件, リング%u件)\n",
+           name, totalSize, valueCapacity, ringCapacity);
+    return true;
+}
+
+void SharedStateChannel::Close() {
+    if (m_header) {
+        m_header->writerActive.store(0, std::memory_order_release);
+        printf("[SharedState] 停止\n");
+    }
+    m_region.Close();
+    m_header = nullptr;
+    m_nameTable = nullptr;
+    m_statePage = nullptr;
+    m_initializedBits = nullptr;
+    m_values = nullptr;
+    m_ring = nullptr;
+}
+
+bool SharedStateChannel::HasReaders() const {
+    return m_header && m_header->readerCount.load(std::memory_order_relaxed) > 0;
+}
+
+uint64_t SharedStateChannel::BeginWrite() {
+    // sequence を奇数にしてから書き込む（読み取り側は奇数・前後不一致なら読み直す）
+    uint64_t sequence = m_statePage->sequence.load(std::memory_order_relaxed) + 1;
+    m_statePage->sequence.store(sequence, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    return sequence;
+}
+
+void SharedStateChannel::EndWrite(uint64_t sequence) {
+    m_statePage->sequence.store(sequence + 1, std::memory_order_release);
+}
+
+void SharedStateChannel::PublishNameTable(const DeltaTracker& tracker) {
+    if (!m_header) return;
+
+    uint32_t capacity = m_header->valueCapacity;
+    uint32_t count = (uint32_t)(std::min)(tracker.GetAddressCount(), (size_t)capacity);
+    if (count < tracker.GetAddressCount()) {
+        printf("[SharedState] 登録数 %zu が容量 %u を超過（超過分は共有しない）\n",
+               tracker.GetAddressCount(), capacity);
+    }
+
+    uint64_t sequence = BeginWrite();
+    for (uint32_t id = 0; id < count; id++) {
+        SharedNameEntry& entry = m_nameTable[id];
+        const char* name = tracker.GetName(id);
+        memset(&entry, 0, sizeof(entry));
+        memcpy(entry.name, name, (std::min)(strlen(name), (size_t)SHARED_STATE_NAME_LENGTH - 1));
+        entry.dsAddress = tracker.GetAddress(id);
+        entry.size = tracker.GetSize(id);
+        m_values[id].store(0, std::memory_order_relaxed);
+    }
+    for (size_t w = 0; w < BitWordCount(capacity); w++) {
+        m_initializedBits[w].store(0, std::memory_order_relaxed);
+    }
+    m_generation++;
+    m_publishedCount = count;
+    m_statePage->valueCount.store(count, std::memory_order_relaxed);
+    m_statePage->generation.store(m_generation, std::memory_order_relaxed);
+    EndWrite(sequence);
+}
+
+void SharedStateChannel::PublishDelta(const DeltaTracker& tracker, uint64_t seq) {
+    if (!m_header) return;
+
+    // 最新状態を先に更新する（読み取り側はリング位置→最新状態の順に読むため、
+    // スナップショットはそれ以前のレコードをすべて含む）
+    uint64_t sequence = BeginWrite();
+    tracker.ForEachChanged([&](uint32_t id) {
+        if (id >= m_publishedCount) return;
+        m_values[id].store(tracker.GetValue(id), std::memory_order_relaxed);
+        std::atomic<uint64_t>& word = m_initializedBits[id >> 6];
+        word.store(word.load(std::memory_order_relaxed) | (1ULL << (id & 63)), std::memory_order_relaxed);
+    });
+    m_statePage->deltaSeq.store(seq, std::memory_order_relaxed);
+    EndWrite(sequence);
+
+    // 変化1件 = 1レコード。各レコードは stamp で個別に保護する
+    uint64_t pos = m_header->ringHead.load(std::memory_order_relaxed);
+    uint64_t mask = m_header->ringCapacity - 1;
+    tracker.ForEachChanged([&](uint32_t id) {
+        if (id >= m_publishedCount) return;
+        SharedDeltaRecord& record = m_ring[pos & mask];
+        record.stamp.store(pos * 2 + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        record.deltaSeq.store(seq, std::memory_order_relaxed);
+        record.generation.store(m_generation, std::memory_order_relaxed);
+        record.id.store(id, std::memory_order_relaxed);
+        record.value.store(tracker.GetValue(id), std::memory_order_relaxed);
+        record.stamp.store(pos * 2 + 2, std::memory_order_release);
+        pos++;
+    });
+    m_header->ringHead.store(pos, std::memory_order_release);
+}
+
+// ========================================
+// SharedStateReader（読み取り側）
+// ========================================
+
+bool SharedStateReader::Open(const char* name) {
+    Close();
+    if (!m_region.Open(name, 0, false)) return false;
+
+    SharedStateHeader* header = reinterpret_cast<SharedStateHeader*>(m_region.GetData());
+    if (m_region.GetSize() < sizeof(SharedStateHeader) ||
+        !header->writerActive.load(std::memory_order_acquire) ||
+        header->magic != SHARED_STATE_MAGIC ||
+        header->layoutVersion != SHARED_STATE_LAYOUT_VERSION ||
+        header->totalSize > m_region.GetSize()) {
+        m_region.Close();
+        return false;
+    }
+
+    m_header = header;
+    m_header->readerCount.fetch_add(1);
+    m_cursor = m_header->ringHead.load(std::memory_order_acquire);
+    m_snapshotSeq = 0;
+    return true;
+}
+
+void SharedStateReader::Close() {
+    if (m_header) {
+        m_header->readerCount.fetch_sub(1);
+        m_header = nullptr;
+    }
+    m_region.Close();
+}
+
+bool SharedStateReader::IsWriterActive() const {
+    return m_header && m_header->writerActive.load(std::memory_order_acquire);
+}
+
+void SharedStateReader::ReadSnapshot(SharedStateSnapshot& out) {
+    if (!m_header) return;
+
+    const uint8_t* base = m_region.GetData();
+    const SharedNameEntry* nameTable = reinterpret_cast<const SharedNameEntry*>(base + m_header->nameTableOffset);
+    SharedStatePage* page = reinterpret_cast<SharedStatePage*>(m_region.GetData() + m_header->statePageOffset);
+    auto* bits = reinterpret_cast<std::atomic<uint64_t>*>(page + 1);
+    auto* values = reinterpret_cast<std::atomic<uint32_t>*>(bits + BitWordCount(m_header->valueCapacity));
+
+    // リング位置を先に取る（この位置より前のレコードはスナップショットに反映済み）
+    m_cursor = m_header->ringHead.load(std::memory_order_acquire);
+
+    for (;;) {
+        uint64_t before = page->sequence.load(std::memory_order_acquire);
+        if (before & 1) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        uint32_t count = (std::min)(page->valueCount.load(std::memory_order_relaxed), m_header->valueCapacity);
+        out.deltaSeq = page->deltaSeq.load(std::memory_order_relaxed);
+        out.generation = page->generation.load(std::memory_order_relaxed);
+        out.names.resize(count);
+        out.addresses.resize(count);
+        out.sizes.resize(count);
+        out.initialized.resize(count);
+        out.values.resize(count);
+        for (uint32_t id = 0; id < count; id++) {
+            SharedNameEntry entry;
+            memcpy(&entry, &nameTable[id], sizeof(entry));
+            entry.name[SHARED_STATE_NAME_LENGTH - 1] = '\0';
+            out.names[id] = entry.name;
+            out.addresses[id] = entry.dsAddress;
+            out.sizes[id] = entry.size;
+            out.initialized[id] = (bits[id >> 6].load(std::memory_order_relaxed) >> (id & 63)) & 1;
+            out.values[id] = values[id].load(std::memory_order_relaxed);
+        }
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (page->sequence.load(std::memory_order_relaxed) == before) break;
+    }
+
+    m_snapshotSeq = out.deltaSeq;
+}
+
+bool SharedStateReader::Poll(std::vector<SharedDeltaChange>& out) {
+    if (!m_header) return false;
+
+    const SharedDeltaRecord* ring = reinterpret_cast<const SharedDeltaRecord*>(m_region.GetData() + m_header->ringOffset);
+    uint64_t capacity = m_header->ringCapacity;
+    uint64_t head = m_header->ringHead.load(std::memory_order_acquire);
+    if (head - m_cursor > capacity) return false;
+
+    for (; m_cursor < head; m_cursor++) {
+        const SharedDeltaRecord& record = ring[m_cursor & (capacity - 1)];
+        uint64_t expected = m_cursor * 2 + 2;
+        if (record.stamp.load(std::memory_order_acquire) != expected) return false;
+
+        SharedDeltaChange change;
+        change.deltaSeq = record.deltaSeq.load(std::memory_order_relaxed);
+        change.generation = record.generation.load(std::memory_order_relaxed);
+        change.id = record.id.load(std::memory_order_relaxed);
+        change.value = record.value.load(std::memory_order_relaxed);
+
+        // 読んでいる間に上書きされていないか
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (record.stamp.load(std::memory_order_relaxed) != expected) return false;
+
+        if (change.deltaSeq > m_snapshotSeq) out.push_back(change);
+    }
+    return true;
+}
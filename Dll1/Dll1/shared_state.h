@@ -0,0 +1,173 @@
+﻿#pragma once
+// shared_state.h : 共有メモリ転送（同一マシン上のツール向け）
+// パイプと並行して、最新状態と変化履歴を共有メモリに書き出す。読み取り側はマップして直接読むため、
+// JSON のエンコード・カーネル経由のコピー・再パースが不要（読み取りのホットパスにシステムコールもない）
+// 書き込みは g_trackerMutex を保持したポーリングスレッドのみ（単一プロデューサー）
+//
+// レイアウト（各セクションは64バイト境界、整数はリトルエンディアン）
+//   SharedStateHeader
+//   名前表   : SharedNameEntry × valueCapacity
+//   最新状態 : SharedStatePage, u64 初期化ビット × ワード数, u32 値 × valueCapacity
+//              seqlock で保護（sequence が奇数の間は書き込み中。読み取り前後で一致すれば一貫している）
+//   リング   : SharedDeltaRecord × ringCapacity
+//              変化した値1件 = 1レコード。単一プロデューサー・複数コンシューマーで、
+//              読み取り側は自分の位置を持ち、追い越されたら最新状態から読み直す
+
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <string>
+#include <vector>
+
+class DeltaTracker;
+
+constexpr uint32_t SHARED_STATE_MAGIC = 0x53525353;   // "SSRS"
+constexpr uint32_t SHARED_STATE_LAYOUT_VERSION = 1;
+constexpr uint32_t SHARED_STATE_NAME_LENGTH = 32;     // NUL終端を含む
+
+struct SharedStateHeader {
+    uint32_t magic;
+    uint32_t layoutVersion;
+    uint32_t totalSize;
+    uint32_t valueCapacity;
+    uint32_t ringCapacity;              // 2の累乗
+    uint32_t nameTableOffset;
+    uint32_t statePageOffset;
+    uint32_t ringOffset;
+    std::atomic<uint32_t> writerActive; // 書き込み側が動作中なら1
+    std::atomic<uint32_t> readerCount;  // 接続中の読み取り側（0の間はポーリングを止めてよい）
+    uint32_t reserved[6];
+    alignas(64) std::atomic<uint64_t> ringHead;  // 書き込み済みレコード数（次に書く位置）
+};
+
+struct SharedNameEntry {
+    char name[SHARED_STATE_NAME_LENGTH];
+    uint32_t dsAddress;
+    uint8_t size;
+    uint8_t reserved[3];
+};
+
+struct SharedStatePage {
+    std::atomic<uint64_t> sequence;     // seqlock
+    std::atomic<uint64_t> deltaSeq;     // 反映済みの最新 delta seq
+    std::atomic<uint32_t> valueCount;   // 名前表の有効件数
+    std::atomic<uint32_t> generation;   // 名前表を書き換える度に+1
+    uint32_t reserved[10];
+};
+
+struct SharedDeltaRecord {
+    std::atomic<uint64_t> stamp;        // 書き込み中は 位置*2+1、完了後は 位置*2+2
+    std::atomic<uint64_t> deltaSeq;
+    std::atomic<uint32_t> generation;
+    std::atomic<uint32_t> id;
+    std::atomic<uint32_t> value;
+    uint32_t reserved;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "共有メモリにはロックフリーな64bit atomicが必要");
+static_assert(sizeof(SharedNameEntry) == 40, "SharedNameEntry のサイズが変わった");
+static_assert(sizeof(SharedStatePage) == 64, "SharedStatePage のサイズが変わった");
+static_assert(sizeof(SharedDeltaRecord) == 32, "SharedDeltaRecord のサイズが変わった");
+
+// 共有メモリの確保・解放（Windows: 名前付きファイルマッピング / Linux: shm_open）
+class SharedMemoryRegion {
+public:
+    SharedMemoryRegion() = default;
+    ~SharedMemoryRegion() { Close(); }
+
+    SharedMemoryRegion(const SharedMemoryRegion&) = delete;
+    SharedMemoryRegion& operator=(const SharedMemoryRegion&) = delete;
+
+    // create=true なら作成（ゼロ初期化される）、false なら既存のものを開く（size=0 で全体）
+    bool Open(const char* name, size_t size, bool create);
+    void Close();
+
+    uint8_t* GetData() const { return m_data; }
+    size_t GetSize() const { return m_size; }
+
+private:
+    uint8_t* m_data = nullptr;
+    size_t m_size = 0;
+    std::string m_name;
+    bool m_owner = false;
+#ifdef _WIN32
+    void* m_mapping = nullptr;
+#endif
+};
+
+// 書き込み側（DLL）
+class SharedStateChannel {
+public:
+    // 共有メモリを作成してヘッダーを初期化。ringCapacity は2の累乗に切り上げる
+    bool Create(const char* name, uint32_t valueCapacity, uint32_t ringCapacity);
+    void Close();
+
+    bool IsOpen() const { return m_header != nullptr; }
+    const char* GetName() const { return m_name.c_str(); }
+    size_t GetSize() const { return m_region.GetSize(); }
+
+    // 読み取り側が接続しているか
+    bool HasReaders() const;
+
+    // 登録内容を名前表に書き出す（世代が変わり、最新状態は未初期化に戻る）
+    void PublishNameTable(const DeltaTracker& tracker);
+
+    // 変化した値を最新状態とリングに書き出す（ResetChangeFlags の前に呼ぶ）
+    void PublishDelta(const DeltaTracker& tracker, uint64_t seq);
+
+private:
+    uint64_t BeginWrite();
+    void EndWrite(uint64_t sequence);
+
+    SharedMemoryRegion m_region;
+    std::string m_name;
+    SharedStateHeader* m_header = nullptr;
+    SharedNameEntry* m_nameTable = nullptr;
+    SharedStatePage* m_statePage = nullptr;
+    std::atomic<uint64_t>* m_initializedBits = nullptr;
+    std::atomic<uint32_t>* m_values = nullptr;
+    SharedDeltaRecord* m_ring = nullptr;
+    uint32_t m_generation = 0;
+    uint32_t m_publishedCount = 0;      // 名前表に書き出した件数（容量で頭打ち）
+};
+
+// 読み取り側（ローカルツール用）
+struct SharedStateSnapshot {
+    uint64_t deltaSeq = 0;
+    uint32_t generation = 0;
+    std::vector<std::string> names;
+    std::vector<uint32_t> addresses;
+    std::vector<uint8_t> sizes;
+    std::vector<uint8_t> initialized;
+    std::vector<uint32_t> values;
+};
+
+struct SharedDeltaChange {
+    uint64_t deltaSeq;
+    uint32_t generation;
+    uint32_t id;
+    uint32_t value;
+};
+
+class SharedStateReader {
+public:
+    ~SharedStateReader() { Close(); }
+
+    bool Open(const char* name);
+    void Close();
+
+    // 最新状態を一貫した状態で取得し、リングの読み取り位置を現在に合わせる
+    void ReadSnapshot(SharedStateSnapshot& out);
+
+    // 前回以降の変化を古い順に out へ追加する
+    // 追い越された（リングが一周した）場合は false。ReadSnapshot からやり直す
+    bool Poll(std::vector<SharedDeltaChange>& out);
+
+    bool IsWriterActive() const;
+
+private:
+    SharedMemoryRegion m_region;
+    SharedStateHeader* m_header = nullptr;
+    uint64_t m_cursor = 0;
+    uint64_t m_snapshotSeq = 0;     // これ以前の delta はスナップショットに反映済み
+};
@@ -0,0 +1,215 @@
+﻿#include "pch.h"
+// tracker_bench.cpp : DeltaTracker::Update の計測（合成 4MB MainRAM イメージ）
+// 旧方式（値毎に1回読む）と読み取りプラン（近接する値を1区間にまとめて読む）で、
+// 1ティックあたりの読み取り回数・バイト数・時間を比べる
+#include "bench_entry.h"
+#include "delta_tracker.h"
+#include "monitor.h"
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+struct TrackerBenchConfig {
+    uint64_t seed = 1;
+    uint32_t values = 147;          // 登録する値の数（RJ 版のアドレス表と同程度）
+    uint32_t ticks = 100000;
+    uint32_t changesPerTick = 3;    // 1ティックに書き換える値の数（変化しやすい2割の値から選ぶ）
+    uint32_t unreadable = 0;        // 読み取りが常に失敗する値の数（解放済みページ等の模擬）
+};
+
+struct TrackerBenchLayout {
+    std::vector<std::string> names;
+    std::vector<uint32_t> addresses;
+    std::vector<uint8_t> sizes;
+    std::vector<PollTier> tiers;
+};
+
+// 読み取りの統計（コールバックは関数ポインタなので静的に持つ）
+static std::vector<uint8_t> s_ram;
+static uint32_t s_badBegin = 0, s_badEnd = 0;  // この範囲に掛かる読み取りは失敗させる
+static uint64_t s_readCalls = 0;
+static uint64_t s_readBytes = 0;
+
+static bool BenchBlockRead(uint32_t ramOffset, uint32_t length, uint8_t* outBuffer) {
+    s_readCalls++;
+    if (ramOffset < s_badEnd && ramOffset + length > s_badBegin) return false;
+    if ((size_t)ramOffset + length > s_ram.size()) return false;
+    memcpy(outBuffer, s_ram.data() + ramOffset, length);
+    s_readBytes += length;
+    return true;
+}
+
+// ゲームの構造体のように、数個〜30個の連続したフィールドの塊を散らばらせる（階層は塊毎）
+static TrackerBenchLayout BuildLayout(const TrackerBenchConfig& config, std::mt19937_64& rng) {
+    TrackerBenchLayout layout;
+    static const uint8_t SIZES[] = { 1, 2, 2, 4 };
+    while (layout.addresses.size() < config.values) {
+        uint32_t cluster = 1 + (uint32_t)(rng() % 30);
+        uint32_t offset = (uint32_t)(rng() % (DS_MAIN_RAM_SIZE - 0x2000)) & ~3u;
+        uint64_t r = rng() % 10;
+        PollTier tier = r < 2 ? PollTier::Hot : (r < 7 ? PollTier::Warm : PollTier::Cold);
+        for (uint32_t i = 0; i < cluster && layout.addresses.size() < config.values; i++) {
+            uint8_t size = SIZES[rng() % 4];
+            offset = (offset + size - 1) & ~(uint32_t)(size - 1);
+            uint32_t id = (uint32_t)layout.addresses.size();
+            layout.names.push_back("VALUE_" + std::to_string(id));
+            layout.addresses.push_back(DS_MAIN_RAM_START + offset);
+            layout.sizes.push_back(size);
+            layout.tiers.push_back(tier);
+            offset += size + (uint32_t)(rng() % 3 == 0 ? rng() % 16 : 0);
+        }
+    }
+    return layout;
+}
+
+// 1ティック分の書き換え（全方式で同じ列を使う）
+struct TrackerBenchWrite {
+    uint32_t ramOffset;
+    uint32_t value;
+    uint8_t size;
+};
+
+static void ApplyWrites(const std::vector<TrackerBenchWrite>& writes, uint32_t tick, uint32_t perTick) {
+    for (uint32_t i = 0; i < perTick; i++) {
+        const TrackerBenchWrite& w = writes[(size_t)tick * perTick + i];
+        memcpy(s_ram.data() + w.ramOffset, &w.value, w.size);
+    }
+}
+
+static double ElapsedNs(std::chrono::steady_clock::time_point start) {
+    return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+// ========================================
+// 計測プログラムの入口（Windows は Bench プロジェクトの "tracker"、Linux は TRACKER_BENCH_MAIN を定義して単体でビルド）
+//   g++ -std=c++17 -O2 -DTRACKER_BENCH_MAIN tracker_bench.cpp delta_tracker.cpp name_index.cpp block_diff.cpp -o tracker_bench
+//   ./tracker_bench [--values N] [--ticks N] [--changes N] [--unreadable N] [--seed N]
+// ========================================
+int TrackerBenchMain(int argc, char** argv) {
+    TrackerBenchConfig config;
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = (i + 1 < argc) ? argv[i + 1] : "0";
+        if (strcmp(arg, "--values") == 0) { config.values = (uint32_t)strtoul(value, nullptr, 10); i++; }
+        else if (strcmp(arg, "--ticks") == 0) { config.ticks = (uint32_t)strtoul(value, nullptr, 10); i++; }
+        else if (strcmp(arg, "--changes") == 0) { config.changesPerTick = (uint32_t)strtoul(value, nullptr, 10); i++; }
+        else if (strcmp(arg, "--unreadable") == 0) { config.unreadable = (uint32_t)strtoul(value, nullptr, 10); i++; }
+        else if (strcmp(arg, "--seed") == 0) { config.seed = strtoull(value, nullptr, 10); i++; }
+        else {
+            fprintf(stderr, "不明な引数: %s\n", arg);
+            return 2;
+        }
+    }
+    if (config.values == 0 || config.ticks == 0) return 2;
+
+    std::mt19937_64 rng(config.seed);
+    s_ram.assign(DS_MAIN_RAM_SIZE, 0);
+    for (auto& b : s_ram) b = (uint8_t)rng();
+    TrackerBenchLayout layout = BuildLayout(config, rng);
+
+    // 読めない値は MainRAM 末尾の 4KB に置き、その範囲の読み取りを失敗させる
+    s_badBegin = DS_MAIN_RAM_SIZE - 0x1000;
+    s_badEnd = DS_MAIN_RAM_SIZE;
+    for (uint32_t i = 0; i < config.unreadable; i++) {
+        layout.names.push_back("UNREADABLE_" + std::to_string(i));
+        layout.addresses.push_back(DS_MAIN_RAM_START + s_badBegin + (i * 64) % 0x1000);
+        layout.sizes.push_back(4);
+        layout.tiers.push_back(PollTier::Warm);
+    }
+    const uint32_t count = (uint32_t)layout.addresses.size();
+    auto ramOffsetOf = [&](uint32_t id) { return (layout.addresses[id] - DS_MAIN_RAM_START) & NDS_MAIN_RAM_MASK; };
+
+    std::vector<TrackerBenchWrite> writes((size_t)config.ticks * config.changesPerTick);
+    uint32_t volatileCount = (std::max)(config.values / 5, 1u);
+    for (auto& w : writes) {
+        uint32_t id = (uint32_t)(rng() % volatileCount);
+        w = { ramOffsetOf(id), (uint32_t)rng(), layout.sizes[id] };
+    }
+    const std::vector<uint8_t> initialRam = s_ram;
+
+    // 書き換えだけの時間（各方式の時間から差し引く）
+    double writeNs;
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t t = 0; t < config.ticks; t++) ApplyWrites(writes, t, config.changesPerTick);
+        writeNs = ElapsedNs(start);
+        s_ram = initialRam;
+    }
+
+    struct Row {
+        const char* name;
+        uint64_t calls;
+        uint64_t bytes;
+        double ns;
+        uint64_t changes;
+    };
+    std::vector<Row> rows;
+
+    // 旧方式: 値毎に1回読み、前回値と比べる
+    {
+        std::vector<uint32_t> current(count, 0);
+        std::vector<uint8_t> initialized(count, 0);
+        uint64_t changes = 0;
+        s_readCalls = s_readBytes = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t t = 0; t < config.ticks; t++) {
+            ApplyWrites(writes, t, config.changesPerTick);
+            for (uint32_t id = 0; id < count; id++) {
+                uint32_t v = 0;
+                if (!BenchBlockRead(ramOffsetOf(id), layout.sizes[id], (uint8_t*)&v)) continue;
+                if (!initialized[id] || current[id] != v) changes++;
+                current[id] = v;
+                initialized[id] = 1;
+            }
+        }
+        rows.push_back({ "値毎", s_readCalls, s_readBytes, ElapsedNs(start) - writeNs, changes });
+        s_ram = initialRam;
+    }
+
+    // 読み取りプラン（全区間を毎ティック / 階層毎の周期）
+    for (bool tiered : { false, true }) {
+        DeltaTracker tracker;
+        for (uint32_t id = 0; id < count; id++) {
+            tracker.RegisterAddress(layout.names[id].c_str(), layout.addresses[id], layout.sizes[id], layout.tiers[id]);
+        }
+        uint64_t changes = 0;
+        s_readCalls = s_readBytes = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t t = 0; t < config.ticks; t++) {
+            ApplyWrites(writes, t, config.changesPerTick);
+            if (tiered) {
+                tracker.Update(BenchBlockRead, NDS_MAIN_RAM_MASK);
+            } else {
+                tracker.UpdateAll(BenchBlockRead, NDS_MAIN_RAM_MASK);
+            }
+            tracker.ForEachChanged([&](uint32_t) { changes++; });
+            tracker.ResetChangeFlags();
+        }
+        rows.push_back({ tiered ? "プラン+階層" : "プラン", s_readCalls, s_readBytes, ElapsedNs(start) - writeNs, changes });
+        if (!tiered) {
+            printf("値 %u (読めない値 %u), 区間 %zu, ティック %u, 書き換え %u/ティック, seed %llu\n",
+                count, config.unreadable, tracker.GetSpanCount(), config.ticks, config.changesPerTick,
+                (unsigned long long)config.seed);
+        }
+        s_ram = initialRam;
+    }
+
+    printf("%-14s %12s %12s %10s %10s\n", "方式", "読み取り/tick", "バイト/tick", "ns/tick", "検出した変化");
+    for (const Row& row : rows) {
+        printf("%-14s %12.1f %12.1f %10.1f %10llu\n", row.name,
+            (double)row.calls / config.ticks, (double)row.bytes / config.ticks,
+            row.ns / config.ticks, (unsigned long long)row.changes);
+    }
+    return 0;
+}
+
+#ifdef TRACKER_BENCH_MAIN
+int main(int argc, char** argv) {
+    return TrackerBenchMain(argc, argv);
+}
+#endif
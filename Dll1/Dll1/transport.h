@@ -0,0 +1,82 @@
+﻿#pragma once
+// transport.h : クライアントとの通信路の抽象化
+// Windows は Named Pipe（PipeServer）、Linux は Unix ドメインソケット（UnixSocketServer）で実装する
+// ブラウザ向けの WebSocket（WebSocketServer）を並べる時は TransportGroup でまとめる
+// モニター本体（monitor.cpp）はこのインターフェースだけを使うため、どちらの上でもそのまま動く
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <functional>
+#include <atomic>
+#include <memory>
+#include "send_queue.h"
+
+class Transport {
+public:
+    // 同時接続クライアント数の上限
+    static constexpr size_t MAX_CLIENTS = 8;
+    // 受信メッセージ1件の上限（超えたものは捨てる）
+    static constexpr size_t MAX_MESSAGE_SIZE = 8192;
+
+    virtual ~Transport() = default;
+
+    // サーバー開始（別スレッドで接続待機）。endpoint: パイプ名 / ソケットのパス
+    virtual bool Start(const char* endpoint) = 0;
+
+    // サーバー停止（全クライアント切断）
+    virtual void Stop() = 0;
+
+    // 送信バッファ作成。同じバッファを複数クライアントへの送信に使い回せる
+    static SendBuffer MakeLine(const std::string& json) {
+        // LF区切りメッセージ
+        auto line = std::make_shared<SendPayload>();
+        line->bytes.reserve(json.size() + 1);
+        line->bytes += json;
+        line->bytes += '\n';
+        return line;
+    }
+    static SendBuffer MakeRaw(const char* data, size_t size) {  // バイト列そのまま（バイナリフレーム用）
+        auto frame = std::make_shared<SendPayload>();
+        frame->bytes.assign(data, size);
+        frame->kind = PayloadKind::Frame;
+        return frame;
+    }
+
+    // 指定クライアントへ送信。送信キューに積むだけで戻る
+    bool Send(uint32_t clientId, const std::string& json, MessageClass cls = MessageClass::Control) {
+        return SendShared(clientId, MakeLine(json), cls);
+    }
+    virtual bool SendShared(uint32_t clientId, const SendBuffer& buffer, MessageClass cls = MessageClass::Control) = 0;
+
+    // 送信キュー溢れ時の扱い（既定は Coalesce。以降に接続したクライアントに適用）
+    void SetOverflowPolicy(OverflowPolicy policy) { m_overflowPolicy = policy; }
+
+    // 送信時間（LatencyStage::Send）の記録先（以降に接続したクライアントに適用）
+    void SetLatencyStats(LatencyStats* stats) { m_latencyStats = stats; }
+
+    // clientId をこの値から振る（TransportGroup で通信路毎に範囲を分ける。Start 前に呼ぶ）
+    void SetClientIdBase(uint32_t base) { m_nextClientId = base; }
+
+    // 指定クライアントの送信キューの深さ・遅延など。未接続なら false
+    virtual bool GetSendQueueStats(uint32_t clientId, SendQueueStats& out) const = 0;
+
+    // 指定クライアントに未送信・書き込み中のメッセージがあるか
+    virtual bool IsSendBusy(uint32_t clientId) const = 0;
+
+    // 接続状態
+    bool IsConnected() const { return m_clientCount.load() > 0; }
+    size_t GetClientCount() const { return m_clientCount.load(); }
+
+    // コールバック（clientId は接続毎に1から振られる）
+    // OnMessage の message は受信バッファ上の NUL 終端済みの1行で、コールバック中だけ有効
+    std::function<void(uint32_t clientId, std::string_view message)> OnMessage;  // メッセージ受信
+    std::function<void(uint32_t clientId)> OnConnect;                            // クライアント接続
+    std::function<void(uint32_t clientId)> OnDisconnect;                         // クライアント切断
+
+protected:
+    OverflowPolicy m_overflowPolicy = OverflowPolicy::Coalesce;
+    LatencyStats* m_latencyStats = nullptr;
+    std::atomic<size_t> m_clientCount{ 0 };
+    std::atomic<uint32_t> m_nextClientId{ 1 };
+};
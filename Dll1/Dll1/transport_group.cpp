@@ -0,0 +1,69 @@
+﻿#include "pch.h"
+#include "transport_group.h"
+#include <cstdio>
+
+TransportGroup::~TransportGroup() {
+    Stop();
+}
+
+bool TransportGroup::Add(Transport* transport, const char* endpoint) {
+    if (m_members.size() >= MAX_TRANSPORTS) return false;
+    uint32_t index = (uint32_t)m_members.size();
+    transport->SetClientIdBase((index << CLIENT_ID_SHIFT) + 1);
+
+    // 各通信路のイベントをそのまま上に流す（接続数はまとめて数える）
+    transport->OnMessage = [this](uint32_t clientId, std::string_view message) {
+        if (OnMessage) OnMessage(clientId, message);
+    };
+    transport->OnConnect = [this](uint32_t clientId) {
+        m_clientCount++;
+        if (OnConnect) OnConnect(clientId);
+    };
+    transport->OnDisconnect = [this](uint32_t clientId) {
+        if (OnDisconnect) OnDisconnect(clientId);
+        m_clientCount--;
+    };
+
+    m_members.push_back({ transport, endpoint });
+    return true;
+}
+
+bool TransportGroup::Start(const char* /*endpoint*/) {
+    bool anyStarted = false;
+    for (const Member& member : m_members) {
+        member.transport->SetOverflowPolicy(m_overflowPolicy);
+        member.transport->SetLatencyStats(m_latencyStats);
+        if (member.transport->Start(member.endpoint)) {
+            anyStarted = true;
+        } else {
+            printf("[TransportGroup] 開始失敗: %s\n", member.endpoint);
+        }
+    }
+    return anyStarted;
+}
+
+void TransportGroup::Stop() {
+    for (const Member& member : m_members) {
+        member.transport->Stop();
+    }
+}
+
+Transport* TransportGroup::FindTransport(uint32_t clientId) const {
+    size_t index = clientId >> CLIENT_ID_SHIFT;
+    return (index < m_members.size()) ? m_members[index].transport : nullptr;
+}
+
+bool TransportGroup::SendShared(uint32_t clientId, const SendBuffer& buffer, MessageClass cls) {
+    Transport* transport = FindTransport(clientId);
+    return transport && transport->SendShared(clientId, buffer, cls);
+}
+
+bool TransportGroup::GetSendQueueStats(uint32_t clientId, SendQueueStats& out) const {
+    Transport* transport = FindTransport(clientId);
+    return transport && transport->GetSendQueueStats(clientId, out);
+}
+
+bool TransportGroup::IsSendBusy(uint32_t clientId) const {
+    Transport* transport = FindTransport(clientId);
+    return transport && transport->IsSendBusy(clientId);
+}
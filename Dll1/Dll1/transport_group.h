@@ -0,0 +1,38 @@
+﻿#pragma once
+// transport_group.h : 複数の通信路を1つの Transport としてまとめる
+// Named Pipe（Electron）と WebSocket（ブラウザ）を同時に待ち受ける時に使う
+// clientId は通信路毎に上位8bitで範囲を分けるため、モニター本体からは区別なく見える
+// 送信バッファ（SendBuffer）はそのまま各通信路に渡すので、同じ delta のエンコード結果を共有する
+
+#include <vector>
+#include "transport.h"
+
+class TransportGroup : public Transport {
+public:
+    static constexpr size_t MAX_TRANSPORTS = 4;
+    static constexpr uint32_t CLIENT_ID_SHIFT = 24;
+
+    TransportGroup() = default;
+    ~TransportGroup() override;
+
+    // 通信路を追加する（Start 前に呼ぶ）。endpoint はその通信路の Start に渡す
+    bool Add(Transport* transport, const char* endpoint);
+
+    // 追加した全通信路を開始する（endpoint は使わない）。1つでも開始できれば true
+    bool Start(const char* endpoint) override;
+    void Stop() override;
+
+    bool SendShared(uint32_t clientId, const SendBuffer& buffer, MessageClass cls = MessageClass::Control) override;
+    bool GetSendQueueStats(uint32_t clientId, SendQueueStats& out) const override;
+    bool IsSendBusy(uint32_t clientId) const override;
+
+private:
+    struct Member {
+        Transport* transport;
+        const char* endpoint;
+    };
+
+    Transport* FindTransport(uint32_t clientId) const;
+
+    std::vector<Member> m_members;
+};
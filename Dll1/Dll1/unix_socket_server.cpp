@@ -0,0 +1,346 @@
+﻿#include "pch.h"
+
+#ifndef _WIN32
+
+#include "unix_socket_server.h"
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <unistd.h>
+
+// epoll に登録するfdの識別子（クライアントは clientId。1始まりなので重ならない）
+static constexpr uint64_t LISTEN_TOKEN = 0;
+static constexpr uint64_t WAKE_TOKEN = UINT64_MAX;
+
+UnixSocketServer::~UnixSocketServer() {
+    Stop();
+}
+
+bool UnixSocketServer::Start(const char* socketPath) {
+    if (m_running.load()) return false;
+
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    size_t pathLength = strlen(socketPath);
+    if (pathLength >= sizeof(addr.sun_path)) {
+        printf("[SocketServer] パスが長すぎる: %s\n", socketPath);
+        return false;
+    }
+    memcpy(addr.sun_path, socketPath, pathLength + 1);
+
+    // 前回異常終了した時のソケットファイルが残っていると bind できない
+    unlink(socketPath);
+
+    m_listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (m_listenFd < 0) {
+        printf("[SocketServer] socket失敗: %d\n", errno);
+        return false;
+    }
+    if (bind(m_listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+        listen(m_listenFd, (int)MAX_CLIENTS) != 0) {
+        printf("[SocketServer] bind/listen失敗: %d\n", errno);
+        close(m_listenFd);
+        m_listenFd = -1;
+        return false;
+    }
+
+    m_epollFd = epoll_create1(EPOLL_CLOEXEC);
+    m_wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_epollFd < 0 || m_wakeFd < 0) {
+        printf("[SocketServer] epoll/eventfd作成失敗: %d\n", errno);
+        if (m_epollFd >= 0) close(m_epollFd);
+        if (m_wakeFd >= 0) close(m_wakeFd);
+        close(m_listenFd);
+        m_epollFd = m_wakeFd = m_listenFd = -1;
+        unlink(socketPath);
+        return false;
+    }
+
+    epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.u64 = LISTEN_TOKEN;
+    epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_listenFd, &ev);
+    ev.data.u64 = WAKE_TOKEN;
+    epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_wakeFd, &ev);
+
+    m_socketPath = socketPath;
+    m_running = true;
+    {
+        std::lock_guard<std::mutex> lock(m_eventsMutex);
+        m_events.clear();
+        m_pendingMessages = 0;
+        m_dispatchStop = false;
+    }
+    m_dispatchThread = std::thread(&UnixSocketServer::DispatchThread, this);
+    m_eventThread = std::thread(&UnixSocketServer::EventThread, this);
+
+    printf("[SocketServer] 開始: %s (最大%zuクライアント)\n", socketPath, MAX_CLIENTS);
+    return true;
+}
+
+void UnixSocketServer::Stop() {
+    if (!m_running.exchange(false)) return;
+
+    // イベントスレッドを起こす（終了時に全クライアントを切断する）
+    uint64_t one = 1;
+    ssize_t ignored = write(m_wakeFd, &one, sizeof(one));
+    (void)ignored;
+    if (m_eventThread.joinable()) {
+        m_eventThread.join();
+    }
+
+    // 切断通知まで積み終わっているので、残りを呼び終えてからディスパッチスレッドを止める
+    {
+        std::lock_guard<std::mutex> lock(m_eventsMutex);
+        m_dispatchStop = true;
+    }
+    m_eventsCv.notify_one();
+    if (m_dispatchThread.joinable()) {
+        m_dispatchThread.join();
+    }
+
+    close(m_listenFd);
+    close(m_epollFd);
+    close(m_wakeFd);
+    m_listenFd = m_epollFd = m_wakeFd = -1;
+    unlink(m_socketPath.c_str());
+
+    printf("[SocketServer] 停止\n");
+}
+
+bool UnixSocketServer::SendShared(uint32_t clientId, const SendBuffer& buffer, MessageClass cls) {
+    std::shared_ptr<Client> client = FindClient(clientId);
+    if (!client || !client->connected.load()) return false;
+    return client->queue.Push(buffer, cls);
+}
+
+bool UnixSocketServer::GetSendQueueStats(uint32_t clientId, SendQueueStats& out) const {
+    std::shared_ptr<Client> client = FindClient(clientId);
+    if (!client) return false;
+    out = client->queue.GetStats();
+    return true;
+}
+
+bool UnixSocketServer::IsSendBusy(uint32_t clientId) const {
+    std::shared_ptr<Client> client = FindClient(clientId);
+    return client && client->queue.IsBusy();
+}
+
+std::shared_ptr<UnixSocketServer::Client> UnixSocketServer::FindClient(uint32_t clientId) const {
+    std::lock_guard<std::mutex> lock(m_clientsMutex);
+    for (const auto& client : m_clients) {
+        if (client->id == clientId) return client;
+    }
+    return nullptr;
+}
+
+bool UnixSocketServer::WriteBlocking(Client& client, const char* data, size_t size) {
+    size_t written = 0;
+    while (written < size) {
+        ssize_t n = send(client.fd, data + written, size - written, MSG_NOSIGNAL);
+        if (n > 0) {
+            written += (size_t)n;
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            // 送信バッファの空き待ち（500ms毎に停止チェック）
+            pollfd pfd = {};
+            pfd.fd = client.fd;
+            pfd.events = POLLOUT;
+            while (poll(&pfd, 1, 500) == 0) {
+                if (!m_running.load() || !client.connected.load()) return false;
+            }
+            continue;
+        }
+        printf("[SocketServer] Send失敗 (id=%u): %d\n", client.id, errno);
+        return false;
+    }
+    return true;
+}
+
+void UnixSocketServer::EventThread() {
+    printf("[SocketServer] イベントスレッド開始\n");
+
+    epoll_event events[16];
+    while (m_running.load()) {
+        int count = epoll_wait(m_epollFd, events, 16, 500);
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            printf("[SocketServer] epoll_wait失敗: %d\n", errno);
+            break;
+        }
+
+        for (int i = 0; i < count && m_running.load(); i++) {
+            uint64_t token = events[i].data.u64;
+            if (token == WAKE_TOKEN) continue;
+            if (token == LISTEN_TOKEN) {
+                AcceptClients();
+                continue;
+            }
+            std::shared_ptr<Client> client = FindClient((uint32_t)token);
+            if (client) {
+                ReadClient(client);
+            }
+        }
+    }
+
+    // 残っているクライアントをすべて切断（未送信分は破棄）
+    std::vector<std::shared_ptr<Client>> remaining;
+    {
+        std::lock_guard<std::mutex> lock(m_clientsMutex);
+        remaining = m_clients;
+    }
+    for (auto& client : remaining) {
+        CloseClient(client);
+    }
+
+    printf("[SocketServer] イベントスレッド停止\n");
+}
+
+void UnixSocketServer::PostEvent(Event::Kind kind, uint32_t clientId, std::string_view message) {
+    {
+        std::lock_guard<std::mutex> lock(m_eventsMutex);
+        if (kind == Event::Kind::Message) {
+            if (m_pendingMessages >= MAX_PENDING_MESSAGES) {
+                printf("[SocketServer] コマンド処理が追いつかないため破棄 (id=%u)\n", clientId);
+                return;
+            }
+            m_pendingMessages++;
+        }
+        Event event;
+        event.kind = kind;
+        event.clientId = clientId;
+        event.message.assign(message.data(), message.size());
+        m_events.push_back(std::move(event));
+    }
+    m_eventsCv.notify_one();
+}
+
+void UnixSocketServer::DispatchThread() {
+    while (true) {
+        Event event;
+        {
+            std::unique_lock<std::mutex> lock(m_eventsMutex);
+            m_eventsCv.wait(lock, [this] { return m_dispatchStop || !m_events.empty(); });
+            if (m_events.empty()) return;
+            event = std::move(m_events.front());
+            m_events.pop_front();
+            if (event.kind == Event::Kind::Message) m_pendingMessages--;
+        }
+
+        // message は std::string に写してあるので NUL 終端のまま渡せる
+        switch (event.kind) {
+        case Event::Kind::Connect:
+            if (OnConnect) OnConnect(event.clientId);
+            break;
+        case Event::Kind::Message:
+            if (OnMessage) OnMessage(event.clientId, std::string_view(event.message.c_str(), event.message.size()));
+            break;
+        case Event::Kind::Disconnect:
+            if (OnDisconnect) OnDisconnect(event.clientId);
+            break;
+        }
+    }
+}
+
+void UnixSocketServer::AcceptClients() {
+    while (true) {
+        int fd = accept4(m_listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                printf("[SocketServer] accept失敗: %d\n", errno);
+            }
+            return;
+        }
+
+        if (m_clientCount.load() >= MAX_CLIENTS) {
+            printf("[SocketServer] 接続数が上限のため拒否\n");
+            close(fd);
+            continue;
+        }
+
+        auto client = std::make_shared<Client>(MAX_MESSAGE_SIZE);
+        client->id = m_nextClientId++;
+        client->fd = fd;
+        client->queue.SetPolicy(m_overflowPolicy);
+        client->queue.SetLatencyStats(m_latencyStats);
+        {
+            std::lock_guard<std::mutex> lock(m_clientsMutex);
+            m_clients.push_back(client);
+        }
+        m_clientCount++;
+
+        // 書き込みスレッド開始。書き込み失敗・キュー溢れではソケットを閉じ側にして、
+        // イベントスレッドに切断を拾わせる
+        Client* c = client.get();
+        c->queue.Start(
+            [this, c](const SendPayload& payload) { return WriteBlocking(*c, payload.bytes.data(), payload.bytes.size()); },
+            [c]() {
+                c->connected = false;
+                shutdown(c->fd, SHUT_RDWR);
+            });
+        c->connected = true;
+
+        epoll_event ev = {};
+        ev.events = EPOLLIN | EPOLLRDHUP;
+        ev.data.u64 = c->id;
+        epoll_ctl(m_epollFd, EPOLL_CTL_ADD, fd, &ev);
+
+        printf("[SocketServer] クライアント接続! (id=%u, 接続数=%zu)\n", c->id, m_clientCount.load());
+        PostEvent(Event::Kind::Connect, c->id);
+    }
+}
+
+void UnixSocketServer::ReadClient(const std::shared_ptr<Client>& client) {
+    // 受信バッファに直接読み込み、行はディスパッチスレッドに写して渡す
+    // エッジトリガーではないので、読めなくなるまで読めば取りこぼしはない
+    while (true) {
+        ssize_t n = recv(client->fd, client->framer.GetWritePtr(), client->framer.GetWritableSize(), 0);
+        if (n > 0) {
+            client->framer.Commit((size_t)n,
+                [&](std::string_view message) {
+                    PostEvent(Event::Kind::Message, client->id, message);
+                },
+                [&](size_t discarded) {
+                    printf("[SocketServer] 上限超えのメッセージを破棄 (id=%u, %zu bytes)\n", client->id, discarded);
+                });
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+
+        // 0 はクライアント側の切断、それ以外はエラー
+        CloseClient(client);
+        return;
+    }
+}
+
+void UnixSocketServer::CloseClient(const std::shared_ptr<Client>& client) {
+    client->connected = false;
+    epoll_ctl(m_epollFd, EPOLL_CTL_DEL, client->fd, nullptr);
+
+    // 書き込み中の send / poll を即座に失敗させてから書き込みスレッドを止める
+    shutdown(client->fd, SHUT_RDWR);
+    client->queue.Stop();
+    {
+        std::lock_guard<std::mutex> lock(m_clientsMutex);
+        m_clients.erase(std::remove(m_clients.begin(), m_clients.end(), client), m_clients.end());
+    }
+    m_clientCount--;
+
+    printf("[SocketServer] クライアント切断 (id=%u, 接続数=%zu)\n", client->id, m_clientCount.load());
+    PostEvent(Event::Kind::Disconnect, client->id);
+
+    close(client->fd);
+    client->fd = -1;
+}
+
+#endif // !_WIN32
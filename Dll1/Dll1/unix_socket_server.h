@@ -0,0 +1,89 @@
+﻿#pragma once
+// unix_socket_server.h : Unix ドメインソケットのサーバー（Linux 版の Transport）
+// 受け付けと受信は epoll の1スレッドでまとめて扱い、送信はクライアント毎の送信キュー（書き込みスレッド）で行う
+// OnConnect / OnMessage / OnDisconnect はイベントスレッドでは呼ばず、受け取り順のまま1本のディスパッチスレッドで呼ぶ
+// （rescan などの重いコマンドやトラッカーのロック待ちで受け付け・受信が止まらないようにする）。
+// 未処理のメッセージは MAX_PENDING_MESSAGES 件までで、それを超えた分は捨てる
+// メッセージの形式・接続数の上限・送信キューの扱いは PipeServer と同じ
+
+#ifndef _WIN32
+
+#include <string>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <deque>
+#include <string_view>
+#include <condition_variable>
+#include "transport.h"
+#include "line_framer.h"
+
+class UnixSocketServer : public Transport {
+public:
+    UnixSocketServer() = default;
+    ~UnixSocketServer() override;
+
+    // サーバー開始（socketPath に待ち受けソケットを作る。残っている古いソケットは消す）
+    bool Start(const char* socketPath) override;
+
+    // サーバー停止（全クライアント切断・ソケットファイル削除）
+    void Stop() override;
+
+    bool SendShared(uint32_t clientId, const SendBuffer& buffer, MessageClass cls = MessageClass::Control) override;
+    bool GetSendQueueStats(uint32_t clientId, SendQueueStats& out) const override;
+    bool IsSendBusy(uint32_t clientId) const override;
+
+    // ディスパッチ待ちのメッセージの上限（接続・切断の通知は数えず、必ず積む）
+    static constexpr size_t MAX_PENDING_MESSAGES = 256;
+
+private:
+    struct Client {
+        explicit Client(size_t maxMessageSize) : framer(maxMessageSize) {}
+
+        uint32_t id = 0;
+        int fd = -1;
+        LineFramer framer;      // イベントスレッドのみが触る
+        SendQueue queue;
+        std::atomic<bool> connected{ false };
+    };
+
+    // ディスパッチスレッドに渡すコールバック1件
+    struct Event {
+        enum class Kind { Connect, Message, Disconnect };
+        Kind kind = Kind::Message;
+        uint32_t clientId = 0;
+        std::string message;
+    };
+
+    void EventThread();
+    void DispatchThread();
+    void PostEvent(Event::Kind kind, uint32_t clientId, std::string_view message = {});
+    void AcceptClients();
+    void ReadClient(const std::shared_ptr<Client>& client);
+    void CloseClient(const std::shared_ptr<Client>& client);
+    std::shared_ptr<Client> FindClient(uint32_t clientId) const;
+
+    // 書き込みスレッドから呼ばれる。1件を書き終えるまでブロックする
+    bool WriteBlocking(Client& client, const char* data, size_t size);
+
+    std::string m_socketPath;
+    int m_listenFd = -1;
+    int m_epollFd = -1;
+    int m_wakeFd = -1;          // Stop からイベントスレッドを起こす eventfd
+    std::thread m_eventThread;
+    std::atomic<bool> m_running{ false };
+
+    std::thread m_dispatchThread;
+    std::mutex m_eventsMutex;
+    std::condition_variable m_eventsCv;
+    std::deque<Event> m_events;
+    size_t m_pendingMessages = 0;
+    bool m_dispatchStop = false;
+
+    mutable std::mutex m_clientsMutex;
+    std::vector<std::shared_ptr<Client>> m_clients;
+};
+
+#endif // !_WIN32
@@ -0,0 +1,250 @@
+﻿#include "pch.h"
+#include "websocket.h"
+#include <cctype>
+
+// Sec-WebSocket-Accept の計算に使う固定値（RFC 6455）
+static const char WEBSOCKET_GUID[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+// ========================================
+// SHA-1 / Base64（ハンドシェイク専用。1接続1回なので素直な実装）
+// ========================================
+
+static uint32_t RotateLeft(uint32_t value, int bits) {
+    return (value << bits) | (value >> (32 - bits));
+}
+
+static void Sha1(const uint8_t* data, size_t size, uint8_t out[20]) {
+    uint32_t h[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+
+    // 末尾に 0x80、0 埋め、ビット長（64bit BE）を付けて64バイト単位にする
+    std::string message(reinterpret_cast<const char*>(data), size);
+    message += (char)0x80;
+    while (message.size() % 64 != 56) message += (char)0;
+    uint64_t bitLength = (uint64_t)size * 8;
+    for (int i = 7; i >= 0; i--) {
+        message += (char)(uint8_t)(bitLength >> (i * 8));
+    }
+
+    for (size_t chunk = 0; chunk < message.size(); chunk += 64) {
+        uint32_t w[80];
+        for (int i = 0; i < 16; i++) {
+            const uint8_t* p = reinterpret_cast<const uint8_t*>(message.data()) + chunk + i * 4;
+            w[i] = ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+        }
+        for (int i = 16; i < 80; i++) {
+            w[i] = RotateLeft(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+        }
+
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i < 80; i++) {
+            uint32_t f, k;
+            if (i < 20)      { f = (b & c) | (~b & d);           k = 0x5A827999; }
+            else if (i < 40) { f = b ^ c ^ d;                    k = 0x6ED9EBA1; }
+            else if (i < 60) { f = (b & c) | (b & d) | (c & d);  k = 0x8F1BBCDC; }
+            else             { f = b ^ c ^ d;                    k = 0xCA62C1D6; }
+            uint32_t temp = RotateLeft(a, 5) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = RotateLeft(b, 30);
+            b = a;
+            a = temp;
+        }
+        h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
+    }
+
+    for (int i = 0; i < 5; i++) {
+        out[i * 4 + 0] = (uint8_t)(h[i] >> 24);
+        out[i * 4 + 1] = (uint8_t)(h[i] >> 16);
+        out[i * 4 + 2] = (uint8_t)(h[i] >> 8);
+        out[i * 4 + 3] = (uint8_t)h[i];
+    }
+}
+
+static std::string Base64Encode(const uint8_t* data, size_t size) {
+    static const char TABLE[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string out;
+    out.reserve((size + 2) / 3 * 4);
+    for (size_t i = 0; i < size; i += 3) {
+        uint32_t n = (uint32_t)data[i] << 16;
+        if (i + 1 < size) n |= (uint32_t)data[i + 1] << 8;
+        if (i + 2 < size) n |= data[i + 2];
+        out += TABLE[(n >> 18) & 63];
+        out += TABLE[(n >> 12) & 63];
+        out += (i + 1 < size) ? TABLE[(n >> 6) & 63] : '=';
+        out += (i + 2 < size) ? TABLE[n & 63] : '=';
+    }
+    return out;
+}
+
+// ========================================
+// ハンドシェイク
+// ========================================
+
+static bool EqualsIgnoreCase(std::string_view a, std::string_view b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); i++) {
+        if (tolower((unsigned char)a[i]) != tolower((unsigned char)b[i])) return false;
+    }
+    return true;
+}
+
+// カンマ区切りのトークン列（Connection: keep-alive, Upgrade など）に token が含まれるか
+static bool ContainsToken(std::string_view list, std::string_view token) {
+    while (!list.empty()) {
+        size_t comma = list.find(',');
+        std::string_view item = list.substr(0, comma);
+        while (!item.empty() && item.front() == ' ') item.remove_prefix(1);
+        while (!item.empty() && item.back() == ' ') item.remove_suffix(1);
+        if (EqualsIgnoreCase(item, token)) return true;
+        if (comma == std::string_view::npos) break;
+        list.remove_prefix(comma + 1);
+    }
+    return false;
+}
+
+WebSocketHandshake ParseWebSocketHandshake(std::string_view request) {
+    WebSocketHandshake result;
+    if (request.substr(0, 4) != "GET ") return result;
+
+    bool upgrade = false, connectionUpgrade = false, version13 = false;
+    size_t lineStart = request.find("\r\n");
+    while (lineStart != std::string_view::npos) {
+        lineStart += 2;
+        size_t lineEnd = request.find("\r\n", lineStart);
+        std::string_view line = request.substr(lineStart, lineEnd - lineStart);
+        lineStart = lineEnd;
+        if (line.empty()) break;
+
+        size_t colon = line.find(':');
+        if (colon == std::string_view::npos) continue;
+        std::string_view name = line.substr(0, colon);
+        std::string_view value = line.substr(colon + 1);
+        while (!value.empty() && value.front() == ' ') value.remove_prefix(1);
+        while (!value.empty() && value.back() == ' ') value.remove_suffix(1);
+
+        if (EqualsIgnoreCase(name, "Upgrade")) {
+            upgrade = EqualsIgnoreCase(value, "websocket");
+        } else if (EqualsIgnoreCase(name, "Connection")) {
+            connectionUpgrade = ContainsToken(value, "upgrade");
+        } else if (EqualsIgnoreCase(name, "Sec-WebSocket-Version")) {
+            version13 = (value == "13");
+        } else if (EqualsIgnoreCase(name, "Sec-WebSocket-Key")) {
+            result.key = value;
+        } else if (EqualsIgnoreCase(name, "Origin")) {
+            result.origin = value;
+        }
+    }
+
+    result.valid = upgrade && connectionUpgrade && version13 && !result.key.empty();
+    return result;
+}
+
+std::string ComputeWebSocketAccept(std::string_view key) {
+    std::string source(key);
+    source += WEBSOCKET_GUID;
+    uint8_t digest[20];
+    Sha1(reinterpret_cast<const uint8_t*>(source.data()), source.size(), digest);
+    return Base64Encode(digest, sizeof(digest));
+}
+
+std::string BuildWebSocketHandshakeResponse(std::string_view key) {
+    std::string response =
+        "HTTP/1.1 101 Switching Protocols\r\n"
+        "Upgrade: websocket\r\n"
+        "Connection: Upgrade\r\n"
+        "Sec-WebSocket-Accept: ";
+    response += ComputeWebSocketAccept(key);
+    response += "\r\n\r\n";
+    return response;
+}
+
+bool IsAllowedWebSocketOrigin(std::string_view origin) {
+    if (origin.empty()) return true;
+
+    // スキーム://ホスト[:ポート]
+    size_t scheme = origin.find("://");
+    if (scheme == std::string_view::npos) return false;
+    std::string_view host = origin.substr(scheme + 3);
+    if (!host.empty() && host.front() == '[') {
+        size_t close = host.find(']');
+        if (close == std::string_view::npos) return false;
+        host = host.substr(0, close + 1);
+    } else {
+        host = host.substr(0, host.find(':'));
+    }
+    return EqualsIgnoreCase(host, "localhost") || host == "127.0.0.1" || host == "[::1]";
+}
+
+// ========================================
+// フレーム
+// ========================================
+
+size_t BuildWebSocketFrameHeader(WebSocketOpcode opcode, size_t payloadSize, uint8_t* out) {
+    out[0] = (uint8_t)(0x80 | (uint8_t)opcode);
+    if (payloadSize < 126) {
+        out[1] = (uint8_t)payloadSize;
+        return 2;
+    }
+    if (payloadSize <= 0xFFFF) {
+        out[1] = 126;
+        out[2] = (uint8_t)(payloadSize >> 8);
+        out[3] = (uint8_t)payloadSize;
+        return 4;
+    }
+    out[1] = 127;
+    for (int i = 0; i < 8; i++) {
+        out[2 + i] = (uint8_t)((uint64_t)payloadSize >> ((7 - i) * 8));
+    }
+    return 10;
+}
+
+size_t WebSocketDecoder::ParseFrame(size_t offset, Frame& frame, Result& result) {
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(m_buffer.data()) + offset;
+    size_t available = m_buffer.size() - offset;
+    if (available < 2) return 0;
+
+    frame.fin = (p[0] & 0x80) != 0;
+    frame.opcode = (WebSocketOpcode)(p[0] & 0x0F);
+    bool masked = (p[1] & 0x80) != 0;
+    uint64_t length = p[1] & 0x7F;
+    size_t headerSize = 2;
+
+    // 予約ビット・未定義の opcode・マスクなし（クライアントは必ずマスクする）は違反
+    bool control = (uint8_t)frame.opcode >= 0x8;
+    bool knownOpcode = frame.opcode == WebSocketOpcode::Continuation || frame.opcode == WebSocketOpcode::Text ||
+                       frame.opcode == WebSocketOpcode::Binary || frame.opcode == WebSocketOpcode::Close ||
+                       frame.opcode == WebSocketOpcode::Ping || frame.opcode == WebSocketOpcode::Pong;
+    if ((p[0] & 0x70) != 0 || !knownOpcode || !masked || (control && (!frame.fin || length > 125))) {
+        result = Fail(WS_CLOSE_PROTOCOL_ERROR);
+        return 0;
+    }
+
+    if (length == 126) {
+        if (available < 4) return 0;
+        length = ((uint64_t)p[2] << 8) | p[3];
+        headerSize = 4;
+    } else if (length == 127) {
+        if (available < 10) return 0;
+        length = 0;
+        for (int i = 0; i < 8; i++) {
+            length = (length << 8) | p[2 + i];
+        }
+        headerSize = 10;
+    }
+    // 全体を受信する前に上限で弾く（巨大な長さを名乗るフレームで溜め込まない）
+    if (length > m_maxMessageSize) {
+        result = Fail(WS_CLOSE_TOO_BIG);
+        return 0;
+    }
+
+    const uint8_t* mask = p + headerSize;
+    headerSize += 4;
+    if (available < headerSize + length) return 0;
+
+    frame.payload = &m_buffer[offset + headerSize];
+    frame.size = (size_t)length;
+    for (size_t i = 0; i < frame.size; i++) {
+        frame.payload[i] ^= (char)mask[i & 3];
+    }
+    return headerSize + frame.size;
+}
@@ -0,0 +1,132 @@
+﻿#pragma once
+// websocket.h : WebSocket（RFC 6455）のハンドシェイクとフレームの組み立て・解釈
+// 通信路には依存しない（ソケットの読み書きは WebSocketServer が行う）
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+enum class WebSocketOpcode : uint8_t {
+    Continuation = 0x0,
+    Text = 0x1,
+    Binary = 0x2,
+    Close = 0x8,
+    Ping = 0x9,
+    Pong = 0xA,
+};
+
+// Close フレームのステータスコード
+constexpr uint16_t WS_CLOSE_NORMAL = 1000;
+constexpr uint16_t WS_CLOSE_PROTOCOL_ERROR = 1002;
+constexpr uint16_t WS_CLOSE_TOO_BIG = 1009;
+
+// ハンドシェイク要求（HTTP の GET）の解釈結果
+struct WebSocketHandshake {
+    bool valid = false;          // WebSocket へのアップグレード要求として正しいか
+    std::string key;             // Sec-WebSocket-Key
+    std::string origin;          // Origin（ブラウザ以外は付けないことがある）
+};
+
+// request: 空行（\r\n\r\n）までの HTTP 要求
+WebSocketHandshake ParseWebSocketHandshake(std::string_view request);
+
+// 101 Switching Protocols の応答（Sec-WebSocket-Accept 付き）
+std::string BuildWebSocketHandshakeResponse(std::string_view key);
+
+// Sec-WebSocket-Accept の値（key + 固定GUID の SHA-1 を Base64 にしたもの）
+std::string ComputeWebSocketAccept(std::string_view key);
+
+// 接続を受け付ける Origin か（省略・localhost・127.0.0.1・[::1] のみ。他のサイトのページからは繋がせない）
+bool IsAllowedWebSocketOrigin(std::string_view origin);
+
+// サーバー → クライアントのフレームヘッダ（マスクなし・FIN あり）。out は10バイト以上。戻り値はヘッダ長
+size_t BuildWebSocketFrameHeader(WebSocketOpcode opcode, size_t payloadSize, uint8_t* out);
+
+// クライアント → サーバーのフレームの解釈
+// 受信したバイト列を順に Feed し、完成したメッセージ（分割フレームは結合済み）をコールバックで渡す
+class WebSocketDecoder {
+public:
+    enum class Result {
+        Ok,         // 続けて受信できる
+        Close,      // Close フレームを受信した（closeCode に相手のステータス）
+        Error,      // プロトコル違反・上限超え（closeCode に返すべきステータス）
+    };
+
+    // maxMessageSize: 1メッセージの上限（分割フレームの合計）
+    explicit WebSocketDecoder(size_t maxMessageSize) : m_maxMessageSize(maxMessageSize) {}
+
+    // onMessage(WebSocketOpcode, char* payload, size_t size)
+    //   Text / Binary / Ping / Pong を渡す。payload は NUL 終端済みで書き換えてよく、コールバック中だけ有効
+    template <typename MessageFunc>
+    Result Feed(const char* data, size_t size, MessageFunc&& onMessage) {
+        m_buffer.append(data, size);
+        size_t offset = 0;
+        Result result = Result::Ok;
+        while (result == Result::Ok) {
+            Frame frame;
+            size_t consumed = ParseFrame(offset, frame, result);
+            if (consumed == 0) break;
+            offset += consumed;
+
+            if ((uint8_t)frame.opcode >= 0x8) {
+                if (frame.opcode == WebSocketOpcode::Close) {
+                    closeCode = (frame.size >= 2)
+                        ? (uint16_t)(((uint8_t)frame.payload[0] << 8) | (uint8_t)frame.payload[1])
+                        : WS_CLOSE_NORMAL;
+                    result = Result::Close;
+                    break;
+                }
+                // 制御フレームは125バイト以下。直後は次のフレームなので、コピーして NUL 終端する
+                char control[126];
+                memcpy(control, frame.payload, frame.size);
+                control[frame.size] = '\0';
+                onMessage(frame.opcode, control, frame.size);
+                continue;
+            }
+
+            // データフレーム（分割されていれば最後のフレームまで溜める）
+            if (frame.opcode != WebSocketOpcode::Continuation) {
+                if (m_inMessage) return Fail(WS_CLOSE_PROTOCOL_ERROR);
+                m_messageOpcode = frame.opcode;
+                m_message.clear();
+                m_inMessage = true;
+            } else if (!m_inMessage) {
+                return Fail(WS_CLOSE_PROTOCOL_ERROR);
+            }
+            if (m_message.size() + frame.size > m_maxMessageSize) return Fail(WS_CLOSE_TOO_BIG);
+            m_message.append(frame.payload, frame.size);
+            if (frame.fin) {
+                m_inMessage = false;
+                onMessage(m_messageOpcode, &m_message[0], m_message.size());
+            }
+        }
+        m_buffer.erase(0, offset);
+        return result;
+    }
+
+    uint16_t closeCode = WS_CLOSE_NORMAL;
+
+private:
+    struct Frame {
+        WebSocketOpcode opcode = WebSocketOpcode::Continuation;
+        bool fin = false;
+        char* payload = nullptr;  // マスク解除済み（m_buffer 上）
+        size_t size = 0;
+    };
+
+    // m_buffer の offset から1フレームを解釈する。未完成なら0、違反なら0 で result に Error
+    size_t ParseFrame(size_t offset, Frame& frame, Result& result);
+
+    Result Fail(uint16_t code) {
+        closeCode = code;
+        return Result::Error;
+    }
+
+    size_t m_maxMessageSize;
+    std::string m_buffer;           // 未処理の受信データ
+    std::string m_message;          // 組み立て中のメッセージ
+    WebSocketOpcode m_messageOpcode = WebSocketOpcode::Text;
+    bool m_inMessage = false;
+};
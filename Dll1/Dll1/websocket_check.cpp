@@ -0,0 +1,388 @@
+﻿#include "pch.h"
+// websocket_check.cpp : WebSocket（websocket.h / WebSocketServer）の確認
+// 通信路に依存しない部分（どちらの OS でも）
+//   - Sec-WebSocket-Accept が RFC 6455 の例と一致する
+//   - マスク付き・分割されたフレーム（途中に Ping を挟む）を1バイトずつ渡しても1つのメッセージに組み立てる
+//   - 16bit 長のフレーム、マスクなし（1002）、上限超え（1009）、Close
+// ローカルの WebSocketServer に TCP で繋ぐ部分（Linux のみ）
+//   - 他のサイトの Origin は 403、localhost の Origin は 101 と RFC の例の Accept
+//   - 分割・マスク付きの Text コマンドが OnMessage に1行で届く、Ping に Pong が返る
+//   - JSON の1行は末尾の LF を除いた Text、バイナリフレームは先頭の u32 長さを除いた Binary で届く
+// --host-port を付けると、monitor_host（--ws-port）で動いているモニターに繋いで
+//   - rescan と setVersion を LF 区切りの1つの Text で送り、フルステートが Text で届く
+//   - setEncoding binary の後のフルステートが、先頭の u32 長さなしの Binary（[Full][本体]）で届く
+// も確かめる。外れたら 1 を返す
+#include "bench_entry.h"
+#include "websocket.h"
+#include "transport.h"
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include "websocket_server.h"
+#include "wire_format.h"
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+// RFC 6455 1.3 の例
+static const char RFC_SAMPLE_KEY[] = "dGhlIHNhbXBsZSBub25jZQ==";
+static const char RFC_SAMPLE_ACCEPT[] = "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=";
+
+static bool Check(bool condition, const char* message) {
+    printf("  %s %s\n", condition ? "OK" : "NG", message);
+    return condition;
+}
+
+// クライアント → サーバーのフレーム（マスク付き。payload は 0xFFFF バイト以下）
+static std::string BuildClientFrame(WebSocketOpcode opcode, bool fin, const std::string& payload,
+                                    const uint8_t mask[4], bool masked = true) {
+    std::string frame;
+    frame += (char)((fin ? 0x80 : 0x00) | (uint8_t)opcode);
+    uint8_t maskBit = masked ? 0x80 : 0x00;
+    if (payload.size() < 126) {
+        frame += (char)(maskBit | (uint8_t)payload.size());
+    } else {
+        frame += (char)(maskBit | 126);
+        frame += (char)(payload.size() >> 8);
+        frame += (char)(payload.size() & 0xFF);
+    }
+    if (!masked) return frame + payload;
+    frame.append(reinterpret_cast<const char*>(mask), 4);
+    for (size_t i = 0; i < payload.size(); i++) {
+        frame += (char)(payload[i] ^ mask[i % 4]);
+    }
+    return frame;
+}
+
+struct DecodedMessage {
+    WebSocketOpcode opcode;
+    std::string payload;
+};
+
+// data を chunk バイトずつ渡し、組み立てたメッセージと最後の結果を返す
+static WebSocketDecoder::Result FeedAll(WebSocketDecoder& decoder, const std::string& data, size_t chunk,
+                                        std::vector<DecodedMessage>& out) {
+    WebSocketDecoder::Result result = WebSocketDecoder::Result::Ok;
+    for (size_t i = 0; i < data.size() && result == WebSocketDecoder::Result::Ok; i += chunk) {
+        size_t length = (std::min)(chunk, data.size() - i);
+        result = decoder.Feed(data.data() + i, length, [&](WebSocketOpcode opcode, char* payload, size_t size) {
+            out.push_back({ opcode, std::string(payload, size) });
+        });
+    }
+    return result;
+}
+
+static bool CheckCodec() {
+    static const uint8_t mask[4] = { 0x37, 0xFA, 0x21, 0x3D };
+    bool ok = true;
+    printf("ハンドシェイク・フレーム\n");
+    ok &= Check(ComputeWebSocketAccept(RFC_SAMPLE_KEY) == RFC_SAMPLE_ACCEPT, "Sec-WebSocket-Accept が RFC 6455 の例と一致");
+    ok &= Check(!IsAllowedWebSocketOrigin("https://example.com") && IsAllowedWebSocketOrigin("http://localhost:5173") &&
+                IsAllowedWebSocketOrigin(""), "Origin は省略・localhost のみ許可");
+
+    // 分割（Text + Continuation）の間に Ping を挟み、1バイトずつ渡す
+    {
+        std::string stream = BuildClientFrame(WebSocketOpcode::Text, false, "{\"cmd\":", mask) +
+                             BuildClientFrame(WebSocketOpcode::Ping, true, "hi", mask) +
+                             BuildClientFrame(WebSocketOpcode::Continuation, true, "\"ping\"}", mask);
+        WebSocketDecoder decoder(Transport::MAX_MESSAGE_SIZE);
+        std::vector<DecodedMessage> messages;
+        WebSocketDecoder::Result result = FeedAll(decoder, stream, 1, messages);
+        ok &= Check(result == WebSocketDecoder::Result::Ok && messages.size() == 2 &&
+                    messages[0].opcode == WebSocketOpcode::Ping && messages[0].payload == "hi" &&
+                    messages[1].opcode == WebSocketOpcode::Text && messages[1].payload == "{\"cmd\":\"ping\"}",
+                    "分割・マスク付きの Text を途中の Ping ごと組み立てる（1バイトずつ）");
+    }
+
+    // 16bit 長（126 以上）の Binary をまとめて渡す
+    {
+        std::string payload(300, '\0');
+        for (size_t i = 0; i < payload.size(); i++) payload[i] = (char)(i * 7);
+        WebSocketDecoder decoder(Transport::MAX_MESSAGE_SIZE);
+        std::vector<DecodedMessage> messages;
+        WebSocketDecoder::Result result = FeedAll(decoder, BuildClientFrame(WebSocketOpcode::Binary, true, payload, mask), 4096, messages);
+        ok &= Check(result == WebSocketDecoder::Result::Ok && messages.size() == 1 &&
+                    messages[0].opcode == WebSocketOpcode::Binary && messages[0].payload == payload,
+                    "16bit 長の Binary のマスクを外す");
+    }
+
+    // マスクなし・上限超え・Close
+    {
+        WebSocketDecoder decoder(Transport::MAX_MESSAGE_SIZE);
+        std::vector<DecodedMessage> messages;
+        WebSocketDecoder::Result result = FeedAll(decoder, BuildClientFrame(WebSocketOpcode::Text, true, "x", mask, false), 4096, messages);
+        ok &= Check(result == WebSocketDecoder::Result::Error && decoder.closeCode == WS_CLOSE_PROTOCOL_ERROR && messages.empty(),
+                    "マスクなしのフレームは 1002");
+    }
+    {
+        WebSocketDecoder decoder(16);
+        std::vector<DecodedMessage> messages;
+        std::string stream = BuildClientFrame(WebSocketOpcode::Text, false, "0123456789", mask) +
+                             BuildClientFrame(WebSocketOpcode::Continuation, true, "0123456789", mask);
+        WebSocketDecoder::Result result = FeedAll(decoder, stream, 4096, messages);
+        ok &= Check(result == WebSocketDecoder::Result::Error && decoder.closeCode == WS_CLOSE_TOO_BIG && messages.empty(),
+                    "分割の合計が上限を超えたら 1009");
+    }
+    {
+        WebSocketDecoder decoder(Transport::MAX_MESSAGE_SIZE);
+        std::vector<DecodedMessage> messages;
+        std::string status = { (char)(WS_CLOSE_NORMAL >> 8), (char)(WS_CLOSE_NORMAL & 0xFF) };
+        WebSocketDecoder::Result result = FeedAll(decoder, BuildClientFrame(WebSocketOpcode::Close, true, status, mask), 4096, messages);
+        ok &= Check(result == WebSocketDecoder::Result::Close && decoder.closeCode == WS_CLOSE_NORMAL, "Close のステータスを読む");
+    }
+    return ok;
+}
+
+#ifndef _WIN32
+
+static int ConnectLocal(uint16_t port) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// 1秒以内に size バイト読めなければ false
+static bool ReadExact(int fd, void* out, size_t size) {
+    uint8_t* p = static_cast<uint8_t*>(out);
+    while (size > 0) {
+        pollfd pfd = { fd, POLLIN, 0 };
+        if (poll(&pfd, 1, 1000) <= 0) return false;
+        ssize_t n = read(fd, p, size);
+        if (n <= 0) return false;
+        p += n;
+        size -= (size_t)n;
+    }
+    return true;
+}
+
+static bool SendString(int fd, const std::string& data) {
+    return send(fd, data.data(), data.size(), MSG_NOSIGNAL) == (ssize_t)data.size();
+}
+
+// ハンドシェイクを送り、応答のヘッダ（空行まで）を返す
+static std::string Handshake(int fd, const char* origin) {
+    std::string request =
+        "GET / HTTP/1.1\r\nHost: 127.0.0.1\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+        "Sec-WebSocket-Version: 13\r\nSec-WebSocket-Key: ";
+    request += RFC_SAMPLE_KEY;
+    request += "\r\nOrigin: ";
+    request += origin;
+    request += "\r\n\r\n";
+    if (!SendString(fd, request)) return "";
+    std::string response;
+    char c;
+    while (response.find("\r\n\r\n") == std::string::npos && ReadExact(fd, &c, 1)) response += c;
+    return response;
+}
+
+// サーバー → クライアントのフレーム（マスクなしであること）を1つ読む
+static bool ReadServerFrame(int fd, uint8_t& opcode, std::string& payload) {
+    uint8_t head[2];
+    if (!ReadExact(fd, head, 2) || (head[1] & 0x80) != 0 || (head[0] & 0x80) == 0) return false;
+    opcode = head[0] & 0x0F;
+    uint64_t length = head[1] & 0x7F;
+    if (length >= 126) {
+        uint8_t ext[8];
+        size_t extSize = (length == 126) ? 2 : 8;
+        if (!ReadExact(fd, ext, extSize)) return false;
+        length = 0;
+        for (size_t i = 0; i < extSize; i++) length = (length << 8) | ext[i];
+    }
+    payload.assign((size_t)length, '\0');
+    return length == 0 || ReadExact(fd, &payload[0], (size_t)length);
+}
+
+static bool CheckServer(uint16_t port) {
+    static const uint8_t mask[4] = { 0x11, 0x22, 0x33, 0x44 };
+    char portText[8];
+    snprintf(portText, sizeof(portText), "%u", port);
+
+    WebSocketServer server;
+    std::mutex mutex;
+    std::vector<uint32_t> connected;
+    std::vector<std::string> received;
+    server.OnConnect = [&](uint32_t clientId) {
+        std::lock_guard<std::mutex> lock(mutex);
+        connected.push_back(clientId);
+    };
+    server.OnMessage = [&](uint32_t, std::string_view message) {
+        std::lock_guard<std::mutex> lock(mutex);
+        received.emplace_back(message);
+    };
+    if (!server.Start(portText)) {
+        fprintf(stderr, "WebSocketServer を開始できません (port %s)\n", portText);
+        return false;
+    }
+
+    bool ok = true;
+    printf("WebSocketServer（127.0.0.1:%u）\n", port);
+
+    // 他のサイトのページからの接続
+    int fd = ConnectLocal(port);
+    std::string response = fd >= 0 ? Handshake(fd, "https://evil.example") : "";
+    ok &= Check(response.compare(0, 12, "HTTP/1.1 403") == 0, "他のサイトの Origin は 403");
+    if (fd >= 0) close(fd);
+
+    // localhost のページからの接続
+    fd = ConnectLocal(port);
+    response = fd >= 0 ? Handshake(fd, "http://localhost:5173") : "";
+    ok &= Check(response.compare(0, 12, "HTTP/1.1 101") == 0 &&
+                response.find(std::string("Sec-WebSocket-Accept: ") + RFC_SAMPLE_ACCEPT + "\r\n") != std::string::npos,
+                "localhost の Origin は 101 と RFC の例の Accept");
+    uint32_t clientId = 0;
+    for (int wait = 0; wait < 100 && clientId == 0; wait++) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!connected.empty()) clientId = connected.back();
+        }
+        if (clientId == 0) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    // 分割・マスク付きのコマンドと Ping
+    SendString(fd, BuildClientFrame(WebSocketOpcode::Text, false, "{\"cmd\":", mask));
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    SendString(fd, BuildClientFrame(WebSocketOpcode::Ping, true, "hb", mask) +
+                   BuildClientFrame(WebSocketOpcode::Continuation, true, "\"ping\"}", mask));
+    uint8_t opcode = 0;
+    std::string payload;
+    ok &= Check(ReadServerFrame(fd, opcode, payload) && opcode == (uint8_t)WebSocketOpcode::Pong && payload == "hb",
+                "Ping に同じ内容の Pong が返る");
+    for (int wait = 0; wait < 100; wait++) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!received.empty()) break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ok &= Check(received.size() == 1 && received[0] == "{\"cmd\":\"ping\"}", "分割・マスク付きの Text が OnMessage に1行で届く");
+    }
+
+    // JSON の1行は LF を除いた Text
+    server.SendShared(clientId, Transport::MakeLine("{\"type\":\"pong\"}"));
+    ok &= Check(ReadServerFrame(fd, opcode, payload) && opcode == (uint8_t)WebSocketOpcode::Text && payload == "{\"type\":\"pong\"}",
+                "JSON の1行は末尾の LF を除いた Text");
+
+    // バイナリフレームは先頭の u32 長さを除いた Binary（[種別][本体]）。126 バイト以上で 16bit 長のヘッダも通す
+    std::string frame;
+    size_t start = BeginWireFrame(frame, WireFrameKind::Delta);
+    for (uint32_t i = 0; i < 100; i++) AppendU32LE(frame, i * 0x01010101u);
+    EndWireFrame(frame, start);
+    server.SendShared(clientId, Transport::MakeRaw(frame.data(), frame.size()), MessageClass::Delta);
+    ok &= Check(ReadServerFrame(fd, opcode, payload) && opcode == (uint8_t)WebSocketOpcode::Binary &&
+                payload == frame.substr(WIRE_FRAME_LENGTH_SIZE) && (uint8_t)payload[0] == (uint8_t)WireFrameKind::Delta,
+                "バイナリフレームは先頭の u32 長さを除いた Binary");
+
+    // Close には同じステータスの Close が返る
+    std::string status = { (char)(WS_CLOSE_NORMAL >> 8), (char)(WS_CLOSE_NORMAL & 0xFF) };
+    SendString(fd, BuildClientFrame(WebSocketOpcode::Close, true, status, mask));
+    ok &= Check(ReadServerFrame(fd, opcode, payload) && opcode == (uint8_t)WebSocketOpcode::Close && payload == status,
+                "Close に同じステータスの Close が返る");
+
+    if (fd >= 0) close(fd);
+    server.Stop();
+    return ok;
+}
+
+// 条件に合うフレームが届くまで読む（3秒で諦める）
+template <typename Predicate>
+static bool ReadUntil(int fd, Predicate&& matches) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(3);
+    uint8_t opcode = 0;
+    std::string payload;
+    while (std::chrono::steady_clock::now() < deadline && ReadServerFrame(fd, opcode, payload)) {
+        if (matches(opcode, payload)) return true;
+    }
+    return false;
+}
+
+static bool CheckMonitorHost(uint16_t port) {
+    static const uint8_t mask[4] = { 0x5A, 0x01, 0xC3, 0x7E };
+    bool ok = true;
+    printf("モニター（ws://127.0.0.1:%u/）\n", port);
+
+    int fd = ConnectLocal(port);
+    std::string response = fd >= 0 ? Handshake(fd, "http://127.0.0.1:5173") : "";
+    if (!Check(response.compare(0, 12, "HTTP/1.1 101") == 0, "接続できる")) {
+        if (fd >= 0) close(fd);
+        return false;
+    }
+
+    SendString(fd, BuildClientFrame(WebSocketOpcode::Text, true,
+        "{\"cmd\":\"rescan\"}\n{\"cmd\":\"setVersion\",\"target\":\"RJ\"}", mask));
+    ok &= Check(ReadUntil(fd, [](uint8_t opcode, const std::string& payload) {
+        return opcode == (uint8_t)WebSocketOpcode::Text && payload.find("\"type\":\"full\"") != std::string::npos &&
+               payload.back() != '\n';
+    }), "rescan / setVersion（1つの Text に2行）でフルステートが Text で届く");
+
+    SendString(fd, BuildClientFrame(WebSocketOpcode::Text, true, "{\"cmd\":\"setEncoding\",\"target\":\"binary\"}", mask));
+    ok &= Check(ReadUntil(fd, [](uint8_t opcode, const std::string& payload) {
+        return opcode == (uint8_t)WebSocketOpcode::Binary && !payload.empty() && (uint8_t)payload[0] == (uint8_t)WireFrameKind::Full;
+    }), "setEncoding binary の後のフルステートは u32 長さなしの Binary");
+
+    close(fd);
+    return ok;
+}
+
+#endif // !_WIN32
+
+// ========================================
+// 計測プログラムの入口（Windows は Bench プロジェクトの "websocket"（フレームの確認のみ）、Linux は WEBSOCKET_CHECK_MAIN を定義して単体でビルド）
+//   g++ -std=c++17 -O2 -DWEBSOCKET_CHECK_MAIN websocket_check.cpp websocket.cpp websocket_server.cpp send_queue.cpp
+//       latency_stats.cpp -lpthread -o websocket_check
+//   ./websocket_check [--port N] [--host-port N]
+// ========================================
+int WebSocketCheckMain(int argc, char** argv) {
+    unsigned port = 0;
+    unsigned hostPort = 0;
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = (i + 1 < argc) ? argv[i + 1] : "0";
+        if (strcmp(arg, "--port") == 0) { port = (unsigned)strtoul(value, nullptr, 10); i++; }
+        else if (strcmp(arg, "--host-port") == 0) { hostPort = (unsigned)strtoul(value, nullptr, 10); i++; }
+        else {
+            fprintf(stderr, "不明な引数: %s\n", arg);
+            return 2;
+        }
+    }
+
+    bool ok = CheckCodec();
+#ifdef _WIN32
+    (void)port;
+    (void)hostPort;
+    printf("WebSocketServer への接続の確認は Linux のみ\n");
+#else
+    // 既定のポートはプロセス毎にずらす（同時に走らせても重ならないように）
+    if (port == 0) port = 38000 + (unsigned)(getpid() % 2000);
+    ok &= CheckServer((uint16_t)port);
+    if (hostPort) ok &= CheckMonitorHost((uint16_t)hostPort);
+#endif
+    printf("%s\n", ok ? "OK" : "NG");
+    return ok ? 0 : 1;
+}
+
+#ifdef WEBSOCKET_CHECK_MAIN
+int main(int argc, char** argv) {
+    return WebSocketCheckMain(argc, argv);
+}
+#endif
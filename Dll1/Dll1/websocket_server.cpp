@@ -0,0 +1,381 @@
+﻿#include "pch.h"
+#include "websocket_server.h"
+#include "websocket.h"
+#include "wire_format.h"
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <chrono>
+#include <algorithm>
+
+#ifdef _WIN32
+#include <ws2tcpip.h>
+#pragma comment(lib, "Ws2_32.lib")
+static constexpr int SHUTDOWN_BOTH = SD_BOTH;
+static int PollSocket(pollfd* fds, int timeoutMs) { return WSAPoll(fds, 1, timeoutMs); }
+static void CloseSocket(SOCKET s) { closesocket(s); }
+static int LastSocketError() { return WSAGetLastError(); }
+#else
+#include <cerrno>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+static constexpr int SHUTDOWN_BOTH = SHUT_RDWR;
+static int PollSocket(pollfd* fds, int timeoutMs) { return poll(fds, 1, timeoutMs); }
+static void CloseSocket(int s) { close(s); }
+static int LastSocketError() { return errno; }
+#endif
+
+using SocketHandle = WebSocketServer::SocketHandle;
+
+// readable になるまで待つ（timeoutMs 経過で false）
+static bool WaitReadable(SocketHandle s, int timeoutMs) {
+    pollfd pfd = {};
+    pfd.fd = s;
+    pfd.events = POLLIN;
+    return PollSocket(&pfd, timeoutMs) > 0;
+}
+
+// head と body を続けて書く（ヘッダを付けるためだけに本体をコピーしないよう、まとめて1回の送信で渡す）
+static bool SendAll(SocketHandle s, const char* head, size_t headSize, const char* body, size_t bodySize) {
+    while (headSize + bodySize > 0) {
+        size_t sent;
+#ifdef _WIN32
+        WSABUF buffers[2] = { { (ULONG)headSize, const_cast<char*>(head) }, { (ULONG)bodySize, const_cast<char*>(body) } };
+        WSABUF* first = headSize ? buffers : buffers + 1;
+        DWORD bytes = 0;
+        if (WSASend(s, first, headSize ? 2 : 1, &bytes, 0, NULL, NULL) != 0) return false;
+        sent = bytes;
+#else
+        iovec iov[2] = { { const_cast<char*>(head), headSize }, { const_cast<char*>(body), bodySize } };
+        msghdr msg = {};
+        msg.msg_iov = headSize ? iov : iov + 1;
+        msg.msg_iovlen = headSize ? 2 : 1;
+        ssize_t n = sendmsg(s, &msg, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        sent = (size_t)n;
+#endif
+        size_t fromHead = (std::min)(sent, headSize);
+        head += fromHead;
+        headSize -= fromHead;
+        sent -= fromHead;
+        body += sent;
+        bodySize -= sent;
+    }
+    return true;
+}
+
+WebSocketServer::~WebSocketServer() {
+    Stop();
+}
+
+bool WebSocketServer::Start(const char* port) {
+    if (m_running.load()) return false;
+
+    int portNumber = atoi(port);
+    if (portNumber <= 0 || portNumber > 65535) {
+        printf("[WebSocket] 不正なポート: %s\n", port);
+        return false;
+    }
+
+#ifdef _WIN32
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+        printf("[WebSocket] WSAStartup失敗\n");
+        return false;
+    }
+#endif
+
+    // localhost からの接続のみ受け付ける
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)portNumber);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    m_listenSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (m_listenSocket == INVALID_SOCKET_HANDLE) {
+        printf("[WebSocket] socket失敗: %d\n", LastSocketError());
+#ifdef _WIN32
+        WSACleanup();
+#endif
+        return false;
+    }
+#ifndef _WIN32
+    // 再起動直後（TIME_WAIT が残っている間）でも bind できるように
+    int reuse = 1;
+    setsockopt(m_listenSocket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+#endif
+    if (bind(m_listenSocket, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+        listen(m_listenSocket, (int)MAX_CLIENTS) != 0) {
+        printf("[WebSocket] bind/listen失敗 (port %d): %d\n", portNumber, LastSocketError());
+        CloseSocket(m_listenSocket);
+        m_listenSocket = INVALID_SOCKET_HANDLE;
+#ifdef _WIN32
+        WSACleanup();
+#endif
+        return false;
+    }
+
+    m_port = port;
+    m_running = true;
+    m_acceptThread = std::thread(&WebSocketServer::AcceptThread, this);
+
+    printf("[WebSocket] 開始: ws://127.0.0.1:%d/ (最大%zuクライアント)\n", portNumber, MAX_CLIENTS);
+    return true;
+}
+
+void WebSocketServer::Stop() {
+    if (!m_running.exchange(false)) return;
+
+    // 全クライアントのブロック中の送受信を解除（各クライアントスレッドが後始末する）
+    {
+        std::lock_guard<std::mutex> lock(m_clientsMutex);
+        for (auto& client : m_clients) {
+            client->connected = false;
+            client->queue.Stop(false);
+            shutdown(client->socket, SHUTDOWN_BOTH);
+        }
+    }
+    if (m_acceptThread.joinable()) {
+        m_acceptThread.join();
+    }
+    CloseSocket(m_listenSocket);
+    m_listenSocket = INVALID_SOCKET_HANDLE;
+
+    // クライアントスレッドは this を使うので、終わるまで待つ（読み取りは500ms毎に停止チェックする）
+    for (int i = 0; i < 40 && m_activeThreads.load() > 0; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+#ifdef _WIN32
+    WSACleanup();
+#endif
+
+    printf("[WebSocket] 停止\n");
+}
+
+bool WebSocketServer::SendShared(uint32_t clientId, const SendBuffer& buffer, MessageClass cls) {
+    std::shared_ptr<Client> client = FindClient(clientId);
+    if (!client || !client->connected.load()) return false;
+    return client->queue.Push(buffer, cls);
+}
+
+bool WebSocketServer::GetSendQueueStats(uint32_t clientId, SendQueueStats& out) const {
+    std::shared_ptr<Client> client = FindClient(clientId);
+    if (!client) return false;
+    out = client->queue.GetStats();
+    return true;
+}
+
+bool WebSocketServer::IsSendBusy(uint32_t clientId) const {
+    std::shared_ptr<Client> client = FindClient(clientId);
+    return client && client->queue.IsBusy();
+}
+
+std::shared_ptr<WebSocketServer::Client> WebSocketServer::FindClient(uint32_t clientId) const {
+    std::lock_guard<std::mutex> lock(m_clientsMutex);
+    for (const auto& client : m_clients) {
+        if (client->id == clientId) return client;
+    }
+    return nullptr;
+}
+
+bool WebSocketServer::WriteFrame(Client& client, uint8_t opcode, const char* payload, size_t size) {
+    uint8_t header[10];
+    size_t headerSize = BuildWebSocketFrameHeader((WebSocketOpcode)opcode, size, header);
+    if (!SendAll(client.socket, reinterpret_cast<const char*>(header), headerSize, payload, size)) {
+        printf("[WebSocket] Send失敗 (id=%u): %d\n", client.id, LastSocketError());
+        return false;
+    }
+    return true;
+}
+
+bool WebSocketServer::WriteBlocking(Client& client, const SendPayload& payload) {
+    const char* data = payload.bytes.data();
+    size_t size = payload.bytes.size();
+    WebSocketOpcode opcode;
+    if (payload.kind == PayloadKind::Frame && size >= WIRE_FRAME_LENGTH_SIZE) {
+        opcode = WebSocketOpcode::Binary;
+        data += WIRE_FRAME_LENGTH_SIZE;
+        size -= WIRE_FRAME_LENGTH_SIZE;
+    } else {
+        opcode = WebSocketOpcode::Text;
+        if (size > 0 && data[size - 1] == '\n') size--;
+    }
+    std::lock_guard<std::mutex> lock(client.writeMutex);
+    return WriteFrame(client, (uint8_t)opcode, data, size);
+}
+
+void WebSocketServer::AcceptThread() {
+    printf("[WebSocket] 接続受付スレッド開始\n");
+
+    while (m_running.load()) {
+        // 接続を待つ（500ms毎に停止チェック）
+        if (!WaitReadable(m_listenSocket, 500)) continue;
+        SocketHandle s = accept(m_listenSocket, nullptr, nullptr);
+        if (s == INVALID_SOCKET_HANDLE) continue;
+
+        {
+            std::lock_guard<std::mutex> lock(m_clientsMutex);
+            if (m_clients.size() >= MAX_CLIENTS) {
+                printf("[WebSocket] 接続数が上限のため拒否\n");
+                CloseSocket(s);
+                continue;
+            }
+        }
+
+        // 小さな delta を溜めずにすぐ送る
+        int noDelay = 1;
+        setsockopt(s, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay));
+
+        auto client = std::make_shared<Client>();
+        client->id = m_nextClientId++;
+        client->socket = s;
+        client->queue.SetPolicy(m_overflowPolicy);
+        client->queue.SetLatencyStats(m_latencyStats);
+        {
+            std::lock_guard<std::mutex> lock(m_clientsMutex);
+            m_clients.push_back(client);
+        }
+
+        // クライアントスレッドが切断まで面倒を見る
+        m_activeThreads++;
+        std::thread(&WebSocketServer::ClientThread, this, client).detach();
+    }
+
+    printf("[WebSocket] 接続受付スレッド停止\n");
+}
+
+bool WebSocketServer::Handshake(Client& client, std::string& leftover) {
+    std::string request;
+    char buf[1024];
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(HANDSHAKE_TIMEOUT_MS);
+
+    size_t headerEnd;
+    while ((headerEnd = request.find("\r\n\r\n")) == std::string::npos) {
+        if (request.size() > MAX_HANDSHAKE_SIZE || !m_running.load()) return false;
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+        if (remaining <= 0 || !WaitReadable(client.socket, (int)(std::min)(remaining, (decltype(remaining))500))) {
+            if (std::chrono::steady_clock::now() >= deadline) return false;
+            continue;
+        }
+        int n = (int)recv(client.socket, buf, sizeof(buf), 0);
+        if (n <= 0) return false;
+        request.append(buf, (size_t)n);
+    }
+
+    WebSocketHandshake handshake = ParseWebSocketHandshake(std::string_view(request.data(), headerEnd + 4));
+    const char* rejection = nullptr;
+    if (!handshake.valid) {
+        rejection = "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+    } else if (!IsAllowedWebSocketOrigin(handshake.origin)) {
+        printf("[WebSocket] 許可していない Origin のため拒否: %s\n", handshake.origin.c_str());
+        rejection = "HTTP/1.1 403 Forbidden\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+    }
+    if (rejection) {
+        SendAll(client.socket, rejection, strlen(rejection), nullptr, 0);
+        return false;
+    }
+
+    std::string response = BuildWebSocketHandshakeResponse(handshake.key);
+    if (!SendAll(client.socket, response.data(), response.size(), nullptr, 0)) return false;
+    leftover = request.substr(headerEnd + 4);
+    return true;
+}
+
+void WebSocketServer::ClientThread(std::shared_ptr<Client> client) {
+    Client* c = client.get();
+
+    std::string leftover;
+    bool upgraded = Handshake(*c, leftover);
+    if (upgraded) {
+        // 書き込みスレッド開始。書き込み失敗・キュー溢れではソケットを閉じ側にして読み取りを終わらせる
+        c->queue.Start(
+            [this, c](const SendPayload& payload) { return WriteBlocking(*c, payload); },
+            [c]() {
+                c->connected = false;
+                shutdown(c->socket, SHUTDOWN_BOTH);
+            });
+        c->connected = true;
+        m_clientCount++;
+
+        printf("[WebSocket] クライアント接続! (id=%u, 接続数=%zu)\n", c->id, m_clientCount.load());
+        if (OnConnect) OnConnect(c->id);
+
+        // 切断までここでブロック
+        ReadLoop(*c, leftover);
+
+        // クライアント切断（未送信分は破棄）
+        c->connected = false;
+        c->queue.Stop();
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_clientsMutex);
+        m_clients.erase(std::remove(m_clients.begin(), m_clients.end(), client), m_clients.end());
+    }
+    if (upgraded) {
+        m_clientCount--;
+        printf("[WebSocket] クライアント切断 (id=%u, 接続数=%zu)\n", c->id, m_clientCount.load());
+        if (OnDisconnect) OnDisconnect(c->id);
+    }
+
+    CloseSocket(c->socket);
+    c->socket = INVALID_SOCKET_HANDLE;
+    m_activeThreads--;
+}
+
+void WebSocketServer::ReadLoop(Client& client, const std::string& leftover) {
+    WebSocketDecoder decoder(MAX_MESSAGE_SIZE);
+
+    // Text メッセージは JSON コマンド1件（LF 区切りで複数並べてもよい）
+    auto onMessage = [&](WebSocketOpcode opcode, char* payload, size_t size) {
+        if (opcode == WebSocketOpcode::Text) {
+            char* line = payload;
+            char* end = payload + size;
+            while (line < end) {
+                char* newline = static_cast<char*>(memchr(line, '\n', (size_t)(end - line)));
+                char* lineEnd = newline ? newline : end;
+                size_t length = (size_t)(lineEnd - line);
+                if (length > 0 && line[length - 1] == '\r') length--;
+                line[length] = '\0';
+                if (length > 0 && OnMessage) OnMessage(client.id, std::string_view(line, length));
+                line = lineEnd + 1;
+            }
+        } else if (opcode == WebSocketOpcode::Ping) {
+            std::lock_guard<std::mutex> lock(client.writeMutex);
+            WriteFrame(client, (uint8_t)WebSocketOpcode::Pong, payload, size);
+        } else if (opcode == WebSocketOpcode::Binary) {
+            printf("[WebSocket] Binary メッセージは受け付けない (id=%u, %zu bytes)\n", client.id, size);
+        }
+    };
+
+    WebSocketDecoder::Result result = WebSocketDecoder::Result::Ok;
+    if (!leftover.empty()) {
+        result = decoder.Feed(leftover.data(), leftover.size(), onMessage);
+    }
+
+    char buf[4096];
+    while (result == WebSocketDecoder::Result::Ok && m_running.load() && client.connected.load()) {
+        // 受信待ち（500ms毎に停止チェック）
+        if (!WaitReadable(client.socket, 500)) continue;
+        int n = (int)recv(client.socket, buf, sizeof(buf), 0);
+        if (n <= 0) return;  // クライアント側の切断・エラー
+        result = decoder.Feed(buf, (size_t)n, onMessage);
+    }
+
+    // Close の応答（受信した Close にはそのステータスを返す）・プロトコル違反の通知
+    if (result != WebSocketDecoder::Result::Ok) {
+        if (result == WebSocketDecoder::Result::Error) {
+            printf("[WebSocket] プロトコル違反のため切断 (id=%u, code=%u)\n", client.id, decoder.closeCode);
+        }
+        uint8_t status[2] = { (uint8_t)(decoder.closeCode >> 8), (uint8_t)decoder.closeCode };
+        std::lock_guard<std::mutex> lock(client.writeMutex);
+        WriteFrame(client, (uint8_t)WebSocketOpcode::Close, reinterpret_cast<const char*>(status), sizeof(status));
+    }
+}
@@ -0,0 +1,77 @@
+﻿#pragma once
+// websocket_server.h : localhost 限定の WebSocket サーバー（ブラウザから直接つなぐための Transport）
+// 構成は PipeServer と同じで、接続受付スレッドと、クライアント毎の読み取りスレッド・送信キューを持つ
+// 送信キューには他の通信路と同じ SendBuffer（JSON の1行 / バイナリフレーム）を積み、
+// 書き込み時に WebSocket のフレームヘッダだけを前に付けて送る（本体はコピーしない）。どちらかは SendPayload::kind で決める
+//   JSON の1行        → Text メッセージ（末尾の LF を除く）
+//   バイナリフレーム  → Binary メッセージ（先頭の u32 長さを除いた [種別][本体]）
+
+#include <string>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <vector>
+#include "transport.h"
+#ifdef _WIN32
+#include <winsock2.h>
+#endif
+
+class WebSocketServer : public Transport {
+public:
+#ifdef _WIN32
+    using SocketHandle = SOCKET;
+    static constexpr SocketHandle INVALID_SOCKET_HANDLE = INVALID_SOCKET;
+#else
+    using SocketHandle = int;
+    static constexpr SocketHandle INVALID_SOCKET_HANDLE = -1;
+#endif
+
+    // ハンドシェイク（HTTP 要求）の上限と待ち時間
+    static constexpr size_t MAX_HANDSHAKE_SIZE = 8192;
+    static constexpr int HANDSHAKE_TIMEOUT_MS = 5000;
+
+    WebSocketServer() = default;
+    ~WebSocketServer() override;
+
+    // サーバー開始（127.0.0.1 の port で待ち受け）。endpoint: ポート番号の文字列
+    bool Start(const char* port) override;
+
+    // サーバー停止（全クライアント切断）
+    void Stop() override;
+
+    bool SendShared(uint32_t clientId, const SendBuffer& buffer, MessageClass cls = MessageClass::Control) override;
+    bool GetSendQueueStats(uint32_t clientId, SendQueueStats& out) const override;
+    bool IsSendBusy(uint32_t clientId) const override;
+
+private:
+    struct Client {
+        uint32_t id = 0;
+        SocketHandle socket = INVALID_SOCKET_HANDLE;
+        SendQueue queue;
+        std::mutex writeMutex;          // 書き込みスレッドと読み取りスレッド（Pong / Close）の書き込みの排他
+        std::atomic<bool> connected{ false };
+    };
+
+    void AcceptThread();
+    void ClientThread(std::shared_ptr<Client> client);
+
+    // ハンドシェイク（成功すれば true。要求の後ろに続いて届いたデータは leftover に残す）
+    bool Handshake(Client& client, std::string& leftover);
+    void ReadLoop(Client& client, const std::string& leftover);
+    std::shared_ptr<Client> FindClient(uint32_t clientId) const;
+
+    // 書き込みスレッドから呼ばれる。SendBuffer 1件を WebSocket メッセージ1件として書き終えるまでブロックする
+    bool WriteBlocking(Client& client, const SendPayload& payload);
+    // フレームヘッダ＋本体を書く（writeMutex を保持して呼ぶ）
+    bool WriteFrame(Client& client, uint8_t opcode, const char* payload, size_t size);
+
+    SocketHandle m_listenSocket = INVALID_SOCKET_HANDLE;
+    std::string m_port;
+    std::thread m_acceptThread;
+    std::atomic<bool> m_running{ false };
+    std::atomic<size_t> m_activeThreads{ 0 };  // 終了していないクライアントスレッド数（Stop で待つ）
+
+    mutable std::mutex m_clientsMutex;
+    std::vector<std::shared_ptr<Client>> m_clients;  // ハンドシェイク中を含む
+};
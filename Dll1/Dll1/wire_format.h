@@ -0,0 +1,101 @@
+﻿#pragma once
+// wire_format.h : バイナリ転送モードのフレーム形式
+// hello でクライアントに提示し、setEncoding コマンドで切り替える（既定は JSON）
+//
+// フレーム: [u32 LE 長さ][u8 種別][本体]   長さ = 種別 + 本体のバイト数
+//   Json      : 本体 = JSON文字列（LFなし）。status / pong / error などの制御メッセージ
+//   NameTable : 本体 = varint 件数, { u8 名前長, 名前, u32 LE DSアドレス, u8 サイズ } × 件数  (id は並び順)
+//   Full      : 本体 = u64 LE seq, { varint id, 値 (サイズ分の LE バイト列) } × 初期化済み件数
+//   Delta     : 本体 = u64 LE seq, { varint id, 値 } × 変化件数
+//   CoalescedDelta : 本体 = u64 LE seq, u64 LE 開始seq, { varint id, 値 } × 変化件数
+//                    送信が詰まっている間の 開始seq〜seq の delta を、値毎の最新値にまとめたもの
+//   TimedDelta / TimedCoalescedDelta : Delta / CoalescedDelta の値の前に u64 LE サンプリング時刻を挟んだもの
+//                    （Unix 時刻のマイクロ秒。サンプリング時刻の付加が有効な時だけ使う）
+//   Instance  : 本体 = u8 インスタンス id, u8 種別, 本体
+//               インスタンス 0 以外の NameTable / Full / Delta 系フレームを包んだもの（インスタンス 0 は包まずに送る）
+// 値のサイズは NameTable から引く
+
+#include <cstdint>
+#include <string>
+
+enum class WireEncoding : uint8_t {
+    Json = 0,
+    Binary = 1,
+};
+
+enum class WireFrameKind : uint8_t {
+    Json = 1,
+    NameTable = 2,
+    Full = 3,
+    Delta = 4,
+    CoalescedDelta = 5,
+    TimedDelta = 6,
+    TimedCoalescedDelta = 7,
+    Instance = 8,
+};
+
+// フレーム長フィールドのバイト数
+constexpr size_t WIRE_FRAME_LENGTH_SIZE = 4;
+
+inline void AppendU32LE(std::string& buf, uint32_t value) {
+    char bytes[4] = {
+        (char)(value & 0xFF), (char)((value >> 8) & 0xFF),
+        (char)((value >> 16) & 0xFF), (char)((value >> 24) & 0xFF),
+    };
+    buf.append(bytes, 4);
+}
+
+inline void AppendU64LE(std::string& buf, uint64_t value) {
+    AppendU32LE(buf, (uint32_t)value);
+    AppendU32LE(buf, (uint32_t)(value >> 32));
+}
+
+// 値を size バイトのリトルエンディアンで追加
+inline void AppendValueLE(std::string& buf, uint32_t value, uint8_t size) {
+    for (uint8_t i = 0; i < size; i++) {
+        buf += (char)((value >> (i * 8)) & 0xFF);
+    }
+}
+
+// LEB128 形式の可変長整数（7ビットずつ、下位から）
+inline void AppendVarint(std::string& buf, uint32_t value) {
+    while (value >= 0x80) {
+        buf += (char)((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    buf += (char)value;
+}
+
+// フレームを開始する。長さは EndWireFrame で埋める。戻り値はフレーム先頭位置
+inline size_t BeginWireFrame(std::string& buf, WireFrameKind kind) {
+    size_t start = buf.size();
+    AppendU32LE(buf, 0);
+    buf += (char)kind;
+    return start;
+}
+
+// インスタンス instance のフレームを開始する（0 以外なら Instance フレームに包む）。長さは EndWireFrame で埋める
+inline size_t BeginInstanceWireFrame(std::string& buf, WireFrameKind kind, uint32_t instance) {
+    if (instance == 0) return BeginWireFrame(buf, kind);
+    size_t start = BeginWireFrame(buf, WireFrameKind::Instance);
+    buf += (char)instance;
+    buf += (char)kind;
+    return start;
+}
+
+inline void EndWireFrame(std::string& buf, size_t start) {
+    uint32_t length = (uint32_t)(buf.size() - start - WIRE_FRAME_LENGTH_SIZE);
+    for (size_t i = 0; i < WIRE_FRAME_LENGTH_SIZE; i++) {
+        buf[start + i] = (char)((length >> (i * 8)) & 0xFF);
+    }
+}
+
+// JSON 制御メッセージをフレームに包む
+inline std::string WrapJsonFrame(const std::string& json) {
+    std::string frame;
+    frame.reserve(WIRE_FRAME_LENGTH_SIZE + 1 + json.size());
+    size_t start = BeginWireFrame(frame, WireFrameKind::Json);
+    frame += json;
+    EndWireFrame(frame, start);
+    return frame;
+}
@@ -105,6 +105,12 @@ function createWindow() {
     }
   });
 
+  ipcMain.on('game-subscribe', (_event, groups: string[] | null) => {
+    if (pipeClient) {
+      pipeClient.subscribe(groups);
+    }
+  });
+
   ipcMain.on('open-external', (_event, url: string) => {
     shell.openExternal(url);
   });
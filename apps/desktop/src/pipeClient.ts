@@ -4,6 +4,39 @@ import { EventEmitter } from 'events';
 const PIPE_NAME = '\\\\.\\pipe\\ssr3_viewer';
 const RECONNECT_INTERVAL = 100;
 
+/** バイナリ転送モードのフレーム種別（Dll1/Dll1/wire_format.h と対応） */
+const FRAME_JSON = 1;
+const FRAME_NAME_TABLE = 2;
+const FRAME_FULL = 3;
+const FRAME_DELTA = 4;
+const FRAME_COALESCED_DELTA = 5;
+const FRAME_TIMED_DELTA = 6;
+const FRAME_TIMED_COALESCED_DELTA = 7;
+const FRAME_INSTANCE = 8;
+const FRAME_LENGTH_SIZE = 4;
+
+interface NameTableEntry {
+  name: string;
+  address: number;
+  size: number;
+}
+
+function toHex(value: number, digits: number): string {
+  return value.toString(16).toUpperCase().padStart(digits, '0');
+}
+
+/** LEB128 可変長整数を読み、値と次の位置を返す */
+function readVarint(buf: Buffer, pos: number): [number, number] {
+  let value = 0;
+  let shift = 0;
+  for (;;) {
+    const b = buf[pos++];
+    value += (b & 0x7f) * 2 ** shift;
+    if (!(b & 0x80)) return [value, pos];
+    shift += 7;
+  }
+}
+
 export interface PipeMessage {
   type: string;
   [key: string]: unknown;
@@ -11,10 +44,20 @@ export interface PipeMessage {
 
 export class PipeClient extends EventEmitter {
   private socket: net.Socket | null = null;
-  private buffer = '';
+  private buffer: Buffer = Buffer.alloc(0);
+  /** 受信側の転送形式。hello で binary が提示されたら切り替えを要求する */
+  private encoding: 'json' | 'binary' = 'json';
+  /** バイナリモードの id → 名前・アドレス・サイズ */
+  private nameTable: NameTableEntry[] = [];
   private reconnectTimer: ReturnType<typeof setTimeout> | null = null;
   private stopped = false;
   private wasConnected = false;
+  /** 最後に適用した delta の seq（null = 未受信） */
+  private lastSeq: number | null = null;
+  /** resume 要求の応答待ち */
+  private resumePending = false;
+  /** 購読中のグループ・パターン（null = 全値）。再接続時に送り直す */
+  private subscription: string[] | null = null;
 
   connect(): void {
     this.stopped = false;
@@ -27,27 +70,25 @@ export class PipeClient extends EventEmitter {
     this.socket = net.createConnection(PIPE_NAME, () => {
       console.log('[PipeClient] Connected to DLL pipe');
       this.wasConnected = true;
+      this.buffer = Buffer.alloc(0);
+      this.encoding = 'json';
+      this.nameTable = [];
       this.emit('connected');
     });
 
-    this.socket.setEncoding('utf-8');
-
-    this.socket.on('data', (data: string) => {
-      this.buffer += data;
-      // LF区切りでメッセージ分割
-      const lines = this.buffer.split('\n');
-      // 最後の不完全行はバッファに残す
-      this.buffer = lines.pop() || '';
-      for (const line of lines) {
-        const trimmed = line.trim();
-        if (!trimmed) continue;
-        try {
-          const msg = JSON.parse(trimmed) as PipeMessage;
-          this.emit('message', msg);
-        } catch {
-          console.warn('[PipeClient] JSON parse error:', trimmed);
-        }
+    this.socket.on('data', (data: Buffer) => {
+      this.buffer = this.buffer.length ? Buffer.concat([this.buffer, data]) : data;
+      // 処理中に転送形式が切り替わることがあるので、1メッセージずつ取り出す
+      let offset = 0;
+      while (offset < this.buffer.length) {
+        const consumed = this.encoding === 'json'
+          ? this.readLine(offset)
+          : this.readFrame(offset);
+        if (consumed === 0) break;
+        offset += consumed;
       }
+      // 不完全なメッセージはバッファに残す
+      this.buffer = this.buffer.subarray(offset);
     });
 
     this.socket.on('error', (err: Error) => {
@@ -66,6 +107,165 @@ export class PipeClient extends EventEmitter {
     });
   }
 
+  /** LF区切りJSONを1行処理し、消費したバイト数を返す（不完全なら0） */
+  private readLine(offset: number): number {
+    const end = this.buffer.indexOf(0x0a, offset);
+    if (end < 0) return 0;
+    const trimmed = this.buffer.toString('utf-8', offset, end).trim();
+    if (trimmed) {
+      try {
+        this.handleMessage(JSON.parse(trimmed) as PipeMessage);
+      } catch {
+        console.warn('[PipeClient] JSON parse error:', trimmed);
+      }
+    }
+    return end + 1 - offset;
+  }
+
+  /** バイナリフレームを1つ処理し、消費したバイト数を返す（不完全なら0） */
+  private readFrame(offset: number): number {
+    if (this.buffer.length - offset < FRAME_LENGTH_SIZE) return 0;
+    const length = this.buffer.readUInt32LE(offset);
+    const total = FRAME_LENGTH_SIZE + length;
+    if (this.buffer.length - offset < total) return 0;
+
+    const frame = this.buffer.subarray(offset + FRAME_LENGTH_SIZE, offset + total);
+    const kind = frame[0];
+    const body = frame.subarray(1);
+    switch (kind) {
+      case FRAME_JSON:
+        try {
+          this.handleMessage(JSON.parse(body.toString('utf-8')) as PipeMessage);
+        } catch {
+          console.warn('[PipeClient] JSON frame parse error');
+        }
+        break;
+      case FRAME_NAME_TABLE:
+        this.nameTable = this.decodeNameTable(body);
+        break;
+      case FRAME_FULL:
+      case FRAME_DELTA:
+        this.handleMessage(this.decodeValues(kind === FRAME_FULL ? 'full' : 'delta', body));
+        break;
+      case FRAME_COALESCED_DELTA:
+      case FRAME_TIMED_COALESCED_DELTA: {
+        // u64 seq, u64 開始seq, [u64 サンプリング時刻,] 値…（JSON の "from" / "coalesced" / "sampleUs" と同じ意味）
+        const timed = kind === FRAME_TIMED_COALESCED_DELTA;
+        const msg = this.decodeValues('delta', body, timed ? 24 : 16);
+        msg.from = Number(body.readBigUInt64LE(8));
+        msg.coalesced = true;
+        if (timed) msg.sampleUs = Number(body.readBigUInt64LE(16));
+        this.handleMessage(msg);
+        break;
+      }
+      case FRAME_TIMED_DELTA: {
+        // u64 seq, u64 サンプリング時刻, 値…
+        const msg = this.decodeValues('delta', body, 16);
+        msg.sampleUs = Number(body.readBigUInt64LE(8));
+        this.handleMessage(msg);
+        break;
+      }
+      case FRAME_INSTANCE:
+        // インスタンス0以外の値（watch で選んだ時だけ届く）。このクライアントはインスタンス0だけを表示する
+        break;
+      default:
+        console.warn('[PipeClient] Unknown frame kind:', kind);
+        break;
+    }
+    return total;
+  }
+
+  private handleMessage(msg: PipeMessage): void {
+    if (msg.type === 'hello') {
+      const encodings = msg.encodings;
+      if (Array.isArray(encodings) && encodings.includes('binary')) {
+        this.send({ cmd: 'setEncoding', target: 'binary' });
+      }
+      if (this.subscription) {
+        this.send({ cmd: 'subscribe', groups: this.subscription });
+      }
+    } else if (msg.type === 'encoding') {
+      // この応答以降のメッセージから新しい形式になる
+      this.encoding = msg.mode === 'binary' ? 'binary' : 'json';
+    }
+    if (!this.acceptSeq(msg)) return;
+    this.emit('message', msg);
+  }
+
+  private decodeNameTable(body: Buffer): NameTableEntry[] {
+    const [count, start] = readVarint(body, 0);
+    let pos = start;
+    const table: NameTableEntry[] = [];
+    for (let i = 0; i < count; i++) {
+      const nameLength = body[pos++];
+      const name = body.toString('utf-8', pos, pos + nameLength);
+      pos += nameLength;
+      const address = body.readUInt32LE(pos);
+      pos += 4;
+      const size = body[pos++];
+      table.push({ name, address, size });
+    }
+    return table;
+  }
+
+  /** full / delta フレームを JSON モードと同じ形のメッセージに変換する（valuesOffset: 値の開始位置） */
+  private decodeValues(type: 'full' | 'delta', body: Buffer, valuesOffset = 8): PipeMessage {
+    const seq = Number(body.readBigUInt64LE(0));
+    const data: Record<string, { v: string; a?: string; s?: number }> = {};
+    let pos = valuesOffset;
+    while (pos < body.length) {
+      let id: number;
+      [id, pos] = readVarint(body, pos);
+      const entry = this.nameTable[id];
+      if (!entry) {
+        console.warn('[PipeClient] Unknown id in frame:', id);
+        break;
+      }
+      const value = body.readUIntLE(pos, entry.size);
+      pos += entry.size;
+      data[entry.name] = type === 'full'
+        ? { v: toHex(value, entry.size * 2), a: toHex(entry.address, 8), s: entry.size }
+        : { v: toHex(value, entry.size * 2) };
+    }
+    return { type, seq, data };
+  }
+
+  /**
+   * seq の連続性を確認する。欠落を検出したら resume を要求し、
+   * 再送が届くまで後続の delta は捨てる（false を返す）
+   */
+  private acceptSeq(msg: PipeMessage): boolean {
+    if (typeof msg.seq !== 'number') return true;
+    const seq = msg.seq;
+
+    if (msg.type === 'full') {
+      this.lastSeq = seq;
+      this.resumePending = false;
+      return true;
+    }
+    if (msg.type !== 'delta') return true;
+
+    if (this.lastSeq === null || seq === this.lastSeq + 1) {
+      this.lastSeq = seq;
+      this.resumePending = false;
+      return true;
+    }
+    // 合流 delta は from〜seq をまとめたもの。前回の続きから始まっていれば欠落ではない
+    if (msg.coalesced === true && typeof msg.from === 'number' &&
+        msg.from <= this.lastSeq + 1 && seq > this.lastSeq) {
+      this.lastSeq = seq;
+      this.resumePending = false;
+      return true;
+    }
+    if (seq <= this.lastSeq) return false; // 再送済みの重複
+    if (!this.resumePending) {
+      console.warn(`[PipeClient] delta欠落: ${this.lastSeq} → ${seq}. resume要求`);
+      this.resumePending = true;
+      this.resume(this.lastSeq);
+    }
+    return false;
+  }
+
   /** コマンド送信 (JSON + LF) */
   send(cmd: object): void {
     if (!this.socket || this.socket.destroyed) return;
@@ -93,11 +293,30 @@ export class PipeClient extends EventEmitter {
     this.send({ cmd: 'ping' });
   }
 
+  /** 指定seqより後の delta 再送要求（再送不可ならフルステートが返る） */
+  resume(seq: number): void {
+    this.send({ cmd: 'resume', seq });
+  }
+
   /** MainRAM再スキャン要求 */
   rescan(): void {
     this.send({ cmd: 'rescan' });
   }
 
+  /**
+   * 処理段階毎の所要時間（応答は type: "stats"）
+   * target 省略で現在の値、"on"（value ms 毎に送信。0 なら1回のみ）/ "off" / "reset" / "timestamps"（value 1 で delta に sampleUs を付ける）
+   */
+  stats(target?: 'on' | 'off' | 'reset' | 'timestamps', value = 0): void {
+    this.send(target ? { cmd: 'stats', target, value } : { cmd: 'stats' });
+  }
+
+  /** 受け取る値の購読（グループ名・値の名前・"CARD*" のような前方一致。null で全値） */
+  subscribe(groups: string[] | null): void {
+    this.subscription = groups;
+    this.send(groups ? { cmd: 'subscribe', groups } : { cmd: 'subscribe', groups: ['*'] });
+  }
+
   private scheduleReconnect(): void {
     if (this.stopped || this.reconnectTimer) return;
     this.reconnectTimer = setTimeout(() => {
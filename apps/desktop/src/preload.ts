@@ -51,6 +51,10 @@ contextBridge.exposeInMainWorld('gameAPI', {
   rescan: () => {
     ipcRenderer.send('game-rescan');
   },
+  // 受け取る値の購読（グループ名・パターン。null で全値）
+  subscribe: (groups: string[] | null) => {
+    ipcRenderer.send('game-subscribe', groups);
+  },
 });
 
 console.log('preload.js finished!');
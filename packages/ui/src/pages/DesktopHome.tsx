@@ -28,6 +28,7 @@ declare global {
       ping: () => void;
       setVersion: (version: string) => void;
       rescan: () => void;
+      subscribe: (groups: string[] | null) => void;
     };
     electronAPI?: {
       openExternal: (url: string) => void;
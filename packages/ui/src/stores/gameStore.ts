@@ -58,15 +58,18 @@ export interface HelloMessage {
   type: 'hello';
   version: string;
   addresses: number;
+  seq: number;
 }
 
 export interface FullMessage {
   type: 'full';
+  seq: number;
   data: Record<string, { v: string; a: string; s: number }>;
 }
 
 export interface DeltaMessage {
   type: 'delta';
+  seq: number;
   data: Record<string, { v: string }>;
 }
 